@@ -0,0 +1,55 @@
+'use strict';
+
+// Deep chains of async context frames with several stores active, comparing
+// the native AsyncContextFrame trie with copying a Map on every update.
+const common = require('../common.js');
+
+const bench = common.createBenchmark(main, {
+  impl: ['native', 'map'],
+  stores: [1, 4, 16],
+  depth: [10, 100],
+  n: [1e4],
+}, {
+  flags: ['--expose-internals'],
+});
+
+function createNativeFrame() {
+  const { internalBinding } = require('internal/test/binding');
+  const { AsyncContextFrame } = internalBinding('async_context_frame');
+  return new AsyncContextFrame();
+}
+
+function createMapFrame() {
+  return {
+    map: new Map(),
+    get(key) { return this.map.get(key); },
+    set(key, value) {
+      const frame = createMapFrame();
+      frame.map = new Map(this.map);
+      frame.map.set(key, value);
+      return frame;
+    },
+  };
+}
+
+function main({ impl, stores, depth, n }) {
+  const keys = Array.from({ length: stores }, () => ({}));
+  let root = impl === 'native' ? createNativeFrame() : createMapFrame();
+  for (const key of keys) root = root.set(key, 0);
+
+  let sum = 0;
+  bench.start();
+  for (let i = 0; i < n; i++) {
+    // Every level of the chain enters a new value for one of the stores,
+    // like nested AsyncLocalStorage.run() calls, and the callbacks read the
+    // stores back.
+    let frame = root;
+    for (let d = 0; d < depth; d++) {
+      frame = frame.set(keys[d % stores], d);
+      sum += frame.get(keys[0]);
+    }
+  }
+  bench.end(n * depth);
+
+  if (sum < 0) throw new Error('unreachable');
+}
@@ -0,0 +1,63 @@
+'use strict';
+
+// Splitting newline-delimited JSON into records, comparing the native bulk
+// splitOffsets() with a loop of buffer.indexOf() calls.
+const common = require('../common.js');
+
+const bench = common.createBenchmark(main, {
+  impl: ['splitOffsets', 'indexOf'],
+  recordSize: [16, 256],
+  size: [64 * 1024 * 1024],
+  n: [4],
+}, {
+  flags: ['--expose-internals'],
+});
+
+function createInput(recordSize, size) {
+  const record = Buffer.from(
+    `${JSON.stringify({ data: 'x'.repeat(Math.max(recordSize - 12, 0)) })}\n`);
+  const buffer = Buffer.allocUnsafe(size - size % record.length);
+  for (let i = 0; i < buffer.length; i += record.length) record.copy(buffer, i);
+  return buffer;
+}
+
+function splitNative(buffer, offsets) {
+  const { internalBinding } = require('internal/test/binding');
+  const { splitOffsets } = internalBinding('buffer');
+  const newline = Buffer.from('\n');
+  let records = 0;
+  let start = 0;
+  for (;;) {
+    const count = splitOffsets(buffer, newline, offsets, start);
+    records += count;
+    const end = offsets[count - 1];
+    if (end === buffer.length) return records;
+    start = end + 1;
+  }
+}
+
+function splitIndexOf(buffer) {
+  let records = 0;
+  let start = 0;
+  for (;;) {
+    const end = buffer.indexOf(10, start);
+    records++;
+    if (end === -1) return records;
+    start = end + 1;
+  }
+}
+
+function main({ impl, recordSize, size, n }) {
+  const buffer = createInput(recordSize, size);
+  const offsets = new Uint32Array(64 * 1024);
+  const split = impl === 'splitOffsets' ?
+    () => splitNative(buffer, offsets) :
+    () => splitIndexOf(buffer);
+
+  let records = 0;
+  bench.start();
+  for (let i = 0; i < n; i++) records += split();
+  bench.end(n * buffer.length / (1024 * 1024));
+
+  if (records === 0) throw new Error('unreachable');
+}
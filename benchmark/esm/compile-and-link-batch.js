@@ -0,0 +1,80 @@
+'use strict';
+
+// Compiling, linking and instantiating a synthetic graph of ES modules,
+// comparing the batched compileAndLinkModules() with one ModuleWrap binding
+// call per module and per step, the way the loader walks the graph.
+const common = require('../common.js');
+
+const bench = common.createBenchmark(main, {
+  impl: ['batch', 'perModule'],
+  modules: [100, 3000],
+  functions: [20],
+  n: [5],
+}, {
+  flags: ['--expose-internals'],
+});
+
+// Module i imports modules 2i + 1 and 2i + 2, so the graph is a binary tree
+// rooted at the entry point, which comes first.
+function createGraph(iteration, modules, functions) {
+  const urls = [];
+  const sources = [];
+  for (let i = 0; i < modules; i++) {
+    let source = '';
+    for (const child of [2 * i + 1, 2 * i + 2]) {
+      if (child < modules) {
+        source += `import { f0 as d${child} } from './mod-${child}.mjs';\n`;
+      }
+    }
+    for (let j = 0; j < functions; j++) {
+      source += `export function f${j}(a, b) {\n` +
+                `  const list = [a, b, ${i}, ${j}];\n` +
+                '  return list.map((x) => x * 2).reduce((x, y) => x + y);\n' +
+                '}\n';
+    }
+    urls.push(`file:///bench/${iteration}/mod-${i}.mjs`);
+    sources.push(source);
+  }
+  return { urls, sources };
+}
+
+function resolve(specifier, referrer) {
+  return new URL(specifier, referrer).href;
+}
+
+function loadPerModule(ModuleWrap, { urls, sources }) {
+  const wraps = new Map();
+  for (let i = 0; i < urls.length; i++) {
+    wraps.set(urls[i], new ModuleWrap(urls[i], undefined, sources[i], 0, 0));
+  }
+  for (const [url, wrap] of wraps) {
+    const requests = wrap.getModuleRequests();
+    const linked = requests.map(({ specifier }) => {
+      return wraps.get(resolve(specifier, url));
+    });
+    wrap.link(linked);
+  }
+  wraps.get(urls[0]).instantiate();
+}
+
+async function loadBatch(compileAndLinkModules, { urls, sources }) {
+  const { 1: errors } = await compileAndLinkModules(urls, sources);
+  if (errors.some((error) => error !== undefined)) throw errors.find(Boolean);
+}
+
+async function main({ impl, modules, functions, n }) {
+  const { internalBinding } = require('internal/test/binding');
+  const { ModuleWrap, compileAndLinkModules } = internalBinding('module_wrap');
+  const graphs = [];
+  for (let i = 0; i < n; i++) graphs.push(createGraph(i, modules, functions));
+
+  bench.start();
+  for (const graph of graphs) {
+    if (impl === 'batch') {
+      await loadBatch(compileAndLinkModules, graph);
+    } else {
+      loadPerModule(ModuleWrap, graph);
+    }
+  }
+  bench.end(n * modules);
+}
@@ -0,0 +1,54 @@
+'use strict';
+
+// Histogram#record() from several threads sharing one histogram, with and
+// without per-thread shards.
+const common = require('../common.js');
+const { Worker } = require('worker_threads');
+
+const bench = common.createBenchmark(main, {
+  sharded: [0, 1],
+  threads: [1, 4],
+  n: [1e6],
+}, {
+  flags: ['--expose-internals'],
+});
+
+const workerCode = `
+const { parentPort, workerData } = require('worker_threads');
+const { histogram, count } = workerData;
+parentPort.once('message', () => {
+  for (let i = 0; i < count; i++)
+    histogram.record(1 + (i & 0xffff));
+  parentPort.postMessage('done');
+});
+parentPort.postMessage('ready');
+`;
+
+function main({ sharded, threads, n }) {
+  const { internalBinding } = require('internal/test/binding');
+  const { Histogram } = internalBinding('performance');
+  const histogram = new Histogram(1, Number.MAX_SAFE_INTEGER, 3, !!sharded);
+  const count = Math.ceil(n / threads);
+  const workers = [];
+  let ready = 0;
+  let done = 0;
+
+  for (let i = 0; i < threads; i++) {
+    const worker = new Worker(workerCode, {
+      eval: true,
+      workerData: { histogram, count },
+    });
+    worker.on('message', (message) => {
+      if (message === 'ready') {
+        // Start all threads at once, after they have started up.
+        if (++ready < threads) return;
+        bench.start();
+        for (const w of workers) w.postMessage('go');
+      } else if (++done === threads) {
+        bench.end(count * threads);
+        for (const w of workers) w.terminate();
+      }
+    });
+    workers.push(worker);
+  }
+}
@@ -0,0 +1,52 @@
+'use strict';
+
+// fs calls with and without the permission model, with a growing number of
+// allowed paths. Every configuration runs in its own process, because the
+// permission model can only be enabled at startup.
+const common = require('../common.js');
+const { spawnSync } = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const bench = common.createBenchmark(main, {
+  permission: ['off', 'on'],
+  paths: [1, 100, 1000],
+  n: [1e5],
+});
+
+const workload = `
+  const fs = require('fs');
+  const [file, n] = process.argv.slice(1);
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < n; i++) {
+    fs.statSync(file);
+    fs.existsSync(file + '.missing');
+  }
+  console.log(String(process.hrtime.bigint() - start));
+`;
+
+function main({ permission, paths, n }) {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'bench-permission-'));
+  const file = path.join(dir, 'file.txt');
+  fs.writeFileSync(file, '');
+
+  const args = [];
+  if (permission === 'on') {
+    args.push('--permission');
+    // Unrelated directories next to the file, so that every lookup passes a
+    // node with that many children.
+    for (let i = 1; i < paths; i++) {
+      args.push(`--allow-fs-read=${path.join(dir, `dir-${i}`, '*')}`);
+    }
+    args.push(`--allow-fs-read=${dir}`);
+  }
+  args.push('-e', workload, file, String(n));
+
+  const child = spawnSync(process.execPath, args, { encoding: 'utf8' });
+  fs.rmSync(dir, { recursive: true });
+  if (child.status !== 0) throw new Error(child.stderr);
+  const elapsed = Number(child.stdout.trim()) / 1e9;
+  // Two fs calls per iteration.
+  bench.report(2 * n / elapsed, elapsed);
+}
@@ -0,0 +1,62 @@
+'use strict';
+
+// Client-to-server throughput over a loopback TLS 1.3 connection, with the
+// client's records encrypted by OpenSSL into the memory BIO or, with ktls=1,
+// by the kernel. Builds without kernel TLS support measure the memory BIO
+// path in both configurations.
+const common = require('../common.js');
+const fixtures = require('../../test/common/fixtures');
+const tls = require('tls');
+
+const bench = common.createBenchmark(main, {
+  ktls: [0, 1],
+  size: [1024, 16 * 1024, 1024 * 1024],
+  dur: [5],
+});
+
+function main({ ktls, size, dur }) {
+  const chunk = Buffer.alloc(size, 'b');
+  const options = {
+    key: fixtures.readKey('rsa_private.pem'),
+    cert: fixtures.readKey('rsa_cert.crt'),
+    minVersion: 'TLSv1.3',
+  };
+
+  let received = 0;
+  const server = tls.createServer(options, (socket) => {
+    socket.on('data', (data) => {
+      received += data.length;
+    });
+    socket.on('error', () => {});
+  });
+
+  server.listen(0, () => {
+    const conn = tls.connect({
+      port: server.address().port,
+      rejectUnauthorized: false,
+      minVersion: 'TLSv1.3',
+    }, () => {
+      // The switch to kernel TLS happens right after the handshake.
+      setImmediate(start);
+    });
+    if (ktls) {
+      conn._handle.enableKTLS();
+    }
+
+    function write() {
+      while (conn.write(chunk));
+    }
+
+    function start() {
+      conn.on('drain', write);
+      bench.start();
+      setTimeout(() => {
+        const mbits = (received * 8) / (1024 * 1024);
+        bench.end(mbits);
+        conn.destroy();
+        server.close();
+      }, dur * 1000);
+      write();
+    }
+  });
+}
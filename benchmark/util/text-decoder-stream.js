@@ -0,0 +1,55 @@
+'use strict';
+
+// Decoding text that arrives in network-sized chunks, comparing the native
+// streaming UTF8Decoder with TextDecoder's stream mode.
+const common = require('../common.js');
+
+const bench = common.createBenchmark(main, {
+  impl: ['native', 'TextDecoder'],
+  type: ['ascii', 'mixed'],
+  chunkSize: [1024, 16 * 1024, 64 * 1024],
+  n: [1e3],
+}, {
+  flags: ['--expose-internals'],
+});
+
+function createInput(type, chunkSize) {
+  const text = type === 'ascii' ?
+    'Lorem ipsum dolor sit amet, consectetur adipiscing elit. ' :
+    'Lorem ipsum dolor sit amet, Ünïcödé テキスト 🚀 consectetur. ';
+  const repeat = Math.ceil(chunkSize * 16 / text.length);
+  const buffer = Buffer.from(text.repeat(repeat));
+  // Chunk boundaries split multi-byte characters like a socket would.
+  const chunks = [];
+  for (let i = 0; i < buffer.length; i += chunkSize) {
+    chunks.push(buffer.subarray(i, i + chunkSize));
+  }
+  return chunks;
+}
+
+function main({ impl, type, chunkSize, n }) {
+  const chunks = createInput(type, chunkSize);
+  let decoder;
+  if (impl === 'native') {
+    const { internalBinding } = require('internal/test/binding');
+    const { UTF8Decoder } = internalBinding('encoding_binding');
+    decoder = new UTF8Decoder(false, false);
+  } else {
+    decoder = new TextDecoder();
+  }
+  const options = { stream: true };
+  const bytes = chunks.reduce((total, chunk) => total + chunk.length, 0);
+
+  let length = 0;
+  bench.start();
+  for (let i = 0; i < n; i++) {
+    for (const chunk of chunks) {
+      length += impl === 'native' ?
+        decoder.decode(chunk, true).length :
+        decoder.decode(chunk, options).length;
+    }
+  }
+  bench.end(n * bytes / (1024 * 1024));
+
+  if (length === 0) throw new Error('unreachable');
+}
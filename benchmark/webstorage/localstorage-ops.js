@@ -0,0 +1,47 @@
+'use strict';
+
+// localStorage reads, writes and key iteration on a file-backed store.
+const common = require('../common.js');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'bench-webstorage-'));
+
+const bench = common.createBenchmark(main, {
+  op: ['getItem', 'setItem', 'key'],
+  entries: [100, 10000],
+  n: [1e5],
+}, {
+  flags: [`--localstorage-file=${path.join(dir, 'storage.db')}`],
+});
+
+function main({ op, entries, n }) {
+  localStorage.clear();
+  for (let i = 0; i < entries; i++) {
+    localStorage.setItem(`key-${i}`, `value-${i}`);
+  }
+
+  bench.start();
+  switch (op) {
+    case 'getItem':
+      for (let i = 0; i < n; i++) {
+        localStorage.getItem(`key-${i % entries}`);
+      }
+      break;
+    case 'setItem':
+      for (let i = 0; i < n; i++) {
+        localStorage.setItem(`key-${i % entries}`, `value-${i}`);
+      }
+      break;
+    case 'key':
+      for (let i = 0; i < n; i++) {
+        localStorage.key(i % entries);
+      }
+      break;
+  }
+  bench.end(n);
+
+  localStorage.clear();
+  process.on('exit', () => fs.rmSync(dir, { recursive: true, force: true }));
+}
@@ -0,0 +1,46 @@
+'use strict';
+
+// Many workers posting to a single receiving port at the same time.
+const common = require('../common.js');
+const { Worker, BroadcastChannel } = require('worker_threads');
+
+const bench = common.createBenchmark(main, {
+  workers: [1, 4, 16],
+  payload: ['string', 'object'],
+  n: [1e5],
+});
+
+const workerCode = `
+const { BroadcastChannel, workerData } = require('worker_threads');
+const { name, payload, count } = workerData;
+const channel = new BroadcastChannel(name);
+const data = payload === 'string' ?
+  'x'.repeat(100) :
+  { a: 1, b: 'hello', c: [1, 2, 3], d: { e: true } };
+for (let i = 0; i < count; i++)
+  channel.postMessage(data);
+channel.close();
+`;
+
+function main({ workers, payload, n }) {
+  const name = `messageport-fan-in-${process.pid}`;
+  const channel = new BroadcastChannel(name);
+  const count = Math.ceil(n / workers);
+  const total = count * workers;
+  let received = 0;
+
+  channel.onmessage = () => {
+    if (++received === total) {
+      bench.end(total);
+      channel.close();
+    }
+  };
+
+  bench.start();
+  for (let i = 0; i < workers; i++) {
+    new Worker(workerCode, {
+      eval: true,
+      workerData: { name, payload, count },
+    });
+  }
+}
@@ -0,0 +1,47 @@
+'use strict';
+
+// Round trips of small JSON-like payloads through a MessageChannel.
+const common = require('../common.js');
+const { MessageChannel, receiveMessageOnPort } = require('worker_threads');
+
+const bench = common.createBenchmark(main, {
+  payload: ['number', 'string', 'record', 'records', 'typedarray', 'map'],
+  n: [1e5],
+});
+
+function createPayload(payload) {
+  switch (payload) {
+    case 'number':
+      return 42;
+    case 'string':
+      return 'hello world';
+    case 'record':
+      return { id: 1, method: 'add', args: [1, 2], ok: true };
+    case 'records':
+      return Array.from({ length: 16 }, (_, i) => ({
+        id: i,
+        name: `item${i}`,
+        price: i * 1.5,
+        tags: ['a', 'b'],
+      }));
+    case 'typedarray':
+      return { id: 1, data: new Float64Array(64) };
+    case 'map':
+      // Not plain data, always uses the V8 serializer.
+      return new Map([[1, 'a'], [2, 'b']]);
+  }
+}
+
+function main({ payload, n }) {
+  const { port1, port2 } = new MessageChannel();
+  const data = createPayload(payload);
+
+  bench.start();
+  for (let i = 0; i < n; i++) {
+    port1.postMessage(data);
+    receiveMessageOnPort(port2);
+  }
+  bench.end(n);
+
+  port1.close();
+}
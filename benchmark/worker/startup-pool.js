@@ -0,0 +1,36 @@
+'use strict';
+
+// Time from `new Worker()` to the worker running its first statement, with
+// and without standby threads in the native worker pool.
+const common = require('../common.js');
+const { Worker } = require('worker_threads');
+
+const bench = common.createBenchmark(main, {
+  pool: [0, 4],
+  n: [100],
+}, { flags: ['--expose-internals'] });
+
+function main({ pool, n }) {
+  const { internalBinding } = require('internal/test/binding');
+  const binding = internalBinding('worker');
+  binding.configureWorkerPool(pool);
+
+  let remaining = n;
+  function spawn() {
+    const worker = new Worker(
+      'require("worker_threads").parentPort.postMessage(0)',
+      { eval: true });
+    worker.once('message', () => worker.terminate());
+    worker.once('exit', () => {
+      if (--remaining > 0) return spawn();
+      bench.end(n);
+      binding.configureWorkerPool(0);
+    });
+  }
+
+  // Give the standby threads time to start up.
+  setTimeout(() => {
+    bench.start();
+    spawn();
+  }, 100);
+}
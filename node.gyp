@@ -85,6 +85,7 @@
       'src/env.cc',
       'src/fs_event_wrap.cc',
       'src/handle_wrap.cc',
+      'src/heap_snapshot_binary.cc',
       'src/heap_utils.cc',
       'src/histogram.cc',
       'src/internal_only_v8.cc',
@@ -106,6 +107,7 @@
       'src/node_binding.cc',
       'src/node_blob.cc',
       'src/node_buffer.cc',
+      'src/node_buffer_search.cc',
       'src/node_builtins.cc',
       'src/node_config.cc',
       'src/node_config_file.cc',
@@ -139,6 +141,7 @@
       'src/node_report.cc',
       'src/node_report_module.cc',
       'src/node_report_utils.cc',
+      'src/node_sampling_profiler.cc',
       'src/node_sea.cc',
       'src/node_serdes.cc',
       'src/node_shadow_realm.cc',
@@ -183,6 +186,7 @@
       'src/tracing/agent.cc',
       'src/tracing/node_trace_buffer.cc',
       'src/tracing/node_trace_writer.cc',
+      'src/tracing/perfetto_trace_writer.cc',
       'src/tracing/trace_event.cc',
       'src/tracing/traced_value.cc',
       'src/tty_wrap.cc',
@@ -236,6 +240,7 @@
       'src/env.h',
       'src/env-inl.h',
       'src/handle_wrap.h',
+      'src/heap_snapshot_binary.h',
       'src/histogram.h',
       'src/histogram-inl.h',
       'src/js_stream.h',
@@ -244,6 +249,7 @@
       'src/large_pages/node_large_page.h',
       'src/memory_tracker.h',
       'src/memory_tracker-inl.h',
+      'src/mpsc_queue.h',
       'src/module_wrap.h',
       'src/node.h',
       'src/node_api.h',
@@ -251,6 +257,7 @@
       'src/node_binding.h',
       'src/node_blob.h',
       'src/node_buffer.h',
+      'src/node_buffer_search.h',
       'src/node_builtins.h',
       'src/node_config_file.h',
       'src/node_constants.h',
@@ -291,6 +298,7 @@
       'src/node_report.h',
       'src/node_revert.h',
       'src/node_root_certs.h',
+      'src/node_sampling_profiler.h',
       'src/node_sea.h',
       'src/node_shadow_realm.h',
       'src/node_snapshotable.h',
@@ -332,6 +340,7 @@
       'src/tracing/agent.h',
       'src/tracing/node_trace_buffer.h',
       'src/tracing/node_trace_writer.h',
+      'src/tracing/perfetto_trace_writer.h',
       'src/tracing/trace_event.h',
       'src/tracing/trace_event_common.h',
       'src/tracing/traced_value.h',
@@ -387,6 +396,7 @@
       'src/crypto/crypto_keys.cc',
       'src/crypto/crypto_keygen.cc',
       'src/crypto/crypto_scrypt.cc',
+      'src/crypto/crypto_session_cache.cc',
       'src/crypto/crypto_tls.cc',
       'src/crypto/crypto_x509.cc',
       'src/crypto/crypto_argon2.h',
@@ -405,6 +415,7 @@
       'src/crypto/crypto_keys.h',
       'src/crypto/crypto_keygen.h',
       'src/crypto/crypto_scrypt.h',
+      'src/crypto/crypto_session_cache.h',
       'src/crypto/crypto_tls.h',
       'src/crypto/crypto_clienthello.h',
       'src/crypto/crypto_context.h',
@@ -421,6 +432,7 @@
     ],
     'node_cctest_openssl_sources': [
       'test/cctest/test_crypto_clienthello.cc',
+      'test/cctest/test_crypto_session_cache.cc',
       'test/cctest/test_node_crypto.cc',
       'test/cctest/test_node_crypto_env.cc',
       'test/cctest/test_quic_cid.cc',
@@ -434,6 +446,9 @@
       'test/cctest/test_inspector_socket.cc',
       'test/cctest/test_inspector_socket_server.cc',
     ],
+    'node_cctest_sqlite_sources': [
+      'test/cctest/test_node_webstorage.cc',
+    ],
     'node_sqlite_sources': [
       'src/node_sqlite.cc',
       'src/node_webstorage.cc',
@@ -1259,6 +1274,11 @@
            ],
            'sources!': [ '<@(node_cctest_inspector_sources)' ],
         }],
+        [ 'node_use_sqlite=="true"', {
+          'defines': [ 'HAVE_SQLITE=1' ],
+        }, {
+          'sources!': [ '<@(node_cctest_sqlite_sources)' ],
+        }],
         ['OS=="solaris"', {
           'ldflags': [ '-I<(SHARED_INTERMEDIATE_DIR)' ]
         }],
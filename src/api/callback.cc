@@ -2,6 +2,7 @@
 #include "async_wrap-inl.h"
 #include "env-inl.h"
 #include "node.h"
+#include "node_perf.h"
 #include "v8.h"
 
 namespace node {
@@ -90,6 +91,12 @@ InternalCallbackScope::InternalCallbackScope(
 
   env->PushAsyncCallbackScope();
 
+  // Entering JavaScript from the event loop starts a new tick of the coarse
+  // clock.
+  if (env->async_callback_scope_depth() == 1) {
+    env->performance_state()->RefreshCoarseClock();
+  }
+
   if (!env->can_call_into_js()) {
     failed_ = true;
     return;
@@ -171,6 +178,8 @@ void InternalCallbackScope::Close() {
   if (!env_->can_call_into_js()) return;
 
   auto weakref_cleanup = OnScopeLeave([&]() { env_->RunWeakRefCleanup(); });
+  performance::EventLoopPhaseProfiler::Scope phase_scope(
+      env_, performance::NODE_PERFORMANCE_LOOP_PHASE_MICROTASKS);
 
   Local<Context> context = env_->context();
   if (!tick_info->has_tick_scheduled()) {
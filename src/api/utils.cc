@@ -1,4 +1,5 @@
 #include "node.h"
+#include "node_internals.h"
 
 #include <csignal>
 
@@ -166,4 +167,13 @@ const char* signo_string(int signo) {
   }
 }
 
+int SignalFromName(std::string_view name) {
+#ifdef NSIG
+  for (int signo = 1; signo < NSIG; signo++) {
+    if (name == signo_string(signo)) return signo;
+  }
+#endif
+  return 0;
+}
+
 }  // namespace node
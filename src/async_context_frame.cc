@@ -1,5 +1,6 @@
 #include "async_context_frame.h"  // NOLINT(build/include_inline)
 
+#include "cppgc_helpers-inl.h"
 #include "env-inl.h"
 #include "node_errors.h"
 #include "node_external_reference.h"
@@ -10,10 +11,17 @@
 
 #include "v8.h"
 
+#include <algorithm>
+#include <bit>
+#include <memory>
+
 using v8::Context;
+using v8::FunctionCallbackInfo;
+using v8::FunctionTemplate;
 using v8::Isolate;
 using v8::Local;
 using v8::Object;
+using v8::ObjectTemplate;
 using v8::String;
 using v8::Value;
 
@@ -38,6 +46,12 @@ Local<Value> current(Isolate* isolate) {
 }
 
 void set(Isolate* isolate, Local<Value> value) {
+  // Most callbacks run in the frame that is already current, which does not
+  // need the Environment lookup below.
+  if (current(isolate) == value) {
+    return;
+  }
+
   auto env = Environment::GetCurrent(isolate);
   if (!env->options()->async_context_frame) {
     return;
@@ -54,6 +68,353 @@ Local<Value> exchange(Isolate* isolate, Local<Value> value) {
   return prior;
 }
 
+//
+// AsyncContextFrame
+//
+namespace {
+
+using Child = AsyncContextFrame::Child;
+using Entry = AsyncContextFrame::Entry;
+using Node = AsyncContextFrame::Node;
+
+constexpr int kBitsPerLevel = AsyncContextFrame::kBitsPerLevel;
+// Identity hashes are 32 bits wide, nodes at this shift hold collisions.
+constexpr int kCollisionShift = 35;
+
+inline uint32_t SlotBit(int hash, int shift) {
+  return 1u << ((static_cast<uint32_t>(hash) >> shift) &
+                AsyncContextFrame::kLevelMask);
+}
+
+inline size_t SlotIndex(uint32_t bitmap, uint32_t bit) {
+  return std::popcount(bitmap & (bit - 1));
+}
+
+inline bool Matches(const Entry* entry, int hash, Local<Object> key) {
+  return entry->hash == hash && entry->key == key;
+}
+
+const Entry* Find(const Node* node, int hash, Local<Object> key) {
+  for (int shift = 0; node != nullptr; shift += kBitsPerLevel) {
+    if (shift == kCollisionShift) {
+      for (uint32_t i = 0; i < node->count; i++) {
+        const Entry* entry = node->children()[i].entry;
+        if (Matches(entry, hash, key)) return entry;
+      }
+      return nullptr;
+    }
+    uint32_t bit = SlotBit(hash, shift);
+    if ((node->bitmap & bit) == 0) return nullptr;
+    const Child& child = node->children()[SlotIndex(node->bitmap, bit)];
+    if (child.entry) {
+      return Matches(child.entry, hash, key) ? child.entry.Get() : nullptr;
+    }
+    node = child.node;
+  }
+  return nullptr;
+}
+
+// Returns a copy of node (which may be null) with entry added, sharing all
+// subtrees that are not on the path to it. Sets *replaced if an entry with
+// the same key was already present.
+const Node* Insert(cppgc::AllocationHandle& handle,
+                   const Node* node,
+                   int shift,
+                   const Entry* entry,
+                   bool* replaced) {
+  const uint32_t count = node != nullptr ? node->count : 0;
+  if (shift == kCollisionShift) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (node->children()[i].entry->key == entry->key) {
+        Node* copy = Node::Copy(handle, node, 0, count);
+        copy->children()[i].entry = entry;
+        *replaced = true;
+        return copy;
+      }
+    }
+    Node* copy = Node::Copy(handle, node, 0, count + 1);
+    copy->children()[count].entry = entry;
+    return copy;
+  }
+
+  const uint32_t bitmap = node != nullptr ? node->bitmap : 0;
+  uint32_t bit = SlotBit(entry->hash, shift);
+  size_t index = SlotIndex(bitmap, bit);
+  if ((bitmap & bit) == 0) {
+    Node* copy = Node::New(handle, bitmap | bit, count + 1);
+    for (size_t i = 0; i < count; i++) {
+      copy->children()[i < index ? i : i + 1] = node->children()[i];
+    }
+    copy->children()[index].entry = entry;
+    return copy;
+  }
+
+  Node* copy = Node::Copy(handle, node, bitmap, count);
+  Child& child = copy->children()[index];
+  if (child.node) {
+    child.node =
+        Insert(handle, child.node, shift + kBitsPerLevel, entry, replaced);
+  } else if (child.entry->key == entry->key) {
+    child.entry = entry;
+    *replaced = true;
+  } else {
+    // Move the existing entry one level down, next to the new one.
+    const Node* level = Insert(
+        handle, nullptr, shift + kBitsPerLevel, child.entry, replaced);
+    child.node = Insert(handle, level, shift + kBitsPerLevel, entry, replaced);
+    child.entry = nullptr;
+  }
+  return copy;
+}
+
+// Returns node itself if it does not contain key, nullptr if removing the
+// entry for key leaves it empty, or a copy without that entry.
+const Node* Remove(cppgc::AllocationHandle& handle,
+                   const Node* node,
+                   int shift,
+                   int hash,
+                   Local<Object> key) {
+  if (node == nullptr) return node;
+  if (shift == kCollisionShift) {
+    uint32_t index = 0;
+    while (index < node->count &&
+           !Matches(node->children()[index].entry, hash, key)) {
+      index++;
+    }
+    if (index == node->count) return node;
+    if (node->count == 1) return nullptr;
+    Node* copy = Node::New(handle, 0, node->count - 1);
+    for (uint32_t i = 0; i < copy->count; i++) {
+      copy->children()[i] = node->children()[i < index ? i : i + 1];
+    }
+    return copy;
+  }
+
+  uint32_t bit = SlotBit(hash, shift);
+  if ((node->bitmap & bit) == 0) return node;
+  size_t index = SlotIndex(node->bitmap, bit);
+  const Child& child = node->children()[index];
+  const Node* level = nullptr;
+  if (child.node) {
+    level = Remove(handle, child.node, shift + kBitsPerLevel, hash, key);
+    if (level == child.node) return node;
+  } else if (!Matches(child.entry, hash, key)) {
+    return node;
+  }
+
+  if (level != nullptr) {
+    Node* copy = Node::Copy(handle, node, node->bitmap, node->count);
+    // Pull a remaining single entry back up, to keep lookups short.
+    if (level->count == 1 && level->children()[0].entry) {
+      copy->children()[index] = level->children()[0];
+    } else {
+      copy->children()[index].node = level;
+    }
+    return copy;
+  }
+  if (node->count == 1) return nullptr;
+  Node* copy = Node::New(handle, node->bitmap & ~bit, node->count - 1);
+  for (size_t i = 0; i < copy->count; i++) {
+    copy->children()[i] = node->children()[i < index ? i : i + 1];
+  }
+  return copy;
+}
+
+}  // namespace
+
+void AsyncContextFrame::Entry::Trace(cppgc::Visitor* visitor) const {
+  visitor->Trace(key);
+  visitor->Trace(value);
+}
+
+AsyncContextFrame::Node* AsyncContextFrame::Node::New(
+    cppgc::AllocationHandle& handle, uint32_t bitmap, uint32_t count) {
+  return cppgc::MakeGarbageCollected<Node>(
+      handle, cppgc::AdditionalBytes(count * sizeof(Child)), bitmap, count);
+}
+
+AsyncContextFrame::Node* AsyncContextFrame::Node::Copy(
+    cppgc::AllocationHandle& handle,
+    const Node* node,
+    uint32_t bitmap,
+    uint32_t count) {
+  Node* copy = New(handle, bitmap, count);
+  if (node != nullptr) {
+    std::copy_n(node->children(), std::min(count, node->count),
+                copy->children());
+  }
+  return copy;
+}
+
+AsyncContextFrame::Node::Node(uint32_t bitmap, uint32_t count)
+    : bitmap(bitmap), count(count) {
+  std::uninitialized_value_construct_n(children(), count);
+}
+
+void AsyncContextFrame::Node::Trace(cppgc::Visitor* visitor) const {
+  for (uint32_t i = 0; i < count; i++) {
+    visitor->Trace(children()[i].entry);
+    visitor->Trace(children()[i].node);
+  }
+}
+
+AsyncContextFrame::AsyncContextFrame(Environment* env,
+                                     Local<Object> obj,
+                                     const Node* root,
+                                     size_t size,
+                                     const Entry* last_entry)
+    : root_(root), size_(size), last_entry_(last_entry) {
+  CppgcMixin::Wrap(this, env, obj);
+}
+
+void AsyncContextFrame::Trace(cppgc::Visitor* visitor) const {
+  CppgcMixin::Trace(visitor);
+  visitor->Trace(root_);
+  visitor->Trace(last_entry_);
+}
+
+const AsyncContextFrame::Entry* AsyncContextFrame::Lookup(Local<Object> key) {
+  if (last_entry_ && last_entry_->key == key) return last_entry_;
+  return Lookup(key->GetIdentityHash(), key);
+}
+
+const AsyncContextFrame::Entry* AsyncContextFrame::Lookup(int hash,
+                                                          Local<Object> key) {
+  const Entry* entry = Find(root_, hash, key);
+  if (entry != nullptr) last_entry_ = entry;
+  return entry;
+}
+
+AsyncContextFrame* AsyncContextFrame::With(Local<Object> key,
+                                           Local<Value> value) {
+  return With(key->GetIdentityHash(), key, value);
+}
+
+AsyncContextFrame* AsyncContextFrame::With(int hash,
+                                           Local<Object> key,
+                                           Local<Value> value) {
+  cppgc::AllocationHandle& handle = env()->cppgc_allocation_handle();
+  const Entry* entry = cppgc::MakeGarbageCollected<Entry>(
+      handle, env()->isolate(), hash, key, value);
+  bool replaced = false;
+  const Node* root = Insert(handle, root_, 0, entry, &replaced);
+  return Create(env(), root, replaced ? size_ : size_ + 1, entry);
+}
+
+AsyncContextFrame* AsyncContextFrame::Without(Local<Object> key) {
+  return Without(key->GetIdentityHash(), key);
+}
+
+AsyncContextFrame* AsyncContextFrame::Without(int hash, Local<Object> key) {
+  const Node* root =
+      Remove(env()->cppgc_allocation_handle(), root_, 0, hash, key);
+  if (root == root_) return this;
+  return Create(env(), root, size_ - 1, nullptr);
+}
+
+AsyncContextFrame* AsyncContextFrame::Create(Environment* env) {
+  return Create(env, nullptr, 0, nullptr);
+}
+
+AsyncContextFrame* AsyncContextFrame::Create(Environment* env,
+                                             const Node* root,
+                                             size_t size,
+                                             const Entry* last_entry) {
+  Local<Object> obj;
+  if (!GetConstructorTemplate(env->isolate_data())
+           ->InstanceTemplate()
+           ->NewInstance(env->context())
+           .ToLocal(&obj)) {
+    return nullptr;
+  }
+  return cppgc::MakeGarbageCollected<AsyncContextFrame>(
+      env->cppgc_allocation_handle(), env, obj, root, size, last_entry);
+}
+
+void AsyncContextFrame::New(const FunctionCallbackInfo<Value>& args) {
+  CHECK(args.IsConstructCall());
+  Environment* env = Environment::GetCurrent(args);
+  DCHECK_NOT_NULL(env->isolate()->GetCppHeap());
+  cppgc::MakeGarbageCollected<AsyncContextFrame>(
+      env->cppgc_allocation_handle(), env, args.This(), nullptr, 0, nullptr);
+}
+
+void AsyncContextFrame::Get(const FunctionCallbackInfo<Value>& args) {
+  AsyncContextFrame* frame;
+  ASSIGN_OR_RETURN_UNWRAP_CPPGC(&frame, args.This());
+  CHECK(args[0]->IsObject());
+  const Entry* entry = frame->Lookup(args[0].As<Object>());
+  if (entry != nullptr) {
+    args.GetReturnValue().Set(entry->value.Get(args.GetIsolate()));
+  }
+}
+
+void AsyncContextFrame::Has(const FunctionCallbackInfo<Value>& args) {
+  AsyncContextFrame* frame;
+  ASSIGN_OR_RETURN_UNWRAP_CPPGC(&frame, args.This());
+  CHECK(args[0]->IsObject());
+  args.GetReturnValue().Set(frame->Lookup(args[0].As<Object>()) != nullptr);
+}
+
+void AsyncContextFrame::Set(const FunctionCallbackInfo<Value>& args) {
+  AsyncContextFrame* frame;
+  ASSIGN_OR_RETURN_UNWRAP_CPPGC(&frame, args.This());
+  CHECK(args[0]->IsObject());
+  AsyncContextFrame* result = frame->With(args[0].As<Object>(), args[1]);
+  if (result != nullptr) args.GetReturnValue().Set(result->object());
+}
+
+void AsyncContextFrame::Delete(const FunctionCallbackInfo<Value>& args) {
+  AsyncContextFrame* frame;
+  ASSIGN_OR_RETURN_UNWRAP_CPPGC(&frame, args.This());
+  CHECK(args[0]->IsObject());
+  AsyncContextFrame* result = frame->Without(args[0].As<Object>());
+  if (result != nullptr) args.GetReturnValue().Set(result->object());
+}
+
+void AsyncContextFrame::Size(const FunctionCallbackInfo<Value>& args) {
+  AsyncContextFrame* frame;
+  ASSIGN_OR_RETURN_UNWRAP_CPPGC(&frame, args.This());
+  args.GetReturnValue().Set(static_cast<double>(frame->size()));
+}
+
+Local<FunctionTemplate> AsyncContextFrame::GetConstructorTemplate(
+    IsolateData* isolate_data) {
+  Local<FunctionTemplate> tmpl =
+      isolate_data->async_context_frame_constructor_template();
+  if (tmpl.IsEmpty()) {
+    Isolate* isolate = isolate_data->isolate();
+    tmpl = NewFunctionTemplate(isolate, New);
+    tmpl->InstanceTemplate()->SetInternalFieldCount(
+        AsyncContextFrame::kInternalFieldCount);
+    SetProtoMethodNoSideEffect(isolate, tmpl, "get", Get);
+    SetProtoMethodNoSideEffect(isolate, tmpl, "has", Has);
+    SetProtoMethod(isolate, tmpl, "set", Set);
+    SetProtoMethod(isolate, tmpl, "delete", Delete);
+    SetProtoMethodNoSideEffect(isolate, tmpl, "size", Size);
+    isolate_data->set_async_context_frame_constructor_template(tmpl);
+  }
+  return tmpl;
+}
+
+void AsyncContextFrame::CreatePerIsolateProperties(
+    IsolateData* isolate_data, Local<ObjectTemplate> target) {
+  SetConstructorFunction(isolate_data->isolate(),
+                         target,
+                         "AsyncContextFrame",
+                         GetConstructorTemplate(isolate_data));
+}
+
+void AsyncContextFrame::RegisterExternalReferences(
+    ExternalReferenceRegistry* registry) {
+  registry->Register(New);
+  registry->Register(Get);
+  registry->Register(Has);
+  registry->Register(Set);
+  registry->Register(Delete);
+  registry->Register(Size);
+}
+
 void CreatePerContextProperties(Local<Object> target,
                                 Local<Value> unused,
                                 Local<Context> context,
@@ -87,3 +448,9 @@ void CreatePerContextProperties(Local<Object> target,
 
 NODE_BINDING_CONTEXT_AWARE_INTERNAL(
     async_context_frame, node::async_context_frame::CreatePerContextProperties)
+NODE_BINDING_PER_ISOLATE_INIT(
+    async_context_frame,
+    node::async_context_frame::AsyncContextFrame::CreatePerIsolateProperties)
+NODE_BINDING_EXTERNAL_REFERENCE(
+    async_context_frame,
+    node::async_context_frame::AsyncContextFrame::RegisterExternalReferences)
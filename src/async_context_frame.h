@@ -3,12 +3,18 @@
 
 #if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
 
-#include "base_object.h"
+#include "cppgc/allocation.h"
+#include "cppgc/member.h"
+#include "cppgc/visitor.h"
+#include "cppgc_helpers.h"
 #include "v8.h"
 
 #include <cstdint>
 
 namespace node {
+
+class ExternalReferenceRegistry;
+
 namespace async_context_frame {
 
 class Scope {
@@ -25,6 +31,121 @@ v8::Local<v8::Value> current(v8::Isolate* isolate);
 void set(v8::Isolate* isolate, v8::Local<v8::Value> value);
 v8::Local<v8::Value> exchange(v8::Isolate* isolate, v8::Local<v8::Value> value);
 
+// Immutable map from AsyncLocalStorage instances to their stores, meant to be
+// used as the continuation preserved embedder data. It is a hash array mapped
+// trie keyed by the identity hash of the instances, so set() and delete()
+// only copy the nodes on the path to the changed entry instead of the whole
+// map, and everything else is shared with the frame they were called on.
+// The frames, nodes and entries are all managed by cppgc, so that a store
+// that refers back to its frame does not keep the frame alive.
+class AsyncContextFrame final : CPPGC_MIXIN(AsyncContextFrame) {
+ public:
+  static constexpr int kBitsPerLevel = 5;
+  static constexpr uint32_t kLevelMask = (1 << kBitsPerLevel) - 1;
+
+  struct Entry final : public cppgc::GarbageCollected<Entry> {
+    Entry(v8::Isolate* isolate,
+          int hash,
+          v8::Local<v8::Object> key,
+          v8::Local<v8::Value> value)
+        : hash(hash), key(isolate, key), value(isolate, value) {}
+
+    void Trace(cppgc::Visitor* visitor) const;
+
+    const int hash;
+    const v8::TracedReference<v8::Object> key;
+    const v8::TracedReference<v8::Value> value;
+  };
+
+  // A child is either an entry or another node.
+  struct Node;
+  struct Child {
+    cppgc::Member<const Entry> entry;
+    cppgc::Member<const Node> node;
+  };
+
+  // Nodes below the last level, where all hash bits have been used, hold
+  // colliding entries in a plain list. The children are stored inline, right
+  // after the node.
+  struct Node final : public cppgc::GarbageCollected<Node> {
+    static Node* New(cppgc::AllocationHandle& handle,
+                     uint32_t bitmap,
+                     uint32_t count);
+    // Returns a copy of node with count children, the first ones copied.
+    static Node* Copy(cppgc::AllocationHandle& handle,
+                      const Node* node,
+                      uint32_t bitmap,
+                      uint32_t count);
+
+    Node(uint32_t bitmap, uint32_t count);
+    void Trace(cppgc::Visitor* visitor) const;
+
+    Child* children() { return reinterpret_cast<Child*>(this + 1); }
+    const Child* children() const {
+      return reinterpret_cast<const Child*>(this + 1);
+    }
+
+    const uint32_t bitmap;  // Which of the 32 slots of this level are used.
+    const uint32_t count;
+  };
+
+  AsyncContextFrame(Environment* env,
+                    v8::Local<v8::Object> obj,
+                    const Node* root,
+                    size_t size,
+                    const Entry* last_entry);
+
+  SET_CPPGC_NAME(AsyncContextFrame)
+  SET_NO_MEMORY_INFO()
+  void Trace(cppgc::Visitor* visitor) const final;
+
+  static void CreatePerIsolateProperties(IsolateData* isolate_data,
+                                         v8::Local<v8::ObjectTemplate> target);
+  static void RegisterExternalReferences(ExternalReferenceRegistry* registry);
+
+  // Returns an empty frame.
+  static AsyncContextFrame* Create(Environment* env);
+
+  // Returns the entry for key, or nullptr.
+  const Entry* Lookup(v8::Local<v8::Object> key);
+  // Return a frame that differs from this one in the entry for key.
+  AsyncContextFrame* With(v8::Local<v8::Object> key,
+                          v8::Local<v8::Value> value);
+  AsyncContextFrame* Without(v8::Local<v8::Object> key);
+
+  // Same as above, with the hash of key given. Exposed for testing, since
+  // the identity hashes of objects cannot be chosen.
+  const Entry* Lookup(int hash, v8::Local<v8::Object> key);
+  AsyncContextFrame* With(int hash,
+                          v8::Local<v8::Object> key,
+                          v8::Local<v8::Value> value);
+  AsyncContextFrame* Without(int hash, v8::Local<v8::Object> key);
+
+  const Node* root() const { return root_; }
+  size_t size() const { return size_; }
+
+ private:
+  static v8::Local<v8::FunctionTemplate> GetConstructorTemplate(
+      IsolateData* isolate_data);
+  static AsyncContextFrame* Create(Environment* env,
+                                   const Node* root,
+                                   size_t size,
+                                   const Entry* last_entry);
+
+  static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void Get(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void Has(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void Set(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void Delete(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void Size(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  const cppgc::Member<const Node> root_;
+  const size_t size_;
+  // Most lookups in a frame are for the same store, so the last entry that
+  // was found is checked before walking the trie.
+  cppgc::Member<const Entry> last_entry_;
+};
+
 }  // namespace async_context_frame
 }  // namespace node
 
@@ -4,8 +4,10 @@
 #include "env-inl.h"
 #include "node_file.h"
 #include "node_internals.h"
+#include "node_mutex.h"
 #include "node_version.h"
 #include "path.h"
+#include "threadpoolwork-inl.h"
 #include "util.h"
 #include "zlib.h"
 
@@ -105,20 +107,18 @@ const char* CompileCacheEntry::type_name() const {
   }
 }
 
-void CompileCacheHandler::ReadCacheFile(CompileCacheEntry* entry) {
-  Debug("[compile cache] reading cache from %s for %s %s...",
-        entry->cache_filename,
-        entry->type_name(),
-        entry->source_filename);
-
+std::unique_ptr<ScriptCompiler::CachedData>
+CompileCacheHandler::ReadCacheFileContents(const std::string& path,
+                                           uint32_t* code_size,
+                                           uint32_t* code_hash,
+                                           std::string* error) {
   uv_fs_t req;
   auto defer_req_cleanup = OnScopeLeave([&req]() { uv_fs_req_cleanup(&req); });
-  const char* path = entry->cache_filename.c_str();
-  uv_file file = uv_fs_open(nullptr, &req, path, O_RDONLY, 0, nullptr);
+  uv_file file = uv_fs_open(nullptr, &req, path.c_str(), O_RDONLY, 0, nullptr);
   if (req.result < 0) {
     // req will be cleaned up by scope leave.
-    Debug(" %s\n", uv_strerror(req.result));
-    return;
+    *error = uv_strerror(req.result);
+    return nullptr;
   }
   uv_fs_req_cleanup(&req);
 
@@ -134,41 +134,22 @@ void CompileCacheHandler::ReadCacheFile(CompileCacheEntry* entry) {
                                      kHeaderCount * sizeof(uint32_t));
   const int r = uv_fs_read(nullptr, &req, file, &headers_buf, 1, 0, nullptr);
   if (r != static_cast<int>(headers_buf.len)) {
-    Debug("reading header failed, bytes read %d", r);
-    if (req.result < 0 && is_debug_) {
-      Debug(", %s", uv_strerror(req.result));
+    *error = "reading header failed, bytes read " + std::to_string(r);
+    if (req.result < 0) {
+      *error += ", ";
+      *error += uv_strerror(req.result);
     }
-    Debug("\n");
-    return;
+    return nullptr;
   }
 
-  Debug("[%d %d %d %d %d]...",
-        headers[kMagicNumberOffset],
-        headers[kCodeSizeOffset],
-        headers[kCacheSizeOffset],
-        headers[kCodeHashOffset],
-        headers[kCacheHashOffset]);
-
   if (headers[kMagicNumberOffset] != kCacheMagicNumber) {
-    Debug("magic number mismatch: expected %d, actual %d\n",
-          kCacheMagicNumber,
-          headers[kMagicNumberOffset]);
-    return;
-  }
-
-  // Check the code size and hash which are already computed.
-  if (headers[kCodeSizeOffset] != entry->code_size) {
-    Debug("code size mismatch: expected %d, actual %d\n",
-          entry->code_size,
-          headers[kCodeSizeOffset]);
-    return;
-  }
-  if (headers[kCodeHashOffset] != entry->code_hash) {
-    Debug("code hash mismatch: expected %d, actual %d\n",
-          entry->code_hash,
-          headers[kCodeHashOffset]);
-    return;
+    *error = SPrintF("magic number mismatch: expected %d, actual %d",
+                     kCacheMagicNumber,
+                     headers[kMagicNumberOffset]);
+    return nullptr;
   }
+  *code_size = headers[kCodeSizeOffset];
+  *code_hash = headers[kCodeHashOffset];
 
   // Read the cache, grow the buffer exponentially whenever it fills up.
   size_t offset = headers_buf.len;
@@ -196,8 +177,8 @@ void CompileCacheHandler::ReadCacheFile(CompileCacheEntry* entry) {
     if (req.result < 0) {  // Error.
       // req will be cleaned up by scope leave.
       delete[] buffer;
-      Debug(" %s\n", uv_strerror(req.result));
-      return;
+      *error = uv_strerror(req.result);
+      return nullptr;
     }
     uv_fs_req_cleanup(&req);
     if (bytes_read <= 0) {
@@ -208,24 +189,118 @@ void CompileCacheHandler::ReadCacheFile(CompileCacheEntry* entry) {
 
   // Check the cache size and hash.
   if (headers[kCacheSizeOffset] != total_read) {
-    Debug("cache size mismatch: expected %d, actual %d\n",
-          headers[kCacheSizeOffset],
-          total_read);
-    return;
+    delete[] buffer;
+    *error = SPrintF("cache size mismatch: expected %d, actual %d",
+                     headers[kCacheSizeOffset],
+                     total_read);
+    return nullptr;
   }
   uint32_t cache_hash = GetHash(reinterpret_cast<char*>(buffer), total_read);
   if (headers[kCacheHashOffset] != cache_hash) {
-    Debug("cache hash mismatch: expected %d, actual %d\n",
-          headers[kCacheHashOffset],
-          cache_hash);
+    delete[] buffer;
+    *error = SPrintF("cache hash mismatch: expected %d, actual %d",
+                     headers[kCacheHashOffset],
+                     cache_hash);
+    return nullptr;
+  }
+
+  return std::make_unique<ScriptCompiler::CachedData>(
+      buffer, total_read, ScriptCompiler::CachedData::BufferOwned);
+}
+
+void CompileCacheHandler::ReadCacheFile(CompileCacheEntry* entry) {
+  Debug("[compile cache] reading cache from %s for %s %s...",
+        entry->cache_filename,
+        entry->type_name(),
+        entry->source_filename);
+
+  uint32_t code_size = 0;
+  uint32_t code_hash = 0;
+  std::string error;
+  std::unique_ptr<ScriptCompiler::CachedData> cache = ReadCacheFileContents(
+      entry->cache_filename, &code_size, &code_hash, &error);
+  if (!cache) {
+    Debug(" %s\n", error);
     return;
   }
 
-  entry->cache.reset(new ScriptCompiler::CachedData(
-      buffer, total_read, ScriptCompiler::CachedData::BufferOwned));
-  Debug(" success, size=%d\n", total_read);
+  // Check the code size and hash which are already computed.
+  if (code_size != entry->code_size) {
+    Debug(" code size mismatch: expected %d, actual %d\n",
+          entry->code_size,
+          code_size);
+    return;
+  }
+  if (code_hash != entry->code_hash) {
+    Debug(" code hash mismatch: expected %d, actual %d\n",
+          entry->code_hash,
+          code_hash);
+    return;
+  }
+
+  Debug(" success, size=%d\n", cache->length);
+  entry->cache = std::move(cache);
 }
 
+// State shared between a PrefetchWork running on the thread pool and the
+// handler, which drops its reference once the file is compiled. The results
+// are only touched by the main thread after `done` is set, and are dropped
+// with the work if the handler stopped waiting for them.
+struct CompileCacheHandler::PrefetchedCache {
+  Mutex mutex;
+  bool done = false;  // Guarded by mutex.
+  // The work that fills this in, while it is pending. Main thread only.
+  PrefetchWork* work = nullptr;
+  std::string cache_filename;
+  uint32_t code_size = 0;
+  uint32_t code_hash = 0;
+  std::string error;
+  std::unique_ptr<ScriptCompiler::CachedData> cache;
+  std::unique_ptr<ScriptCompiler::ConsumeCodeCacheTask> consume_task;
+};
+
+class CompileCacheHandler::PrefetchWork final : public ThreadPoolWork {
+ public:
+  PrefetchWork(Environment* env, std::shared_ptr<PrefetchedCache> prefetch)
+      : ThreadPoolWork(env, "compile_cache.prefetch"),
+        prefetch_(std::move(prefetch)) {}
+
+  void DoThreadPoolWork() override {
+    PrefetchedCache* prefetch = prefetch_.get();
+    prefetch->cache = ReadCacheFileContents(prefetch->cache_filename,
+                                            &prefetch->code_size,
+                                            &prefetch->code_hash,
+                                            &prefetch->error);
+    if (prefetch->cache) {
+      // V8 takes ownership of the cache it deserializes, the entry keeps the
+      // original since V8 wants to see it again when the task is consumed.
+      int length = prefetch->cache->length;
+      uint8_t* data = new uint8_t[length];
+      memcpy(data, prefetch->cache->data, length);
+      prefetch->consume_task.reset(
+          ScriptCompiler::StartConsumingCodeCacheOnBackground(
+              env()->isolate(),
+              std::make_unique<ScriptCompiler::CachedData>(
+                  data, length, ScriptCompiler::CachedData::BufferOwned)));
+      // This is null if V8 does not deserialize concurrently, the cache is
+      // then consumed on the main thread as usual.
+      if (prefetch->consume_task) {
+        prefetch->consume_task->Run();
+      }
+    }
+    Mutex::ScopedLock lock(prefetch->mutex);
+    prefetch->done = true;
+  }
+
+  void AfterThreadPoolWork(int status) override {
+    prefetch_->work = nullptr;
+    delete this;
+  }
+
+ private:
+  std::shared_ptr<PrefetchedCache> prefetch_;
+};
+
 static std::string GetRelativePath(std::string_view path,
                                    std::string_view base) {
 // On Windows, the native encoding is UTF-16, so we need to convert
@@ -245,14 +320,9 @@ static std::string GetRelativePath(std::string_view path,
   return std::string(u8str.begin(), u8str.end());
 }
 
-CompileCacheEntry* CompileCacheHandler::GetOrInsert(Local<String> code,
-                                                    Local<String> filename,
-                                                    CachedCodeType type) {
-  DCHECK(!compile_cache_dir_.empty());
-
-  Environment* env = Environment::GetCurrent(isolate_->GetCurrentContext());
-  Utf8Value filename_utf8(isolate_, filename);
-  std::string file_path = filename_utf8.ToString();
+std::optional<uint32_t> CompileCacheHandler::GetEntryKey(
+    Environment* env, std::string_view filename, CachedCodeType type) {
+  std::string file_path(filename);
   // If the portable cache is enabled and it seems possible to compute the
   // relative position from an absolute path, we use the relative position
   // in the cache key.
@@ -260,7 +330,7 @@ CompileCacheEntry* CompileCacheHandler::GetOrInsert(Local<String> code,
     // Normalize the path to ensure it is consistent.
     std::string normalized_file_path = NormalizeFileURLOrPath(env, file_path);
     if (normalized_file_path.empty()) {
-      return nullptr;
+      return std::nullopt;
     }
     std::string relative_path =
         GetRelativePath(normalized_file_path, normalized_compile_cache_dir_);
@@ -271,7 +341,97 @@ CompileCacheEntry* CompileCacheHandler::GetOrInsert(Local<String> code,
             compile_cache_dir_.c_str());
     }
   }
-  uint32_t key = GetCacheKey(file_path, type);
+  return GetCacheKey(file_path, type);
+}
+
+void CompileCacheHandler::Prefetch(Environment* env,
+                                   std::string_view filename,
+                                   CachedCodeType type) {
+  DCHECK(!compile_cache_dir_.empty());
+  if (prefetches_.size() >= kMaxPrefetches) {
+    return;
+  }
+  std::optional<uint32_t> key = GetEntryKey(env, filename, type);
+  if (!key.has_value() || compiler_cache_store_.contains(*key) ||
+      prefetches_.contains(*key)) {
+    return;
+  }
+
+  auto prefetch = std::make_shared<PrefetchedCache>();
+  prefetch->cache_filename =
+      compile_cache_dir_ + kPathSeparator + Uint32ToHex(*key);
+  Debug("[compile cache] prefetching %s for %s\n",
+        prefetch->cache_filename,
+        filename);
+  prefetch->work = new PrefetchWork(env, prefetch);
+  prefetch->work->ScheduleWork();
+  prefetches_.emplace(*key, std::move(prefetch));
+}
+
+bool CompileCacheHandler::TakePrefetchedCache(CompileCacheEntry* entry) {
+  auto it = prefetches_.find(entry->cache_key);
+  if (it == prefetches_.end()) {
+    return false;
+  }
+  std::shared_ptr<PrefetchedCache> prefetch = std::move(it->second);
+  prefetches_.erase(it);
+  {
+    // The main thread never blocks on a prefetch that is not done: V8 may
+    // need it to take part in a GC while deserializing on the background
+    // thread. The file is read here instead. A prefetch that has not started
+    // is cancelled, one that is running is left to finish, and its result is
+    // dropped with the work.
+    Mutex::ScopedLock lock(prefetch->mutex);
+    if (!prefetch->done) {
+      if (prefetch->work != nullptr && prefetch->work->CancelWork() == 0) {
+        Debug("[compile cache] cancelled prefetch of %s for %s %s\n",
+              entry->cache_filename,
+              entry->type_name(),
+              entry->source_filename);
+      } else {
+        Debug("[compile cache] prefetch of %s for %s %s is still running\n",
+              entry->cache_filename,
+              entry->type_name(),
+              entry->source_filename);
+      }
+      return false;
+    }
+  }
+
+  Debug("[compile cache] using prefetched cache %s for %s %s...",
+        entry->cache_filename,
+        entry->type_name(),
+        entry->source_filename);
+  if (!prefetch->cache) {
+    Debug(" %s\n", prefetch->error);
+    return true;
+  }
+  if (prefetch->code_size != entry->code_size ||
+      prefetch->code_hash != entry->code_hash) {
+    Debug(" code mismatch\n");
+    return true;
+  }
+  Debug(" success, size=%d%s\n",
+        prefetch->cache->length,
+        prefetch->consume_task ? ", deserialized" : "");
+  entry->cache = std::move(prefetch->cache);
+  entry->consume_task = std::move(prefetch->consume_task);
+  return true;
+}
+
+CompileCacheEntry* CompileCacheHandler::GetOrInsert(Local<String> code,
+                                                    Local<String> filename,
+                                                    CachedCodeType type) {
+  DCHECK(!compile_cache_dir_.empty());
+
+  Environment* env = Environment::GetCurrent(isolate_->GetCurrentContext());
+  Utf8Value filename_utf8(isolate_, filename);
+  std::optional<uint32_t> maybe_key =
+      GetEntryKey(env, filename_utf8.ToStringView(), type);
+  if (!maybe_key.has_value()) {
+    return nullptr;
+  }
+  uint32_t key = *maybe_key;
 
   // TODO(joyeecheung): don't encode this again into UTF8. If we read the
   // UTF8 content on disk as raw buffer (from the JS layer, while watching out
@@ -303,7 +463,9 @@ CompileCacheEntry* CompileCacheHandler::GetOrInsert(Local<String> code,
 
   // TODO(joyeecheung): if we fail enough times, stop trying for any future
   // files.
-  ReadCacheFile(result);
+  if (!TakePrefetchedCache(result)) {
+    ReadCacheFile(result);
+  }
 
   return result;
 }
@@ -530,6 +692,7 @@ void CompileCacheHandler::Persist() {
   // avoid rehashing costs.
   Debug("[compile cache] Clear deserialized cache.\n");
   compiler_cache_store_.clear();
+  prefetches_.clear();
 }
 
 CompileCacheHandler::CompileCacheHandler(Environment* env)
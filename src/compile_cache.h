@@ -5,6 +5,7 @@
 
 #include <cinttypes>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
@@ -37,6 +38,9 @@ struct CompileCacheEntry {
   CachedCodeType type;
   bool refreshed = false;
   bool persisted = false;
+  // The cache deserialized off-thread, if it was prefetched. It has to be
+  // passed to V8 together with the cache it was created from.
+  std::unique_ptr<v8::ScriptCompiler::ConsumeCodeCacheTask> consume_task;
 
   // Copy the cache into a new store for V8 to consume. Caller takes
   // ownership.
@@ -76,6 +80,14 @@ class CompileCacheHandler {
   CompileCacheEntry* GetOrInsert(v8::Local<v8::String> code,
                                  v8::Local<v8::String> filename,
                                  CachedCodeType type);
+  // Starts reading the cache for a file that is likely to be compiled soon,
+  // and deserializing it, on the thread pool. When GetOrInsert() is called
+  // for the file, the entry picks up the result if the work is done.
+  // Otherwise the cache is read on the main thread, and the work is
+  // cancelled if it has not started yet, or its result dropped.
+  void Prefetch(Environment* env,
+                std::string_view filename,
+                CachedCodeType type);
   void MaybeSave(CompileCacheEntry* entry,
                  v8::Local<v8::Function> func,
                  bool rejected);
@@ -86,7 +98,21 @@ class CompileCacheHandler {
   std::string_view cache_dir() { return compile_cache_dir_; }
 
  private:
+  struct PrefetchedCache;
+  class PrefetchWork;
+
+  std::optional<uint32_t> GetEntryKey(Environment* env,
+                                      std::string_view filename,
+                                      CachedCodeType type);
   void ReadCacheFile(CompileCacheEntry* entry);
+  bool TakePrefetchedCache(CompileCacheEntry* entry);
+  // Reads a cache file and checks its magic number and cache hash. Returns
+  // nullptr and sets *error on failure. Can be called from any thread.
+  static std::unique_ptr<v8::ScriptCompiler::CachedData> ReadCacheFileContents(
+      const std::string& path,
+      uint32_t* code_size,
+      uint32_t* code_hash,
+      std::string* error);
 
   template <typename T>
   void MaybeSaveImpl(CompileCacheEntry* entry,
@@ -102,6 +128,9 @@ class CompileCacheHandler {
   static constexpr size_t kCodeHashOffset = 3;
   static constexpr size_t kCacheHashOffset = 4;
   static constexpr size_t kHeaderCount = 5;
+  // Guesses that are never compiled stay around until the next Persist(),
+  // so only this many are started.
+  static constexpr size_t kMaxPrefetches = 256;
 
   v8::Isolate* isolate_ = nullptr;
   bool is_debug_ = false;
@@ -111,6 +140,7 @@ class CompileCacheHandler {
   EnableOption portable_ = EnableOption::DEFAULT;
   std::unordered_map<uint32_t, std::unique_ptr<CompileCacheEntry>>
       compiler_cache_store_;
+  std::unordered_map<uint32_t, std::shared_ptr<PrefetchedCache>> prefetches_;
 };
 }  // namespace node
 
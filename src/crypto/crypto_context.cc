@@ -2,6 +2,7 @@
 #include "base_object-inl.h"
 #include "crypto/crypto_bio.h"
 #include "crypto/crypto_common.h"
+#include "crypto/crypto_session_cache.h"
 #include "crypto/crypto_util.h"
 #include "env-inl.h"
 #include "memory_tracker-inl.h"
@@ -1210,6 +1211,7 @@ Local<FunctionTemplate> SecureContext::GetConstructorTemplate(
     SetProtoMethod(isolate, tmpl, "setKey", SetKey);
     SetProtoMethod(isolate, tmpl, "setCert", SetCert);
     SetProtoMethod(isolate, tmpl, "addCACert", AddCACert);
+    SetProtoMethod(isolate, tmpl, "addSharedCACert", AddSharedCACert);
     SetProtoMethod(
         isolate, tmpl, "setAllowPartialTrustChain", SetAllowPartialTrustChain);
     SetProtoMethod(isolate, tmpl, "addCRL", AddCRL);
@@ -1231,6 +1233,8 @@ Local<FunctionTemplate> SecureContext::GetConstructorTemplate(
     SetProtoMethod(isolate, tmpl, "setTicketKeys", SetTicketKeys);
     SetProtoMethod(
         isolate, tmpl, "enableTicketKeyCallback", EnableTicketKeyCallback);
+    SetProtoMethod(
+        isolate, tmpl, "attachSharedSessionCache", AttachSharedSessionCache);
 
     SetProtoMethodNoSideEffect(isolate, tmpl, "getTicketKeys", GetTicketKeys);
     SetProtoMethodNoSideEffect(
@@ -1299,6 +1303,7 @@ void SecureContext::RegisterExternalReferences(
   registry->Register(SetKey);
   registry->Register(SetCert);
   registry->Register(AddCACert);
+  registry->Register(AddSharedCACert);
   registry->Register(AddCRL);
   registry->Register(AddRootCerts);
   registry->Register(SetAllowPartialTrustChain);
@@ -1318,6 +1323,7 @@ void SecureContext::RegisterExternalReferences(
   registry->Register(LoadPKCS12);
   registry->Register(SetTicketKeys);
   registry->Register(EnableTicketKeyCallback);
+  registry->Register(AttachSharedSessionCache);
   registry->Register(GetTicketKeys);
   registry->Register(GetCertificate<true>);
   registry->Register(GetCertificate<false>);
@@ -1362,6 +1368,7 @@ inline void SecureContext::Reset() {
   ctx_.reset();
   cert_.reset();
   issuer_.reset();
+  shared_ca_store_.reset();
 }
 
 SecureContext::~SecureContext() {
@@ -1682,6 +1689,15 @@ X509_STORE* SecureContext::GetCertStoreOwnedByThisSecureContext() {
   if (cert_store == GetOrCreateRootCertStore()) {
     cert_store = NewRootCertStore();
     SSL_CTX_set_cert_store(ctx_.get(), cert_store);
+  } else if (shared_ca_store_) {
+    // Other SecureContexts use the shared store, so modify a copy. Shared
+    // stores only ever contain the certificates of the bundle.
+    cert_store = X509_STORE_new();
+    CHECK_NOT_NULL(cert_store);
+    for (X509* cert : shared_ca_store_->certs)
+      CHECK_EQ(1, X509_STORE_add_cert(cert_store, cert));
+    SSL_CTX_set_cert_store(ctx_.get(), cert_store);
+    shared_ca_store_.reset();
   }
 
   return own_cert_store_cache_ = cert_store;
@@ -1705,6 +1721,40 @@ void SecureContext::SetCACert(const BIOPointer& bio) {
   }
 }
 
+void SecureContext::SetSharedCACert(const BIOPointer& bio) {
+  ClearErrorOnReturn clear_error_on_return;
+  if (!bio) return;
+
+  // The store can only be shared if this context has not put anything into
+  // its own store yet. Otherwise add the bundle to it as usual.
+  std::shared_ptr<const SharedCACertStore> shared;
+  X509_STORE* cert_store = SSL_CTX_get_cert_store(ctx_.get());
+  if (own_cert_store_cache_ == nullptr && !shared_ca_store_ &&
+      sk_X509_OBJECT_num(X509_STORE_get0_objects(cert_store)) == 0) {
+    shared = GetOrCreateSharedCACertStore(bio);
+  }
+  if (!shared) return SetCACert(bio);
+
+  // Take a reference for the SSL_CTX, the shared store outlives it.
+  X509_STORE_up_ref(shared->store);
+  SSL_CTX_set_cert_store(ctx_.get(), shared->store);
+  for (X509* cert : shared->certs)
+    CHECK_EQ(1, SSL_CTX_add_client_CA(ctx_.get(), cert));
+  shared_ca_store_ = std::move(shared);
+}
+
+void SecureContext::AddSharedCACert(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+
+  SecureContext* sc;
+  ASSIGN_OR_RETURN_UNWRAP(&sc, args.This());
+
+  CHECK_GE(args.Length(), 1);  // CA certificate argument is mandatory
+
+  BIOPointer bio(LoadBIO(env, args[0]));
+  sc->SetSharedCACert(bio);
+}
+
 void SecureContext::AddCACert(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args);
 
@@ -1758,6 +1808,7 @@ void SecureContext::SetRootCerts() {
   // Increment reference count so global store is not deleted along with CTX.
   X509_STORE_up_ref(store);
   SSL_CTX_set_cert_store(ctx_.get(), store);
+  shared_ca_store_.reset();
 }
 
 void SecureContext::AddRootCerts(const FunctionCallbackInfo<Value>& args) {
@@ -2145,6 +2196,15 @@ void SecureContext::GetTicketKeys(const FunctionCallbackInfo<Value>& args) {
   if (!Buffer::New(wrap->env(), 48).ToLocal(&buff))
     return;
 
+  if (wrap->uses_shared_session_cache_) {
+    SharedSessionCache::TicketKeys keys;
+    SharedSessionCache::Get()->GetCurrentTicketKeys(&keys);
+    memcpy(Buffer::Data(buff), keys.name, 16);
+    memcpy(Buffer::Data(buff) + 16, keys.hmac, 16);
+    memcpy(Buffer::Data(buff) + 32, keys.aes, 16);
+    return args.GetReturnValue().Set(buff);
+  }
+
   memcpy(Buffer::Data(buff), wrap->ticket_key_name_, 16);
   memcpy(Buffer::Data(buff) + 16, wrap->ticket_key_hmac_, 16);
   memcpy(Buffer::Data(buff) + 32, wrap->ticket_key_aes_, 16);
@@ -2162,6 +2222,15 @@ void SecureContext::SetTicketKeys(const FunctionCallbackInfo<Value>& args) {
 
   CHECK_EQ(buf.length(), 48);
 
+  if (wrap->uses_shared_session_cache_) {
+    SharedSessionCache::TicketKeys keys;
+    memcpy(keys.name, buf.data(), 16);
+    memcpy(keys.hmac, buf.data() + 16, 16);
+    memcpy(keys.aes, buf.data() + 32, 16);
+    SharedSessionCache::Get()->SetTicketKeys(keys);
+    return args.GetReturnValue().Set(true);
+  }
+
   memcpy(wrap->ticket_key_name_, buf.data(), 16);
   memcpy(wrap->ticket_key_hmac_, buf.data() + 16, 16);
   memcpy(wrap->ticket_key_aes_, buf.data() + 32, 16);
@@ -2179,6 +2248,19 @@ void SecureContext::EnableTicketKeyCallback(
   SSL_CTX_set_tlsext_ticket_key_cb(wrap->ctx_.get(), TicketKeyCallback);
 }
 
+// Makes this context resume sessions from, and issue tickets with keys from,
+// the process-wide SharedSessionCache. See NewSessionCallback() and
+// GetSessionCallback() in crypto_tls.cc for the session ID half.
+void SecureContext::AttachSharedSessionCache(
+    const FunctionCallbackInfo<Value>& args) {
+  SecureContext* wrap;
+  ASSIGN_OR_RETURN_UNWRAP(&wrap, args.This());
+
+  wrap->uses_shared_session_cache_ = true;
+  SSL_CTX_set_tlsext_ticket_key_cb(wrap->ctx_.get(),
+                                   TicketCompatibilityCallback);
+}
+
 int SecureContext::TicketKeyCallback(SSL* ssl,
                                      unsigned char* name,
                                      unsigned char* iv,
@@ -2278,6 +2360,33 @@ int SecureContext::TicketCompatibilityCallback(SSL* ssl,
   SecureContext* sc = static_cast<SecureContext*>(
       SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
 
+  if (sc->uses_shared_session_cache_) {
+    SharedSessionCache::TicketKeys keys;
+    int ret = 1;
+    if (enc) {
+      SharedSessionCache::Get()->GetCurrentTicketKeys(&keys);
+      memcpy(name, keys.name, sizeof(keys.name));
+      if (!ncrypto::CSPRNG(iv, 16)) return -1;
+    } else {
+      // 2 tells OpenSSL to issue a new ticket, the key used for this one
+      // has been rotated out.
+      ret = SharedSessionCache::Get()->FindTicketKeys(name, &keys);
+      if (ret == 0) return 0;
+    }
+    if ((enc ? EVP_EncryptInit_ex(
+                   ectx, Cipher::AES_128_CBC, nullptr, keys.aes, iv)
+             : EVP_DecryptInit_ex(
+                   ectx, Cipher::AES_128_CBC, nullptr, keys.aes, iv)) <= 0 ||
+        HMAC_Init_ex(hctx,
+                     keys.hmac,
+                     sizeof(keys.hmac),
+                     Digest::SHA256,
+                     nullptr) <= 0) {
+      return -1;
+    }
+    return ret;
+  }
+
   if (enc) {
     memcpy(name, sc->ticket_key_name_, sizeof(sc->ticket_key_name_));
     if (!ncrypto::CSPRNG(iv, 16) ||
@@ -12,6 +12,8 @@
 
 namespace node {
 namespace crypto {
+struct SharedCACertStore;
+
 // A maxVersion of 0 means "any", but OpenSSL may support TLS versions that
 // Node.js doesn't, so pin the max to what we do support.
 constexpr int kMaxSupportedVersion = TLS1_3_VERSION;
@@ -62,11 +64,18 @@ class SecureContext final : public BaseObject {
   v8::Maybe<void> UseKey(Environment* env, const KeyObjectData& key);
 
   void SetCACert(const ncrypto::BIOPointer& bio);
+  // Like SetCACert(), but reuses the X509_STORE parsed for an identical
+  // bundle by any other SecureContext in the process, if possible.
+  void SetSharedCACert(const ncrypto::BIOPointer& bio);
   void SetRootCerts();
 
   void SetX509StoreFlag(unsigned long flags);  // NOLINT(runtime/int)
   X509_STORE* GetCertStoreOwnedByThisSecureContext();
 
+  inline bool uses_shared_session_cache() const {
+    return uses_shared_session_cache_;
+  }
+
   // TODO(joyeecheung): track the memory used by OpenSSL types
   SET_NO_MEMORY_INFO()
   SET_MEMORY_INFO_NAME(SecureContext)
@@ -93,6 +102,7 @@ class SecureContext final : public BaseObject {
 #endif  // !OPENSSL_NO_ENGINE
   static void SetCert(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void AddCACert(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void AddSharedCACert(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void SetAllowPartialTrustChain(
       const v8::FunctionCallbackInfo<v8::Value>& args);
   static void AddCRL(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -121,6 +131,8 @@ class SecureContext final : public BaseObject {
   static void SetTicketKeys(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void EnableTicketKeyCallback(
       const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void AttachSharedSessionCache(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
   static void CtxGetter(const v8::FunctionCallbackInfo<v8::Value>& info);
 
   template <bool primary>
@@ -149,6 +161,11 @@ class SecureContext final : public BaseObject {
   ncrypto::X509Pointer issuer_;
   // Non-owning cache for SSL_CTX_get_cert_store(ctx_.get())
   X509_STORE* own_cert_store_cache_ = nullptr;
+  // Set while the cert store is shared with other SecureContexts, in which
+  // case it is copied before this context modifies it.
+  std::shared_ptr<const SharedCACertStore> shared_ca_store_;
+  // Sessions and ticket keys come from SharedSessionCache::Get().
+  bool uses_shared_session_cache_ = false;
 #ifndef OPENSSL_NO_ENGINE
   bool client_cert_engine_provided_ = false;
   ncrypto::EnginePointer private_key_engine_;
@@ -0,0 +1,447 @@
+#include "crypto/crypto_session_cache.h"
+#include "crypto/crypto_context.h"
+#include "env-inl.h"
+#include "node_errors.h"
+#include "node_external_reference.h"
+#include "util-inl.h"
+#include "v8.h"
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#include <cstring>
+#include <ctime>
+#include <unordered_map>
+
+namespace node {
+
+using ncrypto::BIOPointer;
+using ncrypto::SSLSessionPointer;
+using ncrypto::X509Pointer;
+using v8::FunctionCallbackInfo;
+using v8::Local;
+using v8::Number;
+using v8::Object;
+using v8::Value;
+
+namespace crypto {
+
+namespace {
+// Layout of the persistence file, all integers in host byte order since the
+// file is only meant to be read back by the same host:
+//
+//   magic[8] version:u32
+//   current_keys[48] has_previous:u8 previous_keys[48]
+//   count:u32 { id_len:u32 id[id_len] expires:u64 der_len:u32 der[der_len] }*
+constexpr char kCacheFileMagic[] = {'N', 'O', 'D', 'E', 'T', 'L', 'S', 'C'};
+constexpr uint32_t kCacheFileVersion = 1;
+
+template <typename T>
+void AppendValue(std::string* out, const T& value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+class CacheFileReader {
+ public:
+  explicit CacheFileReader(const std::string& data) : data_(data) {}
+
+  bool Read(void* out, size_t length) {
+    if (data_.size() - offset_ < length) return false;
+    memcpy(out, data_.data() + offset_, length);
+    offset_ += length;
+    return true;
+  }
+
+  template <typename T>
+  bool Read(T* out) {
+    return Read(out, sizeof(*out));
+  }
+
+  bool ReadBytes(std::string* out, size_t length) {
+    if (data_.size() - offset_ < length) return false;
+    out->assign(data_.data() + offset_, length);
+    offset_ += length;
+    return true;
+  }
+
+ private:
+  const std::string& data_;
+  size_t offset_ = 0;
+};
+
+uint64_t Now() {
+  return static_cast<uint64_t>(time(nullptr));
+}
+
+uint64_t GetSessionTime(const SSL_SESSION* session) {
+#if OPENSSL_VERSION_NUMBER >= 0x30300000L
+  return static_cast<uint64_t>(SSL_SESSION_get_time_ex(session));
+#else
+  return static_cast<uint64_t>(SSL_SESSION_get_time(session));
+#endif
+}
+}  // namespace
+
+SharedSessionCache* SharedSessionCache::Get() {
+  // Intentionally leaked, SecureContexts on other threads may still be
+  // using it while the process exits.
+  static SharedSessionCache* cache = new SharedSessionCache();
+  return cache;
+}
+
+SharedSessionCache::SharedSessionCache()
+    : sessions_(std::make_unique<LRUCache<std::string, Entry>>(
+          kDefaultCapacity)) {
+  CHECK(ncrypto::CSPRNG(&current_keys_, sizeof(current_keys_)));
+}
+
+bool SharedSessionCache::Configure(size_t capacity, const std::string& path) {
+  Mutex::ScopedLock lock(mutex_);
+  if (capacity != sessions_->Capacity()) {
+    auto sessions = std::make_unique<LRUCache<std::string, Entry>>(capacity);
+    // Re-insert from least to most recently used to keep the order.
+    std::vector<std::pair<std::string, Entry>> entries(sessions_->begin(),
+                                                       sessions_->end());
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+      sessions->Put(it->first, it->second);
+    sessions_ = std::move(sessions);
+  }
+  path_ = path;
+  if (path_.empty()) return true;
+  return LoadLocked();
+}
+
+void SharedSessionCache::Insert(SSL_SESSION* session) {
+  unsigned int id_len;
+  const unsigned char* id = SSL_SESSION_get_id(session, &id_len);
+  if (id_len == 0) return;
+
+  int size = i2d_SSL_SESSION(session, nullptr);
+  if (size <= 0 || size > SecureContext::kMaxSessionSize) return;
+
+  Entry entry;
+  entry.der.resize(size);
+  unsigned char* der = entry.der.data();
+  CHECK_EQ(i2d_SSL_SESSION(session, &der), size);
+  entry.expires = GetSessionTime(session) +
+                  static_cast<uint64_t>(SSL_SESSION_get_timeout(session));
+
+  std::string key(reinterpret_cast<const char*>(id), id_len);
+  Mutex::ScopedLock lock(mutex_);
+  sessions_->Put(key, std::move(entry));
+}
+
+SSLSessionPointer SharedSessionCache::Lookup(const unsigned char* id,
+                                             size_t id_len) {
+  std::string key(reinterpret_cast<const char*>(id), id_len);
+  std::vector<unsigned char> der;
+  {
+    Mutex::ScopedLock lock(mutex_);
+    if (!sessions_->Exists(key)) return {};
+    const Entry& entry = sessions_->Get(key);
+    if (entry.expires <= Now()) {
+      sessions_->Erase(key);
+      return {};
+    }
+    der = entry.der;
+  }
+
+  // Deserialize outside of the lock, it is the expensive part.
+  const unsigned char* p = der.data();
+  return SSLSessionPointer(d2i_SSL_SESSION(nullptr, &p, der.size()));
+}
+
+void SharedSessionCache::Remove(const unsigned char* id, size_t id_len) {
+  std::string key(reinterpret_cast<const char*>(id), id_len);
+  Mutex::ScopedLock lock(mutex_);
+  sessions_->Erase(key);
+}
+
+size_t SharedSessionCache::size() const {
+  Mutex::ScopedLock lock(mutex_);
+  return sessions_->Size();
+}
+
+void SharedSessionCache::GetCurrentTicketKeys(TicketKeys* keys) const {
+  Mutex::ScopedLock lock(mutex_);
+  *keys = current_keys_;
+}
+
+int SharedSessionCache::FindTicketKeys(const unsigned char* name,
+                                       TicketKeys* keys) const {
+  Mutex::ScopedLock lock(mutex_);
+  if (memcmp(name, current_keys_.name, kTicketKeyPartSize) == 0) {
+    *keys = current_keys_;
+    return 1;
+  }
+  if (has_previous_keys_ &&
+      memcmp(name, previous_keys_.name, kTicketKeyPartSize) == 0) {
+    *keys = previous_keys_;
+    return 2;
+  }
+  return 0;
+}
+
+bool SharedSessionCache::RotateTicketKeys() {
+  TicketKeys keys;
+  if (!ncrypto::CSPRNG(&keys, sizeof(keys))) return false;
+  std::string path;
+  std::string data;
+  uint64_t generation;
+  {
+    Mutex::ScopedLock lock(mutex_);
+    previous_keys_ = current_keys_;
+    has_previous_keys_ = true;
+    current_keys_ = keys;
+    if (path_.empty()) return true;
+    path = path_;
+    data = SerializeLocked(&generation);
+  }
+  return Save(path, data, generation);
+}
+
+void SharedSessionCache::SetTicketKeys(const TicketKeys& keys) {
+  std::string path;
+  std::string data;
+  uint64_t generation;
+  {
+    Mutex::ScopedLock lock(mutex_);
+    current_keys_ = keys;
+    has_previous_keys_ = false;
+    if (path_.empty()) return;
+    path = path_;
+    data = SerializeLocked(&generation);
+  }
+  Save(path, data, generation);
+}
+
+bool SharedSessionCache::Flush() {
+  std::string path;
+  std::string data;
+  uint64_t generation;
+  {
+    Mutex::ScopedLock lock(mutex_);
+    if (path_.empty()) return true;
+    path = path_;
+    data = SerializeLocked(&generation);
+  }
+  return Save(path, data, generation);
+}
+
+bool SharedSessionCache::LoadLocked() {
+  std::string data;
+  // A missing file is not an error, it is created on the first save.
+  if (ReadFileSync(&data, path_.c_str()) != 0) return true;
+
+  CacheFileReader reader(data);
+  char magic[sizeof(kCacheFileMagic)];
+  uint32_t version;
+  uint8_t has_previous;
+  TicketKeys current;
+  TicketKeys previous;
+  uint32_t count;
+  if (!reader.Read(magic, sizeof(magic)) ||
+      memcmp(magic, kCacheFileMagic, sizeof(magic)) != 0 ||
+      !reader.Read(&version) || version != kCacheFileVersion ||
+      !reader.Read(&current) || !reader.Read(&has_previous) ||
+      !reader.Read(&previous) || !reader.Read(&count)) {
+    return false;
+  }
+
+  // Nothing is applied until the whole file has been read, so that a
+  // truncated file leaves the cache as it was.
+  const uint64_t now = Now();
+  std::vector<std::pair<std::string, Entry>> entries;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t id_len;
+    uint32_t der_len;
+    std::string id;
+    std::string der;
+    Entry entry;
+    if (!reader.Read(&id_len) || !reader.ReadBytes(&id, id_len) ||
+        !reader.Read(&entry.expires) || !reader.Read(&der_len) ||
+        !reader.ReadBytes(&der, der_len)) {
+      return false;
+    }
+    if (entry.expires <= now) continue;
+    entry.der.assign(der.begin(), der.end());
+    entries.emplace_back(std::move(id), std::move(entry));
+  }
+
+  current_keys_ = current;
+  previous_keys_ = previous;
+  has_previous_keys_ = has_previous != 0;
+  for (auto& [id, entry] : entries)
+    sessions_->Put(id, std::move(entry));
+  return true;
+}
+
+std::string SharedSessionCache::SerializeLocked(uint64_t* generation) const {
+  *generation = ++serialized_generation_;
+  std::string data;
+  data.append(kCacheFileMagic, sizeof(kCacheFileMagic));
+  AppendValue(&data, kCacheFileVersion);
+  AppendValue(&data, current_keys_);
+  AppendValue(&data, static_cast<uint8_t>(has_previous_keys_));
+  AppendValue(&data, previous_keys_);
+
+  const uint64_t now = Now();
+  uint32_t count = 0;
+  size_t count_offset = data.size();
+  AppendValue(&data, count);
+  // Oldest first, so that loading the file restores the LRU order.
+  std::vector<std::pair<std::string, Entry>> entries(sessions_->begin(),
+                                                     sessions_->end());
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    const Entry& entry = it->second;
+    if (entry.expires <= now) continue;
+    AppendValue(&data, static_cast<uint32_t>(it->first.size()));
+    data.append(it->first);
+    AppendValue(&data, entry.expires);
+    AppendValue(&data, static_cast<uint32_t>(entry.der.size()));
+    data.append(reinterpret_cast<const char*>(entry.der.data()),
+                entry.der.size());
+    count++;
+  }
+  memcpy(data.data() + count_offset, &count, sizeof(count));
+  return data;
+}
+
+bool SharedSessionCache::Save(const std::string& path,
+                              const std::string& data,
+                              uint64_t generation) {
+  Mutex::ScopedLock lock(file_mutex_);
+  // A concurrent save already wrote newer state.
+  if (generation <= saved_generation_) return true;
+
+  // The file contains ticket keys, so it is written with owner-only
+  // permissions (see WriteFileSync()) and then renamed into place so that
+  // readers never observe a partially written file. Several processes may
+  // share the file, so each writes its own temporary file.
+  std::string tmp_path =
+      path + "." + std::to_string(uv_os_getpid()) + ".tmp";
+  uv_buf_t buf =
+      uv_buf_init(const_cast<char*>(data.data()), data.size());
+  if (WriteFileSync(tmp_path.c_str(), buf) != 0) return false;
+
+  uv_fs_t req;
+  int err = uv_fs_rename(nullptr, &req, tmp_path.c_str(), path.c_str(),
+                         nullptr);
+  uv_fs_req_cleanup(&req);
+  if (err != 0) {
+    uv_fs_unlink(nullptr, &req, tmp_path.c_str(), nullptr);
+    uv_fs_req_cleanup(&req);
+    return false;
+  }
+  saved_generation_ = generation;
+  return true;
+}
+
+SharedCACertStore::~SharedCACertStore() {
+  for (X509* cert : certs) X509_free(cert);
+  if (store != nullptr) X509_STORE_free(store);
+}
+
+std::shared_ptr<const SharedCACertStore> GetOrCreateSharedCACertStore(
+    const BIOPointer& bio) {
+  static Mutex mutex;
+  // Keyed by the SHA-256 digest of the PEM bundle. Entries are kept for the
+  // lifetime of the process, in practice there are only a handful of
+  // distinct bundles.
+  static std::unordered_map<std::string,
+                            std::shared_ptr<const SharedCACertStore>>
+      stores;
+
+  BUF_MEM* mem = bio;
+  if (mem == nullptr || mem->length == 0) return {};
+
+  unsigned char digest[EVP_MAX_MD_SIZE];
+  unsigned int digest_len;
+  if (EVP_Digest(mem->data,
+                 mem->length,
+                 digest,
+                 &digest_len,
+                 EVP_sha256(),
+                 nullptr) != 1) {
+    return {};
+  }
+  std::string key(reinterpret_cast<const char*>(digest), digest_len);
+
+  Mutex::ScopedLock lock(mutex);
+  auto it = stores.find(key);
+  if (it != stores.end()) return it->second;
+
+  ncrypto::ClearErrorOnReturn clear_error_on_return;
+  auto shared = std::make_shared<SharedCACertStore>();
+  shared->store = X509_STORE_new();
+  CHECK_NOT_NULL(shared->store);
+  // Read from a separate BIO so that the caller's BIO is left untouched.
+  BIOPointer in(BIO_new_mem_buf(mem->data, static_cast<int>(mem->length)));
+  CHECK(in);
+  while (X509Pointer x509 = X509Pointer(PEM_read_bio_X509_AUX(
+             in.get(), nullptr, NoPasswordCallback, nullptr))) {
+    CHECK_EQ(1, X509_STORE_add_cert(shared->store, x509.get()));
+    shared->certs.push_back(x509.release());
+  }
+  if (shared->certs.empty()) return {};
+
+  stores.emplace(key, shared);
+  return shared;
+}
+
+namespace SessionCache {
+namespace {
+void ConfigureSharedSessionCache(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  CHECK(args[0]->IsUint32());
+  uint32_t capacity = args[0].As<v8::Uint32>()->Value();
+  if (capacity == 0) capacity = SharedSessionCache::kDefaultCapacity;
+
+  std::string path;
+  if (args[1]->IsString()) {
+    Utf8Value value(env->isolate(), args[1]);
+    path = value.ToString();
+  }
+
+  args.GetReturnValue().Set(SharedSessionCache::Get()->Configure(capacity,
+                                                                 path));
+}
+
+void FlushSharedSessionCache(const FunctionCallbackInfo<Value>& args) {
+  args.GetReturnValue().Set(SharedSessionCache::Get()->Flush());
+}
+
+void RotateSharedTicketKeys(const FunctionCallbackInfo<Value>& args) {
+  args.GetReturnValue().Set(SharedSessionCache::Get()->RotateTicketKeys());
+}
+
+void GetSharedSessionCacheSize(const FunctionCallbackInfo<Value>& args) {
+  args.GetReturnValue().Set(Number::New(
+      args.GetIsolate(),
+      static_cast<double>(SharedSessionCache::Get()->size())));
+}
+}  // namespace
+
+void Initialize(Environment* env, Local<Object> target) {
+  Local<v8::Context> context = env->context();
+  SetMethod(context,
+            target,
+            "configureSharedSessionCache",
+            ConfigureSharedSessionCache);
+  SetMethod(
+      context, target, "flushSharedSessionCache", FlushSharedSessionCache);
+  SetMethod(context, target, "rotateSharedTicketKeys", RotateSharedTicketKeys);
+  SetMethodNoSideEffect(
+      context, target, "getSharedSessionCacheSize", GetSharedSessionCacheSize);
+}
+
+void RegisterExternalReferences(ExternalReferenceRegistry* registry) {
+  registry->Register(ConfigureSharedSessionCache);
+  registry->Register(FlushSharedSessionCache);
+  registry->Register(RotateSharedTicketKeys);
+  registry->Register(GetSharedSessionCacheSize);
+}
+}  // namespace SessionCache
+
+}  // namespace crypto
+}  // namespace node
@@ -0,0 +1,122 @@
+#ifndef SRC_CRYPTO_CRYPTO_SESSION_CACHE_H_
+#define SRC_CRYPTO_CRYPTO_SESSION_CACHE_H_
+
+#if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#include "crypto/crypto_util.h"
+#include "lru_cache-inl.h"
+#include "node_mutex.h"
+#include "v8.h"
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace node {
+namespace crypto {
+
+// Process-wide TLS resumption state shared by every SecureContext that opts
+// in with attachSharedSessionCache(), on any thread. It keeps serialized
+// server sessions for session ID resumption and the ticket keys used for
+// stateless (ticket) resumption, so a client that connected to one worker
+// can resume on any other. Optionally the state is persisted to a file so
+// that a restarted process keeps resuming existing clients.
+class SharedSessionCache final {
+ public:
+  static constexpr size_t kDefaultCapacity = 20 * 1024;
+  static constexpr size_t kTicketKeyPartSize = 16;
+
+  struct TicketKeys {
+    unsigned char name[kTicketKeyPartSize];
+    unsigned char hmac[kTicketKeyPartSize];
+    unsigned char aes[kTicketKeyPartSize];
+  };
+
+  static SharedSessionCache* Get();
+
+  // Resizes the cache and, if path is not empty, loads previously persisted
+  // state from it. Subsequent Flush() and ticket key changes write to path.
+  // Returns false if an existing file could not be parsed.
+  bool Configure(size_t capacity, const std::string& path);
+
+  // Sessions, keyed by session ID. Insert() ignores sessions larger than
+  // SecureContext::kMaxSessionSize. Lookup() returns nullptr for unknown or
+  // expired sessions.
+  void Insert(SSL_SESSION* session);
+  ncrypto::SSLSessionPointer Lookup(const unsigned char* id, size_t id_len);
+  void Remove(const unsigned char* id, size_t id_len);
+  size_t size() const;
+
+  // Ticket keys. The previous key set is kept after a rotation so tickets
+  // issued with it can still be decrypted (and are then renewed).
+  void GetCurrentTicketKeys(TicketKeys* keys) const;
+  // Returns 1 if name matches the current keys, 2 if it matches the previous
+  // keys and 0 if the ticket was issued with neither.
+  int FindTicketKeys(const unsigned char* name, TicketKeys* keys) const;
+  bool RotateTicketKeys();
+  void SetTicketKeys(const TicketKeys& keys);
+
+  // Writes the current state to the configured file, if any.
+  bool Flush();
+
+ private:
+  struct Entry {
+    std::vector<unsigned char> der;
+    uint64_t expires;
+  };
+
+  SharedSessionCache();
+
+  bool LoadLocked();
+  // Serializes the state under mutex_, so that Save() can write it to the
+  // file after releasing the lock, which every handshake takes.
+  std::string SerializeLocked(uint64_t* generation) const;
+  bool Save(const std::string& path,
+            const std::string& data,
+            uint64_t generation);
+
+  mutable Mutex mutex_;
+  std::unique_ptr<LRUCache<std::string, Entry>> sessions_;
+  TicketKeys current_keys_;
+  TicketKeys previous_keys_;
+  bool has_previous_keys_ = false;
+  std::string path_;
+  // Incremented by every SerializeLocked() call.
+  mutable uint64_t serialized_generation_ = 0;
+
+  // Serializes writes to the file, so that a save that serialized older
+  // state can't overwrite a newer one.
+  Mutex file_mutex_;
+  uint64_t saved_generation_ = 0;
+};
+
+// A parsed CA bundle that is shared between all SecureContexts that were
+// given byte-for-byte the same bundle, so that each worker does not have to
+// parse it again.
+struct SharedCACertStore {
+  ~SharedCACertStore();
+
+  X509_STORE* store = nullptr;
+  // Owned references, used to populate the client CA list.
+  std::vector<X509*> certs;
+};
+
+// Returns the shared store for the PEM bundle in bio, parsing it on the
+// first call for a given bundle. Returns nullptr if it has no certificates.
+std::shared_ptr<const SharedCACertStore> GetOrCreateSharedCACertStore(
+    const ncrypto::BIOPointer& bio);
+
+namespace SessionCache {
+void Initialize(Environment* env, v8::Local<v8::Object> target);
+void RegisterExternalReferences(ExternalReferenceRegistry* registry);
+}  // namespace SessionCache
+
+}  // namespace crypto
+}  // namespace node
+
+#endif  // defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#endif  // SRC_CRYPTO_CRYPTO_SESSION_CACHE_H_
@@ -26,6 +26,7 @@
 #include "crypto/crypto_clienthello-inl.h"
 #include "crypto/crypto_common.h"
 #include "crypto/crypto_context.h"
+#include "crypto/crypto_session_cache.h"
 #include "crypto/crypto_util.h"
 #include "debug_utils-inl.h"
 #include "memory_tracker-inl.h"
@@ -72,8 +73,65 @@ using v8::Value;
 
 namespace crypto {
 
+// Kernel TLS offload is only available on Linux, and only when OpenSSL was
+// built with KTLS support. The bundled OpenSSL is configured with no-ktls, so
+// this is typically only enabled with --shared-openssl.
+#if defined(__linux__) && defined(SSL_OP_ENABLE_KTLS) &&                       \
+    !defined(OPENSSL_NO_KTLS)
+#define NODE_TLS_HAVE_KTLS 1
+#else
+#define NODE_TLS_HAVE_KTLS 0
+#endif
+
 namespace {
 
+#if NODE_TLS_HAVE_KTLS
+// The BIO between the SSL object and the socket BIO while kernel TLS is
+// active. Cleartext from DoWrite() goes to the socket through the
+// underlying stream, but OpenSSL writes the records it generates itself
+// (alerts, close_notify, KeyUpdate) to its write BIO. It flushes that BIO
+// before each such record, so refusing the flush with a retry while the
+// underlying stream has writes in flight keeps those records from being
+// interleaved with the queued cleartext. OpenSSL keeps the record and sends
+// it on a later call.
+int KTLSGateWrite(BIO* bio, const char* data, int len) {
+  BIO_clear_retry_flags(bio);
+  int ret = BIO_write(BIO_next(bio), data, len);
+  BIO_copy_next_retry(bio);
+  return ret;
+}
+
+long KTLSGateCtrl(BIO* bio, int cmd, long num, void* ptr) {  // NOLINT
+  const bool* write_in_flight = static_cast<bool*>(BIO_get_data(bio));
+  BIO_clear_retry_flags(bio);
+  if (cmd == BIO_CTRL_FLUSH && *write_in_flight) {
+    BIO_set_retry_write(bio);
+    return 0;
+  }
+  long ret = BIO_ctrl(BIO_next(bio), cmd, num, ptr);  // NOLINT
+  BIO_copy_next_retry(bio);
+  return ret;
+}
+
+int KTLSGateCreate(BIO* bio) {
+  BIO_set_init(bio, 1);
+  return 1;
+}
+
+const BIO_METHOD* GetKTLSGateMethod() {
+  // Static initialization ensures that this is safe to use concurrently.
+  static const BIO_METHOD* method = []() {
+    BIO_METHOD* method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_FILTER,
+                                      "node.js kTLS gate");
+    BIO_meth_set_write(method, KTLSGateWrite);
+    BIO_meth_set_ctrl(method, KTLSGateCtrl);
+    BIO_meth_set_create(method, KTLSGateCreate);
+    return method;
+  }();
+  return method;
+}
+#endif  // NODE_TLS_HAVE_KTLS
+
 // Our custom implementation of the certificate verify callback
 // used when establishing a TLS handshake. Because we cannot perform
 // I/O quickly enough with X509_STORE_CTX_ APIs in this callback,
@@ -100,7 +158,16 @@ SSL_SESSION* GetSessionCallback(
     int* copy) {
   TLSWrap* w = static_cast<TLSWrap*>(SSL_get_app_data(s));
   *copy = 0;
-  return w->ReleaseSession();
+  SSL_SESSION* session = w->ReleaseSession();
+  if (session != nullptr) return session;
+
+  // Nothing was loaded from JS through 'resumeSession', try the sessions
+  // that other contexts in this process have stored.
+  SecureContext* sc = static_cast<SecureContext*>(
+      SSL_CTX_get_app_data(SSL_get_SSL_CTX(s)));
+  if (sc != nullptr && sc->uses_shared_session_cache())
+    return SharedSessionCache::Get()->Lookup(key, len).release();
+  return nullptr;
 }
 
 void OnClientHello(
@@ -163,6 +230,17 @@ int NewSessionCallback(SSL* s, SSL_SESSION* sess) {
   HandleScope handle_scope(env->isolate());
   Context::Scope context_scope(env->context());
 
+  // TLS 1.3 sessions are resumed through stateless tickets, which only need
+  // the shared ticket keys, unless tickets are disabled and OpenSSL falls
+  // back to stateful tickets that are looked up by session ID.
+  SecureContext* sc = static_cast<SecureContext*>(
+      SSL_CTX_get_app_data(SSL_get_SSL_CTX(s)));
+  if (w->is_server() && sc != nullptr && sc->uses_shared_session_cache() &&
+      (SSL_version(s) < TLS1_3_VERSION ||
+       (SSL_get_options(s) & SSL_OP_NO_TICKET) != 0)) {
+    SharedSessionCache::Get()->Insert(sess);
+  }
+
   if (!w->has_session_callbacks()) [[unlikely]]
     return 0;
 
@@ -631,6 +709,15 @@ void TLSWrap::SSLInfoCallback(const SSL* ssl_, int where, int ret) {
 
     c->established_ = true;
 
+    // Switching to kernel TLS issues a KeyUpdate, which can't be done from
+    // inside the SSL_read()/SSL_do_handshake() call that got us here.
+    if (c->ktls_requested_) {
+      BaseObjectPtr<TLSWrap> strong_ref{c};
+      env->SetImmediate([c, strong_ref](Environment* env) {
+        c->MaybeStartKTLS();
+      });
+    }
+
     if (object->Get(env->context(), env->onhandshakedone_string())
           .ToLocal(&callback) && callback->IsFunction()) {
       c->MakeCallback(callback.As<Function>(), 0, nullptr);
@@ -764,6 +851,8 @@ void TLSWrap::OnStreamAfterWrite(WriteWrap* req_wrap, int status) {
   if (status) {
     if (shutdown_) {
       Debug(this, "Ignoring error after shutdown");
+      ktls_write_in_flight_ = false;
+      FinishPendingShutdown();
       return;
     }
 
@@ -772,15 +861,114 @@ void TLSWrap::OnStreamAfterWrite(WriteWrap* req_wrap, int status) {
     return;
   }
 
-  // Commit
-  NodeBIO::FromBIO(enc_out_)->Read(nullptr, write_size_);
+  // Commit. With kernel TLS the cleartext was written to the socket directly
+  // and nothing was peeked from enc_out_.
+  if (!ktls_tx_)
+    NodeBIO::FromBIO(enc_out_)->Read(nullptr, write_size_);
+  // Records that OpenSSL held back meanwhile are retried on its next call
+  // that writes, e.g. SSL_shutdown() in FinishPendingShutdown().
+  ktls_write_in_flight_ = false;
 
   // Ensure that the progress will be made and `InvokeQueued` will be called.
   ClearIn();
 
   // Try writing more data
   write_size_ = 0;
+  MaybeStartKTLS();
   EncOut();
+  FinishPendingShutdown();
+}
+
+bool TLSWrap::MaybeStartKTLS() {
+  if (ktls_tx_)
+    return true;
+
+#if NODE_TLS_HAVE_KTLS
+  if (!ktls_requested_ || ktls_attempted_ || !established_ || shutdown_ ||
+      ssl_ == nullptr) {
+    return false;
+  }
+
+  // Everything the SSL object produced so far must have been written by the
+  // underlying stream before the kernel takes over the record sequence, and
+  // no write may be in flight.
+  if (write_size_ != 0 || current_write_ || BIO_pending(enc_out_) != 0 ||
+      (pending_cleartext_input_ &&
+       pending_cleartext_input_->ByteLength() != 0) ||
+      has_active_write_issued_by_prev_listener_) {
+    Debug(this, "Deferring kTLS, encrypted output is still pending");
+    return false;
+  }
+
+  ktls_attempted_ = true;
+
+  // The current write key was installed while writing into the memory BIO,
+  // and OpenSSL only attaches kernel offload when a key is installed. TLS 1.3
+  // can change keys without renegotiating: send a KeyUpdate through a socket
+  // BIO, after which OpenSSL pushes the new write key into the kernel if the
+  // cipher is supported there.
+  if (SSL_version(ssl_.get()) != TLS1_3_VERSION) {
+    Debug(this, "Not using kTLS, protocol is not TLS 1.3");
+    return false;
+  }
+
+  int fd = GetFD();
+  if (fd < 0) {
+    Debug(this, "Not using kTLS, underlying stream has no file descriptor");
+    return false;
+  }
+
+  BIOPointer sock(BIO_new_socket(fd, BIO_NOCLOSE));
+  BIOPointer gate(BIO_new(GetKTLSGateMethod()));
+  if (!sock || !gate) {
+    return false;
+  }
+  ktls_write_in_flight_ = false;
+  BIO_set_data(gate.get(), &ktls_write_in_flight_);
+  BIO_push(gate.get(), sock.release());
+
+  MarkPopErrorOnReturn mark_pop_error_on_return;
+
+  CHECK_EQ(BIO_up_ref(enc_out_), 1);
+  ktls_enc_out_.reset(enc_out_);
+  SSL_set_options(ssl_.get(), SSL_OP_ENABLE_KTLS);
+  // The SSL object frees the whole chain.
+  SSL_set0_wbio(ssl_.get(), gate.release());
+
+  if (SSL_key_update(ssl_.get(), SSL_KEY_UPDATE_NOT_REQUESTED) == 1 &&
+      SSL_do_handshake(ssl_.get()) == 1 &&
+      BIO_get_ktls_send(SSL_get_wbio(ssl_.get()))) {
+    Debug(this, "Kernel TLS is active for writes");
+    ktls_tx_ = true;
+    return true;
+  }
+
+  // The kernel refused the cipher or the socket, or the KeyUpdate could not
+  // be flushed. Go back to the memory BIO; whatever OpenSSL still has
+  // buffered is written through enc_out_ ahead of any later record, so the
+  // stream stays well-formed.
+  Debug(this, "Falling back from kTLS to the memory BIO");
+  SSL_clear_options(ssl_.get(), SSL_OP_ENABLE_KTLS);
+  SSL_set0_wbio(ssl_.get(), ktls_enc_out_.release());
+#endif  // NODE_TLS_HAVE_KTLS
+
+  return false;
+}
+
+bool TLSWrap::SendPendingKTLSKeyUpdate() {
+#if NODE_TLS_HAVE_KTLS
+  if (SSL_get_key_update_type(ssl_.get()) == SSL_KEY_UPDATE_NONE)
+    return true;
+  // Nothing is in flight, so the gate lets the KeyUpdate through, and the
+  // kernel switches to the new key before the next cleartext is written.
+  CHECK(!ktls_write_in_flight_);
+  MarkPopErrorOnReturn mark_pop_error_on_return;
+  Debug(this, "Sending the KeyUpdate requested by the peer");
+  return SSL_key_update(ssl_.get(), SSL_KEY_UPDATE_NOT_REQUESTED) == 1 &&
+         SSL_do_handshake(ssl_.get()) == 1;
+#else
+  return true;
+#endif  // NODE_TLS_HAVE_KTLS
 }
 
 void TLSWrap::ClearOut() {
@@ -1065,6 +1253,33 @@ int TLSWrap::DoWrite(WriteWrap* w,
   CHECK(!current_write_);
   current_write_.reset(w->GetAsyncWrap());
 
+  // The kernel frames and encrypts whatever is written to the socket, so the
+  // cleartext goes to the underlying stream as-is. write_size_ keeps EncOut()
+  // from completing the write before the underlying stream has.
+  if (ktls_tx_ && length != 0) {
+    if (!SendPendingKTLSKeyUpdate()) {
+      current_write_.reset();
+      return UV_EPROTO;
+    }
+    Debug(this, "Writing %zu bytes of cleartext through kTLS", length);
+    write_size_ = length;
+    ktls_write_in_flight_ = true;
+    StreamWriteResult res = underlying_stream()->Write(bufs, count);
+    if (res.err != 0) {
+      write_size_ = 0;
+      ktls_write_in_flight_ = false;
+      current_write_.reset();
+      return res.err;
+    }
+    if (!res.async) {
+      BaseObjectPtr<TLSWrap> strong_ref{this};
+      env()->SetImmediate([this, strong_ref](Environment* env) {
+        OnStreamAfterWrite(nullptr, 0);
+      });
+    }
+    return 0;
+  }
+
   // Write encrypted data to underlying stream and call Done().
   if (length == 0) {
     EncOut();
@@ -1209,9 +1424,36 @@ int TLSWrap::DoShutdown(ShutdownWrap* req_wrap) {
 
   shutdown_ = true;
   EncOut();
+
+  // With kernel TLS, the close_notify is held back while cleartext is still
+  // being written to the socket. Shutting down the underlying stream now
+  // would send the FIN without it.
+  if (ktls_write_in_flight_) {
+    Debug(this, "Deferring shutdown until the kTLS write is done");
+    CHECK(!pending_shutdown_);
+    pending_shutdown_.reset(req_wrap->GetAsyncWrap());
+    return 0;
+  }
   return underlying_stream()->DoShutdown(req_wrap);
 }
 
+void TLSWrap::FinishPendingShutdown() {
+  if (!pending_shutdown_ || ktls_write_in_flight_)
+    return;
+  Debug(this, "Finishing deferred shutdown");
+  BaseObjectPtr<AsyncWrap> pending_shutdown = std::move(pending_shutdown_);
+  pending_shutdown_.reset();
+  ShutdownWrap* req_wrap = ShutdownWrap::FromObject(pending_shutdown);
+
+  if (ssl_) {
+    MarkPopErrorOnReturn mark_pop_error_on_return;
+    SSL_shutdown(ssl_.get());
+  }
+  int err = underlying_stream()->DoShutdown(req_wrap);
+  if (err != 0)
+    req_wrap->Done(err);
+}
+
 void TLSWrap::SetVerifyMode(const FunctionCallbackInfo<Value>& args) {
   TLSWrap* wrap;
   ASSIGN_OR_RETURN_UNWRAP(&wrap, args.This());
@@ -1316,9 +1558,17 @@ void TLSWrap::Destroy() {
 
   // And destroy
   InvokeQueued(UV_ECANCELED, "Canceled because of SSL destruction");
+  // The underlying stream won't report the kTLS write a deferred shutdown
+  // waits for to this listener anymore.
+  if (pending_shutdown_) {
+    BaseObjectPtr<AsyncWrap> pending_shutdown = std::move(pending_shutdown_);
+    pending_shutdown_.reset();
+    ShutdownWrap::FromObject(pending_shutdown)->Done(UV_ECANCELED);
+  }
 
   env()->external_memory_accounter()->Decrease(env()->isolate(), kExternalSize);
   ssl_.reset();
+  ktls_enc_out_.reset();
 
   enc_in_ = nullptr;
   enc_out_ = nullptr;
@@ -1335,6 +1585,23 @@ void TLSWrap::EnableCertCb(const FunctionCallbackInfo<Value>& args) {
   wrap->WaitForCertCb(OnClientHelloParseEnd, wrap);
 }
 
+void TLSWrap::EnableKTLS(const FunctionCallbackInfo<Value>& args) {
+  TLSWrap* wrap;
+  ASSIGN_OR_RETURN_UNWRAP(&wrap, args.This());
+  CHECK(!wrap->established_);
+
+  // The switch happens after the handshake, see MaybeStartKTLS(). Returns
+  // false if this build can't offload TLS to the kernel at all.
+  wrap->ktls_requested_ = NODE_TLS_HAVE_KTLS;
+  args.GetReturnValue().Set(wrap->ktls_requested_);
+}
+
+void TLSWrap::IsKTLSActive(const FunctionCallbackInfo<Value>& args) {
+  TLSWrap* wrap;
+  ASSIGN_OR_RETURN_UNWRAP(&wrap, args.This());
+  args.GetReturnValue().Set(wrap->ktls_tx_);
+}
+
 void TLSWrap::WaitForCertCb(CertCb cb, void* arg) {
   cert_cb_ = cb;
   cert_cb_arg_ = arg;
@@ -2194,6 +2461,7 @@ void TLSWrap::Initialize(
   SetProtoMethod(isolate, t, "certCbDone", CertCbDone);
   SetProtoMethod(isolate, t, "destroySSL", DestroySSL);
   SetProtoMethod(isolate, t, "enableCertCb", EnableCertCb);
+  SetProtoMethod(isolate, t, "enableKTLS", EnableKTLS);
   SetProtoMethod(isolate, t, "enableALPNCb", EnableALPNCb);
   SetProtoMethod(isolate, t, "endParser", EndParser);
   SetProtoMethod(isolate, t, "enableKeylogCallback", EnableKeylogCallback);
@@ -2219,6 +2487,7 @@ void TLSWrap::Initialize(
 
   SetProtoMethodNoSideEffect(
       isolate, t, "exportKeyingMaterial", ExportKeyingMaterial);
+  SetProtoMethodNoSideEffect(isolate, t, "isKTLSActive", IsKTLSActive);
   SetProtoMethodNoSideEffect(isolate, t, "isSessionReused", IsSessionReused);
   SetProtoMethodNoSideEffect(
       isolate, t, "getALPNNegotiatedProtocol", GetALPNNegotiatedProto);
@@ -2265,6 +2534,7 @@ void TLSWrap::RegisterExternalReferences(ExternalReferenceRegistry* registry) {
   registry->Register(CertCbDone);
   registry->Register(DestroySSL);
   registry->Register(EnableCertCb);
+  registry->Register(EnableKTLS);
   registry->Register(EnableALPNCb);
   registry->Register(EndParser);
   registry->Register(EnableKeylogCallback);
@@ -2283,6 +2553,7 @@ void TLSWrap::RegisterExternalReferences(ExternalReferenceRegistry* registry) {
   registry->Register(SetVerifyMode);
   registry->Register(Start);
   registry->Register(ExportKeyingMaterial);
+  registry->Register(IsKTLSActive);
   registry->Register(IsSessionReused);
   registry->Register(GetALPNNegotiatedProto);
   registry->Register(GetCertificate);
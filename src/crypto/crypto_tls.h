@@ -156,6 +156,20 @@ class TLSWrap : public AsyncWrap,
   void ClearOut();  // SSL_read() clear text "out" from SSL.
   void Destroy();
 
+  // Once the handshake has completed and no encrypted output is buffered,
+  // try to hand the write side of the connection over to the kernel (kTLS).
+  // On success, cleartext is written directly to the underlying stream and
+  // the kernel frames and encrypts it. On failure the connection keeps using
+  // the memory BIO path. Returns true if kernel TLS is active after the call.
+  bool MaybeStartKTLS();
+  // Sends the KeyUpdate that the peer asked for, if any. With kernel TLS,
+  // SSL_write() isn't called, which is where OpenSSL would do that.
+  bool SendPendingKTLSKeyUpdate();
+  // Completes a shutdown that DoShutdown() deferred while a kTLS write was
+  // in flight: sends the close_notify held back meanwhile, then shuts down
+  // the underlying stream.
+  void FinishPendingShutdown();
+
   // Call Done() on outstanding WriteWrap request.
   void InvokeQueued(int status, const char* error_str = nullptr);
 
@@ -177,6 +191,7 @@ class TLSWrap : public AsyncWrap,
   static void CertCbDone(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void DestroySSL(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void EnableCertCb(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void EnableKTLS(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void EnableALPNCb(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void EnableKeylogCallback(
       const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -207,6 +222,7 @@ class TLSWrap : public AsyncWrap,
   static void GetTLSTicket(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void GetWriteQueueSize(
       const v8::FunctionCallbackInfo<v8::Value>& info);
+  static void IsKTLSActive(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void IsSessionReused(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void LoadSession(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void NewSessionDone(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -275,6 +291,21 @@ class TLSWrap : public AsyncWrap,
   bool cert_cb_running_ = false;
   bool eof_ = false;
 
+  // Kernel TLS offload state, see MaybeStartKTLS().
+  bool ktls_requested_ = false;
+  bool ktls_attempted_ = false;
+  bool ktls_tx_ = false;
+  // While kernel TLS is active, the SSL object writes through a socket BIO,
+  // and this keeps enc_out_ alive so the rest of TLSWrap can keep using it.
+  ncrypto::BIOPointer ktls_enc_out_;
+  // Whether the underlying stream is still writing cleartext to the socket.
+  // Read by the BIO in front of the socket BIO, which holds back records
+  // generated by OpenSSL itself meanwhile.
+  bool ktls_write_in_flight_ = false;
+  // A shutdown request waiting for that write, so that the peer receives the
+  // close_notify before the FIN.
+  BaseObjectPtr<AsyncWrap> pending_shutdown_;
+
   // TODO(@jasnell): These state flags should be revisited.
   // The established_ flag indicates that the handshake is
   // completed. The write_callback_scheduled_ flag is less
@@ -8,6 +8,7 @@
 #include "string_bytes.h"
 #include "v8.h"
 
+#include <algorithm>
 #include <cstdint>
 
 namespace node {
@@ -18,9 +19,12 @@ using v8::BackingStore;
 using v8::BackingStoreInitializationMode;
 using v8::Context;
 using v8::FunctionCallbackInfo;
+using v8::FunctionTemplate;
 using v8::HandleScope;
 using v8::Isolate;
 using v8::Local;
+using v8::MaybeLocal;
+using v8::NewStringType;
 using v8::Object;
 using v8::ObjectTemplate;
 using v8::SnapshotCreator;
@@ -222,6 +226,8 @@ void BindingData::CreatePerIsolateProperties(IsolateData* isolate_data,
   SetMethodNoSideEffect(isolate, target, "toASCII", ToASCII);
   SetMethodNoSideEffect(isolate, target, "toUnicode", ToUnicode);
   SetMethodNoSideEffect(isolate, target, "decodeLatin1", DecodeLatin1);
+
+  UTF8Decoder::CreatePerIsolateProperties(isolate_data, target);
 }
 
 void BindingData::CreatePerContextProperties(Local<Object> target,
@@ -240,6 +246,8 @@ void BindingData::RegisterTimerExternalReferences(
   registry->Register(ToASCII);
   registry->Register(ToUnicode);
   registry->Register(DecodeLatin1);
+
+  UTF8Decoder::RegisterExternalReferences(registry);
 }
 
 void BindingData::DecodeLatin1(const FunctionCallbackInfo<Value>& args) {
@@ -288,6 +296,222 @@ void BindingData::DecodeLatin1(const FunctionCallbackInfo<Value>& args) {
   }
 }
 
+namespace {
+
+// Returns the length of the sequence that lead starts, or 0 if no sequence
+// can start with it.
+size_t SequenceLength(uint8_t lead) {
+  if (lead < 0x80) return 1;
+  if (lead < 0xC2) return 0;
+  if (lead < 0xE0) return 2;
+  if (lead < 0xF0) return 3;
+  if (lead < 0xF5) return 4;
+  return 0;
+}
+
+// Returns how many bytes at the start of data form a valid, possibly
+// incomplete, sequence. The bounds of the second byte are the ones of the
+// WHATWG UTF-8 decoder, which rule out overlong forms and surrogates.
+size_t ValidPrefixLength(const uint8_t* data, size_t length) {
+  const size_t sequence_length = SequenceLength(data[0]);
+  if (sequence_length == 0) return 0;
+  size_t i = 1;
+  for (; i < sequence_length && i < length; i++) {
+    uint8_t lower = 0x80;
+    uint8_t upper = 0xBF;
+    if (i == 1) {
+      switch (data[0]) {
+        case 0xE0:
+          lower = 0xA0;
+          break;
+        case 0xED:
+          upper = 0x9F;
+          break;
+        case 0xF0:
+          lower = 0x90;
+          break;
+        case 0xF4:
+          upper = 0x8F;
+          break;
+      }
+    }
+    if (data[i] < lower || data[i] > upper) break;
+  }
+  return i;
+}
+
+// Returns the length of the sequence at the end of data that is valid so
+// far but needs bytes from the next chunk, or 0 if there is none.
+size_t IncompleteSuffixLength(const uint8_t* data, size_t length) {
+  // The lead byte of an incomplete sequence is one of the last three.
+  for (size_t i = 1; i <= std::min<size_t>(3, length); i++) {
+    const uint8_t* lead = data + length - i;
+    if ((*lead & 0xC0) == 0x80) continue;
+    return SequenceLength(*lead) > i && ValidPrefixLength(lead, i) == i ? i
+                                                                         : 0;
+  }
+  return 0;
+}
+
+bool IsBOM(const uint8_t* data, size_t length) {
+  return length >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0;
+}
+
+}  // anonymous namespace
+
+UTF8Decoder::UTF8Decoder(Environment* env,
+                         Local<Object> object,
+                         bool ignore_bom,
+                         bool fatal)
+    : BaseObject(env, object), ignore_bom_(ignore_bom), fatal_(fatal) {
+  MakeWeak();
+}
+
+void UTF8Decoder::New(const FunctionCallbackInfo<Value>& args) {
+  CHECK(args.IsConstructCall());
+  Environment* env = Environment::GetCurrent(args);
+  new UTF8Decoder(env, args.This(), args[0]->IsTrue(), args[1]->IsTrue());
+}
+
+void UTF8Decoder::Decode(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  UTF8Decoder* decoder;
+  ASSIGN_OR_RETURN_UNWRAP(&decoder, args.This());
+
+  if (!(args[0]->IsArrayBuffer() || args[0]->IsSharedArrayBuffer() ||
+        args[0]->IsArrayBufferView())) {
+    return node::THROW_ERR_INVALID_ARG_TYPE(
+        env->isolate(),
+        "The \"input\" argument must be an instance of ArrayBuffer, "
+        "SharedArrayBuffer, or ArrayBufferView.");
+  }
+
+  ArrayBufferViewContents<uint8_t> buffer(args[0]);
+  Local<Value> ret;
+  if (decoder->DecodeChunk(buffer.data(), buffer.length(), args[1]->IsTrue())
+          .ToLocal(&ret)) {
+    args.GetReturnValue().Set(ret);
+  }
+}
+
+MaybeLocal<Value> UTF8Decoder::DecodeChunk(const uint8_t* data,
+                                           size_t length,
+                                           bool stream) {
+  Isolate* isolate = env()->isolate();
+  Local<Value> head;
+
+  if (pending_length_ > 0) {
+    // Complete the sequence left over from the previous chunk first.
+    const size_t sequence_length = SequenceLength(pending_[0]);
+    const size_t available =
+        std::min(sequence_length - pending_length_, length);
+    memcpy(pending_ + pending_length_, data, available);
+    const size_t valid =
+        ValidPrefixLength(pending_, pending_length_ + available);
+    if (valid < sequence_length && valid == pending_length_ + available) {
+      // The whole chunk belongs to the sequence, which is still incomplete.
+      pending_length_ = valid;
+      if (stream) return String::Empty(isolate);
+      if (fatal_) return ThrowInvalidData();
+      Reset();
+      return String::NewFromUtf8(isolate, "\xEF\xBF\xBD").ToLocalChecked();
+    }
+
+    if (valid == sequence_length) {
+      if (!bom_seen_ && !ignore_bom_ && IsBOM(pending_, valid)) {
+        head = String::Empty(isolate);
+      } else {
+        head = String::NewFromUtf8(isolate,
+                                   reinterpret_cast<const char*>(pending_),
+                                   NewStringType::kNormal,
+                                   static_cast<int>(valid))
+                   .ToLocalChecked();
+      }
+    } else {
+      // The bytes after the valid part are decoded as part of the chunk.
+      if (fatal_) return ThrowInvalidData();
+      head = String::NewFromUtf8(isolate, "\xEF\xBF\xBD").ToLocalChecked();
+    }
+    bom_seen_ = true;
+    data += valid - pending_length_;
+    length -= valid - pending_length_;
+    pending_length_ = 0;
+  }
+
+  const size_t suffix = stream ? IncompleteSuffixLength(data, length) : 0;
+  memcpy(pending_, data + length - suffix, suffix);
+  length -= suffix;
+
+  if (!bom_seen_ && length > 0) {
+    if (!ignore_bom_ && IsBOM(data, length)) {
+      data += 3;
+      length -= 3;
+    }
+    bom_seen_ = true;
+  }
+
+  Local<Value> body;
+  if (!DecodeComplete(data, length).ToLocal(&body)) return MaybeLocal<Value>();
+  pending_length_ = suffix;
+  if (!stream) Reset();
+
+  if (head.IsEmpty()) return body;
+  return String::Concat(isolate, head.As<String>(), body.As<String>());
+}
+
+MaybeLocal<Value> UTF8Decoder::DecodeComplete(const uint8_t* data,
+                                              size_t length) {
+  Isolate* isolate = env()->isolate();
+  const char* chars = reinterpret_cast<const char*>(data);
+  if (length == 0) return String::Empty(isolate);
+
+  if (!simdutf::validate_ascii_with_errors(chars, length).error) {
+    return StringBytes::Encode(isolate, chars, length, LATIN1);
+  }
+
+  // UTF-16 never needs more code units than UTF-8 needs bytes.
+  MaybeStackBuffer<uint16_t> utf16(length);
+  simdutf::result result = simdutf::convert_utf8_to_utf16le_with_errors(
+      chars, length, reinterpret_cast<char16_t*>(utf16.out()));
+  if (result.error == simdutf::error_code::SUCCESS) {
+    return StringBytes::Encode(isolate, utf16.out(), result.count);
+  }
+
+  if (fatal_) return ThrowInvalidData();
+  // V8 replaces the invalid sequences with U+FFFD like the WHATWG decoder.
+  return StringBytes::Encode(isolate, chars, length, UTF8);
+}
+
+MaybeLocal<Value> UTF8Decoder::ThrowInvalidData() {
+  Reset();
+  THROW_ERR_ENCODING_INVALID_ENCODED_DATA(
+      env()->isolate(), "The encoded data was not valid for encoding utf-8");
+  return MaybeLocal<Value>();
+}
+
+void UTF8Decoder::Reset() {
+  bom_seen_ = false;
+  pending_length_ = 0;
+}
+
+void UTF8Decoder::CreatePerIsolateProperties(IsolateData* isolate_data,
+                                             Local<ObjectTemplate> target) {
+  Isolate* isolate = isolate_data->isolate();
+
+  Local<FunctionTemplate> t = NewFunctionTemplate(isolate, New);
+  t->InstanceTemplate()->SetInternalFieldCount(
+      UTF8Decoder::kInternalFieldCount);
+  SetProtoMethod(isolate, t, "decode", Decode);
+
+  SetConstructorFunction(isolate, target, "UTF8Decoder", t);
+}
+
+void UTF8Decoder::RegisterExternalReferences(
+    ExternalReferenceRegistry* registry) {
+  registry->Register(New);
+  registry->Register(Decode);
+}
+
 }  // namespace encoding_binding
 }  // namespace node
 
@@ -5,6 +5,7 @@
 
 #include <cinttypes>
 #include "aliased_buffer.h"
+#include "base_object.h"
 #include "node_snapshotable.h"
 #include "v8-fast-api-calls.h"
 
@@ -51,6 +52,48 @@ class BindingData : public SnapshotableObject {
   InternalFieldInfo* internal_field_info_ = nullptr;
 };
 
+// Streaming UTF-8 decoder behind TextDecoder. An incomplete sequence at the
+// end of a chunk is kept until the next decode() call instead of being
+// reassembled in JS. Every chunk is validated and transcoded in a single
+// simdutf pass, and pure ASCII chunks are copied into one-byte strings
+// without transcoding.
+class UTF8Decoder final : public BaseObject {
+ public:
+  static void CreatePerIsolateProperties(IsolateData* isolate_data,
+                                         v8::Local<v8::ObjectTemplate> target);
+  static void RegisterExternalReferences(ExternalReferenceRegistry* registry);
+
+  SET_NO_MEMORY_INFO()
+  SET_MEMORY_INFO_NAME(UTF8Decoder)
+  SET_SELF_SIZE(UTF8Decoder)
+
+ private:
+  UTF8Decoder(Environment* env,
+              v8::Local<v8::Object> object,
+              bool ignore_bom,
+              bool fatal);
+
+  // new UTF8Decoder(ignoreBOM, fatal)
+  static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
+  // decoder.decode(input, stream)
+  static void Decode(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+  v8::MaybeLocal<v8::Value> DecodeChunk(const uint8_t* data,
+                                        size_t length,
+                                        bool stream);
+  // Decodes a chunk that does not end in an incomplete sequence.
+  v8::MaybeLocal<v8::Value> DecodeComplete(const uint8_t* data, size_t length);
+  v8::MaybeLocal<v8::Value> ThrowInvalidData();
+  void Reset();
+
+  const bool ignore_bom_;
+  const bool fatal_;
+  bool bom_seen_ = false;
+  // The start of a sequence that continues in the next chunk.
+  uint8_t pending_[4];
+  size_t pending_length_ = 0;
+};
+
 }  // namespace encoding_binding
 
 }  // namespace node
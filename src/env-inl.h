@@ -757,6 +757,26 @@ inline performance::PerformanceState* Environment::performance_state() {
   return performance_state_.get();
 }
 
+inline performance::EventLoopPhaseProfiler*
+Environment::loop_phase_profiler() const {
+  return loop_phase_profiler_;
+}
+
+inline void Environment::set_loop_phase_profiler(
+    performance::EventLoopPhaseProfiler* profiler) {
+  loop_phase_profiler_ = profiler;
+}
+
+inline profiler::SamplingCpuProfiler* Environment::sampling_cpu_profiler()
+    const {
+  return sampling_cpu_profiler_;
+}
+
+inline void Environment::set_sampling_cpu_profiler(
+    profiler::SamplingCpuProfiler* profiler) {
+  sampling_cpu_profiler_ = profiler;
+}
+
 inline IsolateData* Environment::isolate_data() const {
   return isolate_data_;
 }
@@ -11,6 +11,7 @@
 #include "node_errors.h"
 #include "node_internals.h"
 #include "node_options-inl.h"
+#include "node_perf.h"
 #include "node_process-inl.h"
 #include "node_shadow_realm.h"
 #include "node_snapshotable.h"
@@ -330,6 +331,7 @@ std::ostream& operator<<(std::ostream& output, const SnapshotMetadata& i) {
          << "  \"" << i.node_arch << "\", // node_arch\n"
          << "  \"" << i.node_platform << "\", // node_platform\n"
          << "  " << i.flags << ", // flags\n"
+         << "  " << i.sources << ", // sources\n"
          << "}";
   return output;
 }
@@ -1337,16 +1339,25 @@ void Environment::RunCleanup() {
 
 void Environment::RunAtExitCallbacks() {
   TRACE_EVENT0(TRACING_CATEGORY_NODE1(environment), "AtExit");
-  for (ExitCallback at_exit : at_exit_functions_) {
+  // A callback may remove others, e.g. by destroying the objects they
+  // belong to, so each one is taken off the list before it runs.
+  while (!at_exit_functions_.empty()) {
+    ExitCallback at_exit = at_exit_functions_.front();
+    at_exit_functions_.pop_front();
     at_exit.cb_(at_exit.arg_);
   }
-  at_exit_functions_.clear();
 }
 
 void Environment::AtExit(void (*cb)(void* arg), void* arg) {
   at_exit_functions_.push_front(ExitCallback{cb, arg});
 }
 
+void Environment::RemoveAtExit(void (*cb)(void* arg), void* arg) {
+  at_exit_functions_.remove_if([&](const ExitCallback& at_exit) {
+    return at_exit.cb_ == cb && at_exit.arg_ == arg;
+  });
+}
+
 Maybe<bool> Environment::CheckUnsettledTopLevelAwait() const {
   HandleScope scope(isolate_);
   Local<Context> ctx = context();
@@ -1509,6 +1520,8 @@ void Environment::ToggleTimerRef(bool ref) {
 void Environment::RunTimers(uv_timer_t* handle) {
   Environment* env = Environment::from_timer_handle(handle);
   TRACE_EVENT0(TRACING_CATEGORY_NODE1(environment), "RunTimers");
+  performance::EventLoopPhaseProfiler::Scope phase_scope(
+      env, performance::NODE_PERFORMANCE_LOOP_PHASE_TIMERS);
 
   if (!env->can_call_into_js())
     return;
@@ -1570,6 +1583,8 @@ void Environment::RunTimers(uv_timer_t* handle) {
 void Environment::CheckImmediate(uv_check_t* handle) {
   Environment* env = Environment::from_immediate_check_handle(handle);
   TRACE_EVENT0(TRACING_CATEGORY_NODE1(environment), "CheckImmediate");
+  performance::EventLoopPhaseProfiler::Scope phase_scope(
+      env, performance::NODE_PERFORMANCE_LOOP_PHASE_IMMEDIATES);
 
   HandleScope scope(env->isolate());
   Context::Scope context_scope(env->context());
@@ -63,6 +63,7 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <optional>
 #include <ostream>
 #include <set>
 #include <string>
@@ -82,6 +83,7 @@ class CompiledFnEntry;
 }
 
 namespace performance {
+class EventLoopPhaseProfiler;
 class PerformanceState;
 }
 
@@ -89,6 +91,10 @@ namespace tracing {
 class AgentWriterHandle;
 }
 
+namespace profiler {
+class SamplingCpuProfiler;
+}  // namespace profiler
+
 #if HAVE_INSPECTOR
 namespace profiler {
 class V8CoverageConnection;
@@ -532,6 +538,21 @@ struct EnvSerializeInfo {
   friend std::ostream& operator<<(std::ostream& o, const EnvSerializeInfo& i);
 };
 
+// A file that went into a snapshot built with --build-snapshot, recorded so
+// that --snapshot-auto-rebuild can tell whether the snapshot is stale.
+struct SnapshotSource {
+  std::string path;  // The real path.
+  uint64_t size;
+  uint64_t mtime_ns;
+  uint32_t hash;  // CRC32 of the contents.
+
+  // Returns std::nullopt if the file cannot be read.
+  static std::optional<SnapshotSource> FromFile(const std::string& path);
+  // Only hashes the file again if its size matches and its modification time
+  // does not.
+  bool IsUpToDate() const;
+};
+
 struct SnapshotMetadata {
   // For now kFullyCustomized is only built with the --build-snapshot CLI flag.
   // We might want to add more types of snapshots in the future.
@@ -542,12 +563,24 @@ struct SnapshotMetadata {
   std::string node_arch;
   std::string node_platform;
   SnapshotFlags flags;
+  // The builder script comes first, followed by the configuration file if
+  // there is one. Empty for the built-in snapshot.
+  std::vector<SnapshotSource> sources;
 };
 
 struct SnapshotData {
   enum class DataOwnership { kOwned, kNotOwned };
 
+  // Magic of the original layout, whose metadata has no sources.
   static const uint32_t kMagic = 0x143da19;
+  // Magic of the layout that records the sources in the metadata, and stores
+  // the V8 startup data and the code cache in separate, optionally
+  // compressed sections. The sections start at multiples of
+  // kSectionAlignment in the blob, which covers the page size and the
+  // allocation granularity of the supported platforms, so that they can be
+  // used in place when the blob file is mapped into memory.
+  static const uint32_t kSectionedMagic = 0x143da1a;
+  static constexpr size_t kSectionAlignment = 64 * 1024;
   static const SnapshotIndex kNodeVMContextIndex = 0;
   static const SnapshotIndex kNodeBaseContextIndex = kNodeVMContextIndex + 1;
   static const SnapshotIndex kNodeMainContextIndex = kNodeBaseContextIndex + 1;
@@ -571,14 +604,30 @@ struct SnapshotData {
   // v8::ScriptCompiler::CachedData is not copyable.
   std::vector<builtins::CodeCacheInfo> code_cache;
 
+  // If not null, keeps the memory of v8_snapshot_blob_data alive, which is
+  // then not deleted along with this. This is the case when the snapshot
+  // was mapped from a file.
+  std::shared_ptr<void> v8_snapshot_blob_owner;
+
   void ToFile(FILE* out) const;
   std::vector<char> ToBlob() const;
   // If returns false, the metadata doesn't match the current Node.js binary,
   // and the caller should not consume the snapshot data.
   bool Check() const;
+  // Returns false if the snapshot was built from another builder script than
+  // entry_point, or if one of its sources changed since.
+  bool SourcesAreUpToDate(const std::string& entry_point) const;
+  // Maps the file into memory if possible, so that uncompressed sections
+  // are not copied. On Windows, the file is always read into memory, see
+  // MappedSnapshotFile::Map().
   static bool FromFile(SnapshotData* out, FILE* in);
   static bool FromBlob(SnapshotData* out, const std::vector<char>& in);
   static bool FromBlob(SnapshotData* out, std::string_view in);
+  // If in_owner is not null, it keeps in alive, and uncompressed sections
+  // are used in place instead of being copied.
+  static bool FromBlob(SnapshotData* out,
+                       std::string_view in,
+                       std::shared_ptr<void> in_owner);
   static const SnapshotData* FromEmbedderWrapper(
       const EmbedderSnapshotData* data);
   EmbedderSnapshotData::Pointer AsEmbedderWrapper() const;
@@ -771,6 +820,12 @@ class Environment final : public MemoryRetainer {
   EnabledDebugList* enabled_debug_list() { return &enabled_debug_list_; }
 
   inline performance::PerformanceState* performance_state();
+  inline performance::EventLoopPhaseProfiler* loop_phase_profiler() const;
+  inline void set_loop_phase_profiler(
+      performance::EventLoopPhaseProfiler* profiler);
+  inline profiler::SamplingCpuProfiler* sampling_cpu_profiler() const;
+  inline void set_sampling_cpu_profiler(
+      profiler::SamplingCpuProfiler* profiler);
 
   v8::Maybe<void> CollectUVExceptionInfo(v8::Local<v8::Value> context,
                                          int errorno,
@@ -848,6 +903,9 @@ class Environment final : public MemoryRetainer {
                                const char* dest = nullptr);
 
   void AtExit(void (*cb)(void* arg), void* arg);
+  // Removes a callback added through AtExit(), for objects that go away
+  // before the Environment does.
+  void RemoveAtExit(void (*cb)(void* arg), void* arg);
   void RunAtExitCallbacks();
 
   v8::Maybe<bool> CheckUnsettledTopLevelAwait() const;
@@ -1177,6 +1235,10 @@ class Environment final : public MemoryRetainer {
   // This is the time when the environment is created.
   const uint64_t environment_start_;
   std::unique_ptr<performance::PerformanceState> performance_state_;
+  // Owned by itself, it is deleted once its handles have been closed.
+  performance::EventLoopPhaseProfiler* loop_phase_profiler_ = nullptr;
+  // Owned by itself, it is deleted once its handles have been closed.
+  profiler::SamplingCpuProfiler* sampling_cpu_profiler_ = nullptr;
 
   bool has_serialized_options_ = false;
 
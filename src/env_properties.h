@@ -378,6 +378,7 @@
 #define PER_ISOLATE_TEMPLATE_PROPERTIES(V)                                     \
   V(a_record_template, v8::DictionaryTemplate)                                 \
   V(aaaa_record_template, v8::DictionaryTemplate)                              \
+  V(async_context_frame_constructor_template, v8::FunctionTemplate)            \
   V(async_wrap_ctor_template, v8::FunctionTemplate)                            \
   V(binding_data_default_template, v8::ObjectTemplate)                         \
   V(blob_constructor_template, v8::FunctionTemplate)                           \
@@ -23,6 +23,7 @@
 #include "async_wrap-inl.h"
 #include "env-inl.h"
 #include "node_external_reference.h"
+#include "node_perf.h"
 #include "util-inl.h"
 
 namespace node {
@@ -138,6 +139,8 @@ void HandleWrap::OnClose(uv_handle_t* handle) {
   wrap->Detach();
 
   Environment* env = wrap->env();
+  performance::EventLoopPhaseProfiler::Scope phase_scope(
+      env, performance::NODE_PERFORMANCE_LOOP_PHASE_CLOSE);
   HandleScope scope(env->isolate());
   Context::Scope context_scope(env->context());
 
@@ -0,0 +1,175 @@
+#include "heap_snapshot_binary.h"
+#include "util-inl.h"
+
+#include <cstring>
+
+namespace node {
+namespace heap {
+
+BinaryHeapSnapshotEncoder::BinaryHeapSnapshotEncoder(v8::OutputStream* out)
+    : out_(out) {
+  output_.reserve(kOutputChunkSize + 64);
+  output_.append(kBinaryHeapSnapshotMagic, sizeof(kBinaryHeapSnapshotMagic));
+  output_.push_back(static_cast<char>(kBinaryHeapSnapshotVersion));
+  ints_.reserve(kMaxIntRun);
+}
+
+int BinaryHeapSnapshotEncoder::GetChunkSize() {
+  return kOutputChunkSize;
+}
+
+void BinaryHeapSnapshotEncoder::WriteToken(BinaryHeapSnapshotToken token) {
+  output_.push_back(static_cast<char>(token));
+}
+
+void BinaryHeapSnapshotEncoder::WriteVarint(uint64_t value) {
+  while (value >= 0x80) {
+    output_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  output_.push_back(static_cast<char>(value));
+}
+
+void BinaryHeapSnapshotEncoder::WriteBytes(const std::string& bytes) {
+  WriteVarint(bytes.size());
+  output_.append(bytes);
+}
+
+void BinaryHeapSnapshotEncoder::FlushInts() {
+  if (ints_.empty()) return;
+  WriteToken(BinaryHeapSnapshotToken::kIntRun);
+  WriteVarint(ints_.size());
+  for (int64_t value : ints_) {
+    WriteVarint((static_cast<uint64_t>(value) << 1) ^
+                static_cast<uint64_t>(value >> 63));
+  }
+  ints_.clear();
+}
+
+void BinaryHeapSnapshotEncoder::EndBareToken() {
+  state_ = State::kValue;
+  // Integers with up to 18 digits always fit into an int64_t. Anything else
+  // (fractions, exponents, true/false/null) is kept as text.
+  size_t start = !pending_.empty() && pending_[0] == '-' ? 1 : 0;
+  bool is_int = pending_.size() > start && pending_.size() - start <= 18;
+  int64_t value = 0;
+  for (size_t i = start; is_int && i < pending_.size(); i++) {
+    char c = pending_[i];
+    if (c < '0' || c > '9') {
+      is_int = false;
+    } else {
+      value = value * 10 + (c - '0');
+    }
+  }
+  if (is_int) {
+    ints_.push_back(start == 1 ? -value : value);
+    if (ints_.size() == kMaxIntRun) FlushInts();
+  } else {
+    FlushInts();
+    WriteToken(BinaryHeapSnapshotToken::kLiteral);
+    WriteBytes(pending_);
+  }
+  pending_.clear();
+}
+
+bool BinaryHeapSnapshotEncoder::FlushOutput() {
+  if (output_.empty()) return true;
+  WriteResult result =
+      out_->WriteAsciiChunk(output_.data(), static_cast<int>(output_.size()));
+  output_.clear();
+  return result == kContinue;
+}
+
+v8::OutputStream::WriteResult BinaryHeapSnapshotEncoder::WriteAsciiChunk(
+    char* data, int size) {
+  if (failed_) return kAbort;
+  const char* end = data + size;
+  const char* p = data;
+  while (p < end) {
+    switch (state_) {
+      case State::kString: {
+        // Copy everything up to the next quote or backslash in one go.
+        const char* q = p;
+        while (q < end && (escape_ || (*q != '"' && *q != '\\'))) {
+          escape_ = false;
+          q++;
+        }
+        pending_.append(p, q - p);
+        p = q;
+        if (p == end) break;
+        if (*p == '\\') {
+          escape_ = true;
+          pending_.push_back(*p++);
+          break;
+        }
+        p++;  // Closing quote.
+        FlushInts();
+        WriteToken(BinaryHeapSnapshotToken::kString);
+        WriteBytes(pending_);
+        pending_.clear();
+        state_ = State::kValue;
+        break;
+      }
+      case State::kBare: {
+        char c = *p;
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+            (c >= 'A' && c <= 'Z') || c == '-' || c == '+' || c == '.') {
+          pending_.push_back(c);
+          p++;
+        } else {
+          EndBareToken();
+        }
+        break;
+      }
+      case State::kValue: {
+        char c = *p++;
+        switch (c) {
+          case '[':
+            FlushInts();
+            WriteToken(BinaryHeapSnapshotToken::kArray);
+            break;
+          case '{':
+            FlushInts();
+            WriteToken(BinaryHeapSnapshotToken::kObject);
+            break;
+          case ']':
+          case '}':
+            FlushInts();
+            WriteToken(BinaryHeapSnapshotToken::kEnd);
+            break;
+          case '"':
+            state_ = State::kString;
+            break;
+          case ',':
+          case ':':
+          case ' ':
+          case '\n':
+          case '\r':
+          case '\t':
+            break;
+          default:
+            state_ = State::kBare;
+            pending_.push_back(c);
+            break;
+        }
+        break;
+      }
+    }
+  }
+
+  if (output_.size() >= kOutputChunkSize && !FlushOutput()) {
+    failed_ = true;
+    return kAbort;
+  }
+  return kContinue;
+}
+
+void BinaryHeapSnapshotEncoder::EndOfStream() {
+  if (state_ == State::kBare) EndBareToken();
+  DCHECK(state_ == State::kValue);
+  FlushInts();
+  if (!failed_ && FlushOutput()) out_->EndOfStream();
+}
+
+}  // namespace heap
+}  // namespace node
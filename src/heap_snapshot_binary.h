@@ -0,0 +1,82 @@
+#ifndef SRC_HEAP_SNAPSHOT_BINARY_H_
+#define SRC_HEAP_SNAPSHOT_BINARY_H_
+
+#if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#include "v8-profiler.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace node {
+namespace heap {
+
+// Compact binary encoding of a .heapsnapshot file. It is a token stream that
+// mirrors the JSON document V8 serializes, so that it can be converted back
+// without knowing the snapshot schema (see
+// tools/heapsnapshot-binary-to-json.mjs):
+//
+//   "NHSB" <version: u8>
+//   kEnd                          closes the innermost array or object
+//   kArray | kObject              opens a container
+//   kString <len> <bytes>         JSON string contents, escapes kept as-is
+//   kIntRun <count> <int>...      consecutive integers, zigzag varints
+//   kLiteral <len> <bytes>        any other number, true, false or null
+//
+// Lengths and counts are unsigned LEB128 varints. Almost all of a snapshot
+// is the nodes/edges/locations integer arrays, which shrink to one or two
+// bytes per field. Strings are already deduplicated by the snapshot's own
+// string table and only referenced by index from nodes and edges.
+enum class BinaryHeapSnapshotToken : uint8_t {
+  kEnd = 0,
+  kArray = 1,
+  kObject = 2,
+  kString = 3,
+  kIntRun = 4,
+  kLiteral = 5,
+};
+
+static constexpr char kBinaryHeapSnapshotMagic[] = {'N', 'H', 'S', 'B'};
+static constexpr uint8_t kBinaryHeapSnapshotVersion = 1;
+
+// Transcodes the JSON serialization of a v8::HeapSnapshot into the binary
+// format while it is being produced, forwarding the result to another
+// OutputStream in chunks. Only the token being parsed and a bounded run of
+// integers are buffered, the JSON text itself is never held in memory.
+class BinaryHeapSnapshotEncoder final : public v8::OutputStream {
+ public:
+  explicit BinaryHeapSnapshotEncoder(v8::OutputStream* out);
+
+  int GetChunkSize() override;
+  void EndOfStream() override;
+  WriteResult WriteAsciiChunk(char* data, int size) override;
+
+ private:
+  static constexpr size_t kOutputChunkSize = 65536;
+  static constexpr size_t kMaxIntRun = 4096;
+
+  enum class State { kValue, kString, kBare };
+
+  void WriteToken(BinaryHeapSnapshotToken token);
+  void WriteVarint(uint64_t value);
+  void WriteBytes(const std::string& bytes);
+  void FlushInts();
+  void EndBareToken();
+  bool FlushOutput();
+
+  v8::OutputStream* out_;
+  State state_ = State::kValue;
+  bool escape_ = false;
+  bool failed_ = false;
+  std::string pending_;
+  std::vector<int64_t> ints_;
+  std::string output_;
+};
+
+}  // namespace heap
+}  // namespace node
+
+#endif  // defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#endif  // SRC_HEAP_SNAPSHOT_BINARY_H_
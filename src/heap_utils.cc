@@ -1,5 +1,6 @@
 #include "diagnosticfilename-inl.h"
 #include "env-inl.h"
+#include "heap_snapshot_binary.h"
 #include "memory_tracker-inl.h"
 #include "node_external_reference.h"
 #include "path.h"
@@ -269,10 +270,12 @@ class HeapSnapshotStream : public AsyncWrap,
   HeapSnapshotStream(
       Environment* env,
       HeapSnapshotPointer&& snapshot,
-      Local<Object> obj) :
+      Local<Object> obj,
+      bool binary) :
       AsyncWrap(env, obj, AsyncWrap::PROVIDER_HEAPSNAPSHOT),
       StreamBase(env),
-      snapshot_(std::move(snapshot)) {
+      snapshot_(std::move(snapshot)),
+      binary_(binary) {
     MakeWeak();
     StreamBase::AttachToObject(GetObject());
   }
@@ -305,7 +308,14 @@ class HeapSnapshotStream : public AsyncWrap,
 
   int ReadStart() override {
     CHECK_NE(snapshot_, nullptr);
-    snapshot_->Serialize(this, HeapSnapshot::kJSON);
+    if (binary_) {
+      // The encoder only ever writes complete chunks of binary data to this
+      // stream, which passes them on as they are.
+      BinaryHeapSnapshotEncoder encoder(this);
+      snapshot_->Serialize(&encoder, HeapSnapshot::kJSON);
+    } else {
+      snapshot_->Serialize(this, HeapSnapshot::kJSON);
+    }
     return 0;
   }
 
@@ -340,6 +350,7 @@ class HeapSnapshotStream : public AsyncWrap,
 
  private:
   HeapSnapshotPointer snapshot_;
+  const bool binary_;
 };
 
 inline void TakeSnapshot(Environment* env,
@@ -354,7 +365,8 @@ inline void TakeSnapshot(Environment* env,
 
 Maybe<void> WriteSnapshot(Environment* env,
                           const char* filename,
-                          HeapProfiler::HeapSnapshotOptions options) {
+                          HeapProfiler::HeapSnapshotOptions options,
+                          bool binary) {
   uv_fs_t req;
   int err;
 
@@ -371,7 +383,12 @@ Maybe<void> WriteSnapshot(Environment* env,
   }
 
   FileOutputStream stream(fd, &req);
-  TakeSnapshot(env, &stream, options);
+  if (binary) {
+    BinaryHeapSnapshotEncoder encoder(&stream);
+    TakeSnapshot(env, &encoder, options);
+  } else {
+    TakeSnapshot(env, &stream, options);
+  }
   if ((err = stream.status()) < 0) {
     env->ThrowUVException(err, "write", nullptr, filename);
     return Nothing<void>();
@@ -392,7 +409,7 @@ void DeleteHeapSnapshot(const HeapSnapshot* snapshot) {
 }
 
 BaseObjectPtr<AsyncWrap> CreateHeapSnapshotStream(
-    Environment* env, HeapSnapshotPointer&& snapshot) {
+    Environment* env, HeapSnapshotPointer&& snapshot, bool binary) {
   HandleScope scope(env->isolate());
 
   if (env->streambaseoutputstream_constructor_template().IsEmpty()) {
@@ -413,7 +430,8 @@ BaseObjectPtr<AsyncWrap> CreateHeapSnapshotStream(
            .ToLocal(&obj)) {
     return {};
   }
-  return MakeBaseObject<HeapSnapshotStream>(env, std::move(snapshot), obj);
+  return MakeBaseObject<HeapSnapshotStream>(
+      env, std::move(snapshot), obj, binary);
 }
 
 HeapProfiler::HeapSnapshotOptions GetHeapSnapshotOptions(
@@ -434,13 +452,16 @@ HeapProfiler::HeapSnapshotOptions GetHeapSnapshotOptions(
 
 void CreateHeapSnapshotStream(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args);
-  CHECK_EQ(args.Length(), 1);
+  CHECK_GE(args.Length(), 1);
   auto options = GetHeapSnapshotOptions(args[0]);
+  // Emit the compact binary format instead of JSON, like the third argument
+  // of triggerHeapSnapshot().
+  const bool binary = args[1]->IsTrue();
   HeapSnapshotPointer snapshot{
       env->isolate()->GetHeapProfiler()->TakeHeapSnapshot(options)};
   CHECK(snapshot);
   BaseObjectPtr<AsyncWrap> stream =
-      CreateHeapSnapshotStream(env, std::move(snapshot));
+      CreateHeapSnapshotStream(env, std::move(snapshot), binary);
   if (stream)
     args.GetReturnValue().Set(stream->object());
 }
@@ -448,17 +469,21 @@ void CreateHeapSnapshotStream(const FunctionCallbackInfo<Value>& args) {
 void TriggerHeapSnapshot(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args);
   Isolate* isolate = args.GetIsolate();
-  CHECK_EQ(args.Length(), 2);
+  CHECK_GE(args.Length(), 2);
   Local<Value> filename_v = args[0];
   auto options = GetHeapSnapshotOptions(args[1]);
+  // Write the compact binary format instead of JSON, see
+  // heap_snapshot_binary.h.
+  const bool binary = args[2]->IsTrue();
 
   if (filename_v->IsUndefined()) {
-    DiagnosticFilename name(env, "Heap", "heapsnapshot");
+    DiagnosticFilename name(
+        env, "Heap", binary ? "heapsnapshot.bin" : "heapsnapshot");
     THROW_IF_INSUFFICIENT_PERMISSIONS(
         env,
         permission::PermissionScope::kFileSystemWrite,
         Environment::GetCwd(env->exec_path()));
-    if (WriteSnapshot(env, *name, options).IsNothing()) return;
+    if (WriteSnapshot(env, *name, options, binary).IsNothing()) return;
     if (String::NewFromUtf8(isolate, *name).ToLocal(&filename_v)) {
       args.GetReturnValue().Set(filename_v);
     }
@@ -470,7 +495,7 @@ void TriggerHeapSnapshot(const FunctionCallbackInfo<Value>& args) {
   ToNamespacedPath(env, &path);
   THROW_IF_INSUFFICIENT_PERMISSIONS(
       env, permission::PermissionScope::kFileSystemWrite, path.ToStringView());
-  if (WriteSnapshot(env, *path, options).IsNothing()) return;
+  if (WriteSnapshot(env, *path, options, binary).IsNothing()) return;
   return args.GetReturnValue().Set(filename_v);
 }
 
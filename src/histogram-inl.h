@@ -9,12 +9,50 @@
 
 namespace node {
 
+Histogram::Shard* Histogram::GetShard() {
+  std::atomic<Shard*>* slot = &shards_[CurrentThreadShardIndex()];
+  Shard* shard = slot->load(std::memory_order_acquire);
+  return shard != nullptr ? shard : CreateShard(slot);
+}
+
+template <typename Fn>
+void Histogram::ForEachShard(Fn&& fn) const {
+  if (!sharded()) return;
+  for (const std::atomic<Shard*>& slot : shards_) {
+    Shard* shard = slot.load(std::memory_order_acquire);
+    if (shard != nullptr) fn(shard);
+  }
+}
+
+hdr_histogram* Histogram::MergedLocked() const {
+  ForEachShard([&](Shard* shard) {
+    // Shards that nothing was recorded to since they were last merged are
+    // skipped, so reading repeatedly does not redo the whole merge.
+    if (shard->count.load(std::memory_order_relaxed) == 0 &&
+        shard->exceeds.load(std::memory_order_relaxed) == 0) {
+      return;
+    }
+    Mutex::ScopedLock shard_lock(shard->mutex);
+    hdr_add(histogram_.get(), shard->histogram.get());
+    hdr_reset(shard->histogram.get());
+    count_ += shard->count.exchange(0, std::memory_order_relaxed);
+    exceeds_ += shard->exceeds.exchange(0, std::memory_order_relaxed);
+  });
+  return histogram_.get();
+}
+
 void Histogram::Reset() {
   Mutex::ScopedLock lock(mutex_);
   hdr_reset(histogram_.get());
   exceeds_ = 0;
   count_ = 0;
   prev_ = 0;
+  ForEachShard([](Shard* shard) {
+    Mutex::ScopedLock shard_lock(shard->mutex);
+    hdr_reset(shard->histogram.get());
+    shard->count.store(0, std::memory_order_relaxed);
+    shard->exceeds.store(0, std::memory_order_relaxed);
+  });
 }
 
 double Histogram::Add(const Histogram& other) {
@@ -23,46 +61,66 @@ double Histogram::Add(const Histogram& other) {
   exceeds_ += other.exceeds_;
   if (other.prev_ > prev_)
     prev_ = other.prev_;
-  return static_cast<double>(hdr_add(histogram_.get(), other.histogram_.get()));
+  int64_t dropped = hdr_add(histogram_.get(), other.histogram_.get());
+  other.ForEachShard([&](Shard* shard) {
+    Mutex::ScopedLock shard_lock(shard->mutex);
+    count_ += shard->count.load(std::memory_order_relaxed);
+    exceeds_ += shard->exceeds.load(std::memory_order_relaxed);
+    dropped += hdr_add(histogram_.get(), shard->histogram.get());
+  });
+  return static_cast<double>(dropped);
 }
 
 size_t Histogram::Count() const {
   Mutex::ScopedLock lock(mutex_);
-  return count_;
+  size_t count = count_;
+  ForEachShard([&](Shard* shard) {
+    count += shard->count.load(std::memory_order_relaxed);
+  });
+  return count;
+}
+
+size_t Histogram::Exceeds() const {
+  Mutex::ScopedLock lock(mutex_);
+  size_t exceeds = exceeds_;
+  ForEachShard([&](Shard* shard) {
+    exceeds += shard->exceeds.load(std::memory_order_relaxed);
+  });
+  return exceeds;
 }
 
 int64_t Histogram::Min() const {
   Mutex::ScopedLock lock(mutex_);
-  return hdr_min(histogram_.get());
+  return hdr_min(MergedLocked());
 }
 
 int64_t Histogram::Max() const {
   Mutex::ScopedLock lock(mutex_);
-  return hdr_max(histogram_.get());
+  return hdr_max(MergedLocked());
 }
 
 double Histogram::Mean() const {
   Mutex::ScopedLock lock(mutex_);
-  return hdr_mean(histogram_.get());
+  return hdr_mean(MergedLocked());
 }
 
 double Histogram::Stddev() const {
   Mutex::ScopedLock lock(mutex_);
-  return hdr_stddev(histogram_.get());
+  return hdr_stddev(MergedLocked());
 }
 
 int64_t Histogram::Percentile(double percentile) const {
   Mutex::ScopedLock lock(mutex_);
   CHECK_GT(percentile, 0);
   CHECK_LE(percentile, 100);
-  return hdr_value_at_percentile(histogram_.get(), percentile);
+  return hdr_value_at_percentile(MergedLocked(), percentile);
 }
 
 template <typename Iterator>
 void Histogram::Percentiles(Iterator&& fn) {
   Mutex::ScopedLock lock(mutex_);
   hdr_iter iter;
-  hdr_iter_percentile_init(&iter, histogram_.get(), 1);
+  hdr_iter_percentile_init(&iter, MergedLocked(), 1);
   while (hdr_iter_next(&iter)) {
     double key = iter.specifics.percentiles.percentile;
     fn(key, iter.value);
@@ -70,6 +128,16 @@ void Histogram::Percentiles(Iterator&& fn) {
 }
 
 bool Histogram::Record(int64_t value) {
+  if (sharded()) {
+    Shard* shard = GetShard();
+    Mutex::ScopedLock shard_lock(shard->mutex);
+    bool recorded = hdr_record_value(shard->histogram.get(), value);
+    if (!recorded)
+      shard->exceeds.fetch_add(1, std::memory_order_relaxed);
+    else
+      shard->count.fetch_add(1, std::memory_order_relaxed);
+    return recorded;
+  }
   Mutex::ScopedLock lock(mutex_);
   bool recorded = hdr_record_value(histogram_.get(), value);
   if (!recorded)
@@ -79,9 +147,18 @@ bool Histogram::Record(int64_t value) {
   return recorded;
 }
 
-uint64_t Histogram::RecordDelta() {
+uint64_t Histogram::RecordDelta(uint64_t time) {
+  Mutex::ScopedLock lock(mutex_);
+  return RecordDeltaLocked(time);
+}
+
+uint64_t Histogram::RecordDeltaCoarse(uint64_t time) {
   Mutex::ScopedLock lock(mutex_);
-  uint64_t time = uv_hrtime();
+  if (time < prev_) time = prev_;
+  return RecordDeltaLocked(time);
+}
+
+uint64_t Histogram::RecordDeltaLocked(uint64_t time) {
   int64_t delta = 0;
   if (prev_ > 0) {
     CHECK_GE(time, prev_);
@@ -97,7 +174,11 @@ uint64_t Histogram::RecordDelta() {
 
 size_t Histogram::GetMemorySize() const {
   Mutex::ScopedLock lock(mutex_);
-  return hdr_get_memory_size(histogram_.get());
+  size_t size = hdr_get_memory_size(histogram_.get());
+  ForEachShard([&](Shard* shard) {
+    size += sizeof(Shard) + hdr_get_memory_size(shard->histogram.get());
+  });
+  return size;
 }
 
 }  // namespace node
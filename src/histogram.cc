@@ -25,13 +25,46 @@ using v8::String;
 using v8::Uint32;
 using v8::Value;
 
-Histogram::Histogram(const Options& options) {
+Histogram::Histogram(const Options& options)
+    : options_(options), histogram_(NewHdrHistogram(options)) {}
+
+Histogram::~Histogram() {
+  for (std::atomic<Shard*>& slot : shards_)
+    delete slot.load(std::memory_order_relaxed);
+}
+
+Histogram::HistogramPointer Histogram::NewHdrHistogram(
+    const Options& options) {
   hdr_histogram* histogram;
   CHECK_EQ(0, hdr_init(options.lowest,
                        options.highest,
                        options.figures,
                        &histogram));
-  histogram_.reset(histogram);
+  return HistogramPointer(histogram);
+}
+
+size_t Histogram::CurrentThreadShardIndex() {
+  // Threads are assigned shards round-robin, so that up to kShardCount
+  // threads never share one.
+  static std::atomic<size_t> next_index{0};
+  thread_local size_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+  return index;
+}
+
+// Shards are created on first use, since each one is as large as the
+// histogram itself.
+Histogram::Shard* Histogram::CreateShard(std::atomic<Shard*>* slot) {
+  Shard* shard = new Shard();
+  shard->histogram = NewHdrHistogram(options_);
+  Shard* expected = nullptr;
+  if (!slot->compare_exchange_strong(expected, shard,
+                                     std::memory_order_acq_rel)) {
+    // Another thread that uses the same shard was faster.
+    delete shard;
+    return expected;
+  }
+  return shard;
 }
 
 void Histogram::MemoryInfo(MemoryTracker* tracker) const {
@@ -64,6 +97,8 @@ CFunction HistogramBase::fast_record_(
     CFunction::Make(&HistogramBase::FastRecord));
 CFunction HistogramBase::fast_record_delta_(
     CFunction::Make(&HistogramBase::FastRecordDelta));
+CFunction HistogramBase::fast_record_delta_coarse_(
+    CFunction::Make(&HistogramBase::FastRecordDeltaCoarse));
 CFunction IntervalHistogram::fast_start_(
     CFunction::Make(&IntervalHistogram::FastStart));
 CFunction IntervalHistogram::fast_stop_(
@@ -168,6 +203,22 @@ void HistogramBase::FastRecordDelta(Local<Value> receiver) {
   (*histogram)->RecordDelta();
 }
 
+// Uses the coarse clock of the Environment, see PerformanceState.
+void HistogramBase::RecordDeltaCoarse(const FunctionCallbackInfo<Value>& args) {
+  HistogramBase* histogram;
+  ASSIGN_OR_RETURN_UNWRAP(&histogram, args.This());
+  (*histogram)->RecordDeltaCoarse(
+      histogram->env()->performance_state()->coarse_now());
+}
+
+void HistogramBase::FastRecordDeltaCoarse(Local<Value> receiver) {
+  TRACK_V8_FAST_API_CALL("histogram.recordDeltaCoarse");
+  HistogramBase* histogram;
+  ASSIGN_OR_RETURN_UNWRAP(&histogram, receiver);
+  (*histogram)->RecordDeltaCoarse(
+      histogram->env()->performance_state()->coarse_now());
+}
+
 void HistogramBase::Record(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args);
   CHECK_IMPLIES(!args[0]->IsNumber(), args[0]->IsBigInt());
@@ -257,7 +308,7 @@ void HistogramBase::New(const FunctionCallbackInfo<Value>& args) {
 
   int32_t figures = args[2].As<Uint32>()->Value();
   new HistogramBase(env, args.This(), Histogram::Options {
-    lowest, highest, figures
+    lowest, highest, figures, args[3]->IsTrue()
   });
 }
 
@@ -274,6 +325,11 @@ Local<FunctionTemplate> HistogramBase::GetConstructorTemplate(
     SetFastMethod(isolate, instance, "record", Record, &fast_record_);
     SetFastMethod(
         isolate, instance, "recordDelta", RecordDelta, &fast_record_delta_);
+    SetFastMethod(isolate,
+                  instance,
+                  "recordDeltaCoarse",
+                  RecordDeltaCoarse,
+                  &fast_record_delta_coarse_);
     SetProtoMethod(isolate, tmpl, "add", Add);
     HistogramImpl::AddMethods(isolate, tmpl);
     isolate_data->set_histogram_ctor_template(tmpl);
@@ -287,8 +343,10 @@ void HistogramBase::RegisterExternalReferences(
   registry->Register(Add);
   registry->Register(Record);
   registry->Register(RecordDelta);
+  registry->Register(RecordDeltaCoarse);
   registry->Register(fast_record_);
   registry->Register(fast_record_delta_);
+  registry->Register(fast_record_delta_coarse_);
   HistogramImpl::RegisterExternalReferences(registry);
 }
 
@@ -11,6 +11,7 @@
 #include "uv.h"
 #include "v8.h"
 
+#include <atomic>
 #include <functional>
 #include <limits>
 #include <map>
@@ -28,10 +29,15 @@ class Histogram : public MemoryRetainer {
     int64_t lowest = 1;
     int64_t highest = std::numeric_limits<int64_t>::max();
     int figures = kDefaultHistogramFigures;
+    // Record() from different threads goes to separate per-thread shards,
+    // so that threads do not contend for a single lock. Values recorded
+    // since the previous read are merged into the histogram when it is
+    // read, which makes reading more expensive.
+    bool sharded = false;
   };
 
   explicit Histogram(const Options& options);
-  virtual ~Histogram() = default;
+  virtual ~Histogram();
 
   inline bool Record(int64_t value);
   inline void Reset();
@@ -40,10 +46,15 @@ class Histogram : public MemoryRetainer {
   inline double Mean() const;
   inline double Stddev() const;
   inline int64_t Percentile(double percentile) const;
-  inline size_t Exceeds() const { return exceeds_; }
+  inline size_t Exceeds() const;
   inline size_t Count() const;
 
-  inline uint64_t RecordDelta();
+  // Records the time elapsed since the previous call.
+  inline uint64_t RecordDelta(uint64_t time = uv_hrtime());
+  // Same as RecordDelta(), for a reading of a coarse clock. Such a reading
+  // may lag behind a precise one taken before it, in which case the delta
+  // is 0.
+  inline uint64_t RecordDeltaCoarse(uint64_t time);
 
   inline double Add(const Histogram& other);
 
@@ -54,16 +65,47 @@ class Histogram : public MemoryRetainer {
 
   inline size_t GetMemorySize() const;
 
+  bool sharded() const { return options_.sharded; }
+
   void MemoryInfo(MemoryTracker* tracker) const override;
   SET_MEMORY_INFO_NAME(Histogram)
   SET_SELF_SIZE(Histogram)
 
  private:
   using HistogramPointer = DeleteFnPtr<hdr_histogram, hdr_close>;
+
+  struct Shard {
+    // Only contended while the shard is being merged by a reader.
+    Mutex mutex;
+    HistogramPointer histogram;
+    // Values recorded since the shard was last merged. These are atomic so
+    // that Count() and Exceeds() do not need to take the shard's mutex.
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> exceeds{0};
+  };
+  static constexpr size_t kShardCount = 16;
+
+  static HistogramPointer NewHdrHistogram(const Options& options);
+  static size_t CurrentThreadShardIndex();
+  inline Shard* GetShard();
+  Shard* CreateShard(std::atomic<Shard*>* slot);
+  template <typename Fn>
+  inline void ForEachShard(Fn&& fn) const;
+  // Moves the values of all shards that have been recorded to since the
+  // previous call into histogram_, and returns histogram_. Must be called
+  // with mutex_ held.
+  inline hdr_histogram* MergedLocked() const;
+  // Must be called with mutex_ held.
+  inline uint64_t RecordDeltaLocked(uint64_t time);
+
+  Options options_;
+  // In sharded mode, this contains the values from Add() and RecordDelta()
+  // and those that were merged from the shards.
   HistogramPointer histogram_;
+  std::atomic<Shard*> shards_[kShardCount] = {};
   uint64_t prev_ = 0;
-  size_t exceeds_ = 0;
-  size_t count_ = 0;
+  mutable size_t exceeds_ = 0;
+  mutable size_t count_ = 0;
   Mutex mutex_;
 };
 
@@ -155,10 +197,13 @@ class HistogramBase final : public BaseObject, public HistogramImpl {
 
   static void Record(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void RecordDelta(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void RecordDeltaCoarse(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Add(const v8::FunctionCallbackInfo<v8::Value>& args);
 
   static void FastRecord(v8::Local<v8::Value> receiver, const int64_t value);
   static void FastRecordDelta(v8::Local<v8::Value> receiver);
+  static void FastRecordDeltaCoarse(v8::Local<v8::Value> receiver);
 
   HistogramBase(
       Environment* env,
@@ -199,6 +244,7 @@ class HistogramBase final : public BaseObject, public HistogramImpl {
  private:
   static v8::CFunction fast_record_;
   static v8::CFunction fast_record_delta_;
+  static v8::CFunction fast_record_delta_coarse_;
 };
 
 class IntervalHistogram final : public HandleWrap, public HistogramImpl {
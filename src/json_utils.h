@@ -26,6 +26,12 @@ class JSONWriter {
  public:
   JSONWriter(std::ostream& out, bool compact)
     : out_(out), compact_(compact) {}
+  // Creates a writer for a fragment of a document that continues after a
+  // value at the given indentation. The result can be inserted with
+  // json_raw() into a writer that is at the same position.
+  JSONWriter(std::ostream& out, bool compact, int indentation)
+    : out_(out), compact_(compact), indent_(indentation),
+      state_(kAfterValue) {}
 
  private:
   inline void indent() { indent_ += 2; }
@@ -125,6 +131,12 @@ class JSONWriter {
     state_ = kAfterValue;
   }
 
+  inline void json_raw(std::string_view fragment) {
+    if (fragment.empty()) return;
+    out_ << fragment;
+    state_ = kAfterValue;
+  }
+
   struct Null {};  // Usable as a JSON value.
 
   struct ForeignJSON {
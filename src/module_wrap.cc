@@ -1,5 +1,7 @@
 #include "module_wrap.h"
 
+#include "ada.h"
+#include "compile_cache.h"
 #include "env.h"
 #include "memory_tracker-inl.h"
 #include "node_contextify.h"
@@ -8,11 +10,13 @@
 #include "node_internals.h"
 #include "node_process-inl.h"
 #include "node_watchdog.h"
+#include "threadpoolwork-inl.h"
 #include "util-inl.h"
 
 #include <sys/stat.h>  // S_IFDIR
 
 #include <algorithm>
+#include <memory>
 
 namespace node {
 namespace loader {
@@ -460,6 +464,67 @@ void ModuleWrap::New(const FunctionCallbackInfo<Value>& args) {
   args.GetReturnValue().Set(that);
 }
 
+// Resolves the requests that can be resolved without the loader, that is
+// relative or file: specifiers without import attributes in a module with a
+// file: URL, to the URL the loader would resolve them to unless the target is
+// a symlink. Returns an empty string for the other requests.
+static std::string ResolveFileURLRequest(
+    Isolate* isolate,
+    const std::optional<ada::url_aggregator>& base,
+    Local<ModuleRequest> request) {
+  if (!base || base->type != ada::scheme::FILE ||
+      request->GetImportAttributes()->Length() > 0) {
+    return std::string();
+  }
+  Utf8Value specifier(isolate, request->GetSpecifier());
+  std::string_view view = specifier.ToStringView();
+  if (!view.starts_with("./") && !view.starts_with("../") &&
+      !view.starts_with("/") && !view.starts_with("file:")) {
+    return std::string();
+  }
+  auto resolved = ada::parse<ada::url_aggregator>(view, &*base);
+  if (!resolved || resolved->type != ada::scheme::FILE) {
+    return std::string();
+  }
+  return std::string(resolved->get_href());
+}
+
+static std::optional<ada::url_aggregator> ParseModuleURL(Isolate* isolate,
+                                                         Local<String> url) {
+  Utf8Value url_utf8(isolate, url);
+  auto parsed = ada::parse<ada::url_aggregator>(url_utf8.ToStringView());
+  if (!parsed) {
+    return std::nullopt;
+  }
+  return std::move(*parsed);
+}
+
+// Once a module is compiled, its static dependencies are known. Start reading
+// and deserializing the compile cache of those that can be resolved without
+// the loader, so that it is ready by the time the loader gets to compile
+// them. Guesses that are wrong only cost a file read on the thread pool.
+static void PrefetchDependencyCompileCache(Realm* realm,
+                                           Local<Module> module,
+                                           Local<String> url) {
+  Isolate* isolate = realm->isolate();
+  Local<Context> context = realm->context();
+  std::optional<ada::url_aggregator> base = ParseModuleURL(isolate, url);
+  if (!base || base->type != ada::scheme::FILE) {
+    return;
+  }
+
+  Local<FixedArray> requests = module->GetModuleRequests();
+  for (int i = 0; i < requests->Length(); i++) {
+    std::string resolved = ResolveFileURLRequest(
+        isolate, base, requests->Get(context, i).As<ModuleRequest>());
+    if (resolved.empty()) {
+      continue;
+    }
+    realm->env()->compile_cache_handler()->Prefetch(
+        realm->env(), resolved, CachedCodeType::kESM);
+  }
+}
+
 MaybeLocal<Module> ModuleWrap::CompileSourceTextModule(
     Realm* realm,
     Local<String> source_text,
@@ -493,32 +558,50 @@ MaybeLocal<Module> ModuleWrap::CompileSourceTextModule(
         source_text, url, CachedCodeType::kESM);
   }
 
-  if (cache_entry != nullptr && cache_entry->cache != nullptr) {
+  ScriptCompiler::ConsumeCodeCacheTask* consume_task = nullptr;
+  // The cache that V8 gets a view of while it compiles the module.
+  std::unique_ptr<ScriptCompiler::CachedData> lent_cache;
+  if (cache_entry != nullptr && cache_entry->consume_task) {
+    // The cache was deserialized off-thread, V8 only needs to see the data
+    // it was created from again, so there is no need to copy it. The entry
+    // gets it back once source, which points into it, is gone.
+    consume_task = cache_entry->consume_task.release();
+    lent_cache = std::move(cache_entry->cache);
+    cached_data = new ScriptCompiler::CachedData(
+        lent_cache->data,
+        lent_cache->length,
+        ScriptCompiler::CachedData::BufferNotOwned);
+  } else if (cache_entry != nullptr && cache_entry->cache != nullptr) {
     // source will take ownership of cached_data.
     cached_data = cache_entry->CopyCache();
   }
 
-  ScriptCompiler::Source source(source_text, origin, cached_data);
-  ScriptCompiler::CompileOptions options;
-  if (cached_data == nullptr) {
-    options = ScriptCompiler::kNoCompileOptions;
-  } else {
-    options = ScriptCompiler::kConsumeCodeCache;
-  }
-
   Local<Module> module;
-  if (!ScriptCompiler::CompileModule(isolate, &source, options)
-           .ToLocal(&module)) {
-    return scope.EscapeMaybe(MaybeLocal<Module>());
+  bool compiled;
+  {
+    // source will take ownership of cached_data and consume_task.
+    ScriptCompiler::Source source(
+        source_text, origin, cached_data, consume_task);
+    ScriptCompiler::CompileOptions options =
+        cached_data == nullptr ? ScriptCompiler::kNoCompileOptions
+                               : ScriptCompiler::kConsumeCodeCache;
+    compiled = ScriptCompiler::CompileModule(isolate, &source, options)
+                   .ToLocal(&module);
+    if (compiled && options == ScriptCompiler::kConsumeCodeCache) {
+      *cache_rejected = source.GetCachedData()->rejected;
+    }
   }
-
-  if (options == ScriptCompiler::kConsumeCodeCache) {
-    *cache_rejected = source.GetCachedData()->rejected;
+  if (lent_cache) {
+    cache_entry->cache = std::move(lent_cache);
+  }
+  if (!compiled) {
+    return scope.EscapeMaybe(MaybeLocal<Module>());
   }
 
   if (cache_entry != nullptr) {
     realm->env()->compile_cache_handler()->MaybeSave(
         cache_entry, module, *cache_rejected);
+    PrefetchDependencyCompileCache(realm, module, url);
   }
 
   return scope.Escape(module);
@@ -1413,6 +1496,469 @@ void ModuleWrap::CreateRequiredModuleFacade(
   args.GetReturnValue().Set(facade->GetModuleNamespace());
 }
 
+namespace {
+// Hands a copy of the source text to V8 in a single chunk.
+class SourceTextStream final : public ScriptCompiler::ExternalSourceStream {
+ public:
+  SourceTextStream(uint8_t* data, size_t length)
+      : data_(data), length_(length) {}
+  ~SourceTextStream() override { delete[] data_; }
+
+  size_t GetMoreData(const uint8_t** src) override {
+    if (data_ == nullptr) {
+      return 0;
+    }
+    // V8 takes ownership of the returned data.
+    *src = data_;
+    data_ = nullptr;
+    return length_;
+  }
+
+ private:
+  uint8_t* data_;
+  size_t length_;
+};
+
+}  // anonymous namespace
+
+// The state of a compileAndLinkModules() call. Modules that are not in the
+// compile cache are streamed, that is parsed and compiled on the thread pool,
+// everything else happens on the main thread once all of them are done.
+// Deletes itself after settling the promise.
+class ModuleWrap::CompileAndLinkJob final {
+ public:
+  CompileAndLinkJob(Realm* realm, Local<Promise::Resolver> resolver)
+      : realm_(realm), resolver_(realm->isolate(), resolver) {}
+
+  void AddModule(Local<String> url, Local<String> source_text, bool stream);
+  void Start();
+
+ private:
+  class StreamingWork final : public ThreadPoolWork {
+   public:
+    StreamingWork(Environment* env,
+                  CompileAndLinkJob* job,
+                  ScriptCompiler::ScriptStreamingTask* task)
+        : ThreadPoolWork(env, "module_wrap.CompileAndLinkJob"),
+          job_(job),
+          task_(task) {}
+
+    void DoThreadPoolWork() override { task_->Run(); }
+
+    void AfterThreadPoolWork(int status) override {
+      CompileAndLinkJob* job = job_;
+      delete this;
+      if (--job->pending_ == 0) {
+        job->Finish();
+      }
+    }
+
+   private:
+    CompileAndLinkJob* job_;
+    std::unique_ptr<ScriptCompiler::ScriptStreamingTask> task_;
+  };
+
+  struct Entry {
+    Global<String> url;
+    Global<String> source_text;
+    // Null for modules that are compiled on the main thread.
+    std::unique_ptr<ScriptCompiler::StreamedSource> streamed;
+    ModuleWrap* wrap = nullptr;
+  };
+
+  void Finish();
+  // Each returns false if execution was terminated or an exception other
+  // than a compilation or instantiation error is pending.
+  bool Compile(LocalVector<Value>* wraps, LocalVector<Value>* errors);
+  void Link();
+  bool Instantiate(LocalVector<Value>* errors);
+  bool RecordError(size_t i,
+                   const errors::TryCatchScope& try_catch,
+                   LocalVector<Value>* errors);
+
+  Realm* realm_;
+  Global<Promise::Resolver> resolver_;
+  std::vector<Entry> entries_;
+  // Dependents of each module among the linked ones.
+  std::vector<std::vector<size_t>> dependents_;
+  size_t pending_ = 0;
+};
+
+void ModuleWrap::CompileAndLinkJob::AddModule(Local<String> url,
+                                              Local<String> source_text,
+                                              bool stream) {
+  Isolate* isolate = realm_->isolate();
+  Entry& entry = entries_.emplace_back();
+  entry.url.Reset(isolate, url);
+  entry.source_text.Reset(isolate, source_text);
+  if (!stream) {
+    return;
+  }
+
+  uint32_t length = source_text->Length();
+  uint8_t* data;
+  ScriptCompiler::StreamedSource::Encoding encoding;
+  if (source_text->IsOneByte()) {
+    data = new uint8_t[length];
+    source_text->WriteOneByteV2(isolate, 0, length, data);
+    encoding = ScriptCompiler::StreamedSource::ONE_BYTE;
+  } else {
+    data = new uint8_t[length * sizeof(uint16_t)];
+    source_text->WriteV2(isolate, 0, length, reinterpret_cast<uint16_t*>(data));
+    length *= sizeof(uint16_t);
+    encoding = ScriptCompiler::StreamedSource::TWO_BYTE;
+  }
+  entry.streamed = std::make_unique<ScriptCompiler::StreamedSource>(
+      std::make_unique<SourceTextStream>(data, length), encoding);
+}
+
+void ModuleWrap::CompileAndLinkJob::Start() {
+  Isolate* isolate = realm_->isolate();
+  for (Entry& entry : entries_) {
+    if (!entry.streamed) {
+      continue;
+    }
+    ScriptCompiler::ScriptStreamingTask* task = ScriptCompiler::StartStreaming(
+        isolate, entry.streamed.get(), v8::ScriptType::kModule);
+    (new StreamingWork(realm_->env(), this, task))->ScheduleWork();
+    pending_++;
+  }
+  if (pending_ == 0) {
+    Finish();
+  }
+}
+
+bool ModuleWrap::CompileAndLinkJob::RecordError(
+    size_t i,
+    const errors::TryCatchScope& try_catch,
+    LocalVector<Value>* errors) {
+  if (!try_catch.HasCaught() || try_catch.HasTerminated()) {
+    return false;
+  }
+  AppendExceptionLine(realm_->env(),
+                      try_catch.Exception(),
+                      try_catch.Message(),
+                      ErrorHandlingMode::MODULE_ERROR);
+  (*errors)[i] = try_catch.Exception();
+  return true;
+}
+
+bool ModuleWrap::CompileAndLinkJob::Compile(LocalVector<Value>* wraps,
+                                            LocalVector<Value>* errors) {
+  Environment* env = realm_->env();
+  Isolate* isolate = realm_->isolate();
+  Local<Context> context = realm_->context();
+  Local<Symbol> id_symbol =
+      realm_->isolate_data()->source_text_module_default_hdo();
+  Local<PrimitiveArray> host_defined_options =
+      GetHostDefinedOptions(isolate, id_symbol);
+
+  for (size_t i = 0; i < entries_.size(); i++) {
+    Entry& entry = entries_[i];
+    Local<String> url = entry.url.Get(isolate);
+    Local<String> source_text = entry.source_text.Get(isolate);
+    TryCatchScope try_catch(env);
+    Local<Module> module;
+    bool compiled;
+    if (entry.streamed) {
+      ScriptOrigin origin(url,
+                          0,               // line offset
+                          0,               // column offset
+                          true,            // is cross origin
+                          -1,              // script id
+                          Local<Value>(),  // source map URL
+                          false,           // is opaque (?)
+                          false,           // is WASM
+                          true,            // is ES Module
+                          host_defined_options);
+      compiled = ScriptCompiler::CompileModule(
+                     context, entry.streamed.get(), source_text, origin)
+                     .ToLocal(&module);
+      entry.streamed.reset();
+      if (compiled && env->use_compile_cache()) {
+        CompileCacheEntry* cache_entry =
+            env->compile_cache_handler()->GetOrInsert(
+                source_text, url, CachedCodeType::kESM);
+        if (cache_entry != nullptr) {
+          env->compile_cache_handler()->MaybeSave(cache_entry, module, false);
+        }
+      }
+    } else {
+      bool cache_rejected = false;
+      compiled = CompileSourceTextModule(realm_,
+                                         source_text,
+                                         url,
+                                         0,
+                                         0,
+                                         host_defined_options,
+                                         std::nullopt,
+                                         &cache_rejected)
+                     .ToLocal(&module);
+    }
+    if (!compiled) {
+      if (!RecordError(i, try_catch, errors)) {
+        return false;
+      }
+      continue;
+    }
+
+    entry.wrap = WrapSourceTextModule(realm_, module, url, id_symbol);
+    if (entry.wrap == nullptr) {
+      // Hand the exception to Finish(), which rejects the promise with it.
+      if (try_catch.HasCaught() && !try_catch.HasTerminated()) {
+        try_catch.ReThrow();
+      }
+      return false;
+    }
+    // The wrapper is weak, this keeps it alive until the promise is settled.
+    (*wraps)[i] = entry.wrap->object();
+  }
+  return true;
+}
+
+// Links the modules whose requests all resolve to another module of the batch
+// without the loader, the loader has to link the others.
+void ModuleWrap::CompileAndLinkJob::Link() {
+  Isolate* isolate = realm_->isolate();
+  Local<Context> context = realm_->context();
+
+  std::unordered_map<std::string_view, size_t> index_by_url;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].wrap != nullptr) {
+      index_by_url.emplace(entries_[i].wrap->url_, i);
+    }
+  }
+
+  dependents_.resize(entries_.size());
+  for (size_t i = 0; i < entries_.size(); i++) {
+    ModuleWrap* dependent = entries_[i].wrap;
+    if (dependent == nullptr) {
+      continue;
+    }
+    Local<FixedArray> requests =
+        dependent->module_.Get(isolate)->GetModuleRequests();
+    std::optional<ada::url_aggregator> base =
+        ParseModuleURL(isolate, entries_[i].url.Get(isolate));
+    const int request_count = requests->Length();
+    std::vector<ModuleWrap*> linked_module_wraps(request_count);
+    LocalVector<Value> linked(isolate, request_count);
+    bool resolved_all = true;
+    for (int j = 0; j < request_count; j++) {
+      Local<ModuleRequest> request =
+          requests->Get(context, j).As<ModuleRequest>();
+      auto it = index_by_url.end();
+      if (request->GetPhase() == ModuleImportPhase::kEvaluation) {
+        it = index_by_url.find(ResolveFileURLRequest(isolate, base, request));
+      }
+      if (it == index_by_url.end()) {
+        resolved_all = false;
+        break;
+      }
+      linked_module_wraps[j] = entries_[it->second].wrap;
+      linked[j] = linked_module_wraps[j]->object();
+    }
+    if (!resolved_all) {
+      continue;
+    }
+
+    for (ModuleWrap* dependency : linked_module_wraps) {
+      dependents_[index_by_url[dependency->url_]].push_back(i);
+    }
+    dependent->object()->SetInternalField(
+        kLinkedRequestsSlot, Array::New(isolate, linked.data(), linked.size()));
+    std::swap(dependent->linked_module_wraps_, linked_module_wraps);
+    dependent->linked_ = true;
+  }
+}
+
+// Instantiates the modules whose graph is completely linked, which takes a
+// single InstantiateModule() call if the entry point comes first.
+bool ModuleWrap::CompileAndLinkJob::Instantiate(LocalVector<Value>* errors) {
+  Isolate* isolate = realm_->isolate();
+  Local<Context> context = realm_->context();
+
+  std::vector<bool> instantiable(entries_.size(), true);
+  std::vector<size_t> worklist;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].wrap == nullptr || !entries_[i].wrap->IsLinked()) {
+      instantiable[i] = false;
+      worklist.push_back(i);
+    }
+  }
+  while (!worklist.empty()) {
+    size_t i = worklist.back();
+    worklist.pop_back();
+    for (size_t dependent : dependents_[i]) {
+      if (instantiable[dependent]) {
+        instantiable[dependent] = false;
+        worklist.push_back(dependent);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (!instantiable[i]) {
+      continue;
+    }
+    Local<Module> module = entries_[i].wrap->module_.Get(isolate);
+    if (module->GetStatus() != Module::kUninstantiated) {
+      continue;
+    }
+    TryCatchScope try_catch(realm_->env());
+    if (module
+            ->InstantiateModule(
+                context, ResolveModuleCallback, ResolveSourceCallback)
+            .IsNothing() &&
+        !RecordError(i, try_catch, errors)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void ModuleWrap::CompileAndLinkJob::Finish() {
+  std::unique_ptr<CompileAndLinkJob> self(this);
+  Environment* env = realm_->env();
+  if (!env->can_call_into_js()) {
+    return;
+  }
+  Isolate* isolate = realm_->isolate();
+  HandleScope handle_scope(isolate);
+  Local<Context> context = realm_->context();
+  Context::Scope context_scope(context);
+  InternalCallbackScope callback_scope(env,
+                                       Object::New(isolate),
+                                       {0, 0},
+                                       InternalCallbackScope::kNoFlags);
+  Local<Promise::Resolver> resolver = resolver_.Get(isolate);
+
+  ShouldNotAbortOnUncaughtScope no_abort_scope(env);
+  TryCatchScope try_catch(env);
+  LocalVector<Value> wraps(isolate, entries_.size());
+  LocalVector<Value> errors(isolate, entries_.size());
+  std::fill(wraps.begin(), wraps.end(), Undefined(isolate));
+  std::fill(errors.begin(), errors.end(), Undefined(isolate));
+  if (Compile(&wraps, &errors)) {
+    Link();
+    if (Instantiate(&errors)) {
+      Local<Value> result[] = {
+          Array::New(isolate, wraps.data(), wraps.size()),
+          Array::New(isolate, errors.data(), errors.size()),
+      };
+      USE(resolver->Resolve(context,
+                            Array::New(isolate, result, arraysize(result))));
+      return;
+    }
+  }
+  if (try_catch.HasCaught() && !try_catch.HasTerminated()) {
+    USE(resolver->Reject(context, try_catch.Exception()));
+  }
+}
+
+ModuleWrap* ModuleWrap::WrapSourceTextModule(Realm* realm,
+                                             Local<Module> module,
+                                             Local<String> url,
+                                             Local<Symbol> id_symbol) {
+  Isolate* isolate = realm->isolate();
+  Local<Context> context = realm->context();
+  Local<Object> that;
+  if (!realm->isolate_data()
+           ->module_wrap_constructor_template()
+           ->InstanceTemplate()
+           ->NewInstance(context)
+           .ToLocal(&that)) {
+    return nullptr;
+  }
+
+  Local<UnboundModuleScript> script = module->GetUnboundModuleScript();
+  if (that->SetPrivate(context,
+                       realm->isolate_data()->host_defined_option_symbol(),
+                       id_symbol)
+          .IsNothing() ||
+      that->Set(context,
+                realm->env()->has_top_level_await_string(),
+                Boolean::New(isolate, module->HasTopLevelAwait()))
+          .IsNothing() ||
+      that->Set(context,
+                realm->env()->source_url_string(),
+                script->GetSourceURL())
+          .IsNothing() ||
+      that->Set(context,
+                realm->env()->source_map_url_string(),
+                script->GetSourceMappingURL())
+          .IsNothing() ||
+      that->Set(context,
+                realm->isolate_data()->synthetic_string(),
+                Boolean::New(isolate, false))
+          .IsNothing() ||
+      that->Set(context, realm->isolate_data()->url_string(), url)
+          .IsNothing() ||
+      that->SetPrivate(context,
+                       realm->isolate_data()->source_map_data_private_symbol(),
+                       Undefined(isolate))
+          .IsNothing()) {
+    return nullptr;
+  }
+
+  return new ModuleWrap(realm,
+                        that,
+                        module,
+                        url,
+                        context->GetExtrasBindingObject(),
+                        Undefined(isolate));
+}
+
+// compileAndLinkModules(urls, sources) compiles the source text modules of
+// a graph the loader has already resolved and fetched, in the main context
+// and with the default host defined options, and links and instantiates as
+// much of it as can be done without the loader (see CompileAndLinkJob).
+// Returns a promise for [modules, errors]: modules[i] is the ModuleWrap of
+// urls[i], or undefined if it failed to compile, and errors[i] is the
+// compilation or instantiation error thrown for it, if any. The loader has
+// to link the modules that are not instantiated afterwards.
+void ModuleWrap::CompileAndLinkModules(
+    const FunctionCallbackInfo<Value>& args) {
+  Realm* realm = Realm::GetCurrent(args);
+  Isolate* isolate = realm->isolate();
+  Local<Context> context = realm->context();
+  Environment* env = realm->env();
+  CHECK_EQ(realm, env->principal_realm());
+
+  CHECK(args[0]->IsArray());
+  CHECK(args[1]->IsArray());
+  std::vector<Global<Value>> urls;
+  std::vector<Global<Value>> sources;
+  if (FromV8Array(context, args[0].As<Array>(), &urls).IsNothing() ||
+      FromV8Array(context, args[1].As<Array>(), &sources).IsNothing()) {
+    return;
+  }
+  CHECK_EQ(urls.size(), sources.size());
+
+  Local<Promise::Resolver> resolver;
+  if (!Promise::Resolver::New(context).ToLocal(&resolver)) {
+    return;
+  }
+  auto job = std::make_unique<CompileAndLinkJob>(realm, resolver);
+  for (size_t i = 0; i < urls.size(); i++) {
+    Local<Value> url = urls[i].Get(isolate);
+    Local<Value> source_text = sources[i].Get(isolate);
+    CHECK(url->IsString());
+    CHECK(source_text->IsString());
+    // Deserializing a code cache is cheaper than streaming the module.
+    bool stream = true;
+    if (env->use_compile_cache()) {
+      CompileCacheEntry* cache_entry =
+          env->compile_cache_handler()->GetOrInsert(source_text.As<String>(),
+                                                    url.As<String>(),
+                                                    CachedCodeType::kESM);
+      stream = cache_entry == nullptr || cache_entry->cache == nullptr;
+    }
+    job->AddModule(url.As<String>(), source_text.As<String>(), stream);
+  }
+  job.release()->Start();
+  args.GetReturnValue().Set(resolver->GetPromise());
+}
+
 void ModuleWrap::CreatePerIsolateProperties(IsolateData* isolate_data,
                                             Local<ObjectTemplate> target) {
   Isolate* isolate = isolate_data->isolate();
@@ -1456,6 +2002,7 @@ void ModuleWrap::CreatePerIsolateProperties(IsolateData* isolate_data,
             target,
             "createRequiredModuleFacade",
             CreateRequiredModuleFacade);
+  SetMethod(isolate, target, "compileAndLinkModules", CompileAndLinkModules);
   SetMethod(isolate, target, "throwIfPromiseRejected", ThrowIfPromiseRejected);
 }
 
@@ -1502,6 +2049,7 @@ void ModuleWrap::RegisterExternalReferences(
   registry->Register(HasAsyncGraph);
 
   registry->Register(CreateRequiredModuleFacade);
+  registry->Register(CompileAndLinkModules);
 
   registry->Register(SetImportModuleDynamicallyCallback);
   registry->Register(SetInitializeImportMetaObjectCallback);
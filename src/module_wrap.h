@@ -10,6 +10,9 @@
 #include "base_object.h"
 #include "v8-script.h"
 
+// Forward declare test fixtures for `friend` declaration.
+class CompileAndLinkTest;
+
 namespace node {
 
 class IsolateData;
@@ -153,6 +156,8 @@ class ModuleWrap : public BaseObject {
       const v8::FunctionCallbackInfo<v8::Value>& args);
 
  private:
+  class CompileAndLinkJob;
+
   ModuleWrap(Realm* realm,
              v8::Local<v8::Object> object,
              v8::Local<v8::Module> module,
@@ -161,6 +166,14 @@ class ModuleWrap : public BaseObject {
              v8::Local<v8::Value> synthetic_evaluation_step);
   ~ModuleWrap() override;
 
+  // Creates the wrapper of a source text module compiled in the main context
+  // the way New() does, for modules compiled without calling into JS.
+  // Returns nullptr if an exception is pending.
+  static ModuleWrap* WrapSourceTextModule(Realm* realm,
+                                          v8::Local<v8::Module> module,
+                                          v8::Local<v8::String> url,
+                                          v8::Local<v8::Symbol> id_symbol);
+
   static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void GetModuleRequests(
       const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -170,6 +183,8 @@ class ModuleWrap : public BaseObject {
       const v8::FunctionCallbackInfo<v8::Value>& args);
 
   static void Link(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void CompileAndLinkModules(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Instantiate(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Evaluate(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void EvaluateSync(const v8::FunctionCallbackInfo<v8::Value>& args);
@@ -220,6 +235,8 @@ class ModuleWrap : public BaseObject {
   // convenient shortcuts, but do not hold the ModuleWraps alive. The actual
   // strong references come from the array in kLinkedRequestsSlot.
   std::vector<ModuleWrap*> linked_module_wraps_;
+
+  friend class ::CompileAndLinkTest;
 };
 
 }  // namespace loader
@@ -0,0 +1,92 @@
+#ifndef SRC_MPSC_QUEUE_H_
+#define SRC_MPSC_QUEUE_H_
+
+#if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#include "util.h"
+
+#include <atomic>
+#include <utility>
+
+namespace node {
+
+// Unbounded multi-producer, single-consumer FIFO queue. Push() may be called
+// from any thread and never blocks or takes a lock. All other methods may
+// only be called from the (single) consumer thread, or after the consumer
+// role has been handed to another thread with proper synchronization.
+//
+// This is the node-based queue by Dmitry Vyukov: producers swap themselves
+// in as the new head with a single atomic exchange and then link the
+// previous head to their node. Until that link is stored, the consumer sees
+// the queue as ending before that node, so a producer must always notify the
+// consumer *after* Push() returns.
+template <typename T>
+class MPSCQueue final {
+ public:
+  MPSCQueue() : head_(&stub_), tail_(&stub_) {}
+  ~MPSCQueue() {
+    T ignored;
+    while (Pop(&ignored)) {}
+    if (tail_ != &stub_) delete tail_;
+  }
+
+  MPSCQueue(const MPSCQueue&) = delete;
+  MPSCQueue& operator=(const MPSCQueue&) = delete;
+  MPSCQueue(MPSCQueue&&) = delete;
+  MPSCQueue& operator=(MPSCQueue&&) = delete;
+
+  // Thread-safe.
+  void Push(T value) {
+    Node* node = new Node(std::move(value));
+    size_.fetch_add(1, std::memory_order_relaxed);
+    Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  // Consumer only. Returns the oldest element without removing it, or
+  // nullptr if the queue is (observably) empty.
+  T* Peek() {
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    return next == nullptr ? nullptr : &next->value;
+  }
+
+  // Consumer only. Removes the oldest element, returns false if there was
+  // none.
+  bool Pop(T* out) {
+    Node* tail = tail_;
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (next == nullptr) return false;
+    // `next` becomes the new stub; its value has been handed out.
+    *out = std::move(next->value);
+    tail_ = next;
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    if (tail != &stub_) delete tail;
+    return true;
+  }
+
+  // Consumer only.
+  bool empty() { return Peek() == nullptr; }
+
+  // Approximate number of elements, may be called from any thread.
+  size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Node {
+    Node() = default;
+    explicit Node(T&& value) : value(std::move(value)) {}
+
+    std::atomic<Node*> next{nullptr};
+    T value;
+  };
+
+  std::atomic<Node*> head_;  // Most recently pushed node.
+  Node* tail_;               // Consumer side, always points at a stub node.
+  Node stub_;
+  std::atomic<size_t> size_{0};
+};
+
+}  // namespace node
+
+#endif  // defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#endif  // SRC_MPSC_QUEUE_H_
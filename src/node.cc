@@ -42,6 +42,7 @@
 #include "node_realm-inl.h"
 #include "node_report.h"
 #include "node_revert.h"
+#include "node_sampling_profiler.h"
 #include "node_sea.h"
 #include "node_snapshot_builder.h"
 #include "node_v8_platform-inl.h"
@@ -243,6 +244,15 @@ void Environment::InitializeDiagnostics() {
   if (options_->trace_promises) {
     isolate_->SetPromiseHook(TracePromises);
   }
+  if (options_->cpu_prof_continuous) {
+    int signal = options_->cpu_prof_continuous_signal.empty()
+                     ? 0
+                     : SignalFromName(options_->cpu_prof_continuous_signal);
+    profiler::SamplingCpuProfiler::Start(
+        this,
+        static_cast<uint32_t>(options_->cpu_prof_continuous_window),
+        signal);
+  }
 }
 
 static
@@ -1413,11 +1423,24 @@ ExitCode GenerateAndWriteSnapshotData(const SnapshotData** snapshot_data_ptr,
                                                 result->exec_args(),
                                                 builder_script_content,
                                                 snapshot_config);
-    if (exit_code == ExitCode::kNoFailure) {
-      *snapshot_data_ptr = generated_data.release();
-    } else {
+    if (exit_code != ExitCode::kNoFailure) {
       return exit_code;
     }
+
+    // Record what went into the snapshot for --snapshot-auto-rebuild.
+    if (builder_script_content.has_value()) {
+      std::vector<std::string> source_paths{builder_script};
+      if (!config_path.empty()) {
+        source_paths.push_back(config_path);
+      }
+      for (const std::string& path : source_paths) {
+        std::optional<SnapshotSource> source = SnapshotSource::FromFile(path);
+        if (source.has_value()) {
+          generated_data->metadata.sources.push_back(std::move(*source));
+        }
+      }
+    }
+    *snapshot_data_ptr = generated_data.release();
   }
 
   // Get the path to write the snapshot blob to.
@@ -1429,11 +1452,10 @@ ExitCode GenerateAndWriteSnapshotData(const SnapshotData** snapshot_data_ptr,
     snapshot_blob_path = std::string("snapshot.blob");
   }
 
-  FILE* fp = fopen(snapshot_blob_path.c_str(), "wb");
-  if (fp != nullptr) {
-    (*snapshot_data_ptr)->ToFile(fp);
-    fclose(fp);
-  } else {
+  // Processes that started from an older snapshot at this path may still
+  // have it mapped, so don't overwrite it in place.
+  if (!SnapshotBuilder::ReplaceSnapshotFile(*snapshot_data_ptr,
+                                            snapshot_blob_path)) {
     fprintf(stderr,
             "Cannot open %s for writing a snapshot.\n",
             snapshot_blob_path.c_str());
@@ -1442,7 +1464,8 @@ ExitCode GenerateAndWriteSnapshotData(const SnapshotData** snapshot_data_ptr,
   return exit_code;
 }
 
-bool LoadSnapshotData(const SnapshotData** snapshot_data_ptr) {
+bool LoadSnapshotData(const SnapshotData** snapshot_data_ptr,
+                      const InitializationResultImpl* result) {
   // nullptr indicates there's no snapshot data.
   DCHECK_NULL(*snapshot_data_ptr);
 
@@ -1470,19 +1493,37 @@ bool LoadSnapshotData(const SnapshotData** snapshot_data_ptr) {
   // Ignore it when we are loading from SEA.
   if (!is_sea && !per_process::cli_options->snapshot_blob.empty()) {
     std::string filename = per_process::cli_options->snapshot_blob;
+    const bool auto_rebuild = per_process::cli_options->snapshot_auto_rebuild;
+    std::unique_ptr<SnapshotData> read_data;
     FILE* fp = fopen(filename.c_str(), "rb");
-    if (fp == nullptr) {
+    if (fp != nullptr) {
+      read_data = std::make_unique<SnapshotData>();
+      bool ok = SnapshotData::FromFile(read_data.get(), fp);
+      fclose(fp);
+      if (!ok) {
+        read_data.reset();
+      }
+    } else if (!auto_rebuild) {
       fprintf(stderr, "Cannot open %s", filename.c_str());
       return false;
     }
-    std::unique_ptr<SnapshotData> read_data = std::make_unique<SnapshotData>();
-    bool ok = SnapshotData::FromFile(read_data.get(), fp);
-    fclose(fp);
-    if (!ok) {
-      return false;
+
+    if (!auto_rebuild) {
+      if (!read_data) {
+        return false;
+      }
+      *snapshot_data_ptr = read_data.release();
+      return true;
+    }
+
+    // With --snapshot-auto-rebuild, the entry point is the builder script.
+    // If the snapshot is missing or stale, run that as a regular script
+    // instead and build the snapshot for the next start in the background.
+    if (read_data && read_data->SourcesAreUpToDate(result->args()[1])) {
+      *snapshot_data_ptr = read_data.release();
+      return true;
     }
-    *snapshot_data_ptr = read_data.release();
-    return true;
+    SnapshotBuilder::RebuildInBackground(result->args(), result->exec_args());
   }
 
   if (per_process::cli_options->node_snapshot) {
@@ -1556,7 +1597,16 @@ static ExitCode StartInternal(int argc, char** argv) {
   }
 
   // Without --build-snapshot, we are in snapshot loading mode.
-  if (!LoadSnapshotData(&snapshot_data)) {
+  if (per_process::cli_options->snapshot_auto_rebuild &&
+      result->args().size() < 2) {
+    fprintf(stderr,
+            "--snapshot-auto-rebuild must be used with the snapshot builder "
+            "script as entry point.\n"
+            "Usage: node --snapshot-blob snap.blob --snapshot-auto-rebuild "
+            "/path/to/entry.js\n");
+    return ExitCode::kInvalidCommandLineArgument;
+  }
+  if (!LoadSnapshotData(&snapshot_data, result.get())) {
     return ExitCode::kStartupSnapshotFailure;
   }
   NodeMainInstance main_instance(snapshot_data,
@@ -647,6 +647,11 @@ enum class SnapshotFlags : uint32_t {
   // in the snapshot at the expense of a bigger snapshot size and
   // potentially breaking portability of the snapshot.
   kWithoutCodeCache = 1 << 0,
+  // Whether the V8 startup data and the code cache should be compressed
+  // with zstd in the snapshot blob. This makes the blob smaller at the
+  // expense of decompressing it at startup instead of mapping it into
+  // memory.
+  kCompressed = 1 << 1,
 };
 
 struct SnapshotConfig {
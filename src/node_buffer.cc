@@ -22,6 +22,7 @@
 #include "node_buffer.h"
 #include "node.h"
 #include "node_blob.h"
+#include "node_buffer_search.h"
 #include "node_debug.h"
 #include "node_errors.h"
 #include "node_external_reference.h"
@@ -1177,6 +1178,96 @@ int32_t FastIndexOfNumber(Local<Value>,
 
 static CFunction fast_index_of_number(CFunction::Make(FastIndexOfNumber));
 
+// Assume caller has properly validated args: haystack and needle are
+// buffers and offsets is a Uint32Array. Throws if the offsets do not fit
+// into it or start is out of range.
+template <bool kSplit>
+uint32_t IndexOfAllImpl(Isolate* isolate,
+                        Local<Value> haystack_obj,
+                        Local<Value> needle_obj,
+                        Local<Value> offsets_obj,
+                        uint32_t start) {
+  ArrayBufferViewContents<uint8_t> haystack(haystack_obj);
+  if (haystack.length() > UINT32_MAX) {
+    THROW_ERR_OUT_OF_RANGE(isolate, "The buffer is too large to be searched.");
+    return 0;
+  }
+  if (start > haystack.length()) {
+    THROW_ERR_OUT_OF_RANGE(isolate, "The value of \"start\" is out of range.");
+    return 0;
+  }
+  ArrayBufferViewContents<uint8_t> needle(needle_obj);
+  SPREAD_BUFFER_ARG(offsets_obj, offsets);
+  auto find = kSplit ? SplitOffsets : FindAll;
+  return static_cast<uint32_t>(
+      find(haystack.data(),
+           haystack.length(),
+           start,
+           needle.data(),
+           needle.length(),
+           reinterpret_cast<uint32_t*>(offsets_data),
+           offsets_length / sizeof(uint32_t)));
+}
+
+template <bool kSplit>
+void SlowIndexOfAll(const FunctionCallbackInfo<Value>& args) {
+  CHECK(args[2]->IsUint32Array());
+  CHECK(args[3]->IsUint32());
+
+  Environment* env = Environment::GetCurrent(args);
+  THROW_AND_RETURN_UNLESS_BUFFER(env, args[0]);
+  THROW_AND_RETURN_UNLESS_BUFFER(env, args[1]);
+
+  uint32_t count = IndexOfAllImpl<kSplit>(env->isolate(),
+                                          args[0],
+                                          args[1],
+                                          args[2],
+                                          args[3].As<Uint32>()->Value());
+  args.GetReturnValue().Set(count);
+}
+
+template <bool kSplit>
+uint32_t FastIndexOfAll(Local<Value>,
+                        Local<Value> haystack_obj,
+                        Local<Value> needle_obj,
+                        Local<Value> offsets_obj,
+                        uint32_t start,
+                        // NOLINTNEXTLINE(runtime/references)
+                        FastApiCallbackOptions& options) {
+  if constexpr (kSplit) {
+    TRACK_V8_FAST_API_CALL("buffer.splitOffsets");
+  } else {
+    TRACK_V8_FAST_API_CALL("buffer.indexOfAll");
+  }
+  HandleScope scope(options.isolate);
+  return IndexOfAllImpl<kSplit>(
+      options.isolate, haystack_obj, needle_obj, offsets_obj, start);
+}
+
+static CFunction fast_index_of_all(CFunction::Make(FastIndexOfAll<false>));
+static CFunction fast_split_offsets(CFunction::Make(FastIndexOfAll<true>));
+
+// Counts the newlines like wc -l, a last line without one is not included.
+void SlowCountLines(const FunctionCallbackInfo<Value>& args) {
+  THROW_AND_RETURN_UNLESS_BUFFER(Environment::GetCurrent(args), args[0]);
+  ArrayBufferViewContents<uint8_t> buffer(args[0]);
+  args.GetReturnValue().Set(static_cast<double>(
+      CountByte(buffer.data(), buffer.length(), '\n')));
+}
+
+double FastCountLines(Local<Value>,
+                      Local<Value> buffer_obj,
+                      // NOLINTNEXTLINE(runtime/references)
+                      FastApiCallbackOptions& options) {
+  TRACK_V8_FAST_API_CALL("buffer.countLines");
+  HandleScope scope(options.isolate);
+  ArrayBufferViewContents<uint8_t> buffer(buffer_obj);
+  return static_cast<double>(
+      CountByte(buffer.data(), buffer.length(), '\n'));
+}
+
+static CFunction fast_count_lines(CFunction::Make(FastCountLines));
+
 void Swap16(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args);
   THROW_AND_RETURN_UNLESS_BUFFER(env, args[0]);
@@ -1574,6 +1665,18 @@ void Initialize(Local<Object> target,
                             SlowIndexOfNumber,
                             &fast_index_of_number);
   SetMethodNoSideEffect(context, target, "indexOfString", IndexOfString);
+  SetFastMethod(context,
+                target,
+                "indexOfAll",
+                SlowIndexOfAll<false>,
+                &fast_index_of_all);
+  SetFastMethod(context,
+                target,
+                "splitOffsets",
+                SlowIndexOfAll<true>,
+                &fast_split_offsets);
+  SetFastMethodNoSideEffect(
+      context, target, "countLines", SlowCountLines, &fast_count_lines);
 
   SetMethod(context, target, "copyArrayBuffer", CopyArrayBuffer);
 
@@ -1646,6 +1749,12 @@ void RegisterExternalReferences(ExternalReferenceRegistry* registry) {
   registry->Register(SlowIndexOfNumber);
   registry->Register(fast_index_of_number);
   registry->Register(IndexOfString);
+  registry->Register(SlowIndexOfAll<false>);
+  registry->Register(fast_index_of_all);
+  registry->Register(SlowIndexOfAll<true>);
+  registry->Register(fast_split_offsets);
+  registry->Register(SlowCountLines);
+  registry->Register(fast_count_lines);
 
   registry->Register(Swap16);
   registry->Register(Swap32);
@@ -0,0 +1,334 @@
+#include "node_buffer_search.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NODE_BUFFER_SEARCH_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define NODE_BUFFER_SEARCH_AVX2 1
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define NODE_BUFFER_SEARCH_NEON 1
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace node {
+namespace Buffer {
+
+namespace {
+
+inline unsigned CountTrailingZeros(uint64_t mask) {
+#ifdef _MSC_VER
+  unsigned long index;  // NOLINT(runtime/int)
+  _BitScanForward64(&index, mask);
+  return index;
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+// Collects the matches of a needle. The vector kernels only report
+// candidates whose first and last byte match, the bytes in between are
+// compared here.
+class Matches {
+ public:
+  Matches(const uint8_t* haystack,
+          const uint8_t* needle,
+          size_t needle_length,
+          uint32_t* out,
+          size_t capacity)
+      : haystack_(haystack),
+        needle_(needle),
+        needle_length_(needle_length),
+        out_(out),
+        capacity_(capacity) {}
+
+  size_t count() const { return count_; }
+
+  // Returns true once out is full.
+  bool Add(size_t offset) {
+    // Matches do not overlap.
+    if (offset < resume_) return false;
+    if (needle_length_ > 2 &&
+        memcmp(haystack_ + offset + 1, needle_ + 1, needle_length_ - 2) != 0) {
+      return false;
+    }
+    out_[count_++] = static_cast<uint32_t>(offset);
+    resume_ = offset + needle_length_;
+    return count_ == capacity_;
+  }
+
+  // Adds the candidates of a vector comparison that started at pos. Bit
+  // i << kShift of mask is set if the candidate at pos + i matched.
+  template <unsigned kShift>
+  bool AddAll(size_t pos, uint64_t mask) {
+    for (; mask != 0; mask &= mask - 1) {
+      if (Add(pos + (CountTrailingZeros(mask) >> kShift))) return true;
+    }
+    return false;
+  }
+
+  // Searches the remainder that is too short for a vector comparison.
+  size_t Finish(size_t pos, size_t length) {
+    pos = std::max(pos, resume_);
+    while (length - pos >= needle_length_) {
+      const size_t candidates = length - pos - needle_length_ + 1;
+      const void* ptr = memchr(haystack_ + pos, needle_[0], candidates);
+      if (ptr == nullptr) break;
+      size_t offset = static_cast<const uint8_t*>(ptr) - haystack_;
+      if (haystack_[offset + needle_length_ - 1] ==
+              needle_[needle_length_ - 1] &&
+          Add(offset)) {
+        break;
+      }
+      pos = std::max(offset + 1, resume_);
+    }
+    return count_;
+  }
+
+ private:
+  const uint8_t* haystack_;
+  const uint8_t* needle_;
+  size_t needle_length_;
+  uint32_t* out_;
+  size_t capacity_;
+  size_t count_ = 0;
+  size_t resume_ = 0;
+};
+
+#if !NODE_BUFFER_SEARCH_SSE2 && !NODE_BUFFER_SEARCH_NEON
+size_t FindAllScalar(const uint8_t* haystack,
+                     size_t length,
+                     size_t start,
+                     const uint8_t* needle,
+                     size_t needle_length,
+                     uint32_t* out,
+                     size_t capacity) {
+  Matches matches(haystack, needle, needle_length, out, capacity);
+  return matches.Finish(start, length);
+}
+#endif
+
+size_t CountByteScalar(const uint8_t* data, size_t length, uint8_t byte) {
+  return std::count(data, data + length, byte);
+}
+
+#if NODE_BUFFER_SEARCH_SSE2
+size_t FindAllSse2(const uint8_t* haystack,
+                   size_t length,
+                   size_t start,
+                   const uint8_t* needle,
+                   size_t needle_length,
+                   uint32_t* out,
+                   size_t capacity) {
+  Matches matches(haystack, needle, needle_length, out, capacity);
+  const size_t last = needle_length - 1;
+  const __m128i first_byte = _mm_set1_epi8(static_cast<char>(needle[0]));
+  const __m128i last_byte = _mm_set1_epi8(static_cast<char>(needle[last]));
+  size_t pos = start;
+  for (; length - pos >= last + 16; pos += 16) {
+    const __m128i head =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack + pos));
+    const __m128i tail = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(haystack + pos + last));
+    const uint32_t mask = _mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(head, first_byte), _mm_cmpeq_epi8(tail, last_byte)));
+    if (mask != 0 && matches.AddAll<0>(pos, mask)) return matches.count();
+  }
+  return matches.Finish(pos, length);
+}
+
+size_t CountByteSse2(const uint8_t* data, size_t length, uint8_t byte) {
+  const __m128i needle = _mm_set1_epi8(static_cast<char>(byte));
+  size_t count = 0;
+  size_t pos = 0;
+  while (length - pos >= 16) {
+    // Count in bytes, which overflow after 255 blocks, then sum them up.
+    size_t blocks = std::min<size_t>((length - pos) / 16, 255);
+    __m128i counters = _mm_setzero_si128();
+    for (; blocks > 0; blocks--, pos += 16) {
+      const __m128i chunk =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+      counters = _mm_sub_epi8(counters, _mm_cmpeq_epi8(chunk, needle));
+    }
+    uint64_t sums[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums),
+                     _mm_sad_epu8(counters, _mm_setzero_si128()));
+    count += sums[0] + sums[1];
+  }
+  return count + CountByteScalar(data + pos, length - pos, byte);
+}
+#endif  // NODE_BUFFER_SEARCH_SSE2
+
+#if NODE_BUFFER_SEARCH_AVX2
+__attribute__((target("avx2"))) size_t FindAllAvx2(const uint8_t* haystack,
+                                                   size_t length,
+                                                   size_t start,
+                                                   const uint8_t* needle,
+                                                   size_t needle_length,
+                                                   uint32_t* out,
+                                                   size_t capacity) {
+  Matches matches(haystack, needle, needle_length, out, capacity);
+  const size_t last = needle_length - 1;
+  const __m256i first_byte = _mm256_set1_epi8(static_cast<char>(needle[0]));
+  const __m256i last_byte = _mm256_set1_epi8(static_cast<char>(needle[last]));
+  size_t pos = start;
+  for (; length - pos >= last + 32; pos += 32) {
+    const __m256i head =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(haystack + pos));
+    const __m256i tail = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(haystack + pos + last));
+    const uint32_t mask = _mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(head, first_byte),
+                         _mm256_cmpeq_epi8(tail, last_byte)));
+    if (mask != 0 && matches.AddAll<0>(pos, mask)) return matches.count();
+  }
+  return matches.Finish(pos, length);
+}
+
+__attribute__((target("avx2"))) size_t CountByteAvx2(const uint8_t* data,
+                                                     size_t length,
+                                                     uint8_t byte) {
+  const __m256i needle = _mm256_set1_epi8(static_cast<char>(byte));
+  size_t count = 0;
+  size_t pos = 0;
+  while (length - pos >= 32) {
+    size_t blocks = std::min<size_t>((length - pos) / 32, 255);
+    __m256i counters = _mm256_setzero_si256();
+    for (; blocks > 0; blocks--, pos += 32) {
+      const __m256i chunk =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+      counters = _mm256_sub_epi8(counters, _mm256_cmpeq_epi8(chunk, needle));
+    }
+    uint64_t sums[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums),
+                        _mm256_sad_epu8(counters, _mm256_setzero_si256()));
+    count += sums[0] + sums[1] + sums[2] + sums[3];
+  }
+  return count + CountByteScalar(data + pos, length - pos, byte);
+}
+#endif  // NODE_BUFFER_SEARCH_AVX2
+
+#if NODE_BUFFER_SEARCH_NEON
+// NEON has no movemask, narrowing the comparison result by four bits yields
+// one nibble per byte instead.
+inline uint64_t NibbleMask(uint8x16_t eq) {
+  const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) &
+         0x8888888888888888ull;
+}
+
+size_t FindAllNeon(const uint8_t* haystack,
+                   size_t length,
+                   size_t start,
+                   const uint8_t* needle,
+                   size_t needle_length,
+                   uint32_t* out,
+                   size_t capacity) {
+  Matches matches(haystack, needle, needle_length, out, capacity);
+  const size_t last = needle_length - 1;
+  const uint8x16_t first_byte = vdupq_n_u8(needle[0]);
+  const uint8x16_t last_byte = vdupq_n_u8(needle[last]);
+  size_t pos = start;
+  for (; length - pos >= last + 16; pos += 16) {
+    const uint8x16_t head = vld1q_u8(haystack + pos);
+    const uint8x16_t tail = vld1q_u8(haystack + pos + last);
+    const uint64_t mask = NibbleMask(
+        vandq_u8(vceqq_u8(head, first_byte), vceqq_u8(tail, last_byte)));
+    if (mask != 0 && matches.AddAll<2>(pos, mask)) return matches.count();
+  }
+  return matches.Finish(pos, length);
+}
+
+size_t CountByteNeon(const uint8_t* data, size_t length, uint8_t byte) {
+  const uint8x16_t needle = vdupq_n_u8(byte);
+  size_t count = 0;
+  size_t pos = 0;
+  while (length - pos >= 16) {
+    size_t blocks = std::min<size_t>((length - pos) / 16, 255);
+    uint8x16_t counters = vdupq_n_u8(0);
+    for (; blocks > 0; blocks--, pos += 16) {
+      counters = vsubq_u8(counters, vceqq_u8(vld1q_u8(data + pos), needle));
+    }
+    count += vaddlvq_u8(counters);
+  }
+  return count + CountByteScalar(data + pos, length - pos, byte);
+}
+#endif  // NODE_BUFFER_SEARCH_NEON
+
+using FindAllFunction = size_t (*)(const uint8_t*,
+                                   size_t,
+                                   size_t,
+                                   const uint8_t*,
+                                   size_t,
+                                   uint32_t*,
+                                   size_t);
+using CountByteFunction = size_t (*)(const uint8_t*, size_t, uint8_t);
+
+struct Kernels {
+  FindAllFunction find_all;
+  CountByteFunction count_byte;
+};
+
+Kernels SelectKernels() {
+#if NODE_BUFFER_SEARCH_AVX2
+  if (__builtin_cpu_supports("avx2")) return {FindAllAvx2, CountByteAvx2};
+#endif
+#if NODE_BUFFER_SEARCH_SSE2
+  return {FindAllSse2, CountByteSse2};
+#elif NODE_BUFFER_SEARCH_NEON
+  return {FindAllNeon, CountByteNeon};
+#else
+  return {FindAllScalar, CountByteScalar};
+#endif
+}
+
+const Kernels& GetKernels() {
+  static const Kernels kernels = SelectKernels();
+  return kernels;
+}
+
+}  // anonymous namespace
+
+size_t FindAll(const uint8_t* haystack,
+               size_t length,
+               size_t start,
+               const uint8_t* needle,
+               size_t needle_length,
+               uint32_t* out,
+               size_t capacity) {
+  CHECK_LE(length, UINT32_MAX);
+  CHECK_LE(start, length);
+  if (needle_length == 0 || capacity == 0) return 0;
+  return GetKernels().find_all(
+      haystack, length, start, needle, needle_length, out, capacity);
+}
+
+size_t SplitOffsets(const uint8_t* haystack,
+                    size_t length,
+                    size_t start,
+                    const uint8_t* delimiter,
+                    size_t delimiter_length,
+                    uint32_t* out,
+                    size_t capacity) {
+  size_t count = FindAll(
+      haystack, length, start, delimiter, delimiter_length, out, capacity);
+  // FindAll() only stops early when out is full.
+  if (count < capacity) out[count++] = static_cast<uint32_t>(length);
+  return count;
+}
+
+size_t CountByte(const uint8_t* data, size_t length, uint8_t byte) {
+  return GetKernels().count_byte(data, length, byte);
+}
+
+}  // namespace Buffer
+}  // namespace node
@@ -0,0 +1,54 @@
+#ifndef SRC_NODE_BUFFER_SEARCH_H_
+#define SRC_NODE_BUFFER_SEARCH_H_
+
+#if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#include <cstddef>
+#include <cstdint>
+
+namespace node {
+namespace Buffer {
+
+// Bulk search primitives that find every occurrence of a needle in one pass
+// instead of one occurrence per call. The kernels compare a whole vector of
+// haystack bytes against the first and the last byte of the needle at once
+// and only verify the remaining bytes for the candidates, so that scanning
+// for short needles such as line delimiters is bound by memory bandwidth.
+// The widest kernel the CPU supports (AVX2, SSE2 or NEON) is selected on
+// first use.
+
+// Writes the offsets of the non-overlapping occurrences of needle in
+// haystack[start, length) to out, at most capacity of them, and returns how
+// many were written. The search can be resumed after the last offset plus
+// needle_length. length must not exceed UINT32_MAX and start must not
+// exceed length, callers have to validate both.
+size_t FindAll(const uint8_t* haystack,
+               size_t length,
+               size_t start,
+               const uint8_t* needle,
+               size_t needle_length,
+               uint32_t* out,
+               size_t capacity);
+
+// Like FindAll(), but additionally writes length as the end of the last
+// segment once there are no more delimiters and out has room for it. Entry
+// i is the end of segment i, which begins after entry i - 1 plus
+// delimiter_length, or at start for the first one. The split is complete
+// once the last entry is length.
+size_t SplitOffsets(const uint8_t* haystack,
+                    size_t length,
+                    size_t start,
+                    const uint8_t* delimiter,
+                    size_t delimiter_length,
+                    uint32_t* out,
+                    size_t capacity);
+
+// Returns how often byte occurs in data[0, length).
+size_t CountByte(const uint8_t* data, size_t length, uint8_t byte);
+
+}  // namespace Buffer
+}  // namespace node
+
+#endif  // defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#endif  // SRC_NODE_BUFFER_SEARCH_H_
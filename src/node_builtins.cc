@@ -519,13 +519,32 @@ MaybeLocal<Function> BuiltinLoader::LookupAndCompile(
   return LookupAndCompileInternal(context, id, parameters, optional_realm);
 }
 
+std::vector<std::string> BuiltinLoader::GetCodeCacheBuiltinIds() const {
+  constexpr std::string_view v8_tools_prefix = "internal/deps/v8/tools/";
+  std::vector<std::string> result;
+  for (const auto& id : GetBuiltinIds()) {
+    // No need to generate code cache for v8 scripts.
+    if (!id.starts_with(v8_tools_prefix)) {
+      result.emplace_back(id);
+    }
+  }
+  return result;
+}
+
 bool BuiltinLoader::CompileAllBuiltinsAndCopyCodeCache(
     Local<Context> context,
     const std::vector<std::string>& eager_builtins,
     std::vector<CodeCacheInfo>* out) {
-  auto ids = GetBuiltinIds();
+  return CompileBuiltinsAndCopyCodeCache(
+      context, eager_builtins, GetCodeCacheBuiltinIds(), out);
+}
+
+bool BuiltinLoader::CompileBuiltinsAndCopyCodeCache(
+    Local<Context> context,
+    const std::vector<std::string>& eager_builtins,
+    const std::vector<std::string>& ids,
+    std::vector<CodeCacheInfo>* out) {
   bool all_succeeded = true;
-  constexpr std::string_view v8_tools_prefix = "internal/deps/v8/tools/";
   constexpr std::string_view primordial_prefix = "internal/per_context/";
   constexpr std::string_view bootstrap_prefix = "internal/bootstrap/";
   constexpr std::string_view main_prefix = "internal/main/";
@@ -533,11 +552,6 @@ bool BuiltinLoader::CompileAllBuiltinsAndCopyCodeCache(
       std::unordered_set(eager_builtins.begin(), eager_builtins.end());
 
   for (const auto& id : ids) {
-    if (id.starts_with(v8_tools_prefix)) {
-      // No need to generate code cache for v8 scripts.
-      continue;
-    }
-
     // Eagerly compile primordials/boostrap/main scripts during code cache
     // generation.
     if (id.starts_with(primordial_prefix) || id.starts_with(bootstrap_prefix) ||
@@ -561,8 +575,11 @@ bool BuiltinLoader::CompileAllBuiltinsAndCopyCodeCache(
   }
 
   RwLock::ScopedReadLock lock(code_cache_->mutex);
-  for (const auto& [id, data] : code_cache_->map) {
-    out->push_back({id, data});
+  for (const auto& id : ids) {
+    auto it = code_cache_->map.find(id);
+    if (it != code_cache_->map.end()) {
+      out->push_back({id, it->second});
+    }
   }
   return all_succeeded;
 }
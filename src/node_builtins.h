@@ -46,6 +46,12 @@ class BuiltinCodeCacheData {
   BuiltinCodeCacheData(const uint8_t* data, size_t length)
       : data(data), length(length), owning_ptr(nullptr) {}
 
+  // data points into memory that is kept alive by owner.
+  BuiltinCodeCacheData(const uint8_t* data,
+                       size_t length,
+                       std::shared_ptr<void> owner)
+      : data(data), length(length), owning_ptr(std::move(owner)) {}
+
   const uint8_t* data;
   size_t length;
 
@@ -123,6 +129,15 @@ class NODE_EXTERN_PRIVATE BuiltinLoader {
       v8::Local<v8::Context> context,
       const std::vector<std::string>& lazy_builtins,
       std::vector<CodeCacheInfo>* out);
+  // Like CompileAllBuiltinsAndCopyCodeCache(), but only for the given ids.
+  // This allows the code cache to be generated in several isolates at once.
+  bool CompileBuiltinsAndCopyCodeCache(
+      v8::Local<v8::Context> context,
+      const std::vector<std::string>& eager_builtins,
+      const std::vector<std::string>& ids,
+      std::vector<CodeCacheInfo>* out);
+  // Returns the ids of the builtins that code cache is generated for.
+  std::vector<std::string> GetCodeCacheBuiltinIds() const;
   void RefreshCodeCache(const std::vector<CodeCacheInfo>& in);
 
   void CopySourceAndCodeCacheReferenceFrom(const BuiltinLoader* other);
@@ -53,6 +53,7 @@ namespace crypto {
   V(Random)                                                                    \
   V(RSAAlg)                                                                    \
   V(SecureContext)                                                             \
+  V(SessionCache)                                                              \
   V(Sign)                                                                      \
   V(SPKAC)                                                                     \
   V(Timing)                                                                    \
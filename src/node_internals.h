@@ -420,6 +420,9 @@ int WriteFileSync(v8::Isolate* isolate,
                   const char* path,
                   v8::Local<v8::String> string);
 
+// The inverse of signo_string(), returns 0 for unknown names.
+int SignalFromName(std::string_view name);
+
 class DiagnosticFilename {
  public:
   static void LocalTime(TIME_TYPE* tm_struct);
@@ -446,7 +449,8 @@ class DiagnosticFilename {
 namespace heap {
 v8::Maybe<void> WriteSnapshot(Environment* env,
                               const char* filename,
-                              v8::HeapProfiler::HeapSnapshotOptions options);
+                              v8::HeapProfiler::HeapSnapshotOptions options,
+                              bool binary = false);
 }
 
 namespace heap {
@@ -455,8 +459,10 @@ void DeleteHeapSnapshot(const v8::HeapSnapshot* snapshot);
 using HeapSnapshotPointer =
   DeleteFnPtr<const v8::HeapSnapshot, DeleteHeapSnapshot>;
 
+// If binary is true, the stream emits the format of heap_snapshot_binary.h
+// instead of JSON.
 BaseObjectPtr<AsyncWrap> CreateHeapSnapshotStream(
-    Environment* env, HeapSnapshotPointer&& snapshot);
+    Environment* env, HeapSnapshotPointer&& snapshot, bool binary = false);
 }  // namespace heap
 
 node_module napi_module_to_node_module(const napi_module* mod);
@@ -476,6 +482,9 @@ std::ostream& operator<<(std::ostream& output,
                          const TickInfo::SerializeInfo& d);
 std::ostream& operator<<(std::ostream& output,
                          const AsyncHooks::SerializeInfo& d);
+std::ostream& operator<<(std::ostream& output, const SnapshotSource& d);
+std::ostream& operator<<(std::ostream& output,
+                         const std::vector<SnapshotSource>& vec);
 std::ostream& operator<<(std::ostream& output, const SnapshotMetadata& d);
 
 namespace performance {
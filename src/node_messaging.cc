@@ -18,25 +18,42 @@ using v8::BackingStore;
 using v8::CompiledWasmModule;
 using v8::Context;
 using v8::EscapableHandleScope;
+using v8::False;
 using v8::Function;
 using v8::FunctionCallbackInfo;
 using v8::FunctionTemplate;
 using v8::Global;
 using v8::HandleScope;
+using v8::IndexFilter;
+using v8::Int32;
+using v8::Integer;
 using v8::Isolate;
 using v8::Just;
 using v8::JustVoid;
+using v8::KeyCollectionMode;
+using v8::KeyConversionMode;
 using v8::Local;
 using v8::LocalVector;
 using v8::Maybe;
 using v8::MaybeLocal;
+using v8::Name;
+using v8::NewStringType;
 using v8::Nothing;
+using v8::Null;
+using v8::Number;
 using v8::Object;
 using v8::ObjectTemplate;
+using v8::ONLY_ENUMERABLE;
+using v8::PropertyFilter;
 using v8::SharedArrayBuffer;
 using v8::SharedValueConveyor;
+using v8::SKIP_SYMBOLS;
 using v8::String;
 using v8::Symbol;
+using v8::True;
+using v8::TypedArray;
+using v8::Uint32;
+using v8::Undefined;
 using v8::Value;
 using v8::ValueDeserializer;
 using v8::ValueSerializer;
@@ -135,6 +152,562 @@ class DeserializerDelegate : public ValueDeserializer::Delegate {
   const std::optional<SharedValueConveyor>& shared_value_conveyor_;
 };
 
+// Messages that consist only of "plain data" skip the ValueSerializer and use
+// a simpler format, see PlainDataSerializer below. Every value starts with one
+// of these tags.
+enum class PlainDataTag : uint8_t {
+  kUndefined,
+  kNull,
+  kTrue,
+  kFalse,
+  kInt32,                // ZigZag-encoded varint.
+  kDouble,               // 8 bytes, host byte order.
+  kOneByteString,        // Varint length, Latin-1 characters.
+  kTwoByteString,        // Varint length, 2-byte aligned UTF-16 code units.
+  kArray,                // Varint length, elements.
+  kObject,               // Varint index of a known shape, values.
+  kObjectWithNewShape,   // Varint key count, keys (as strings), values.
+  kTypedArray,           // Type, varint length, varint byte length, data.
+};
+
+#define PLAIN_DATA_TYPED_ARRAY_TYPES(V)                                        \
+  V(Uint8Array)                                                                \
+  V(Int8Array)                                                                 \
+  V(Uint8ClampedArray)                                                         \
+  V(Uint16Array)                                                               \
+  V(Int16Array)                                                                \
+  V(Uint32Array)                                                               \
+  V(Int32Array)                                                                \
+  V(Float32Array)                                                              \
+  V(Float64Array)                                                              \
+  V(BigInt64Array)                                                             \
+  V(BigUint64Array)
+
+enum class PlainDataArrayType : uint8_t {
+#define V(Type) k##Type,
+  PLAIN_DATA_TYPED_ARRAY_TYPES(V)
+#undef V
+};
+
+bool GetPlainDataArrayType(Local<TypedArray> view, PlainDataArrayType* type) {
+#define V(Type)                                                                \
+  if (view->Is##Type()) {                                                      \
+    *type = PlainDataArrayType::k##Type;                                       \
+    return true;                                                               \
+  }
+  PLAIN_DATA_TYPED_ARRAY_TYPES(V)
+#undef V
+  return false;
+}
+
+// Reads messages written by PlainDataSerializer. The buffer is not modified,
+// so the same message can be read more than once (e.g. by every receiver of
+// a BroadcastChannel message).
+class PlainDataDeserializer {
+ public:
+  PlainDataDeserializer(Isolate* isolate,
+                        Local<Context> context,
+                        const MallocedBuffer<char>& buffer)
+      : isolate_(isolate),
+        context_(context),
+        data_(reinterpret_cast<const uint8_t*>(buffer.data)),
+        size_(buffer.size),
+        shape_keys_(isolate) {}
+
+  MaybeLocal<Value> Read() {
+    Local<Value> value;
+    if (!ReadValue().ToLocal(&value)) return {};
+    CHECK_EQ(position_, size_);
+    return value;
+  }
+
+ private:
+  MaybeLocal<Value> ReadValue() {
+    switch (static_cast<PlainDataTag>(ReadByte())) {
+      case PlainDataTag::kUndefined:
+        return Undefined(isolate_);
+      case PlainDataTag::kNull:
+        return Null(isolate_);
+      case PlainDataTag::kTrue:
+        return True(isolate_);
+      case PlainDataTag::kFalse:
+        return False(isolate_);
+      case PlainDataTag::kInt32: {
+        uint32_t zigzag = static_cast<uint32_t>(ReadVarint());
+        int32_t value = static_cast<int32_t>((zigzag >> 1) ^ -(zigzag & 1));
+        return Integer::New(isolate_, value);
+      }
+      case PlainDataTag::kDouble: {
+        double value;
+        memcpy(&value, ReadBytes(sizeof(value)), sizeof(value));
+        return Number::New(isolate_, value);
+      }
+      case PlainDataTag::kOneByteString:
+        return ReadString(false, NewStringType::kNormal);
+      case PlainDataTag::kTwoByteString:
+        return ReadString(true, NewStringType::kNormal);
+      case PlainDataTag::kArray:
+        return ReadArray();
+      case PlainDataTag::kObject:
+        return ReadObject(ReadVarint());
+      case PlainDataTag::kObjectWithNewShape:
+        return ReadObjectWithNewShape();
+      case PlainDataTag::kTypedArray:
+        return ReadTypedArray();
+    }
+    UNREACHABLE();
+  }
+
+  MaybeLocal<String> ReadString(bool two_byte, NewStringType type) {
+    size_t length = ReadVarint();
+    if (!two_byte) {
+      return String::NewFromOneByte(
+          isolate_, ReadBytes(length), type, static_cast<int>(length));
+    }
+    position_ += position_ % sizeof(uint16_t);
+    return String::NewFromTwoByte(
+        isolate_,
+        reinterpret_cast<const uint16_t*>(ReadBytes(length * sizeof(uint16_t))),
+        type,
+        static_cast<int>(length));
+  }
+
+  MaybeLocal<Value> ReadArray() {
+    size_t length = ReadVarint();
+    LocalVector<Value> elements(isolate_);
+    elements.reserve(length);
+    for (size_t i = 0; i < length; i++) {
+      Local<Value> element;
+      if (!ReadValue().ToLocal(&element)) return {};
+      elements.push_back(element);
+    }
+    return Array::New(isolate_, elements.data(), length);
+  }
+
+  MaybeLocal<Value> ReadObjectWithNewShape() {
+    size_t count = ReadVarint();
+    size_t offset = shape_keys_.size();
+    for (size_t i = 0; i < count; i++) {
+      PlainDataTag tag = static_cast<PlainDataTag>(ReadByte());
+      CHECK(tag == PlainDataTag::kOneByteString ||
+            tag == PlainDataTag::kTwoByteString);
+      // Keys are likely to be used as property names again on this side, so
+      // internalize them right away.
+      Local<String> key;
+      if (!ReadString(tag == PlainDataTag::kTwoByteString,
+                      NewStringType::kInternalized)
+               .ToLocal(&key)) {
+        return {};
+      }
+      shape_keys_.push_back(key);
+    }
+    shapes_.emplace_back(offset, count);
+    return ReadObject(shapes_.size() - 1);
+  }
+
+  MaybeLocal<Value> ReadObject(size_t shape) {
+    CHECK_LT(shape, shapes_.size());
+    auto [offset, count] = shapes_[shape];
+    // Object::New() with a list of properties creates dictionary-mode
+    // objects. Adding the properties one by one instead lets objects of the
+    // same shape share their maps through V8's transition tree, just like
+    // objects created by the ValueSerializer or by JS code.
+    Local<Object> object = Object::New(isolate_);
+    for (size_t i = 0; i < count; i++) {
+      Local<Value> value;
+      if (!ReadValue().ToLocal(&value) ||
+          object->CreateDataProperty(context_, shape_keys_[offset + i], value)
+              .IsNothing()) {
+        return {};
+      }
+    }
+    return object;
+  }
+
+  MaybeLocal<Value> ReadTypedArray() {
+    PlainDataArrayType type = static_cast<PlainDataArrayType>(ReadByte());
+    size_t length = ReadVarint();
+    size_t byte_length = ReadVarint();
+    Local<ArrayBuffer> buffer = ArrayBuffer::New(isolate_, byte_length);
+    if (byte_length > 0)
+      memcpy(buffer->Data(), ReadBytes(byte_length), byte_length);
+    switch (type) {
+#define V(Type)                                                                \
+  case PlainDataArrayType::k##Type:                                            \
+    return v8::Type::New(buffer, 0, length);
+      PLAIN_DATA_TYPED_ARRAY_TYPES(V)
+#undef V
+    }
+    UNREACHABLE();
+  }
+
+  uint8_t ReadByte() { return *ReadBytes(1); }
+
+  const uint8_t* ReadBytes(size_t length) {
+    CHECK_LE(length, size_ - position_);
+    const uint8_t* ret = data_ + position_;
+    position_ += length;
+    return ret;
+  }
+
+  uint64_t ReadVarint() {
+    uint64_t value = 0;
+    for (unsigned shift = 0;; shift += 7) {
+      CHECK_LT(shift, 64);
+      uint8_t byte = ReadByte();
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) return value;
+    }
+  }
+
+  Isolate* isolate_;
+  Local<Context> context_;
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_ = 0;
+  // Keys of all shapes, in order; shapes_ holds (offset, count) pairs.
+  LocalVector<Name> shape_keys_;
+  std::vector<std::pair<size_t, size_t>> shapes_;
+};
+
+// Serializes a restricted subset of values ("plain data"): primitives other
+// than symbols and BigInts, plain objects with string keys, dense arrays and
+// TypedArrays that span a whole, non-shared ArrayBuffer. Structured cloning
+// of these does not depend on anything but their visible structure, so they
+// can be written in a compact format that is much cheaper to produce and to
+// read back than the ValueSerializer one. Key lists of objects ("shapes")
+// are only written the first time they are seen; later objects with the same
+// keys in the same order refer to them by index, and the receiving side
+// creates them with pre-internalized keys.
+//
+// Write() returns Just(false) as soon as it finds anything outside of this
+// subset, including objects that are reachable more than once, and the
+// caller then falls back to the ValueSerializer. Accessor properties are
+// rejected before any value is read, so no user code runs before the
+// fallback and getters are only ever called once.
+class PlainDataSerializer {
+ public:
+  PlainDataSerializer(Environment* env, Local<Context> context)
+      : env_(env),
+        isolate_(env->isolate()),
+        context_(context),
+        seen_objects_(isolate_),
+        shape_keys_(isolate_) {}
+
+  ~PlainDataSerializer() { free(data_); }
+
+  PlainDataSerializer(const PlainDataSerializer&) = delete;
+  PlainDataSerializer& operator=(const PlainDataSerializer&) = delete;
+
+  Maybe<bool> Write(Local<Value> value) {
+    if (value->IsUndefined()) {
+      WriteTag(PlainDataTag::kUndefined);
+    } else if (value->IsNull()) {
+      WriteTag(PlainDataTag::kNull);
+    } else if (value->IsTrue()) {
+      WriteTag(PlainDataTag::kTrue);
+    } else if (value->IsFalse()) {
+      WriteTag(PlainDataTag::kFalse);
+    } else if (value->IsInt32()) {
+      int32_t int_value = value.As<Int32>()->Value();
+      WriteTag(PlainDataTag::kInt32);
+      WriteVarint((static_cast<uint32_t>(int_value) << 1) ^
+                  static_cast<uint32_t>(int_value >> 31));
+    } else if (value->IsNumber()) {
+      double number = value.As<Number>()->Value();
+      WriteTag(PlainDataTag::kDouble);
+      memcpy(Allocate(sizeof(number)), &number, sizeof(number));
+    } else if (value->IsString()) {
+      WriteString(value.As<String>());
+    } else if (value->IsObject()) {
+      if (depth_ >= kMaxDepth) return Just(false);
+      Local<Object> object = value.As<Object>();
+      if (!MarkSeen(object)) return Just(false);
+      depth_++;
+      auto decrease_depth = OnScopeLeave([&]() { depth_--; });
+      if (object->IsArray()) return WriteArray(object.As<Array>());
+      if (object->IsTypedArray())
+        return Just(WriteTypedArray(object.As<TypedArray>()));
+      return WriteObject(object);
+    } else {
+      return Just(false);
+    }
+    return Just(true);
+  }
+
+  MallocedBuffer<char> Release() {
+    MallocedBuffer<char> ret(reinterpret_cast<char*>(data_), size_);
+    data_ = nullptr;
+    size_ = capacity_ = 0;
+    return ret;
+  }
+
+ private:
+  // Deeper structures are rare and are left to the ValueSerializer, which
+  // does not recurse on the native stack as freely.
+  static constexpr size_t kMaxDepth = 128;
+
+  Maybe<bool> WriteObject(Local<Object> object) {
+    if (!IsPlainObject(object)) return Just(false);
+
+    Local<Array> keys;
+    if (!object
+             ->GetOwnPropertyNames(
+                 context_,
+                 static_cast<PropertyFilter>(ONLY_ENUMERABLE | SKIP_SYMBOLS),
+                 KeyConversionMode::kKeepNumbers)
+             .ToLocal(&keys)) {
+      return Nothing<bool>();
+    }
+    uint32_t count = keys->Length();
+    LocalVector<Name> names(isolate_);
+    names.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+      Local<Value> key;
+      if (!keys->Get(context_, i).ToLocal(&key)) return Nothing<bool>();
+      // Integer-indexed properties are kept as numbers. They are uncommon
+      // enough in plain records to leave them to the ValueSerializer.
+      if (!key->IsString()) return Just(false);
+      // Reading an accessor property would call into JS, which could also
+      // change properties that were already written.
+      bool is_accessor;
+      if (!object->HasRealNamedCallbackProperty(context_, key.As<Name>())
+               .To(&is_accessor)) {
+        return Nothing<bool>();
+      }
+      if (is_accessor) return Just(false);
+      names.push_back(key.As<Name>());
+    }
+
+    size_t shape;
+    if (FindOrAddShape(names, &shape)) {
+      WriteTag(PlainDataTag::kObject);
+      WriteVarint(shape);
+    } else {
+      WriteTag(PlainDataTag::kObjectWithNewShape);
+      WriteVarint(count);
+      for (Local<Name> name : names) WriteString(name.As<String>());
+    }
+
+    for (Local<Name> name : names) {
+      Local<Value> value;
+      bool ok;
+      if (!object->Get(context_, name).ToLocal(&value) ||
+          !Write(value).To(&ok)) {
+        return Nothing<bool>();
+      }
+      if (!ok) return Just(false);
+    }
+    return Just(true);
+  }
+
+  Maybe<bool> WriteArray(Local<Array> array) {
+    if (array_prototype_.IsEmpty())
+      array_prototype_ = Array::New(isolate_)->GetPrototypeV2();
+    if (array->GetPrototypeV2() != array_prototype_) return Just(false);
+
+    // Named properties on arrays are preserved by structured cloning.
+    Local<Array> names;
+    if (!array
+             ->GetPropertyNames(
+                 context_,
+                 KeyCollectionMode::kOwnOnly,
+                 static_cast<PropertyFilter>(ONLY_ENUMERABLE | SKIP_SYMBOLS),
+                 IndexFilter::kSkipIndices)
+             .ToLocal(&names)) {
+      return Nothing<bool>();
+    }
+    if (names->Length() != 0) return Just(false);
+
+    uint32_t length = array->Length();
+    WriteTag(PlainDataTag::kArray);
+    WriteVarint(length);
+    for (uint32_t i = 0; i < length; i++) {
+      bool has_element;
+      if (!array->HasRealIndexedProperty(context_, i).To(&has_element))
+        return Nothing<bool>();
+      // Holes would be filled with undefined.
+      if (!has_element) return Just(false);
+      Local<String> index;
+      bool is_accessor;
+      if (!Uint32::NewFromUnsigned(isolate_, i)
+               ->ToString(context_)
+               .ToLocal(&index) ||
+          !array->HasRealNamedCallbackProperty(context_, index)
+               .To(&is_accessor)) {
+        return Nothing<bool>();
+      }
+      if (is_accessor) return Just(false);
+      Local<Value> element;
+      bool ok;
+      if (!array->Get(context_, i).ToLocal(&element) ||
+          !Write(element).To(&ok)) {
+        return Nothing<bool>();
+      }
+      if (!ok) return Just(false);
+    }
+    return Just(true);
+  }
+
+  bool WriteTypedArray(Local<TypedArray> view) {
+    // Structured cloning preserves the whole underlying ArrayBuffer, so only
+    // views that cover all of it can be copied as-is.
+    Local<ArrayBuffer> buffer = view->Buffer();
+    if (buffer->IsSharedArrayBuffer() || buffer->WasDetached() ||
+        buffer->IsResizableByUserJavaScript() || view->ByteOffset() != 0 ||
+        view->ByteLength() != buffer->ByteLength() || !MarkSeen(buffer)) {
+      return false;
+    }
+
+    PlainDataArrayType type;
+    if (!GetPlainDataArrayType(view, &type)) return false;
+
+    size_t byte_length = view->ByteLength();
+    WriteTag(PlainDataTag::kTypedArray);
+    *Allocate(1) = static_cast<uint8_t>(type);
+    WriteVarint(view->Length());
+    WriteVarint(byte_length);
+    if (byte_length > 0) view->CopyContents(Allocate(byte_length), byte_length);
+    return true;
+  }
+
+  void WriteString(Local<String> string) {
+    uint32_t length = string->Length();
+    if (string->IsOneByte()) {
+      WriteTag(PlainDataTag::kOneByteString);
+      WriteVarint(length);
+      string->WriteOneByteV2(isolate_, 0, length, Allocate(length));
+    } else {
+      WriteTag(PlainDataTag::kTwoByteString);
+      WriteVarint(length);
+      if (size_ % sizeof(uint16_t) != 0) *Allocate(1) = 0;
+      string->WriteV2(isolate_,
+                      0,
+                      length,
+                      reinterpret_cast<uint16_t*>(
+                          Allocate(length * sizeof(uint16_t))));
+    }
+  }
+
+  bool IsPlainObject(Local<Object> object) {
+    // Checked first because looking up the prototype of a Proxy runs a trap.
+    if (object->IsProxy() || object->IsFunction() ||
+        object->InternalFieldCount() > 0) {
+      return false;
+    }
+    if (object_prototype_.IsEmpty())
+      object_prototype_ = Object::New(isolate_)->GetPrototypeV2();
+    if (object->GetPrototypeV2() != object_prototype_) return false;
+    // Built-in objects whose prototype has been replaced.
+    if (object->IsArgumentsObject() || object->IsArrayBuffer() ||
+        object->IsArrayBufferView() || object->IsBigIntObject() ||
+        object->IsBooleanObject() || object->IsDate() ||
+        object->IsGeneratorObject() || object->IsMap() ||
+        object->IsMapIterator() || object->IsModuleNamespaceObject() ||
+        object->IsNativeError() || object->IsNumberObject() ||
+        object->IsPromise() || object->IsRegExp() || object->IsSet() ||
+        object->IsSetIterator() || object->IsSharedArrayBuffer() ||
+        object->IsStringObject() || object->IsSymbolObject() ||
+        object->IsWasmMemoryObject() || object->IsWasmModuleObject() ||
+        object->IsWeakMap() || object->IsWeakSet()) {
+      return false;
+    }
+    // Objects with special handling in SerializerDelegate::WriteHostObject().
+    auto env_proxy_ctor_template = env_->env_proxy_ctor_template();
+    if (!env_proxy_ctor_template.IsEmpty() &&
+        env_proxy_ctor_template->HasInstance(object)) {
+      return false;
+    }
+    return !JSTransferable::IsJSTransferable(env_, context_, object);
+  }
+
+  // Returns false if the object has been written before. The fallback path
+  // preserves shared references and cycles.
+  bool MarkSeen(Local<Object> object) {
+    int hash = object->GetIdentityHash();
+    auto range = seen_index_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (seen_objects_[it->second] == object) return false;
+    }
+    seen_index_.emplace(hash, seen_objects_.size());
+    seen_objects_.push_back(object);
+    return true;
+  }
+
+  // Returns true and sets *index if an identical list of keys has been
+  // written before, otherwise records it under a new index.
+  bool FindOrAddShape(const LocalVector<Name>& names, size_t* index) {
+    uint32_t hash = names.size();
+    for (Local<Name> name : names)
+      hash = hash * 31 + static_cast<uint32_t>(name->GetIdentityHash());
+
+    auto range = shape_index_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      auto [offset, count] = shapes_[it->second];
+      if (count != names.size()) continue;
+      bool equal = true;
+      for (size_t i = 0; i < count && equal; i++)
+        equal = shape_keys_[offset + i]->StrictEquals(names[i]);
+      if (equal) {
+        *index = it->second;
+        return true;
+      }
+    }
+
+    *index = shapes_.size();
+    shape_index_.emplace(hash, *index);
+    shapes_.emplace_back(shape_keys_.size(), names.size());
+    shape_keys_.insert(shape_keys_.end(), names.begin(), names.end());
+    return false;
+  }
+
+  void WriteTag(PlainDataTag tag) {
+    *Allocate(1) = static_cast<uint8_t>(tag);
+  }
+
+  void WriteVarint(uint64_t value) {
+    uint8_t* out = Allocate(10);
+    size_t written = 0;
+    do {
+      uint8_t byte = value & 0x7f;
+      value >>= 7;
+      out[written++] = byte | (value != 0 ? 0x80 : 0);
+    } while (value != 0);
+    size_ -= 10 - written;
+  }
+
+  // Returns a pointer to `length` bytes at the end of the output.
+  uint8_t* Allocate(size_t length) {
+    if (capacity_ - size_ < length) {
+      capacity_ = std::max(capacity_ * 2, size_ + length);
+      capacity_ = std::max<size_t>(capacity_, 64);
+      data_ = Realloc(data_, capacity_);
+    }
+    uint8_t* ret = data_ + size_;
+    size_ += length;
+    return ret;
+  }
+
+  Environment* env_;
+  Isolate* isolate_;
+  Local<Context> context_;
+  Local<Value> object_prototype_;
+  Local<Value> array_prototype_;
+  size_t depth_ = 0;
+
+  uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  size_t capacity_ = 0;
+
+  // Objects that have been written so far, indexed by their identity hash.
+  LocalVector<Object> seen_objects_;
+  std::unordered_multimap<int, size_t> seen_index_;
+  // Keys of all shapes, in order; shapes_ holds (offset, count) pairs.
+  LocalVector<Name> shape_keys_;
+  std::vector<std::pair<size_t, size_t>> shapes_;
+  std::unordered_multimap<uint32_t, size_t> shape_index_;
+};
+
 }  // anonymous namespace
 
 MaybeLocal<Value> Message::Deserialize(Environment* env,
@@ -143,6 +716,15 @@ MaybeLocal<Value> Message::Deserialize(Environment* env,
   Context::Scope context_scope(context);
 
   CHECK(!IsCloseMessage());
+  if (is_plain_data_) {
+    EscapableHandleScope handle_scope(env->isolate());
+    PlainDataDeserializer deserializer(
+        env->isolate(), context, main_message_buf_);
+    Local<Value> value;
+    if (!deserializer.Read().ToLocal(&value)) return {};
+    return handle_scope.Escape(value);
+  }
+
   if (port_list != nullptr && !transferables_.empty()) {
     // Need to create this outside of the EscapableHandleScope, but inside
     // the Context::Scope.
@@ -476,6 +1058,17 @@ Maybe<bool> Message::Serialize(Environment* env,
   // Verify that we're not silently overwriting an existing message.
   CHECK(main_message_buf_.is_empty());
 
+  if (transfer_list_v.length() == 0) {
+    PlainDataSerializer plain_data(env, context);
+    bool is_plain_data;
+    if (!plain_data.Write(input).To(&is_plain_data)) return Nothing<bool>();
+    if (is_plain_data) {
+      main_message_buf_ = plain_data.Release();
+      is_plain_data_ = true;
+      return Just(true);
+    }
+  }
+
   SerializerDelegate delegate(env, context, this);
   ValueSerializer serializer(env->isolate(), &delegate);
   delegate.serializer = &serializer;
@@ -628,15 +1221,22 @@ MessagePortData::~MessagePortData() {
 }
 
 void MessagePortData::MemoryInfo(MemoryTracker* tracker) const {
-  Mutex::ScopedLock lock(mutex_);
-  tracker->TrackField("incoming_messages", incoming_messages_);
+  // The queue can only be walked by its consumer, so just estimate its size.
+  tracker->TrackFieldWithSize("incoming_messages",
+                              incoming_messages_.size() * sizeof(Message),
+                              "std::shared_ptr<Message>");
 }
 
 void MessagePortData::AddToIncomingQueue(std::shared_ptr<Message> message) {
   // This function will be called by other threads.
-  Mutex::ScopedLock lock(mutex_);
-  incoming_messages_.emplace_back(std::move(message));
+  incoming_messages_.Push(std::move(message));
+
+  // The receiver clears wakeup_pending_ before it drains the queue, so if it
+  // is already set, the message will be picked up by a drain that is yet to
+  // start and there is no need to wake the receiver again.
+  if (wakeup_pending_.exchange(true, std::memory_order_acq_rel)) return;
 
+  Mutex::ScopedLock lock(mutex_);
   if (owner_ != nullptr) {
     Debug(owner_, "Adding message to incoming queue");
     owner_->TriggerAsync();
@@ -774,9 +1374,8 @@ MaybeLocal<Value> MessagePort::ReceiveMessage(Local<Context> context,
                                               Local<Value>* port_list) {
   std::shared_ptr<Message> received;
   {
-    // Get the head of the message queue.
-    Mutex::ScopedLock lock(data_->mutex_);
-
+    // Get the head of the message queue. This thread is the only consumer,
+    // so no lock is needed.
     Debug(this, "MessagePort has message");
 
     bool wants_message =
@@ -786,14 +1385,12 @@ MaybeLocal<Value> MessagePort::ReceiveMessage(Local<Context> context,
     // - There are no pending messages
     // - We are not intending to receive messages, and the message we would
     //   receive is not the final "close" message.
-    if (data_->incoming_messages_.empty() ||
-        (!wants_message &&
-         !data_->incoming_messages_.front()->IsCloseMessage())) {
+    std::shared_ptr<Message>* front = data_->incoming_messages_.Peek();
+    if (front == nullptr || (!wants_message && !(*front)->IsCloseMessage())) {
       return env()->no_message_symbol();
     }
 
-    received = data_->incoming_messages_.front();
-    data_->incoming_messages_.pop_front();
+    CHECK(data_->incoming_messages_.Pop(&received));
   }
 
   if (received->IsCloseMessage()) {
@@ -815,13 +1412,17 @@ void MessagePort::OnMessage(MessageProcessingMode mode) {
   // Because all data was sent from the previous context.
   if (IsDetached()) return;
 
+  // Messages added from here on need a new wakeup, everything that is already
+  // in the queue is drained below. This needs to be a read-modify-write so
+  // that it synchronizes with the producers that saw the flag set.
+  data_->wakeup_pending_.exchange(false, std::memory_order_acq_rel);
+
   HandleScope handle_scope(env()->isolate());
   Local<Context> context =
       object(env()->isolate())->GetCreationContextChecked();
 
   size_t processing_limit;
   if (mode == MessageProcessingMode::kNormalOperation) {
-    Mutex::ScopedLock lock(data_->mutex_);
     processing_limit = std::max(data_->incoming_messages_.size(),
                                 static_cast<size_t>(1000));
   } else {
@@ -1111,7 +1712,6 @@ void MessagePort::PostMessage(const FunctionCallbackInfo<Value>& args) {
 void MessagePort::Start() {
   Debug(this, "Start receiving messages");
   receiving_messages_ = true;
-  Mutex::ScopedLock lock(data_->mutex_);
   if (!data_->incoming_messages_.empty())
     TriggerAsync();
 }
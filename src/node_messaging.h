@@ -4,9 +4,10 @@
 #if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
 
 #include "env.h"
+#include "mpsc_queue.h"
 #include "node_mutex.h"
 #include "v8.h"
-#include <deque>
+#include <atomic>
 #include <string>
 #include <unordered_map>
 #include <set>
@@ -118,6 +119,9 @@ class Message : public MemoryRetainer {
   std::vector<std::unique_ptr<TransferData>> transferables_;
   std::vector<v8::CompiledWasmModule> wasm_modules_;
   std::optional<v8::SharedValueConveyor> shared_value_conveyor_;
+  // Whether main_message_buf_ was written by the plain data fast path
+  // rather than by the V8 ValueSerializer.
+  bool is_plain_data_ = false;
 
   friend class MessagePort;
 };
@@ -179,8 +183,9 @@ class MessagePortData : public TransferData {
   MessagePortData(const MessagePortData& other) = delete;
   MessagePortData& operator=(const MessagePortData& other) = delete;
 
-  // Add a message to the incoming queue and notify the receiver.
-  // This may be called from any thread.
+  // Add a message to the incoming queue and notify the receiver, unless a
+  // notification is already pending. This may be called from any thread and
+  // does not lock unless it needs to notify the receiver.
   void AddToIncomingQueue(std::shared_ptr<Message> message);
   v8::Maybe<bool> Dispatch(
       std::shared_ptr<Message> message,
@@ -206,13 +211,17 @@ class MessagePortData : public TransferData {
   SET_SELF_SIZE(MessagePortData)
 
  private:
-  // This mutex protects all fields below it, with the exception of
-  // sibling_.
-  mutable Mutex mutex_;
   // TODO(addaleax): Make this a std::variant<std::shared_ptr, std::unique_ptr>
   // once that is available with C++17, because std::shared_ptr comes with
   // overhead that is only necessary for BroadcastChannel.
-  std::deque<std::shared_ptr<Message>> incoming_messages_;
+  // Only the owner's thread consumes messages, see MPSCQueue.
+  MPSCQueue<std::shared_ptr<Message>> incoming_messages_;
+  // Set by the first producer after the receiver last started draining the
+  // queue, so that a burst of messages results in a single uv_async_send().
+  std::atomic<bool> wakeup_pending_{false};
+
+  // This mutex protects all fields below it.
+  mutable Mutex mutex_;
   MessagePort* owner_ = nullptr;
   std::shared_ptr<SiblingGroup> group_;
   friend class MessagePort;
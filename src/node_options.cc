@@ -6,6 +6,7 @@
 #include "node_errors.h"
 #include "node_external_reference.h"
 #include "node_internals.h"
+#include "node_sampling_profiler.h"
 #include "node_sea.h"
 #include "uv.h"
 #if HAVE_OPENSSL
@@ -102,11 +103,19 @@ void PerProcessOptions::CheckOptions(std::vector<std::string>* errors,
 #endif  // V8_ENABLE_SANDBOX
 #endif  // HAVE_OPENSSL
 
+  if (trace_event_format != "json" && trace_event_format != "perfetto") {
+    errors->push_back("invalid value for --trace-event-format");
+  }
+
   if (use_largepages != "off" &&
       use_largepages != "on" &&
       use_largepages != "silent") {
     errors->push_back("invalid value for --use-largepages");
   }
+
+  if (snapshot_auto_rebuild && snapshot_blob.empty()) {
+    errors->push_back("--snapshot-auto-rebuild requires --snapshot-blob");
+  }
   per_isolate->CheckOptions(errors, argv);
 }
 
@@ -259,6 +268,27 @@ void EnvironmentOptions::CheckOptions(std::vector<std::string>* errors,
 #endif
   }
 
+  if (!cpu_prof_continuous) {
+    if (cpu_prof_continuous_window !=
+        profiler::SamplingCpuProfiler::kDefaultWindowSeconds) {
+      errors->push_back("--cpu-prof-continuous-window must be used with "
+                        "--cpu-prof-continuous");
+    }
+    if (!cpu_prof_continuous_signal.empty()) {
+      errors->push_back("--cpu-prof-continuous-signal must be used with "
+                        "--cpu-prof-continuous");
+    }
+  } else if (cpu_prof_continuous_window == 0 ||
+             cpu_prof_continuous_window > 3600) {
+    errors->push_back("--cpu-prof-continuous-window must be between 1 and "
+                      "3600 seconds");
+  }
+  if (!cpu_prof_continuous_signal.empty() &&
+      SignalFromName(cpu_prof_continuous_signal) == 0) {
+    errors->push_back("invalid value for --cpu-prof-continuous-signal: " +
+                      cpu_prof_continuous_signal);
+  }
+
 #if HAVE_INSPECTOR
   if (!cpu_prof) {
     if (!cpu_prof_name.empty()) {
@@ -744,6 +774,21 @@ EnvironmentOptionsParser::EnvironmentOptionsParser() {
             &EnvironmentOptions::prof_process);
   // Options after --prof-process are passed through to the prof processor.
   AddAlias("--prof-process", {"--prof-process", "--"});
+  AddOption("--cpu-prof-continuous",
+            "continuously sample the CPU at a low frequency, keeping the "
+            "samples of the last --cpu-prof-continuous-window seconds",
+            &EnvironmentOptions::cpu_prof_continuous,
+            kAllowedInEnvvar);
+  AddOption("--cpu-prof-continuous-window",
+            "number of seconds of samples kept by --cpu-prof-continuous "
+            "(default: 60)",
+            &EnvironmentOptions::cpu_prof_continuous_window,
+            kAllowedInEnvvar);
+  AddOption("--cpu-prof-continuous-signal",
+            "write the samples kept by --cpu-prof-continuous to a pprof file "
+            "in the diagnostic directory upon receiving this signal",
+            &EnvironmentOptions::cpu_prof_continuous_signal,
+            kAllowedInEnvvar);
 #if HAVE_INSPECTOR
   AddOption("--cpu-prof",
             "Start the V8 CPU profiler on start up, and write the CPU profile "
@@ -1236,6 +1281,17 @@ PerProcessOptionsParser::PerProcessOptionsParser(
             "data, it supports ${rotation} and ${pid}.",
             &PerProcessOptions::trace_event_file_pattern,
             kAllowedInEnvvar);
+  AddOption("--trace-event-format",
+            "format of the trace-events data, 'json' (default) or "
+            "'perfetto' for the binary Perfetto protobuf format",
+            &PerProcessOptions::trace_event_format,
+            kAllowedInEnvvar);
+  AddOption("--trace-event-coarse-clock",
+            "stamp trace events of the main thread with the coarse clock that "
+            "is refreshed once per event loop callback instead of reading the "
+            "clock per event",
+            &PerProcessOptions::trace_event_coarse_clock,
+            kAllowedInEnvvar);
   AddAlias("--trace-events-enabled", {
     "--trace-event-categories", "v8,node,node.async_hooks" });
   AddOption("--v8-pool-size",
@@ -1264,6 +1320,12 @@ PerProcessOptionsParser::PerProcessOptionsParser(
             "state",
             &PerProcessOptions::snapshot_blob,
             kAllowedInEnvvar);
+  AddOption("--snapshot-auto-rebuild",
+            "Run the entry point without the --snapshot-blob snapshot if it "
+            "is missing or its sources changed, and rebuild it in the "
+            "background for the next start",
+            &PerProcessOptions::snapshot_auto_rebuild,
+            kAllowedInEnvvar);
 
   // 12.x renamed this inadvertently, so alias it for consistency within the
   // release line, while using the original name for consistency with older
@@ -168,6 +168,9 @@ class EnvironmentOptions : public Options {
   bool preserve_symlinks = false;
   bool preserve_symlinks_main = false;
   bool prof_process = false;
+  bool cpu_prof_continuous = false;
+  uint64_t cpu_prof_continuous_window = 60;
+  std::string cpu_prof_continuous_signal;
 #if HAVE_INSPECTOR
   std::string cpu_prof_dir;
   static const uint64_t kDefaultCpuProfInterval = 1000;
@@ -322,6 +325,8 @@ class PerProcessOptions : public Options {
   std::string title;
   std::string trace_event_categories;
   std::string trace_event_file_pattern = "node_trace.${rotation}.log";
+  std::string trace_event_format = "json";
+  bool trace_event_coarse_clock = false;
   int64_t v8_thread_pool_size = 4;
   bool zero_fill_all_buffers = false;
   bool debug_arraybuffer_allocations = false;
@@ -331,6 +336,7 @@ class PerProcessOptions : public Options {
   // Therefore --node-snapshot is a per-process option.
   bool node_snapshot = true;
   std::string snapshot_blob;
+  bool snapshot_auto_rebuild = false;
 
   std::vector<std::string> security_reverts;
   bool print_bash_completion = false;
@@ -7,6 +7,7 @@
 #include "node_external_reference.h"
 #include "node_internals.h"
 #include "node_process-inl.h"
+#include "tracing/agent.h"
 #include "util-inl.h"
 
 #include <cinttypes>
@@ -24,6 +25,7 @@ using v8::GCType;
 using v8::Integer;
 using v8::Isolate;
 using v8::Local;
+using v8::LocalVector;
 using v8::MaybeLocal;
 using v8::Object;
 using v8::ObjectTemplate;
@@ -35,6 +37,8 @@ using v8::Value;
 #define MICROS_PER_MILLIS 1e3
 // Nanoseconds in a millisecond, as a float.
 #define NANOS_PER_MILLIS 1e6
+// Nanoseconds in a second, as an integer.
+#define NANOS_PER_SEC 1000000000
 
 const uint64_t performance_process_start = PERFORMANCE_NOW();
 const double performance_process_start_timestamp =
@@ -57,7 +61,12 @@ PerformanceState::PerformanceState(Isolate* isolate,
                 offsetof(performance_state_internal, observers),
                 NODE_PERFORMANCE_ENTRY_TYPE_INVALID,
                 root,
-                MAYBE_FIELD_PTR(info, observers)) {
+                MAYBE_FIELD_PTR(info, observers)),
+      coarse_clock(isolate,
+                   offsetof(performance_state_internal, coarse_clock),
+                   NODE_PERFORMANCE_COARSE_CLOCK_FIELD_COUNT,
+                   root,
+                   MAYBE_FIELD_PTR(info, coarse_clock)) {
   if (info == nullptr) {
     // For performance states initialized from scratch, reset
     // all the milestones and initialize the time origin.
@@ -65,6 +74,7 @@ PerformanceState::PerformanceState(Isolate* isolate,
     // initialization in the deserialize callback.
     ResetMilestones();
     Initialize(time_origin, time_origin_timestamp);
+    RefreshCoarseClock();
   }
 }
 
@@ -83,7 +93,8 @@ PerformanceState::SerializeInfo PerformanceState::Serialize(
 
   SerializeInfo info{root.Serialize(context, creator),
                      milestones.Serialize(context, creator),
-                     observers.Serialize(context, creator)};
+                     observers.Serialize(context, creator),
+                     coarse_clock.Serialize(context, creator)};
   return info;
 }
 
@@ -105,9 +116,11 @@ void PerformanceState::Deserialize(v8::Local<v8::Context> context,
   root.Deserialize(context);
   milestones.Deserialize(context);
   observers.Deserialize(context);
+  coarse_clock.Deserialize(context);
 
   // Re-initialize the time origin and timestamp i.e. the process start time.
   Initialize(time_origin, time_origin_timestamp);
+  RefreshCoarseClock();
 }
 
 std::ostream& operator<<(std::ostream& o,
@@ -116,10 +129,22 @@ std::ostream& operator<<(std::ostream& o,
     << "  " << i.root << ",  // root\n"
     << "  " << i.milestones << ",  // milestones\n"
     << "  " << i.observers << ",  // observers\n"
+    << "  " << i.coarse_clock << ",  // coarse_clock\n"
     << "}";
   return o;
 }
 
+void PerformanceState::RefreshCoarseClock(uint64_t now) {
+  coarse_now_ = now;
+  coarse_clock[NODE_PERFORMANCE_COARSE_CLOCK_NOW] =
+      static_cast<double>(now - performance_process_start) / NANOS_PER_MILLIS;
+  coarse_clock[NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_SEC] =
+      static_cast<double>(now / NANOS_PER_SEC);
+  coarse_clock[NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_NSEC] =
+      static_cast<double>(now % NANOS_PER_SEC);
+  tracing::TracingController::UpdateCoarseClock(now);
+}
+
 void PerformanceState::Mark(PerformanceMilestone milestone, uint64_t ts) {
   this->milestones[milestone] = static_cast<double>(ts);
   TRACE_EVENT_INSTANT_WITH_TIMESTAMP0(
@@ -278,6 +303,100 @@ void UvMetricsInfo(const FunctionCallbackInfo<Value>& args) {
   args.GetReturnValue().Set(arr);
 }
 
+EventLoopPhaseProfiler::EventLoopPhaseProfiler(Environment* env) : env_(env) {
+  for (std::shared_ptr<Histogram>& histogram : histograms_)
+    histogram = std::make_shared<Histogram>(Histogram::Options {});
+
+  CHECK_EQ(0, uv_prepare_init(env->event_loop(), &prepare_handle_));
+  CHECK_EQ(0, uv_check_init(env->event_loop(), &check_handle_));
+  prepare_handle_.data = this;
+  check_handle_.data = this;
+  // The prepare handle runs right before the loop polls for I/O, and the
+  // check handle right after the I/O callbacks. The time in between, minus
+  // the time spent blocked in the poll, is spent in I/O callbacks.
+  uv_prepare_start(&prepare_handle_, [](uv_prepare_t* handle) {
+    EventLoopPhaseProfiler* profiler =
+        static_cast<EventLoopPhaseProfiler*>(handle->data);
+    profiler->poll_start_ = uv_hrtime();
+    profiler->poll_start_idle_time_ =
+        uv_metrics_idle_time(profiler->env_->event_loop());
+  });
+  uv_check_start(&check_handle_, [](uv_check_t* handle) {
+    EventLoopPhaseProfiler* profiler =
+        static_cast<EventLoopPhaseProfiler*>(handle->data);
+    if (profiler->poll_start_ == 0) return;
+    uint64_t elapsed = uv_hrtime() - profiler->poll_start_;
+    uint64_t idle = uv_metrics_idle_time(profiler->env_->event_loop()) -
+                    profiler->poll_start_idle_time_;
+    profiler->Record(NODE_PERFORMANCE_LOOP_PHASE_IO,
+                     elapsed > idle ? elapsed - idle : 0);
+    profiler->poll_start_ = 0;
+  });
+  uv_unref(reinterpret_cast<uv_handle_t*>(&prepare_handle_));
+  uv_unref(reinterpret_cast<uv_handle_t*>(&check_handle_));
+
+  env->AddCleanupHook(CleanupHook, this);
+}
+
+void EventLoopPhaseProfiler::Start(Environment* env) {
+  if (env->loop_phase_profiler() != nullptr) return;
+  env->set_loop_phase_profiler(new EventLoopPhaseProfiler(env));
+}
+
+void EventLoopPhaseProfiler::Stop(Environment* env) {
+  EventLoopPhaseProfiler* profiler = env->loop_phase_profiler();
+  if (profiler == nullptr) return;
+  env->set_loop_phase_profiler(nullptr);
+  env->RemoveCleanupHook(CleanupHook, profiler);
+
+  profiler->pending_handle_closes_ = 2;
+  auto on_close = [](auto* handle) {
+    EventLoopPhaseProfiler* profiler =
+        static_cast<EventLoopPhaseProfiler*>(handle->data);
+    if (--profiler->pending_handle_closes_ == 0) delete profiler;
+  };
+  env->CloseHandle(&profiler->prepare_handle_, on_close);
+  env->CloseHandle(&profiler->check_handle_, on_close);
+}
+
+void EventLoopPhaseProfiler::CleanupHook(void* data) {
+  Stop(static_cast<EventLoopPhaseProfiler*>(data)->env_);
+}
+
+void EventLoopPhaseProfiler::Record(PerformanceLoopPhase phase,
+                                    uint64_t duration) {
+  histograms_[phase]->Record(duration);
+  TRACE_COUNTER1(TRACING_CATEGORY_NODE2(perf, event_loop_phases),
+                 GetPerformanceLoopPhaseName(phase), duration);
+}
+
+void StartLoopPhaseProfiler(const FunctionCallbackInfo<Value>& args) {
+  EventLoopPhaseProfiler::Start(Environment::GetCurrent(args));
+}
+
+void StopLoopPhaseProfiler(const FunctionCallbackInfo<Value>& args) {
+  EventLoopPhaseProfiler::Stop(Environment::GetCurrent(args));
+}
+
+// Returns the histograms of the running profiler, indexed by
+// PerformanceLoopPhase, or undefined if the profiler is not running. The
+// histograms stay valid after the profiler is stopped.
+void GetLoopPhaseHistograms(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  EventLoopPhaseProfiler* profiler = env->loop_phase_profiler();
+  if (profiler == nullptr) return;
+
+  LocalVector<Value> histograms(env->isolate());
+  for (int i = 0; i < NODE_PERFORMANCE_LOOP_PHASE_COUNT; i++) {
+    BaseObjectPtr<HistogramBase> histogram = HistogramBase::Create(
+        env, profiler->histogram(static_cast<PerformanceLoopPhase>(i)));
+    if (!histogram) return;
+    histograms.push_back(histogram->object());
+  }
+  args.GetReturnValue().Set(
+      Array::New(env->isolate(), histograms.data(), histograms.size()));
+}
+
 void CreateELDHistogram(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args);
   int64_t interval = args[0].As<Integer>()->Value();
@@ -322,6 +441,26 @@ static void SlowPerformanceNow(const FunctionCallbackInfo<Value>& args) {
 static v8::CFunction fast_performance_now(
     v8::CFunction::Make(FastPerformanceNow));
 
+// Refreshes the coarse clock before a reading that has to be current.
+static void RefreshCoarseClockImpl(Environment* env) {
+  env->performance_state()->RefreshCoarseClock();
+}
+
+static void FastRefreshCoarseClock(
+    v8::Local<v8::Value> receiver,
+    // NOLINTNEXTLINE(runtime/references)
+    v8::FastApiCallbackOptions& options) {
+  TRACK_V8_FAST_API_CALL("performance.refreshCoarseClock");
+  RefreshCoarseClockImpl(Environment::GetCurrent(options.isolate));
+}
+
+static void SlowRefreshCoarseClock(const FunctionCallbackInfo<Value>& args) {
+  RefreshCoarseClockImpl(Environment::GetCurrent(args));
+}
+
+static v8::CFunction fast_refresh_coarse_clock(
+    v8::CFunction::Make(FastRefreshCoarseClock));
+
 static void CreatePerIsolateProperties(IsolateData* isolate_data,
                                        Local<ObjectTemplate> target) {
   Isolate* isolate = isolate_data->isolate();
@@ -342,8 +481,17 @@ static void CreatePerIsolateProperties(IsolateData* isolate_data,
   SetMethod(isolate, target, "createELDHistogram", CreateELDHistogram);
   SetMethod(isolate, target, "markBootstrapComplete", MarkBootstrapComplete);
   SetMethod(isolate, target, "uvMetricsInfo", UvMetricsInfo);
+  SetMethod(isolate, target, "startLoopPhaseProfiler", StartLoopPhaseProfiler);
+  SetMethod(isolate, target, "stopLoopPhaseProfiler", StopLoopPhaseProfiler);
+  SetMethod(
+      isolate, target, "getLoopPhaseHistograms", GetLoopPhaseHistograms);
   SetFastMethodNoSideEffect(
       isolate, target, "now", SlowPerformanceNow, &fast_performance_now);
+  SetFastMethod(isolate,
+                target,
+                "refreshCoarseClock",
+                SlowRefreshCoarseClock,
+                &fast_refresh_coarse_clock);
 }
 
 void CreatePerContextProperties(Local<Object> target,
@@ -360,6 +508,9 @@ void CreatePerContextProperties(Local<Object> target,
   target->Set(context,
               FIXED_ONE_BYTE_STRING(isolate, "milestones"),
               state->milestones.GetJSArray()).Check();
+  target->Set(context,
+              FIXED_ONE_BYTE_STRING(isolate, "coarseClock"),
+              state->coarse_clock.GetJSArray()).Check();
 
   Local<Object> constants = Object::New(isolate);
 
@@ -393,6 +544,17 @@ void CreatePerContextProperties(Local<Object> target,
   NODE_PERFORMANCE_MILESTONES(V)
 #undef V
 
+#define V(name, _)                                                            \
+  NODE_DEFINE_HIDDEN_CONSTANT(constants, NODE_PERFORMANCE_LOOP_PHASE_##name);
+  NODE_PERFORMANCE_LOOP_PHASES(V)
+#undef V
+
+  NODE_DEFINE_HIDDEN_CONSTANT(constants, NODE_PERFORMANCE_COARSE_CLOCK_NOW);
+  NODE_DEFINE_HIDDEN_CONSTANT(constants,
+                              NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_SEC);
+  NODE_DEFINE_HIDDEN_CONSTANT(constants,
+                              NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_NSEC);
+
   PropertyAttribute attr =
       static_cast<PropertyAttribute>(ReadOnly | DontDelete);
 
@@ -409,8 +571,13 @@ void RegisterExternalReferences(ExternalReferenceRegistry* registry) {
   registry->Register(CreateELDHistogram);
   registry->Register(MarkBootstrapComplete);
   registry->Register(UvMetricsInfo);
+  registry->Register(StartLoopPhaseProfiler);
+  registry->Register(StopLoopPhaseProfiler);
+  registry->Register(GetLoopPhaseHistograms);
   registry->Register(SlowPerformanceNow);
   registry->Register(fast_performance_now);
+  registry->Register(SlowRefreshCoarseClock);
+  registry->Register(fast_refresh_coarse_clock);
   HistogramBase::RegisterExternalReferences(registry);
   IntervalHistogram::RegisterExternalReferences(registry);
 }
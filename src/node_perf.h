@@ -51,6 +51,16 @@ inline const char* GetPerformanceEntryTypeName(
   }
 }
 
+inline const char* GetPerformanceLoopPhaseName(PerformanceLoopPhase phase) {
+  switch (phase) {
+#define V(name, label) case NODE_PERFORMANCE_LOOP_PHASE_##name: return label;
+  NODE_PERFORMANCE_LOOP_PHASES(V)
+#undef V
+    default:
+      UNREACHABLE();
+  }
+}
+
 inline PerformanceEntryType ToPerformanceEntryTypeEnum(
     const char* type) {
 #define V(name, label)                                                        \
@@ -158,6 +168,72 @@ struct GCPerformanceEntryTraits {
 
 using GCPerformanceEntry = PerformanceEntry<GCPerformanceEntryTraits>;
 
+// Records how long the parts of an event loop iteration that run JavaScript
+// take, in nanoseconds, with one histogram per phase:
+//   - timers: one run of the timers phase.
+//   - io: the callbacks of one poll phase, without the time spent waiting
+//     for events.
+//   - immediates: one run of the check phase.
+//   - close: one HandleWrap close callback.
+//   - microtasks: draining the nextTick and microtask queues when an
+//     InternalCallbackScope closes.
+// Samples of the other phases include the microtask draining that follows
+// their callbacks. The profiler is off unless started for an Environment.
+class EventLoopPhaseProfiler final {
+ public:
+  // Measures the lifetime of the scope if the profiler is running.
+  class Scope {
+   public:
+    inline Scope(Environment* env, PerformanceLoopPhase phase);
+    inline ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Environment* env_;
+    PerformanceLoopPhase phase_;
+    uint64_t start_;
+  };
+
+  static void Start(Environment* env);
+  static void Stop(Environment* env);
+
+  void Record(PerformanceLoopPhase phase, uint64_t duration);
+
+  const std::shared_ptr<Histogram>& histogram(
+      PerformanceLoopPhase phase) const {
+    return histograms_[phase];
+  }
+
+ private:
+  explicit EventLoopPhaseProfiler(Environment* env);
+
+  static void CleanupHook(void* data);
+
+  Environment* env_;
+  // Bracket the poll phase.
+  uv_prepare_t prepare_handle_;
+  uv_check_t check_handle_;
+  uint64_t poll_start_ = 0;
+  uint64_t poll_start_idle_time_ = 0;
+  int pending_handle_closes_ = 0;
+  std::shared_ptr<Histogram> histograms_[NODE_PERFORMANCE_LOOP_PHASE_COUNT];
+};
+
+EventLoopPhaseProfiler::Scope::Scope(Environment* env,
+                                     PerformanceLoopPhase phase)
+    : env_(env),
+      phase_(phase),
+      start_(env->loop_phase_profiler() != nullptr ? uv_hrtime() : 0) {}
+
+EventLoopPhaseProfiler::Scope::~Scope() {
+  if (start_ == 0) return;
+  // The profiler may have been stopped in the meantime.
+  EventLoopPhaseProfiler* profiler = env_->loop_phase_profiler();
+  if (profiler != nullptr) profiler->Record(phase_, uv_hrtime() - start_);
+}
+
 }  // namespace performance
 }  // namespace node
 
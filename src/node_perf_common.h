@@ -55,12 +55,37 @@ enum PerformanceEntryType {
   NODE_PERFORMANCE_ENTRY_TYPE_INVALID
 };
 
+#define NODE_PERFORMANCE_LOOP_PHASES(V)                                       \
+  V(TIMERS, "timers")                                                         \
+  V(IO, "io")                                                                 \
+  V(IMMEDIATES, "immediates")                                                 \
+  V(CLOSE, "close")                                                           \
+  V(MICROTASKS, "microtasks")
+
+enum PerformanceLoopPhase {
+#define V(name, _) NODE_PERFORMANCE_LOOP_PHASE_##name,
+  NODE_PERFORMANCE_LOOP_PHASES(V)
+#undef V
+  NODE_PERFORMANCE_LOOP_PHASE_COUNT
+};
+
+// Fields of PerformanceState::coarse_clock, all derived from the same reading.
+enum PerformanceCoarseClockField {
+  // Milliseconds since the process started, like performance.now().
+  NODE_PERFORMANCE_COARSE_CLOCK_NOW,
+  // Seconds and remaining nanoseconds, like process.hrtime().
+  NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_SEC,
+  NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_NSEC,
+  NODE_PERFORMANCE_COARSE_CLOCK_FIELD_COUNT
+};
+
 class PerformanceState {
  public:
   struct SerializeInfo {
     AliasedBufferIndex root;
     AliasedBufferIndex milestones;
     AliasedBufferIndex observers;
+    AliasedBufferIndex coarse_clock;
   };
 
   explicit PerformanceState(v8::Isolate* isolate,
@@ -77,6 +102,10 @@ class PerformanceState {
   AliasedUint8Array root;
   AliasedFloat64Array milestones;
   AliasedUint32Array observers;
+  // Coarse clock that JavaScript can read without calling into C++. It is
+  // refreshed whenever the event loop enters JavaScript and on request, so
+  // it is as old as the current callback at most.
+  AliasedFloat64Array coarse_clock;
 
   uint64_t performance_last_gc_start_mark = 0;
   uint16_t current_gc_type = 0;
@@ -84,14 +113,21 @@ class PerformanceState {
   void Mark(enum PerformanceMilestone milestone,
             uint64_t ts = PERFORMANCE_NOW());
 
+  void RefreshCoarseClock(uint64_t now = PERFORMANCE_NOW());
+  // The PERFORMANCE_NOW() value of the last refresh.
+  uint64_t coarse_now() const { return coarse_now_; }
+
  private:
   void Initialize(uint64_t time_origin, double time_origin_timestamp);
   void ResetMilestones();
   struct performance_state_internal {
     // doubles first so that they are always sizeof(double)-aligned
     double milestones[NODE_PERFORMANCE_MILESTONE_INVALID];
+    double coarse_clock[NODE_PERFORMANCE_COARSE_CLOCK_FIELD_COUNT];
     uint32_t observers[NODE_PERFORMANCE_ENTRY_TYPE_INVALID];
   };
+
+  uint64_t coarse_now_ = 0;
 };
 
 }  // namespace performance
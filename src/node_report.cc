@@ -1,4 +1,5 @@
 #include "node_report.h"
+#include "async_wrap-inl.h"
 #include "debug_utils-inl.h"
 #include "diagnosticfilename-inl.h"
 #include "env-inl.h"
@@ -8,6 +9,7 @@
 #include "node_mutex.h"
 #include "node_worker.h"
 #include "permission/permission.h"
+#include "threadpoolwork-inl.h"
 #include "util.h"
 
 #ifdef _WIN32
@@ -22,6 +24,7 @@
 #include <ctime>
 #include <cwctype>
 #include <fstream>
+#include <memory>
 #include <ranges>
 
 constexpr int NODE_REPORT_VERSION = 5;
@@ -36,6 +39,7 @@ using v8::Context;
 using v8::HandleScope;
 using v8::HeapSpaceStatistics;
 using v8::HeapStatistics;
+using v8::Integer;
 using v8::Isolate;
 using v8::Just;
 using v8::Local;
@@ -49,10 +53,54 @@ using v8::StackFrame;
 using v8::StackTrace;
 using v8::String;
 using v8::TryCatch;
+using v8::Undefined;
 using v8::V8;
 using v8::Value;
 
 namespace report {
+
+// Worker thread subreports that are requested while a report is captured.
+// They are filled in by the workers and awaited when the report is written.
+struct WorkerSubreports {
+  Mutex mutex;
+  ConditionVariable notify;
+  std::vector<std::string> reports;
+  size_t expected = 0;
+};
+
+// The parts of a report that have to be collected on the thread that the
+// report is about: the JavaScript stack and heap, the native stack, the
+// thread's resource usage and the libuv handles. The command line and the
+// environment variables are copied here as well, since they may only be
+// read or changed by the main thread. Everything else is added by
+// RenderReport(), which can run on any thread.
+struct ReportCapture {
+  std::string message;
+  std::string trigger;
+  std::string filename;
+  bool compact = false;
+  bool exclude_network = false;
+  bool exclude_env = false;
+
+  TIME_TYPE tm_struct;
+  bool has_timestamp = false;
+  uv_timeval64_t timestamp;
+  bool has_thread_id = false;
+  uint64_t thread_id = 0;
+  std::string cwd;
+  uint64_t uptime = 1;
+  std::vector<std::string> cmdline;
+  std::vector<std::pair<std::string, std::string>> environment_variables;
+
+  // Pre-rendered "javascriptStack", "javascriptHeap" and "libuv" sections.
+  std::string javascript;
+  std::string libuv;
+  std::vector<void*> native_frames;
+  bool has_thread_rusage = false;
+  uv_rusage_t thread_rusage;
+  std::shared_ptr<WorkerSubreports> workers;
+};
+
 // Internal/static function declarations
 static void WriteNodeReport(Isolate* isolate,
                             Environment* env,
@@ -64,6 +112,11 @@ static void WriteNodeReport(Isolate* isolate,
                             bool compact,
                             bool exclude_network = false,
                             bool exclude_env = false);
+static void CaptureReport(Isolate* isolate,
+                          Environment* env,
+                          Local<Value> error,
+                          ReportCapture* capture);
+static void RenderReport(const ReportCapture& capture, std::ostream& out);
 static void PrintVersionInformation(JSONWriter* writer,
                                     bool exclude_network = false);
 static void PrintJavaScriptErrorStack(JSONWriter* writer,
@@ -77,10 +130,17 @@ static void PrintJavaScriptStack(JSONWriter* writer,
 static void PrintJavaScriptErrorProperties(JSONWriter* writer,
                                            Isolate* isolate,
                                            Local<Value> error);
-static void PrintNativeStack(JSONWriter* writer);
-static void PrintResourceUsage(JSONWriter* writer);
+static void PrintNativeStack(JSONWriter* writer,
+                             const std::vector<void*>& frames);
+static void PrintResourceUsage(JSONWriter* writer,
+                               uint64_t uptime,
+                               const uv_rusage_t* thread_rusage);
 static void PrintGCStatistics(JSONWriter* writer, Isolate* isolate);
-static void PrintEnvironmentVariables(JSONWriter* writer);
+static void CaptureEnvironmentVariables(
+    std::vector<std::pair<std::string, std::string>>* variables);
+static void PrintEnvironmentVariables(
+    JSONWriter* writer,
+    const std::vector<std::pair<std::string, std::string>>& variables);
 static void PrintSystemInformation(JSONWriter* writer);
 static void PrintLoadedLibraries(JSONWriter* writer);
 static void PrintComponentVersions(JSONWriter* writer);
@@ -100,9 +160,140 @@ static void WriteNodeReport(Isolate* isolate,
                             bool compact,
                             bool exclude_network,
                             bool exclude_env) {
-  // Obtain the current time and the pid.
-  TIME_TYPE tm_struct;
-  DiagnosticFilename::LocalTime(&tm_struct);
+  ReportCapture capture;
+  capture.message = message;
+  capture.trigger = trigger;
+  capture.filename = filename;
+  capture.compact = compact;
+  capture.exclude_network = exclude_network;
+  capture.exclude_env = exclude_env;
+  CaptureReport(isolate, env, error, &capture);
+  RenderReport(capture, out);
+}
+
+// Collects the thread-bound parts of the report. The JavaScript and libuv
+// sections are rendered right away into fragments that continue after the
+// header, at the indentation of the top-level object.
+static void CaptureReport(Isolate* isolate,
+                          Environment* env,
+                          Local<Value> error,
+                          ReportCapture* capture) {
+  // Obtain the current time.
+  DiagnosticFilename::LocalTime(&capture->tm_struct);
+  capture->has_timestamp = uv_gettimeofday(&capture->timestamp) == 0;
+
+  // Get process uptime in seconds
+  capture->uptime =
+      (uv_hrtime() - per_process::node_start_time) / (NANOS_PER_SEC);
+  if (capture->uptime == 0) capture->uptime = 1;  // avoid division by zero.
+
+  if (env != nullptr) {
+    capture->has_thread_id = true;
+    capture->thread_id = env->thread_id();
+  }
+
+  {
+    // Report the process cwd.
+    char buf[PATH_MAX_BYTES];
+    size_t cwd_size = sizeof(buf);
+    if (uv_cwd(buf, &cwd_size) == 0) capture->cwd = buf;
+  }
+
+  {
+    Mutex::ScopedLock lock(per_process::cli_options_mutex);
+    capture->cmdline = per_process::cli_options->cmdline;
+  }
+  if (!capture->exclude_env)
+    CaptureEnvironmentVariables(&capture->environment_variables);
+
+  {
+    std::ostringstream out;
+    JSONWriter writer(out, capture->compact, 2);
+    if (isolate != nullptr) {
+      writer.json_objectstart("javascriptStack");
+      // Report summary JavaScript error stack backtrace
+      PrintJavaScriptErrorStack(&writer, isolate, error, capture->trigger);
+
+      writer.json_objectend();  // the end of 'javascriptStack'
+
+      // Report V8 Heap and Garbage Collector information
+      PrintGCStatistics(&writer, isolate);
+    } else {
+      writer.json_objectstart("javascriptStack");
+      PrintEmptyJavaScriptStack(&writer);
+      writer.json_objectend();  // the end of 'javascriptStack'
+    }
+    capture->javascript = out.str();
+  }
+
+  // Capture native stack backtrace, symbols are looked up when rendering.
+  {
+    auto sym_ctx = NativeSymbolDebuggingContext::New();
+    void* frames[256];
+    const int size = sym_ctx->GetStackTrace(frames, arraysize(frames));
+    if (size > 1) capture->native_frames.assign(frames + 1, frames + size);
+  }
+
+  capture->has_thread_rusage =
+      uv_getrusage_thread(&capture->thread_rusage) == 0;
+
+  {
+    std::ostringstream out;
+    JSONWriter writer(out, capture->compact, 2);
+    writer.json_arraystart("libuv");
+    if (env != nullptr) {
+      uv_walk(env->event_loop(),
+              capture->exclude_network ? WalkHandleNoNetwork
+                                       : WalkHandleNetwork,
+              static_cast<void*>(&writer));
+
+      writer.json_start();
+      writer.json_keyvalue("type", "loop");
+      writer.json_keyvalue("is_active",
+          static_cast<bool>(uv_loop_alive(env->event_loop())));
+      writer.json_keyvalue("address",
+          ValueToHexString(reinterpret_cast<int64_t>(env->event_loop())));
+
+      // Report Event loop idle time
+      uint64_t idle_time = uv_metrics_idle_time(env->event_loop());
+      writer.json_keyvalue("loopIdleTimeSeconds", 1.0 * idle_time / 1e9);
+      writer.json_end();
+    }
+    writer.json_arrayend();
+    capture->libuv = out.str();
+  }
+
+  if (env != nullptr) {
+    // The subreports are only awaited in RenderReport(), so that a report
+    // that is rendered on another thread does not block this one.
+    auto workers = std::make_shared<WorkerSubreports>();
+    std::string trigger = capture->trigger;
+    size_t expected_results = 0;
+
+    env->ForEachWorker([&](Worker* w) {
+      expected_results += w->RequestInterrupt(
+          [workers, trigger, w = w](Environment* env) {
+            std::ostringstream os;
+            std::string name =
+                "Worker thread subreport [" + std::string(w->name()) + "]";
+            GetNodeReport(env, name, trigger, Local<Value>(), os);
+
+            Mutex::ScopedLock lock(workers->mutex);
+            workers->reports.emplace_back(os.str());
+            workers->notify.Signal(lock);
+          });
+    });
+
+    Mutex::ScopedLock lock(workers->mutex);
+    workers->expected = expected_results;
+    capture->workers = std::move(workers);
+  }
+}
+
+// Writes the report, combining the captured sections with the ones that
+// describe the whole process.
+static void RenderReport(const ReportCapture& capture, std::ostream& out) {
+  // Obtain the pid.
   uv_pid_t pid = uv_os_getpid();
 
   // Save formatting for output stream.
@@ -112,18 +303,19 @@ static void WriteNodeReport(Isolate* isolate,
   // File stream opened OK, now start printing the report content:
   // the title and header information (event, filename, timestamp and pid)
 
-  JSONWriter writer(out, compact);
+  JSONWriter writer(out, capture.compact);
   writer.json_start();
   writer.json_objectstart("header");
   writer.json_keyvalue("reportVersion", NODE_REPORT_VERSION);
-  writer.json_keyvalue("event", message);
-  writer.json_keyvalue("trigger", trigger);
-  if (!filename.empty())
-    writer.json_keyvalue("filename", filename);
+  writer.json_keyvalue("event", capture.message);
+  writer.json_keyvalue("trigger", capture.trigger);
+  if (!capture.filename.empty())
+    writer.json_keyvalue("filename", capture.filename);
   else
     writer.json_keyvalue("filename", JSONWriter::Null{});
 
   // Report dump event and module load date/time stamps
+  const TIME_TYPE& tm_struct = capture.tm_struct;
   char timebuf[64];
 #ifdef _WIN32
   snprintf(timebuf,
@@ -149,114 +341,61 @@ static void WriteNodeReport(Isolate* isolate,
   writer.json_keyvalue("dumpEventTime", timebuf);
 #endif
 
-  uv_timeval64_t ts;
-  if (uv_gettimeofday(&ts) == 0) {
+  if (capture.has_timestamp) {
+    const uv_timeval64_t& ts = capture.timestamp;
     writer.json_keyvalue("dumpEventTimeStamp",
                          std::to_string(ts.tv_sec * 1000 + ts.tv_usec / 1000));
   }
 
   // Report native process ID
   writer.json_keyvalue("processId", pid);
-  if (env != nullptr)
-    writer.json_keyvalue("threadId", env->thread_id());
+  if (capture.has_thread_id)
+    writer.json_keyvalue("threadId", capture.thread_id);
   else
     writer.json_keyvalue("threadId", JSONWriter::Null{});
 
-  {
-    // Report the process cwd.
-    char buf[PATH_MAX_BYTES];
-    size_t cwd_size = sizeof(buf);
-    if (uv_cwd(buf, &cwd_size) == 0)
-      writer.json_keyvalue("cwd", buf);
-  }
+  if (!capture.cwd.empty()) writer.json_keyvalue("cwd", capture.cwd);
 
   // Report out the command line.
-  if (!per_process::cli_options->cmdline.empty()) {
+  if (!capture.cmdline.empty()) {
     writer.json_arraystart("commandLine");
-    for (const std::string& arg : per_process::cli_options->cmdline) {
+    for (const std::string& arg : capture.cmdline) {
       writer.json_element(arg);
     }
     writer.json_arrayend();
   }
 
   // Report Node.js and OS version information
-  PrintVersionInformation(&writer, exclude_network);
+  PrintVersionInformation(&writer, capture.exclude_network);
   writer.json_objectend();
 
-  if (isolate != nullptr) {
-    writer.json_objectstart("javascriptStack");
-    // Report summary JavaScript error stack backtrace
-    PrintJavaScriptErrorStack(&writer, isolate, error, trigger);
-
-    writer.json_objectend();  // the end of 'javascriptStack'
-
-    // Report V8 Heap and Garbage Collector information
-    PrintGCStatistics(&writer, isolate);
-  } else {
-    writer.json_objectstart("javascriptStack");
-    PrintEmptyJavaScriptStack(&writer);
-    writer.json_objectend();  // the end of 'javascriptStack'
-  }
+  writer.json_raw(capture.javascript);
 
   // Report native stack backtrace
-  PrintNativeStack(&writer);
+  PrintNativeStack(&writer, capture.native_frames);
 
   // Report OS and current thread resource usage
-  PrintResourceUsage(&writer);
-
-  writer.json_arraystart("libuv");
-  if (env != nullptr) {
-    uv_walk(env->event_loop(),
-            exclude_network ? WalkHandleNoNetwork : WalkHandleNetwork,
-            static_cast<void*>(&writer));
+  PrintResourceUsage(
+      &writer,
+      capture.uptime,
+      capture.has_thread_rusage ? &capture.thread_rusage : nullptr);
 
-    writer.json_start();
-    writer.json_keyvalue("type", "loop");
-    writer.json_keyvalue("is_active",
-        static_cast<bool>(uv_loop_alive(env->event_loop())));
-    writer.json_keyvalue("address",
-        ValueToHexString(reinterpret_cast<int64_t>(env->event_loop())));
-
-    // Report Event loop idle time
-    uint64_t idle_time = uv_metrics_idle_time(env->event_loop());
-    writer.json_keyvalue("loopIdleTimeSeconds", 1.0 * idle_time / 1e9);
-    writer.json_end();
-  }
-
-  writer.json_arrayend();
+  writer.json_raw(capture.libuv);
 
   writer.json_arraystart("workers");
-  if (env != nullptr) {
-    Mutex workers_mutex;
-    ConditionVariable notify;
-    std::vector<std::string> worker_infos;
-    size_t expected_results = 0;
-
-    env->ForEachWorker([&](Worker* w) {
-      expected_results += w->RequestInterrupt([&, w = w](Environment* env) {
-        std::ostringstream os;
-        std::string name =
-            "Worker thread subreport [" + std::string(w->name()) + "]";
-        GetNodeReport(env, name, trigger, Local<Value>(), os);
-
-        Mutex::ScopedLock lock(workers_mutex);
-        worker_infos.emplace_back(os.str());
-        notify.Signal(lock);
-      });
-    });
-
-    Mutex::ScopedLock lock(workers_mutex);
-    worker_infos.reserve(expected_results);
-    while (worker_infos.size() < expected_results)
-      notify.Wait(lock);
-    for (const std::string& worker_info : worker_infos)
+  if (capture.workers) {
+    WorkerSubreports* workers = capture.workers.get();
+    Mutex::ScopedLock lock(workers->mutex);
+    while (workers->reports.size() < workers->expected)
+      workers->notify.Wait(lock);
+    for (const std::string& worker_info : workers->reports)
       writer.json_element(JSONWriter::ForeignJSON { worker_info });
   }
   writer.json_arrayend();
 
   // Report operating system information
-  if (exclude_env == false) {
-    PrintEnvironmentVariables(&writer);
+  if (capture.exclude_env == false) {
+    PrintEnvironmentVariables(&writer, capture.environment_variables);
   }
   PrintSystemInformation(&writer);
 
@@ -552,14 +691,11 @@ static void PrintJavaScriptErrorStack(JSONWriter* writer,
 }
 
 // Report a native stack backtrace
-static void PrintNativeStack(JSONWriter* writer) {
+static void PrintNativeStack(JSONWriter* writer,
+                             const std::vector<void*>& frames) {
   auto sym_ctx = NativeSymbolDebuggingContext::New();
-  void* frames[256];
-  const int size = sym_ctx->GetStackTrace(frames, arraysize(frames));
   writer->json_arraystart("nativeStack");
-  int i;
-  for (i = 1; i < size; i++) {
-    void* frame = frames[i];
+  for (void* frame : frames) {
     writer->json_start();
     writer->json_keyvalue("pc",
                           ValueToHexString(reinterpret_cast<uintptr_t>(frame)));
@@ -625,12 +761,11 @@ static void PrintGCStatistics(JSONWriter* writer, Isolate* isolate) {
   writer->json_objectend();
 }
 
-static void PrintResourceUsage(JSONWriter* writer) {
-  // Get process uptime in seconds
-  uint64_t uptime =
-      (uv_hrtime() - per_process::node_start_time) / (NANOS_PER_SEC);
-  if (uptime == 0) uptime = 1;  // avoid division by zero.
-
+// The thread usage statistics are passed in because they have to be
+// obtained on the thread that the report is about.
+static void PrintResourceUsage(JSONWriter* writer,
+                               uint64_t uptime,
+                               const uv_rusage_t* thread_rusage) {
   // Process and current thread usage statistics
   uv_rusage_t rusage;
   writer->json_objectstart("resourceUsage");
@@ -681,8 +816,8 @@ static void PrintResourceUsage(JSONWriter* writer) {
   }
   writer->json_objectend();
 
-  uv_rusage_t stats;
-  if (uv_getrusage_thread(&stats) == 0) {
+  if (thread_rusage != nullptr) {
+    const uv_rusage_t& stats = *thread_rusage;
     writer->json_objectstart("uvthreadResourceUsage");
     double user_cpu =
         stats.ru_utime.tv_sec + SEC_PER_MICROS * stats.ru_utime.tv_usec;
@@ -705,25 +840,32 @@ static void PrintResourceUsage(JSONWriter* writer) {
   }
 }
 
-static void PrintEnvironmentVariables(JSONWriter* writer) {
+static void CaptureEnvironmentVariables(
+    std::vector<std::pair<std::string, std::string>>* variables) {
   uv_env_item_t* envitems;
   int envcount;
   int r;
 
-  writer->json_objectstart("environmentVariables");
-
   {
     Mutex::ScopedLock lock(per_process::env_var_mutex);
     r = uv_os_environ(&envitems, &envcount);
   }
 
   if (r == 0) {
+    variables->reserve(envcount);
     for (int i = 0; i < envcount; i++)
-      writer->json_keyvalue(envitems[i].name, envitems[i].value);
+      variables->emplace_back(envitems[i].name, envitems[i].value);
 
     uv_os_free_environ(envitems, envcount);
   }
+}
 
+static void PrintEnvironmentVariables(
+    JSONWriter* writer,
+    const std::vector<std::pair<std::string, std::string>>& variables) {
+  writer->json_objectstart("environmentVariables");
+  for (const auto& [name, value] : variables)
+    writer->json_keyvalue(name, value);
   writer->json_objectend();
 }
 
@@ -820,25 +962,20 @@ static void PrintRelease(JSONWriter* writer) {
   writer->json_objectend();
 }
 
-}  // namespace report
-
-std::string TriggerNodeReport(Isolate* isolate,
-                              Environment* env,
-                              std::string_view message,
-                              std::string_view trigger,
-                              std::string_view name,
-                              Local<Value> error) {
-  std::string filename;
-
-  // Determine the required report filename. In order of priority:
-  //   1) supplied on API 2) configured on startup 3) default generated
+// Determine the required report filename. In order of priority:
+//   1) supplied on API 2) configured on startup 3) default generated
+// Returns false if an exception was thrown because writing the report is
+// not permitted.
+static bool ResolveReportFilename(Environment* env,
+                                  std::string_view name,
+                                  std::string* filename) {
   if (!name.empty()) {
-    filename = name;
+    *filename = name;
     // we may not always be in a great state when generating a node report
     // allow for the case where we don't have an env
     if (env != nullptr) {
       THROW_IF_INSUFFICIENT_PERMISSIONS(
-          env, permission::PermissionScope::kFileSystemWrite, name, filename);
+          env, permission::PermissionScope::kFileSystemWrite, name, false);
       // Filename was specified as API parameter.
     }
   } else {
@@ -849,9 +986,9 @@ std::string TriggerNodeReport(Isolate* isolate,
     }
     if (report_filename.length() > 0) {
       // File name was supplied via start-up option.
-      filename = report_filename;
+      *filename = report_filename;
     } else {
-      filename = *DiagnosticFilename(
+      *filename = *DiagnosticFilename(
           env != nullptr ? env->thread_id() : 0, "report", "json");
     }
     if (env != nullptr) {
@@ -859,9 +996,129 @@ std::string TriggerNodeReport(Isolate* isolate,
           env,
           permission::PermissionScope::kFileSystemWrite,
           Environment::GetCwd(env->exec_path()),
-          filename);
+          false);
     }
   }
+  return true;
+}
+
+static std::string ReportPathname(const std::string& report_directory,
+                                  const std::string& filename) {
+  if (report_directory.empty()) return filename;
+  return report_directory + kPathSeparator + filename;
+}
+
+// Renders and writes a report on the thread pool, once the parts that are
+// bound to the reporting thread have been captured.
+class ReportWriteJob final : public AsyncWrap, public ThreadPoolWork {
+ public:
+  ReportWriteJob(Environment* env,
+                 Local<Object> object,
+                 std::string&& pathname)
+      : AsyncWrap(env, object, AsyncWrap::PROVIDER_REPORTWRITE),
+        ThreadPoolWork(env, "report"),
+        pathname_(std::move(pathname)) {}
+
+  ReportCapture* capture() { return &capture_; }
+
+  void DoThreadPoolWork() override {
+    std::ostringstream out;
+    RenderReport(capture_, out);
+    std::string report = out.str();
+
+    if (capture_.filename == "stdout") {
+      std::cout << report << std::flush;
+      return;
+    }
+    if (capture_.filename == "stderr") {
+      std::cerr << report << std::flush;
+      return;
+    }
+
+    uv_buf_t buf = uv_buf_init(report.data(), report.size());
+    status_ = WriteFileSync(pathname_.c_str(), buf);
+    if (status_ != 0) {
+      std::cerr << "\nFailed to write Node.js report file: " << pathname_
+                << " (" << uv_strerror(status_) << ")" << std::endl;
+      return;
+    }
+    std::cerr << "\nWrote Node.js report to file: " << capture_.filename
+              << std::endl;
+  }
+
+  void AfterThreadPoolWork(int status) override {
+    std::unique_ptr<ReportWriteJob> ptr(this);
+    // The report is lost if the environment is torn down in the meantime.
+    if (status == UV_ECANCELED) return;
+    CHECK_EQ(status, 0);
+
+    Environment* env = AsyncWrap::env();
+    Isolate* isolate = env->isolate();
+    HandleScope handle_scope(isolate);
+    Context::Scope context_scope(env->context());
+
+    Local<Value> argv[] = {Integer::New(isolate, status_),
+                           Undefined(isolate)};
+    if (status_ == 0 &&
+        !ToV8Value(env->context(), capture_.filename, isolate)
+             .ToLocal(&argv[1])) {
+      return;
+    }
+    MakeCallback(env->oncomplete_string(), arraysize(argv), argv);
+  }
+
+  SET_NO_MEMORY_INFO()
+  SET_MEMORY_INFO_NAME(ReportWriteJob)
+  SET_SELF_SIZE(ReportWriteJob)
+
+ private:
+  ReportCapture capture_;
+  std::string pathname_;
+  int status_ = 0;
+};
+
+void TriggerNodeReportAsync(Environment* env,
+                            Local<Object> req,
+                            std::string_view message,
+                            std::string_view trigger,
+                            std::string_view name,
+                            Local<Value> error) {
+  std::string filename;
+  if (!ResolveReportFilename(env, name, &filename)) return;
+
+  std::string report_directory;
+  bool compact;
+  {
+    Mutex::ScopedLock lock(per_process::cli_options_mutex);
+    report_directory = per_process::cli_options->report_directory;
+    compact = per_process::cli_options->report_compact;
+  }
+  std::string pathname = ReportPathname(report_directory, filename);
+
+  auto job = std::make_unique<ReportWriteJob>(env, req, std::move(pathname));
+  ReportCapture* capture = job->capture();
+  capture->message = message;
+  capture->trigger = trigger;
+  capture->filename = std::move(filename);
+  capture->compact = compact;
+  capture->exclude_network = env->options()->report_exclude_network;
+  capture->exclude_env = env->report_exclude_env();
+  CaptureReport(env->isolate(), env, error, capture);
+
+  job->ScheduleWork();
+  job.release();
+}
+
+}  // namespace report
+
+std::string TriggerNodeReport(Isolate* isolate,
+                              Environment* env,
+                              std::string_view message,
+                              std::string_view trigger,
+                              std::string_view name,
+                              Local<Value> error) {
+  std::string filename;
+  if (!report::ResolveReportFilename(env, name, &filename)) return filename;
 
   // Open the report file stream for writing. Supports stdout/err,
   // user-specified or (default) generated name
@@ -878,12 +1135,8 @@ std::string TriggerNodeReport(Isolate* isolate,
       report_directory = per_process::cli_options->report_directory;
     }
     // Regular file. Append filename to directory path if one was specified
-    if (report_directory.length() > 0) {
-      std::string pathname = report_directory + kPathSeparator + filename;
-      outfile.open(pathname, std::ios::out | std::ios::binary);
-    } else {
-      outfile.open(filename, std::ios::out | std::ios::binary);
-    }
+    outfile.open(report::ReportPathname(report_directory, filename),
+                 std::ios::out | std::ios::binary);
     // Check for errors on the file open
     if (!outfile.is_open()) {
       std::cerr << "\nFailed to open Node.js report file: " << filename;
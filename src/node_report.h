@@ -31,9 +31,21 @@ std::string ValueToHexString(T value) {
   return hex.str();
 }
 
+// Writes a report like TriggerNodeReport() does, but only the parts that are
+// bound to the current thread are collected synchronously. The rest of the
+// report is generated and written on the thread pool, after which
+// req.oncomplete(status, filename) is called.
+void TriggerNodeReportAsync(Environment* env,
+                            v8::Local<v8::Object> req,
+                            std::string_view message,
+                            std::string_view trigger,
+                            std::string_view name,
+                            v8::Local<v8::Value> error);
+
 // Function declarations - export functions in src/node_report_module.cc
 void WriteReport(const v8::FunctionCallbackInfo<v8::Value>& info);
 void GetReport(const v8::FunctionCallbackInfo<v8::Value>& info);
+void WriteReportAsync(const v8::FunctionCallbackInfo<v8::Value>& info);
 
 }  // namespace report
 }  // namespace node
@@ -1,3 +1,4 @@
+#include "async_wrap-inl.h"
 #include "env.h"
 #include "node_errors.h"
 #include "node_external_reference.h"
@@ -19,6 +20,7 @@ namespace node {
 namespace report {
 using v8::Context;
 using v8::FunctionCallbackInfo;
+using v8::FunctionTemplate;
 using v8::HandleScope;
 using v8::Isolate;
 using v8::Local;
@@ -52,6 +54,30 @@ void WriteReport(const FunctionCallbackInfo<Value>& info) {
   }
 }
 
+// Like WriteReport(), but the report is generated and written on the thread
+// pool. req is a ReportWriteWrap whose oncomplete(status, filename) is called
+// once the file has been written.
+void WriteReportAsync(const FunctionCallbackInfo<Value>& info) {
+  Environment* env = Environment::GetCurrent(info);
+  Isolate* isolate = env->isolate();
+  HandleScope scope(isolate);
+  std::string filename;
+
+  CHECK_EQ(info.Length(), 5);
+  CHECK(info[0]->IsObject());
+  Utf8Value message(isolate, info[1].As<String>());
+  Utf8Value trigger(isolate, info[2].As<String>());
+
+  if (info[3]->IsString()) filename = Utf8Value(isolate, info[3]).ToString();
+
+  TriggerNodeReportAsync(env,
+                         info[0].As<Object>(),
+                         message.ToStringView(),
+                         trigger.ToStringView(),
+                         filename,
+                         info[4]);
+}
+
 // External JavaScript API for returning a report
 void GetReport(const FunctionCallbackInfo<Value>& info) {
   Environment* env = Environment::GetCurrent(info);
@@ -201,6 +227,7 @@ static void Initialize(Local<Object> exports,
                        void* priv) {
   SetMethod(context, exports, "writeReport", WriteReport);
   SetMethod(context, exports, "getReport", GetReport);
+  SetMethod(context, exports, "writeReportAsync", WriteReportAsync);
   SetMethod(context, exports, "getCompact", GetCompact);
   SetMethod(context, exports, "setCompact", SetCompact);
   SetMethod(context, exports, "getExcludeNetwork", GetExcludeNetwork);
@@ -226,11 +253,18 @@ static void Initialize(Local<Object> exports,
             exports,
             "setReportOnUncaughtException",
             SetReportOnUncaughtException);
+
+  Environment* env = Environment::GetCurrent(context);
+  Local<FunctionTemplate> rww =
+      BaseObject::MakeLazilyInitializedJSTemplate(env);
+  rww->Inherit(AsyncWrap::GetConstructorTemplate(env));
+  SetConstructorFunction(context, exports, "ReportWriteWrap", rww);
 }
 
 void RegisterExternalReferences(ExternalReferenceRegistry* registry) {
   registry->Register(WriteReport);
   registry->Register(GetReport);
+  registry->Register(WriteReportAsync);
   registry->Register(GetCompact);
   registry->Register(SetCompact);
   registry->Register(GetExcludeNetwork);
@@ -0,0 +1,455 @@
+#include "node_sampling_profiler.h"
+#include "debug_utils-inl.h"
+#include "diagnosticfilename-inl.h"
+#include "env-inl.h"
+#include "node_internals.h"
+#include "util-inl.h"
+
+#include "zlib.h"
+
+#include <chrono>
+
+namespace node {
+namespace profiler {
+
+using v8::CpuProfile;
+using v8::CpuProfileNode;
+using v8::CpuProfilingMode;
+using v8::CpuProfilingOptions;
+using v8::CpuProfilingResult;
+using v8::CpuProfilingStatus;
+using v8::HandleScope;
+
+namespace {
+
+// Field numbers of perftools.profiles.Profile, see
+// https://github.com/google/pprof/blob/main/proto/profile.proto.
+namespace field {
+// Profile
+constexpr uint32_t kSampleType = 1;
+constexpr uint32_t kSample = 2;
+constexpr uint32_t kLocation = 4;
+constexpr uint32_t kFunction = 5;
+constexpr uint32_t kStringTable = 6;
+constexpr uint32_t kTimeNanos = 9;
+constexpr uint32_t kDurationNanos = 10;
+constexpr uint32_t kPeriodType = 11;
+constexpr uint32_t kPeriod = 12;
+// ValueType
+constexpr uint32_t kType = 1;
+constexpr uint32_t kUnit = 2;
+// Sample
+constexpr uint32_t kLocationId = 1;
+constexpr uint32_t kValue = 2;
+// Location
+constexpr uint32_t kId = 1;
+constexpr uint32_t kLine = 4;
+// Line
+constexpr uint32_t kFunctionId = 1;
+constexpr uint32_t kLineNumber = 2;
+// Function
+constexpr uint32_t kName = 2;
+constexpr uint32_t kSystemName = 3;
+constexpr uint32_t kFilename = 4;
+constexpr uint32_t kStartLine = 5;
+}  // namespace field
+
+void AppendVarInt(std::string* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendVarIntField(std::string* out, uint32_t field, uint64_t value) {
+  AppendVarInt(out, static_cast<uint64_t>(field) << 3);
+  AppendVarInt(out, value);
+}
+
+void AppendBytesField(std::string* out,
+                      uint32_t field,
+                      const std::string& value) {
+  AppendVarInt(out, (static_cast<uint64_t>(field) << 3) | 2);
+  AppendVarInt(out, value.size());
+  out->append(value);
+}
+
+class StringTable {
+ public:
+  StringTable() { Intern(""); }
+
+  uint64_t Intern(const std::string& str) {
+    auto it = ids_.emplace(str, strings_.size());
+    if (it.second) strings_.push_back(str);
+    return it.first->second;
+  }
+
+  void AppendTo(std::string* out) const {
+    for (const std::string& str : strings_)
+      AppendBytesField(out, field::kStringTable, str);
+  }
+
+ private:
+  std::vector<std::string> strings_;
+  std::unordered_map<std::string, uint64_t> ids_;
+};
+
+std::string ValueType(StringTable* strings,
+                      const char* type,
+                      const char* unit) {
+  std::string value_type;
+  AppendVarIntField(&value_type, field::kType, strings->Intern(type));
+  AppendVarIntField(&value_type, field::kUnit, strings->Intern(unit));
+  return value_type;
+}
+
+bool Gzip(const std::string& input, std::string* output) {
+  z_stream stream = {};
+  // 16 selects the gzip wrapper, which is what pprof tools expect.
+  if (deflateInit2(&stream,
+                   Z_DEFAULT_COMPRESSION,
+                   Z_DEFLATED,
+                   15 + 16,
+                   8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  output->resize(deflateBound(&stream, input.size()));
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef*>(output->data());
+  stream.avail_out = output->size();
+  int err = deflate(&stream, Z_FINISH);
+  output->resize(stream.total_out);
+  deflateEnd(&stream);
+  return err == Z_STREAM_END;
+}
+
+uint64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string StackKey(const std::vector<uint32_t>& frames) {
+  return std::string(reinterpret_cast<const char*>(frames.data()),
+                     frames.size() * sizeof(frames[0]));
+}
+
+}  // namespace
+
+SamplingCpuProfiler::SamplingCpuProfiler(Environment* env,
+                                         uint32_t window_seconds)
+    : env_(env),
+      cpu_profiler_(v8::CpuProfiler::New(env->isolate())),
+      buckets_(window_seconds > 0 ? window_seconds : 1) {
+  buckets_[0].start_time_ns = NowNs();
+  AddFrame(Frame{"(truncated)", "", 0, 0});
+  AddStack({0});
+}
+
+SamplingCpuProfiler::~SamplingCpuProfiler() {
+  if (profile_id_ != 0) {
+    CpuProfile* profile = cpu_profiler_->Stop(profile_id_);
+    if (profile != nullptr) profile->Delete();
+  }
+  cpu_profiler_->Dispose();
+}
+
+bool SamplingCpuProfiler::Start(Environment* env,
+                                uint32_t window_seconds,
+                                int signal) {
+  if (env->sampling_cpu_profiler() != nullptr) return false;
+  SamplingCpuProfiler* profiler =
+      new SamplingCpuProfiler(env, window_seconds);
+  if (!profiler->StartProfile()) {
+    delete profiler;
+    return false;
+  }
+
+  if (signal != 0) {
+    CHECK_EQ(uv_signal_init(env->event_loop(), &profiler->signal_), 0);
+    profiler->signal_.data = profiler;
+    int err = uv_signal_start(
+        &profiler->signal_,
+        [](uv_signal_t* handle, int signum) {
+          SamplingCpuProfiler* profiler =
+              static_cast<SamplingCpuProfiler*>(handle->data);
+          std::string filename = profiler->WriteToDiagnosticFile();
+          if (!filename.empty()) {
+            FPrintF(stderr, "Wrote CPU profile to %s\n", filename);
+          }
+        },
+        signal);
+    if (err != 0) {
+      // E.g. an invalid signal number, or one that can't be caught. The
+      // profiler can only be deleted once its handle is closed.
+      env->CloseHandle(&profiler->signal_, [](uv_signal_t* handle) {
+        delete static_cast<SamplingCpuProfiler*>(handle->data);
+      });
+      return false;
+    }
+    uv_unref(reinterpret_cast<uv_handle_t*>(&profiler->signal_));
+    profiler->has_signal_ = true;
+  }
+
+  CHECK_EQ(uv_timer_init(env->event_loop(), &profiler->timer_), 0);
+  profiler->timer_.data = profiler;
+  uv_timer_start(
+      &profiler->timer_,
+      [](uv_timer_t* handle) {
+        static_cast<SamplingCpuProfiler*>(handle->data)->Rotate();
+      },
+      kBucketMs,
+      kBucketMs);
+  uv_unref(reinterpret_cast<uv_handle_t*>(&profiler->timer_));
+
+  env->set_sampling_cpu_profiler(profiler);
+  env->AddCleanupHook(CleanupHook, profiler);
+  return true;
+}
+
+void SamplingCpuProfiler::Stop(Environment* env) {
+  SamplingCpuProfiler* profiler = env->sampling_cpu_profiler();
+  if (profiler == nullptr) return;
+  env->set_sampling_cpu_profiler(nullptr);
+  env->RemoveCleanupHook(CleanupHook, profiler);
+
+  profiler->pending_handle_closes_ = profiler->has_signal_ ? 2 : 1;
+  auto on_close = [](auto* handle) {
+    SamplingCpuProfiler* profiler =
+        static_cast<SamplingCpuProfiler*>(handle->data);
+    if (--profiler->pending_handle_closes_ == 0) delete profiler;
+  };
+  env->CloseHandle(&profiler->timer_, on_close);
+  if (profiler->has_signal_) env->CloseHandle(&profiler->signal_, on_close);
+}
+
+void SamplingCpuProfiler::CleanupHook(void* data) {
+  Stop(static_cast<SamplingCpuProfiler*>(data)->env_);
+}
+
+bool SamplingCpuProfiler::StartProfile() {
+  HandleScope handle_scope(env_->isolate());
+  // A profile never needs to hold more than one window worth of samples,
+  // even if the event loop is blocked and it cannot be rotated in time.
+  unsigned max_samples = static_cast<unsigned>(
+      buckets_.size() * kBucketMs * 1000 / kSamplingIntervalUs);
+  CpuProfilingResult result = cpu_profiler_->Start(CpuProfilingOptions{
+      CpuProfilingMode::kLeafNodeLineNumbers, max_samples,
+      kSamplingIntervalUs});
+  if (result.status != CpuProfilingStatus::kStarted) return false;
+  profile_id_ = result.id;
+  return true;
+}
+
+void SamplingCpuProfiler::Flush() {
+  v8::ProfilerId previous = profile_id_;
+  // Start the next profile before stopping the current one, so that no
+  // samples are lost in between.
+  if (!StartProfile()) return;
+  CpuProfile* profile = cpu_profiler_->Stop(previous);
+  if (profile == nullptr) return;
+  Aggregate(profile);
+  profile->Delete();
+}
+
+void SamplingCpuProfiler::Rotate() {
+  Flush();
+  current_bucket_ = (current_bucket_ + 1) % buckets_.size();
+  if (filled_buckets_ < buckets_.size()) filled_buckets_++;
+  Bucket& bucket = buckets_[current_bucket_];
+  for (const auto& [stack, count] : bucket.samples)
+    stacks_[stack].live_samples -= count;
+  bucket.samples.clear();
+  bucket.start_time_ns = NowNs();
+
+  // Drop the stacks that left the window before the tables fill up.
+  if (stacks_.size() >= kMaxStacks * 3 / 4 ||
+      frames_.size() >= kMaxFrames * 3 / 4) {
+    Compact();
+  }
+}
+
+void SamplingCpuProfiler::Aggregate(const CpuProfile* profile) {
+  // Samples with the same leaf node share a stack, which only needs to be
+  // looked up once per profile.
+  std::unordered_map<const CpuProfileNode*, uint32_t> node_stacks;
+  Bucket& bucket = buckets_[current_bucket_];
+  const int count = profile->GetSamplesCount();
+  for (int i = 0; i < count; i++) {
+    const CpuProfileNode* node = profile->GetSample(i);
+    auto it = node_stacks.find(node);
+    uint32_t stack;
+    if (it != node_stacks.end()) {
+      stack = it->second;
+    } else {
+      stack = InternStack(node);
+      node_stacks.emplace(node, stack);
+    }
+    bucket.samples[stack]++;
+    stacks_[stack].live_samples++;
+  }
+}
+
+uint32_t SamplingCpuProfiler::InternStack(const CpuProfileNode* node) {
+  // Skip the synthetic (root) node.
+  size_t depth = 0;
+  for (const CpuProfileNode* n = node; n->GetParent() != nullptr;
+       n = n->GetParent()) {
+    depth++;
+  }
+  // In the worst case, every frame of the stack is new.
+  if (stacks_.size() >= kMaxStacks || frames_.size() + depth > kMaxFrames)
+    return 0;
+  std::vector<uint32_t> frames;
+  frames.reserve(depth);
+  for (; node->GetParent() != nullptr; node = node->GetParent())
+    frames.push_back(InternFrame(node));
+  auto it = stack_ids_.find(StackKey(frames));
+  if (it != stack_ids_.end()) return it->second;
+  return AddStack(std::move(frames));
+}
+
+uint32_t SamplingCpuProfiler::InternFrame(const CpuProfileNode* node) {
+  Frame frame{node->GetFunctionNameStr(),
+              node->GetScriptResourceNameStr(),
+              node->GetLineNumber(),
+              node->GetColumnNumber()};
+  return AddFrame(std::move(frame));
+}
+
+uint32_t SamplingCpuProfiler::AddStack(std::vector<uint32_t>&& frames) {
+  auto it = stack_ids_.emplace(StackKey(frames), stacks_.size());
+  if (it.second) stacks_.push_back(Stack{std::move(frames), 0});
+  return it.first->second;
+}
+
+uint32_t SamplingCpuProfiler::AddFrame(Frame&& frame) {
+  std::string key = frame.function_name + '\0' + frame.url + '\0' +
+                    std::to_string(frame.line) + ':' +
+                    std::to_string(frame.column);
+  auto it = frame_ids_.emplace(std::move(key), frames_.size());
+  if (it.second) frames_.push_back(std::move(frame));
+  return it.first->second;
+}
+
+void SamplingCpuProfiler::Compact() {
+  constexpr uint32_t kRemoved = static_cast<uint32_t>(-1);
+  std::vector<Stack> old_stacks = std::move(stacks_);
+  std::vector<Frame> old_frames = std::move(frames_);
+  stacks_.clear();
+  frames_.clear();
+  stack_ids_.clear();
+  frame_ids_.clear();
+
+  std::vector<uint32_t> stack_map(old_stacks.size(), kRemoved);
+  std::vector<uint32_t> frame_map(old_frames.size(), kRemoved);
+  for (size_t i = 0; i < old_stacks.size(); i++) {
+    Stack& stack = old_stacks[i];
+    // Keep the truncated stack even if it has no samples.
+    if (i != 0 && stack.live_samples == 0) continue;
+    for (uint32_t& frame : stack.frames) {
+      if (frame_map[frame] == kRemoved)
+        frame_map[frame] = AddFrame(std::move(old_frames[frame]));
+      frame = frame_map[frame];
+    }
+    uint32_t live_samples = stack.live_samples;
+    stack_map[i] = AddStack(std::move(stack.frames));
+    stacks_[stack_map[i]].live_samples = live_samples;
+  }
+
+  for (Bucket& bucket : buckets_) {
+    std::unordered_map<uint32_t, uint32_t> samples;
+    for (const auto& [stack, count] : bucket.samples) {
+      CHECK_NE(stack_map[stack], kRemoved);
+      samples[stack_map[stack]] += count;
+    }
+    bucket.samples = std::move(samples);
+  }
+}
+
+std::string SamplingCpuProfiler::Serialize() {
+  StringTable strings;
+  std::string profile;
+  AppendBytesField(
+      &profile, field::kSampleType, ValueType(&strings, "samples", "count"));
+  AppendBytesField(
+      &profile, field::kSampleType, ValueType(&strings, "cpu", "nanoseconds"));
+
+  constexpr uint64_t kPeriodNs = uint64_t{kSamplingIntervalUs} * 1000;
+  std::vector<bool> used_frames(frames_.size());
+  for (const Stack& stack : stacks_) {
+    if (stack.live_samples == 0) continue;
+    std::string sample;
+    std::string location_ids;
+    for (uint32_t frame : stack.frames) {
+      // Ids must be non-zero.
+      AppendVarInt(&location_ids, frame + 1);
+      used_frames[frame] = true;
+    }
+    AppendBytesField(&sample, field::kLocationId, location_ids);
+    std::string values;
+    AppendVarInt(&values, stack.live_samples);
+    AppendVarInt(&values, stack.live_samples * kPeriodNs);
+    AppendBytesField(&sample, field::kValue, values);
+    AppendBytesField(&profile, field::kSample, sample);
+  }
+
+  // There is exactly one location and one function per frame.
+  for (size_t i = 0; i < frames_.size(); i++) {
+    if (!used_frames[i]) continue;
+    const Frame& frame = frames_[i];
+    std::string line;
+    AppendVarIntField(&line, field::kFunctionId, i + 1);
+    AppendVarIntField(&line, field::kLineNumber, frame.line);
+    std::string location;
+    AppendVarIntField(&location, field::kId, i + 1);
+    AppendBytesField(&location, field::kLine, line);
+    AppendBytesField(&profile, field::kLocation, location);
+
+    const std::string& name = frame.function_name.empty()
+                                  ? std::string("(anonymous)")
+                                  : frame.function_name;
+    std::string function;
+    AppendVarIntField(&function, field::kId, i + 1);
+    AppendVarIntField(&function, field::kName, strings.Intern(name));
+    AppendVarIntField(&function, field::kSystemName, strings.Intern(name));
+    AppendVarIntField(&function, field::kFilename, strings.Intern(frame.url));
+    AppendVarIntField(&function, field::kStartLine, frame.line);
+    AppendBytesField(&profile, field::kFunction, function);
+  }
+
+  std::string period_type = ValueType(&strings, "cpu", "nanoseconds");
+  strings.AppendTo(&profile);
+  size_t oldest = (current_bucket_ + buckets_.size() + 1 - filled_buckets_) %
+                  buckets_.size();
+  uint64_t start_time_ns = buckets_[oldest].start_time_ns;
+  AppendVarIntField(&profile, field::kTimeNanos, start_time_ns);
+  AppendVarIntField(&profile, field::kDurationNanos, NowNs() - start_time_ns);
+  AppendBytesField(&profile, field::kPeriodType, period_type);
+  AppendVarIntField(&profile, field::kPeriod, kPeriodNs);
+
+  std::string compressed;
+  if (!Gzip(profile, &compressed)) return "";
+  return compressed;
+}
+
+std::string SamplingCpuProfiler::WriteToDiagnosticFile() {
+  Flush();
+  std::string profile = Serialize();
+  if (profile.empty()) return "";
+
+  std::string dir = env_->options()->diagnostic_dir;
+  if (dir.empty()) dir = Environment::GetCwd(env_->exec_path());
+  DiagnosticFilename name(env_, "CPU", "pb.gz");
+  std::string filename = dir + kPathSeparator + (*name);
+  uv_buf_t buf = uv_buf_init(profile.data(), profile.size());
+  if (WriteFileSync(filename.c_str(), buf) != 0) return "";
+  return filename;
+}
+
+}  // namespace profiler
+}  // namespace node
@@ -0,0 +1,114 @@
+#ifndef SRC_NODE_SAMPLING_PROFILER_H_
+#define SRC_NODE_SAMPLING_PROFILER_H_
+
+#if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#include "uv.h"
+#include "v8-profiler.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace node {
+
+class Environment;
+
+namespace profiler {
+
+// Always-on, low-frequency CPU profiler. It keeps the samples of the last
+// `window_seconds` seconds, aggregated per call stack in a ring of one
+// second buckets, so its memory use does not grow with the process uptime.
+// The current state can be dumped at any time in the gzipped pprof format,
+// either through the binding or, if a signal was given, when the process
+// receives that signal.
+//
+// Every second the running V8 profile is replaced by a new one and its
+// samples are folded into the current bucket. The bucket that falls out of
+// the window is subtracted again, and stacks that are no longer referenced
+// by any bucket are dropped once the stack table fills up. Should the live
+// stacks alone exceed the tables, new stacks are counted as "(truncated)".
+class SamplingCpuProfiler final {
+ public:
+  static constexpr int kSamplingIntervalUs = 10000;  // 100 Hz
+  static constexpr uint64_t kBucketMs = 1000;
+  static constexpr uint32_t kDefaultWindowSeconds = 60;
+  static constexpr size_t kMaxStacks = 16384;
+  static constexpr size_t kMaxFrames = 65536;
+
+  // Returns false if the profiler is already running in env, V8 refused
+  // to start another profile or the signal can't be watched. signal may be
+  // 0.
+  static bool Start(Environment* env, uint32_t window_seconds, int signal);
+  static void Stop(Environment* env);
+
+  // Folds the samples taken so far into the current bucket, so that they
+  // are included in the next Serialize() call.
+  void Flush();
+  // Returns the samples in the window as a gzipped pprof profile.proto, or
+  // an empty string if compression failed.
+  std::string Serialize();
+  // Writes Serialize() to a file in the diagnostic directory and returns
+  // its path, or an empty string on failure.
+  std::string WriteToDiagnosticFile();
+
+  size_t stack_count() const { return stacks_.size(); }
+
+ private:
+  struct Frame {
+    std::string function_name;
+    std::string url;
+    int line;
+    int column;
+  };
+
+  struct Stack {
+    std::vector<uint32_t> frames;  // Leaf first.
+    uint32_t live_samples = 0;
+  };
+
+  struct Bucket {
+    std::unordered_map<uint32_t, uint32_t> samples;  // Stack id -> count.
+    uint64_t start_time_ns = 0;
+  };
+
+  SamplingCpuProfiler(Environment* env, uint32_t window_seconds);
+  ~SamplingCpuProfiler();
+
+  bool StartProfile();
+  void Rotate();
+  void Aggregate(const v8::CpuProfile* profile);
+  uint32_t InternStack(const v8::CpuProfileNode* node);
+  uint32_t InternFrame(const v8::CpuProfileNode* node);
+  uint32_t AddStack(std::vector<uint32_t>&& frames);
+  uint32_t AddFrame(Frame&& frame);
+  void Compact();
+
+  static void CleanupHook(void* data);
+
+  Environment* env_;
+  v8::CpuProfiler* cpu_profiler_;
+  v8::ProfilerId profile_id_ = 0;
+  uv_timer_t timer_;
+  uv_signal_t signal_;
+  bool has_signal_ = false;
+  int pending_handle_closes_ = 0;
+
+  std::vector<Bucket> buckets_;
+  size_t current_bucket_ = 0;
+  size_t filled_buckets_ = 1;
+
+  // Stack 0 consists of a single "(truncated)" frame 0. Samples whose stack
+  // does not fit into the tables anymore are attributed to it.
+  std::vector<Stack> stacks_;
+  std::unordered_map<std::string, uint32_t> stack_ids_;
+  std::vector<Frame> frames_;
+  std::unordered_map<std::string, uint32_t> frame_ids_;
+};
+
+}  // namespace profiler
+}  // namespace node
+
+#endif  // defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
+
+#endif  // SRC_NODE_SAMPLING_PROFILER_H_
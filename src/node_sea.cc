@@ -7,12 +7,14 @@
 #include "node_errors.h"
 #include "node_external_reference.h"
 #include "node_internals.h"
+#include "node_mutex.h"
 #include "node_options.h"
 #include "node_snapshot_builder.h"
 #include "node_union_bytes.h"
 #include "node_v8_platform-inl.h"
 #include "simdjson.h"
 #include "util-inl.h"
+#include "zstd.h"
 
 // The POSTJECT_SENTINEL_FUSE macro is a string of random characters selected by
 // the Node.js project that is present only once in the entire binary. It is
@@ -23,6 +25,8 @@
 #include "postject-api.h"
 #undef POSTJECT_SENTINEL_FUSE
 
+#include <cstring>
+#include <map>
 #include <memory>
 #include <string_view>
 #include <tuple>
@@ -121,14 +125,12 @@ size_t SeaSerializer::Write(const SeaResource& sea) {
   if (!sea.assets.empty()) {
     Debug("Write SEA resource assets size %zu\n", sea.assets.size());
     written_total += WriteArithmetic<size_t>(sea.assets.size());
-    for (auto const& [key, content] : sea.assets) {
-      Debug("Write SEA resource asset %s at %p, size=%zu\n",
-            key,
-            content.data(),
-            content.size());
-      written_total += WriteStringView(key, StringLogMode::kAddressAndContent);
-      written_total += WriteStringView(content, StringLogMode::kAddressOnly);
-    }
+    written_total +=
+        WriteStringView(sea.assets.index(), StringLogMode::kAddressOnly);
+    written_total +=
+        WriteStringView(sea.assets.keys(), StringLogMode::kAddressOnly);
+    written_total +=
+        WriteStringView(sea.assets.contents(), StringLogMode::kAddressOnly);
   }
 
   if (static_cast<bool>(sea.flags & SeaFlags::kIncludeExecArgv)) {
@@ -195,19 +197,14 @@ SeaResource SeaDeserializer::Read() {
           code_cache.size());
   }
 
-  std::unordered_map<std::string_view, std::string_view> assets;
+  SeaAssetTable assets;
   if (static_cast<bool>(flags & SeaFlags::kIncludeAssets)) {
     size_t assets_size = ReadArithmetic<size_t>();
     Debug("Read SEA resource assets size %zu\n", assets_size);
-    for (size_t i = 0; i < assets_size; ++i) {
-      std::string_view key = ReadStringView(StringLogMode::kAddressAndContent);
-      std::string_view content = ReadStringView(StringLogMode::kAddressOnly);
-      Debug("Read SEA resource asset %s at %p, size=%zu\n",
-            key,
-            content.data(),
-            content.size());
-      assets.emplace(key, content);
-    }
+    std::string_view index = ReadStringView(StringLogMode::kAddressOnly);
+    std::string_view keys = ReadStringView(StringLogMode::kAddressOnly);
+    std::string_view contents = ReadStringView(StringLogMode::kAddressOnly);
+    assets = SeaAssetTable(assets_size, index, keys, contents);
   }
 
   std::vector<std::string_view> exec_argv;
@@ -260,8 +257,151 @@ std::string_view FindSingleExecutableBlob() {
 #endif  // !defined(DISABLE_SINGLE_EXECUTABLE_APPLICATION)
 }
 
+// Decompressed assets, keyed by the address of their compressed content. Like
+// the blob itself they are never freed, so that the ArrayBuffers handed out
+// for them stay valid.
+std::string_view DecompressAsset(std::string_view content, size_t size) {
+  static Mutex mutex;
+  static auto* cache = new std::unordered_map<const char*, std::string>();
+  Mutex::ScopedLock lock(mutex);
+  auto it = cache->find(content.data());
+  if (it != cache->end()) {
+    return it->second;
+  }
+
+  std::string result(size, '\0');
+  size_t r =
+      ZSTD_decompress(result.data(), size, content.data(), content.size());
+  CHECK(!ZSTD_isError(r));
+  CHECK_EQ(r, size);
+  per_process::Debug(DebugCategory::SEA,
+                     "Decompressed SEA asset at %p, size=%zu\n",
+                     content.data(),
+                     size);
+  return cache->emplace(content.data(), std::move(result)).first->second;
+}
+
 }  // anonymous namespace
 
+SeaAssetTable::SeaAssetTable(size_t count,
+                             std::string_view index,
+                             std::string_view keys,
+                             std::string_view contents)
+    : count_(count), index_(index), keys_(keys), contents_(contents) {
+  CHECK_EQ(index.size(), count * kEntrySize);
+}
+
+SeaAssetTable SeaAssetTable::Build(
+    const std::map<std::string, std::string>& assets,
+    bool compress,
+    std::string* storage) {
+  // Decompression speed hardly depends on the level, this only trades build
+  // time for size.
+  static constexpr int kCompressionLevel = 12;
+
+  std::string index;
+  index.reserve(assets.size() * kEntrySize);
+  std::string keys;
+  std::string contents;
+  std::string compressed;
+  for (const auto& [key, content] : assets) {
+    Entry entry{keys.size(),
+                key.size(),
+                contents.size(),
+                content.size(),
+                content.size(),
+                Compression::kNone};
+    keys += key;
+
+    if (compress && !content.empty()) {
+      compressed.resize(ZSTD_compressBound(content.size()));
+      size_t r = ZSTD_compress(compressed.data(),
+                               compressed.size(),
+                               content.data(),
+                               content.size(),
+                               kCompressionLevel);
+      if (!ZSTD_isError(r) && r < content.size()) {
+        entry.content_size = r;
+        entry.compression = Compression::kZstd;
+      }
+    }
+    if (entry.compression == Compression::kZstd) {
+      contents.append(compressed.data(), entry.content_size);
+    } else {
+      contents += content;
+    }
+    WriteEntry(entry, &index);
+  }
+
+  size_t index_size = index.size();
+  storage->clear();
+  storage->reserve(index_size + keys.size() + contents.size());
+  storage->append(index);
+  storage->append(keys);
+  storage->append(contents);
+  std::string_view view = *storage;
+  return SeaAssetTable(assets.size(),
+                       view.substr(0, index_size),
+                       view.substr(index_size, keys.size()),
+                       view.substr(index_size + keys.size()));
+}
+
+void SeaAssetTable::WriteEntry(const Entry& entry, std::string* index) {
+  const uint64_t fields[kEntryFields] = {
+      entry.key_offset,
+      entry.key_size,
+      entry.content_offset,
+      entry.content_size,
+      entry.size,
+      static_cast<uint64_t>(entry.compression),
+  };
+  for (uint64_t field : fields) {
+    index->append(reinterpret_cast<const char*>(&field), sizeof(field));
+  }
+}
+
+SeaAssetTable::Entry SeaAssetTable::entry(size_t i) const {
+  DCHECK_LT(i, count_);
+  // The index is not necessarily aligned inside the blob.
+  uint64_t fields[kEntryFields];
+  memcpy(fields, index_.data() + i * kEntrySize, kEntrySize);
+  return Entry{fields[0],
+               fields[1],
+               fields[2],
+               fields[3],
+               fields[4],
+               static_cast<Compression>(fields[5])};
+}
+
+std::string_view SeaAssetTable::key(size_t i) const {
+  Entry e = entry(i);
+  return keys_.substr(e.key_offset, e.key_size);
+}
+
+std::optional<std::string_view> SeaAssetTable::Get(std::string_view key) const {
+  size_t low = 0;
+  size_t high = count_;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (this->key(mid) < key) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  if (low == count_ || this->key(low) != key) {
+    return std::nullopt;
+  }
+
+  Entry e = entry(low);
+  std::string_view content = contents_.substr(e.content_offset, e.content_size);
+  if (e.compression == Compression::kNone) {
+    return content;
+  }
+  CHECK(e.compression == Compression::kZstd);
+  return DecompressAsset(content, e.size);
+}
+
 bool SeaResource::use_snapshot() const {
   return static_cast<bool>(flags & SeaFlags::kUseSnapshot);
 }
@@ -381,6 +521,7 @@ struct SeaConfig {
   SeaFlags flags = SeaFlags::kDefault;
   SeaExecArgvExtension exec_argv_extension = SeaExecArgvExtension::kEnv;
   std::unordered_map<std::string, std::string> assets;
+  bool compress_assets = false;
   std::vector<std::string> exec_argv;
 };
 
@@ -500,6 +641,13 @@ std::optional<SeaConfig> ParseSingleExecutableConfig(
       if (!result.assets.empty()) {
         result.flags |= SeaFlags::kIncludeAssets;
       }
+    } else if (key == "compressAssets") {
+      if (field.value().get_bool().get(result.compress_assets)) {
+        FPrintF(stderr,
+                "\"compressAssets\" field of %s is not a Boolean\n",
+                config_path);
+        return std::nullopt;
+      }
     } else if (key == "execArgv") {
       simdjson::ondemand::array exec_argv_array;
       if (field.value().get_array().get(exec_argv_array)) {
@@ -675,7 +823,7 @@ std::optional<std::string> GenerateCodeCache(std::string_view main_path,
 }
 
 int BuildAssets(const std::unordered_map<std::string, std::string>& config,
-                std::unordered_map<std::string, std::string>* assets) {
+                std::map<std::string, std::string>* assets) {
   for (auto const& [key, path] : config) {
     std::string blob;
     int r = ReadFileSync(&blob, path.c_str());
@@ -729,14 +877,13 @@ ExitCode GenerateSingleExecutableBlob(
     optional_sv_code_cache = code_cache;
   }
 
-  std::unordered_map<std::string, std::string> assets;
+  std::map<std::string, std::string> assets;
   if (!config.assets.empty() && BuildAssets(config.assets, &assets) != 0) {
     return ExitCode::kGenericUserError;
   }
-  std::unordered_map<std::string_view, std::string_view> assets_view;
-  for (auto const& [key, content] : assets) {
-    assets_view.emplace(key, content);
-  }
+  std::string assets_storage;
+  SeaAssetTable asset_table =
+      SeaAssetTable::Build(assets, config.compress_assets, &assets_storage);
   std::vector<std::string_view> exec_argv_view;
   for (const auto& arg : config.exec_argv) {
     exec_argv_view.emplace_back(arg);
@@ -749,7 +896,7 @@ ExitCode GenerateSingleExecutableBlob(
           ? std::string_view{snapshot_blob.data(), snapshot_blob.size()}
           : std::string_view{main_script.data(), main_script.size()},
       optional_sv_code_cache,
-      assets_view,
+      asset_table,
       exec_argv_view};
 
   SeaSerializer serializer;
@@ -790,18 +937,16 @@ void GetAsset(const FunctionCallbackInfo<Value>& args) {
   CHECK(args[0]->IsString());
   Utf8Value key(args.GetIsolate(), args[0]);
   SeaResource sea_resource = FindSingleExecutableResource();
-  if (sea_resource.assets.empty()) {
-    return;
-  }
-  auto it = sea_resource.assets.find(*key);
-  if (it == sea_resource.assets.end()) {
+  std::optional<std::string_view> content =
+      sea_resource.assets.Get(key.ToStringView());
+  if (!content.has_value()) {
     return;
   }
   // We cast away the constness here, the JS land should ensure that
   // the data is not mutated.
   std::unique_ptr<v8::BackingStore> store = ArrayBuffer::NewBackingStore(
-      const_cast<char*>(it->second.data()),
-      it->second.size(),
+      const_cast<char*>(content->data()),
+      content->size(),
       [](void*, size_t, void*) {},
       nullptr);
   Local<ArrayBuffer> ab = ArrayBuffer::New(args.GetIsolate(), std::move(store));
@@ -816,9 +961,9 @@ void GetAssetKeys(const FunctionCallbackInfo<Value>& args) {
   Local<Context> context = isolate->GetCurrentContext();
   LocalVector<Value> keys(isolate);
   keys.reserve(sea_resource.assets.size());
-  for (const auto& [key, _] : sea_resource.assets) {
+  for (size_t i = 0; i < sea_resource.assets.size(); ++i) {
     Local<Value> key_str;
-    if (!ToV8Value(context, key).ToLocal(&key_str)) {
+    if (!ToV8Value(context, sea_resource.assets.key(i)).ToLocal(&key_str)) {
       return;
     }
     keys.push_back(key_str);
@@ -4,6 +4,7 @@
 #if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
 
 #include <cinttypes>
+#include <map>
 #include <optional>
 #include <string>
 #include <string_view>
@@ -37,13 +38,73 @@ enum class SeaExecArgvExtension : uint8_t {
   kCli = 2,
 };
 
+// The assets embedded in a single executable application. The table is a
+// view into the blob: an index of fixed-size entries sorted by key, followed
+// by the keys and the contents it points into. Nothing is parsed at startup,
+// lookups are a binary search over the index. Contents may be compressed
+// with zstd, in which case they are decompressed on first access and kept
+// for the lifetime of the process.
+class SeaAssetTable {
+ public:
+  enum class Compression : uint64_t {
+    kNone = 0,
+    kZstd = 1,
+  };
+
+  // Offsets are relative to the beginning of the keys and the contents.
+  struct Entry {
+    uint64_t key_offset;
+    uint64_t key_size;
+    uint64_t content_offset;
+    uint64_t content_size;
+    uint64_t size;  // Uncompressed size.
+    Compression compression;
+  };
+  // Entries are written field by field as uint64_t in the byte order of the
+  // host, like the rest of the blob, independently of the layout of Entry.
+  static constexpr size_t kEntryFields = 6;
+  static constexpr size_t kEntrySize = kEntryFields * sizeof(uint64_t);
+
+  SeaAssetTable() = default;
+  SeaAssetTable(size_t count,
+                std::string_view index,
+                std::string_view keys,
+                std::string_view contents);
+
+  // Lays out assets in *storage and returns a table that refers to it.
+  // Assets are compressed if compress is true and that makes them smaller.
+  static SeaAssetTable Build(const std::map<std::string, std::string>& assets,
+                             bool compress,
+                             std::string* storage);
+
+  size_t size() const { return count_; }
+  bool empty() const { return count_ == 0; }
+  std::string_view key(size_t i) const;
+  // Returns the uncompressed content of the asset, or std::nullopt if there
+  // is no asset with that key.
+  std::optional<std::string_view> Get(std::string_view key) const;
+
+  std::string_view index() const { return index_; }
+  std::string_view keys() const { return keys_; }
+  std::string_view contents() const { return contents_; }
+
+ private:
+  static void WriteEntry(const Entry& entry, std::string* index);
+  Entry entry(size_t i) const;
+
+  size_t count_ = 0;
+  std::string_view index_;
+  std::string_view keys_;
+  std::string_view contents_;
+};
+
 struct SeaResource {
   SeaFlags flags = SeaFlags::kDefault;
   SeaExecArgvExtension exec_argv_extension = SeaExecArgvExtension::kEnv;
   std::string_view code_path;
   std::string_view main_code_or_snapshot;
   std::optional<std::string_view> code_cache;
-  std::unordered_map<std::string_view, std::string_view> assets;
+  SeaAssetTable assets;
   std::vector<std::string_view> exec_argv;
 
   bool use_snapshot() const;
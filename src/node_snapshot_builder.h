@@ -7,14 +7,22 @@
 #include <cstdint>
 #include <optional>
 #include <string_view>
+#include <vector>
 #include "node_exit_code.h"
 #include "node_mutex.h"
 #include "v8.h"
 
+// Forward declare test fixtures for `friend` declaration.
+class BuiltinCodeCacheTest;
+class SnapshotRebuildTest;
+
 namespace node {
 
 class ExternalReferenceRegistry;
 struct SnapshotData;
+namespace builtins {
+struct CodeCacheInfo;
+}  // namespace builtins
 
 std::optional<SnapshotConfig> ReadSnapshotConfig(const char* path);
 
@@ -47,8 +55,46 @@ class NODE_EXTERN_PRIVATE SnapshotBuilder {
   static ExitCode CreateSnapshot(SnapshotData* out,
                                  CommonEnvironmentSetup* setup);
 
+  // Starts a detached process that runs args with exec_args and
+  // --build-snapshot to replace the --snapshot-blob snapshot, unless another
+  // process started doing that in the last kRebuildLockTimeoutMs. The new
+  // snapshot is written with ReplaceSnapshotFile().
+  static void RebuildInBackground(const std::vector<std::string>& args,
+                                  const std::vector<std::string>& exec_args);
+  // Writes the snapshot to a temporary file and renames it to path. On POSIX
+  // systems the rename is atomic: processes starting meanwhile read either
+  // the old or the new file, and those that have the old one mapped keep
+  // their copy. On Windows, the rename fails while another process has the
+  // file open, e.g. while it is read at startup. With
+  // --snapshot-auto-rebuild, also releases the lock taken by
+  // RebuildInBackground(). Returns false if the snapshot could not be
+  // written.
+  static bool ReplaceSnapshotFile(const SnapshotData* data,
+                                  const std::string& path);
+
+  static constexpr uint64_t kRebuildLockTimeoutMs = 10 * 60 * 1000;
+
  private:
+  static constexpr size_t kMaxCodeCacheThreads = 8;
+
+  // Compiles every builtin in isolates deserialized from snapshot, spread
+  // over up to max_threads threads, and appends their code cache to out,
+  // sorted by id.
+  static ExitCode BuildCodeCacheFromSnapshot(
+      const SnapshotData* snapshot,
+      std::vector<builtins::CodeCacheInfo>* out,
+      size_t max_threads = kMaxCodeCacheThreads);
+
+  static std::string GetRebuildLockPath(const std::string& snapshot_path);
+  // Creates the lock file of a rebuild. Returns false if another process
+  // holds it.
+  static bool AcquireRebuildLock(const std::string& lock_path);
+  static void ReleaseRebuildLock(const std::string& lock_path);
+
   static std::unique_ptr<ExternalReferenceRegistry> registry_;
+
+  friend class ::BuiltinCodeCacheTest;
+  friend class ::SnapshotRebuildTest;
 };
 }  // namespace node
 
@@ -1,7 +1,11 @@
 
 #include "node_snapshotable.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <vector>
 #include "aliased_buffer-inl.h"
@@ -28,11 +32,18 @@
 #include "node_v8_platform-inl.h"
 #include "simdjson.h"
 #include "timers.h"
+#include "zlib.h"
+#include "zstd.h"
 
 #if HAVE_INSPECTOR
 #include "inspector/worker_inspector.h"  // ParentInspectorHandle
 #endif
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 namespace node {
 
 using v8::Context;
@@ -54,6 +65,7 @@ using v8::TryCatch;
 using v8::Value;
 
 const uint32_t SnapshotData::kMagic;
+const uint32_t SnapshotData::kSectionedMagic;
 
 std::ostream& operator<<(std::ostream& output,
                          const builtins::CodeCacheInfo& info) {
@@ -92,6 +104,22 @@ std::ostream& operator<<(std::ostream& output,
   return output;
 }
 
+std::ostream& operator<<(std::ostream& output, const SnapshotSource& source) {
+  output << "{ \"" << source.path << "\", " << source.size << ", "
+         << source.mtime_ns << ", " << source.hash << " }";
+  return output;
+}
+
+std::ostream& operator<<(std::ostream& output,
+                         const std::vector<SnapshotSource>& vec) {
+  output << "{";
+  for (const auto& source : vec) {
+    output << " " << source << ",";
+  }
+  output << " }";
+  return output;
+}
+
 std::ostream& operator<<(std::ostream& output, const PropInfo& info) {
   output << "{ \"" << info.name << "\", " << std::to_string(info.id) << ", "
          << std::to_string(info.index) << " }";
@@ -393,6 +421,7 @@ size_t SnapshotSerializer::Write(const ImmediateInfo::SerializeInfo& data) {
 // [ 4/8 bytes ]  snapshot index of root
 // [ 4/8 bytes ]  snapshot index of milestones
 // [ 4/8 bytes ]  snapshot index of observers
+// [ 4/8 bytes ]  snapshot index of coarse_clock
 template <>
 performance::PerformanceState::SerializeInfo SnapshotDeserializer::Read() {
   Debug("Read<PerformanceState::SerializeInfo>()\n");
@@ -401,6 +430,7 @@ performance::PerformanceState::SerializeInfo SnapshotDeserializer::Read() {
   result.root = ReadArithmetic<AliasedBufferIndex>();
   result.milestones = ReadArithmetic<AliasedBufferIndex>();
   result.observers = ReadArithmetic<AliasedBufferIndex>();
+  result.coarse_clock = ReadArithmetic<AliasedBufferIndex>();
   if (is_debug) {
     std::string str = ToStr(result);
     Debug("Read<PerformanceState::SerializeInfo>() %s\n", str.c_str());
@@ -419,6 +449,7 @@ size_t SnapshotSerializer::Write(
   size_t written_total = WriteArithmetic<AliasedBufferIndex>(data.root);
   written_total += WriteArithmetic<AliasedBufferIndex>(data.milestones);
   written_total += WriteArithmetic<AliasedBufferIndex>(data.observers);
+  written_total += WriteArithmetic<AliasedBufferIndex>(data.coarse_clock);
 
   Debug("Write<PerformanceState::SerializeInfo>() wrote %d bytes\n",
         written_total);
@@ -527,6 +558,45 @@ size_t SnapshotSerializer::Write(const EnvSerializeInfo& data) {
   return written_total;
 }
 
+// Layout of SnapshotSource
+// [ 4/8 bytes ]  length of the path string
+// [    ...    ]  |length| bytes of path
+// [  8 bytes  ]  size of the file
+// [  8 bytes  ]  modification time of the file in nanoseconds
+// [  4 bytes  ]  CRC32 of the file contents
+template <>
+SnapshotSource SnapshotDeserializer::Read() {
+  Debug("Read<SnapshotSource>()\n");
+
+  SnapshotSource result;
+  result.path = ReadString();
+  result.size = ReadArithmetic<uint64_t>();
+  result.mtime_ns = ReadArithmetic<uint64_t>();
+  result.hash = ReadArithmetic<uint32_t>();
+
+  if (is_debug) {
+    std::string str = ToStr(result);
+    Debug("Read<SnapshotSource>() %s\n", str.c_str());
+  }
+  return result;
+}
+
+template <>
+size_t SnapshotSerializer::Write(const SnapshotSource& data) {
+  if (is_debug) {
+    std::string str = ToStr(data);
+    Debug("Write<SnapshotSource>() %s\n", str.c_str());
+  }
+
+  size_t written_total = WriteString(data.path);
+  written_total += WriteArithmetic<uint64_t>(data.size);
+  written_total += WriteArithmetic<uint64_t>(data.mtime_ns);
+  written_total += WriteArithmetic<uint32_t>(data.hash);
+
+  Debug("Write<SnapshotSource>() wrote %d bytes\n", written_total);
+  return written_total;
+}
+
 // Layout of SnapshotMetadata
 // [  1 byte   ]  type of the snapshot
 // [ 4/8 bytes ]  length of the node version string
@@ -578,16 +648,422 @@ size_t SnapshotSerializer::Write(const SnapshotMetadata& data) {
   return written_total;
 }
 
+SnapshotFlags operator|(SnapshotFlags x, SnapshotFlags y) {
+  return static_cast<SnapshotFlags>(static_cast<uint32_t>(x) |
+                                    static_cast<uint32_t>(y));
+}
+
+SnapshotFlags operator&(SnapshotFlags x, SnapshotFlags y) {
+  return static_cast<SnapshotFlags>(static_cast<uint32_t>(x) &
+                                    static_cast<uint32_t>(y));
+}
+
+SnapshotFlags operator|=(/* NOLINT (runtime/references) */ SnapshotFlags& x,
+                         SnapshotFlags y) {
+  return x = x | y;
+}
+
 // Layout of the snapshot blob
-// [   4 bytes    ]  kMagic
+// [   4 bytes    ]  kSectionedMagic
 // [   4/8 bytes  ]  length of Node.js version string
 // [    ...       ]  contents of Node.js version string
 // [   4/8 bytes  ]  length of Node.js arch string
 // [    ...       ]  contents of Node.js arch string
-// [    ...       ]  v8_snapshot_blob_data from SnapshotCreator::CreateBlob()
+// [    ...       ]  metadata.sources
 // [    ...       ]  isolate_data_info
 // [    ...       ]  env_info
+// [    ...       ]  table of SnapshotSection
+// [    ...       ]  zero padding up to SnapshotData::kSectionAlignment
+// [    ...       ]  v8_snapshot_blob_data from SnapshotCreator::CreateBlob()
+// [    ...       ]  zero padding up to SnapshotData::kSectionAlignment
 // [    ...       ]  code_cache
+//
+// Blobs written before the sections were introduced start with kMagic, and
+// the rest of them is the metadata, without sources, followed by
+// v8_snapshot_blob_data, isolate_data_info, env_info and code_cache in a row.
+// They can still be read.
+
+namespace {
+
+enum class SnapshotSectionType : uint32_t {
+  kV8StartupData = 0,
+  kCodeCache = 1,
+};
+
+enum class SnapshotSectionCompression : uint32_t {
+  kNone = 0,
+  // A sequence of zstd frames, each holding up to kCompressionChunkSize
+  // bytes of the section, so that they can be decompressed in parallel.
+  kZstd = 1,
+};
+
+struct SnapshotSection {
+  SnapshotSectionType type;
+  SnapshotSectionCompression compression;
+  uint64_t offset;    // From the start of the blob.
+  uint64_t size;      // In the blob.
+  uint64_t raw_size;  // After decompression.
+};
+
+constexpr size_t kCompressionChunkSize = 4 * 1024 * 1024;
+constexpr size_t kMaxDecompressionThreads = 8;
+
+std::ostream& operator<<(std::ostream& output, const SnapshotSection& s) {
+  output << "{ " << static_cast<uint32_t>(s.type) << ", "
+         << static_cast<uint32_t>(s.compression) << ", " << s.offset << ", "
+         << s.size << ", " << s.raw_size << " }";
+  return output;
+}
+
+std::ostream& operator<<(std::ostream& output,
+                         const std::vector<SnapshotSection>& vec) {
+  output << "{\n";
+  for (const auto& section : vec) {
+    output << "  " << section << ",\n";
+  }
+  output << "}";
+  return output;
+}
+
+}  // anonymous namespace
+
+// Layout of SnapshotSection
+// [ 4 bytes ]  type
+// [ 4 bytes ]  compression
+// [ 8 bytes ]  offset
+// [ 8 bytes ]  size
+// [ 8 bytes ]  raw_size
+template <>
+SnapshotSection SnapshotDeserializer::Read() {
+  Debug("Read<SnapshotSection>()\n");
+
+  SnapshotSection result;
+  result.type = static_cast<SnapshotSectionType>(ReadArithmetic<uint32_t>());
+  result.compression =
+      static_cast<SnapshotSectionCompression>(ReadArithmetic<uint32_t>());
+  result.offset = ReadArithmetic<uint64_t>();
+  result.size = ReadArithmetic<uint64_t>();
+  result.raw_size = ReadArithmetic<uint64_t>();
+
+  if (is_debug) {
+    std::string str = ToStr(result);
+    Debug("Read<SnapshotSection>() %s\n", str.c_str());
+  }
+  return result;
+}
+
+template <>
+size_t SnapshotSerializer::Write(const SnapshotSection& data) {
+  if (is_debug) {
+    std::string str = ToStr(data);
+    Debug("Write<SnapshotSection>() %s\n", str.c_str());
+  }
+
+  size_t written_total =
+      WriteArithmetic<uint32_t>(static_cast<uint32_t>(data.type));
+  written_total +=
+      WriteArithmetic<uint32_t>(static_cast<uint32_t>(data.compression));
+  written_total += WriteArithmetic<uint64_t>(data.offset);
+  written_total += WriteArithmetic<uint64_t>(data.size);
+  written_total += WriteArithmetic<uint64_t>(data.raw_size);
+
+  Debug("Write<SnapshotSection>() wrote %d bytes\n", written_total);
+  return written_total;
+}
+
+namespace {
+
+// Compresses content into out in independent frames of at most
+// kCompressionChunkSize bytes. Returns false if that does not make it
+// smaller.
+bool CompressSection(std::string_view content, std::vector<char>* out) {
+  out->clear();
+  for (size_t pos = 0; pos < content.size(); pos += kCompressionChunkSize) {
+    size_t chunk_size = std::min(kCompressionChunkSize, content.size() - pos);
+    size_t out_pos = out->size();
+    out->resize(out_pos + ZSTD_compressBound(chunk_size));
+    size_t r = ZSTD_compress(out->data() + out_pos,
+                             out->size() - out_pos,
+                             content.data() + pos,
+                             chunk_size,
+                             ZSTD_CLEVEL_DEFAULT);
+    if (ZSTD_isError(r)) {
+      return false;
+    }
+    out->resize(out_pos + r);
+    if (out->size() >= content.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct ZstdFrame {
+  const char* src;
+  size_t src_size;
+  char* dst;
+  size_t dst_size;
+};
+
+// Appends the frames of a compressed section to frames, to be decompressed
+// into out, which has room for raw_size bytes. Returns false if the frames
+// do not add up to raw_size.
+bool AppendZstdFrames(std::string_view content,
+                      char* out,
+                      size_t raw_size,
+                      std::vector<ZstdFrame>* frames) {
+  size_t out_pos = 0;
+  while (!content.empty()) {
+    size_t frame_size =
+        ZSTD_findFrameCompressedSize(content.data(), content.size());
+    if (ZSTD_isError(frame_size)) {
+      return false;
+    }
+    unsigned long long content_size =  // NOLINT(runtime/int)
+        ZSTD_getFrameContentSize(content.data(), frame_size);
+    if (content_size == ZSTD_CONTENTSIZE_UNKNOWN ||
+        content_size == ZSTD_CONTENTSIZE_ERROR ||
+        content_size > raw_size - out_pos) {
+      return false;
+    }
+    frames->push_back({content.data(),
+                       frame_size,
+                       out + out_pos,
+                       static_cast<size_t>(content_size)});
+    out_pos += content_size;
+    content.remove_prefix(frame_size);
+  }
+  return out_pos == raw_size;
+}
+
+struct ZstdFrameQueue {
+  const std::vector<ZstdFrame>* frames = nullptr;
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+};
+
+void DecompressZstdFrames(ZstdFrameQueue* queue) {
+  for (size_t i = queue->next++; i < queue->frames->size();
+       i = queue->next++) {
+    const ZstdFrame& frame = (*queue->frames)[i];
+    size_t r =
+        ZSTD_decompress(frame.dst, frame.dst_size, frame.src, frame.src_size);
+    if (ZSTD_isError(r) || r != frame.dst_size) {
+      queue->failed = true;
+    }
+  }
+}
+
+void DecompressionThreadMain(void* data) {
+  DecompressZstdFrames(static_cast<ZstdFrameQueue*>(data));
+}
+
+// Decompresses the frames on up to kMaxDecompressionThreads threads,
+// including the current one.
+bool DecompressInParallel(const std::vector<ZstdFrame>& frames) {
+  ZstdFrameQueue queue;
+  queue.frames = &frames;
+  size_t thread_count =
+      std::min({static_cast<size_t>(uv_available_parallelism()),
+                kMaxDecompressionThreads,
+                frames.size()});
+  std::vector<uv_thread_t> threads;
+  for (size_t i = 1; i < thread_count; ++i) {
+    uv_thread_t thread;
+    if (uv_thread_create(&thread, DecompressionThreadMain, &queue) == 0) {
+      threads.push_back(thread);
+    }
+  }
+  // Frames left over by threads that could not be started are taken by the
+  // others.
+  DecompressZstdFrames(&queue);
+  for (uv_thread_t& thread : threads) {
+    CHECK_EQ(uv_thread_join(&thread), 0);
+  }
+  return !queue.failed;
+}
+
+// Reads the code cache written by WriteVector<builtins::CodeCacheInfo>()
+// without copying the cached data out of section, which is kept alive by
+// owner.
+std::vector<builtins::CodeCacheInfo> ReadCodeCacheInPlace(
+    std::string_view section, std::shared_ptr<void> owner) {
+  SnapshotDeserializer r(section);
+  size_t count = r.ReadArithmetic<size_t>();
+  std::vector<builtins::CodeCacheInfo> result;
+  result.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    std::string id = r.ReadString();
+    size_t length = r.ReadArithmetic<size_t>();
+    CHECK_LE(length, section.size() - r.read_total);
+    const uint8_t* data =
+        reinterpret_cast<const uint8_t*>(section.data() + r.read_total);
+    r.read_total += length;
+    result.push_back(
+        {std::move(id), builtins::BuiltinCodeCacheData(data, length, owner)});
+  }
+  return result;
+}
+
+// Reads the V8 startup data and the code cache from the sections of in.
+// Compressed sections are decompressed together so that their frames are
+// spread over the same threads.
+bool ReadSnapshotSections(SnapshotData* out,
+                          std::string_view in,
+                          const std::vector<SnapshotSection>& sections,
+                          std::shared_ptr<void> in_owner) {
+  auto invalid = []() {
+    fprintf(stderr, "Invalid section table in the startup snapshot\n");
+    return false;
+  };
+
+  const SnapshotSection* v8_section = nullptr;
+  const SnapshotSection* code_cache_section = nullptr;
+  for (const SnapshotSection& section : sections) {
+    if (section.offset > in.size() ||
+        section.size > in.size() - section.offset) {
+      return invalid();
+    }
+    switch (section.compression) {
+      case SnapshotSectionCompression::kNone:
+        if (section.raw_size != section.size) {
+          return invalid();
+        }
+        break;
+      case SnapshotSectionCompression::kZstd:
+        break;
+      default:
+        return invalid();
+    }
+    switch (section.type) {
+      case SnapshotSectionType::kV8StartupData:
+        v8_section = &section;
+        break;
+      case SnapshotSectionType::kCodeCache:
+        code_cache_section = &section;
+        break;
+      default:
+        return invalid();
+    }
+  }
+  if (v8_section == nullptr || code_cache_section == nullptr ||
+      v8_section->raw_size == 0 ||
+      v8_section->raw_size > static_cast<uint64_t>(INT_MAX)) {
+    return invalid();
+  }
+
+  auto contents = [&](const SnapshotSection* section) {
+    return in.substr(section->offset, section->size);
+  };
+
+  std::vector<ZstdFrame> frames;
+  std::unique_ptr<char[]> v8_data;
+  std::shared_ptr<char[]> code_cache_data;
+  if (v8_section->compression == SnapshotSectionCompression::kZstd) {
+    v8_data.reset(new char[v8_section->raw_size]);
+    if (!AppendZstdFrames(contents(v8_section),
+                          v8_data.get(),
+                          v8_section->raw_size,
+                          &frames)) {
+      return invalid();
+    }
+  }
+  if (code_cache_section->compression == SnapshotSectionCompression::kZstd) {
+    code_cache_data.reset(new char[code_cache_section->raw_size]);
+    if (!AppendZstdFrames(contents(code_cache_section),
+                          code_cache_data.get(),
+                          code_cache_section->raw_size,
+                          &frames)) {
+      return invalid();
+    }
+  }
+  if (!frames.empty() && !DecompressInParallel(frames)) {
+    fprintf(stderr, "Failed to decompress the startup snapshot\n");
+    return false;
+  }
+
+  int v8_size = static_cast<int>(v8_section->raw_size);
+  if (v8_data) {
+    out->v8_snapshot_blob_data = {v8_data.release(), v8_size};
+  } else if (in_owner) {
+    out->v8_snapshot_blob_data = {contents(v8_section).data(), v8_size};
+    out->v8_snapshot_blob_owner = in_owner;
+  } else {
+    // The data pointer of v8::StartupData would be deleted so it must be
+    // new'ed.
+    char* copy = new char[v8_size];
+    memcpy(copy, contents(v8_section).data(), v8_size);
+    out->v8_snapshot_blob_data = {copy, v8_size};
+  }
+
+  if (code_cache_data) {
+    std::string_view decompressed(code_cache_data.get(),
+                                  code_cache_section->raw_size);
+    out->code_cache =
+        ReadCodeCacheInPlace(decompressed, std::move(code_cache_data));
+  } else if (in_owner) {
+    out->code_cache =
+        ReadCodeCacheInPlace(contents(code_cache_section), in_owner);
+  } else {
+    SnapshotDeserializer r(contents(code_cache_section));
+    out->code_cache = r.ReadVector<builtins::CodeCacheInfo>();
+  }
+  return true;
+}
+
+// A read-only mapping of a snapshot blob file. Its pages are shared with
+// the page cache, and thereby with other processes that start from the
+// same file.
+class MappedSnapshotFile {
+ public:
+  // Returns nullptr if the file cannot be mapped. On Windows, files are never
+  // mapped: a file mapped by any process can't be replaced, which would keep
+  // --build-snapshot and the background rebuild from renaming a new snapshot
+  // over it for as long as a process started from it is running.
+  static std::shared_ptr<MappedSnapshotFile> Map(FILE* fp);
+
+  MappedSnapshotFile(const MappedSnapshotFile&) = delete;
+  MappedSnapshotFile& operator=(const MappedSnapshotFile&) = delete;
+  ~MappedSnapshotFile();
+
+  std::string_view contents() const { return {data_, size_}; }
+
+ private:
+  MappedSnapshotFile(const char* data, size_t size)
+      : data_(data), size_(size) {}
+
+  const char* data_;
+  size_t size_;
+};
+
+std::shared_ptr<MappedSnapshotFile> MappedSnapshotFile::Map(FILE* fp) {
+#ifdef _WIN32
+  USE(fp);
+  return nullptr;
+#else
+  int fd = fileno(fp);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      st.st_size <= 0) {
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  return std::shared_ptr<MappedSnapshotFile>(
+      new MappedSnapshotFile(static_cast<const char*>(data), size));
+#endif
+}
+
+MappedSnapshotFile::~MappedSnapshotFile() {
+#ifndef _WIN32
+  munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+}  // anonymous namespace
 
 std::vector<char> SnapshotData::ToBlob() const {
   std::vector<char> result;
@@ -598,19 +1074,73 @@ std::vector<char> SnapshotData::ToBlob() const {
   size_t written_total = 0;
 
   // Metadata
-  w.Debug("0x%x: Write magic %" PRIx32 "\n", w.sink.size(), kMagic);
-  written_total += w.WriteArithmetic<uint32_t>(kMagic);
+  w.Debug("0x%x: Write magic %" PRIx32 "\n", w.sink.size(), kSectionedMagic);
+  written_total += w.WriteArithmetic<uint32_t>(kSectionedMagic);
   w.Debug("0x%x: Write metadata\n", w.sink.size());
   written_total += w.Write<SnapshotMetadata>(metadata);
-  w.Debug("0x%x: Write snapshot blob\n", w.sink.size());
-  written_total += w.Write<v8::StartupData>(v8_snapshot_blob_data);
+  w.Debug("0x%x: Write metadata sources\n", w.sink.size());
+  written_total += w.WriteVector<SnapshotSource>(metadata.sources);
   w.Debug("0x%x: Write IsolateDataSerializeInfo\n", w.sink.size());
   written_total += w.Write<IsolateDataSerializeInfo>(isolate_data_info);
   w.Debug("0x%x: Write EnvSerializeInfo\n", w.sink.size());
   written_total += w.Write<EnvSerializeInfo>(env_info);
-  w.Debug("0x%x: Write CodeCacheInfo\n", w.sink.size());
-  written_total += w.WriteVector<builtins::CodeCacheInfo>(code_cache);
-  w.Debug("SnapshotData::ToBlob() Wrote %d bytes\n", written_total);
+
+  SnapshotSerializer code_cache_writer;
+  code_cache_writer.WriteVector<builtins::CodeCacheInfo>(code_cache);
+  CHECK_GT(v8_snapshot_blob_data.raw_size, 0);
+  std::vector<std::string_view> contents = {
+      {v8_snapshot_blob_data.data,
+       static_cast<size_t>(v8_snapshot_blob_data.raw_size)},
+      {code_cache_writer.sink.data(), code_cache_writer.sink.size()},
+  };
+  std::vector<SnapshotSection> sections = {
+      {SnapshotSectionType::kV8StartupData,
+       SnapshotSectionCompression::kNone,
+       0,
+       contents[0].size(),
+       contents[0].size()},
+      {SnapshotSectionType::kCodeCache,
+       SnapshotSectionCompression::kNone,
+       0,
+       contents[1].size(),
+       contents[1].size()},
+  };
+
+  std::vector<std::vector<char>> compressed(sections.size());
+  if (static_cast<bool>(metadata.flags & SnapshotFlags::kCompressed)) {
+    for (size_t i = 0; i < sections.size(); ++i) {
+      if (CompressSection(contents[i], &compressed[i])) {
+        contents[i] = {compressed[i].data(), compressed[i].size()};
+        sections[i].compression = SnapshotSectionCompression::kZstd;
+        sections[i].size = contents[i].size();
+      }
+    }
+  }
+
+  // The size of the section table does not depend on the offsets, so write
+  // it once to find out where the sections start.
+  size_t table_start = w.sink.size();
+  w.WriteVector<SnapshotSection>(sections);
+  size_t offset = w.sink.size();
+  for (SnapshotSection& section : sections) {
+    offset = (offset + kSectionAlignment - 1) / kSectionAlignment *
+             kSectionAlignment;
+    section.offset = offset;
+    offset += section.size;
+  }
+  w.sink.resize(table_start);
+  w.Debug("0x%x: Write sections\n", w.sink.size());
+  written_total += w.WriteVector<SnapshotSection>(sections);
+  w.sink.reserve(offset);
+  for (size_t i = 0; i < sections.size(); ++i) {
+    w.sink.resize(sections[i].offset, 0);
+    w.Debug("0x%x: Write section %d\n", w.sink.size(), i);
+    written_total +=
+        w.WriteArithmetic<char>(contents[i].data(), contents[i].size());
+  }
+  w.Debug("SnapshotData::ToBlob() Wrote %d bytes, %d with padding\n",
+          written_total,
+          w.sink.size());
 
   // Return using the temporary value to enable copy elision.
   std::swap(result, w.sink);
@@ -634,6 +1164,11 @@ EmbedderSnapshotData::Pointer SnapshotData::AsEmbedderWrapper() const {
 }
 
 bool SnapshotData::FromFile(SnapshotData* out, FILE* in) {
+  std::shared_ptr<MappedSnapshotFile> mapped = MappedSnapshotFile::Map(in);
+  if (mapped) {
+    std::string_view contents = mapped->contents();
+    return FromBlob(out, contents, std::move(mapped));
+  }
   return FromBlob(out, ReadFileSync(in));
 }
 
@@ -642,30 +1177,56 @@ bool SnapshotData::FromBlob(SnapshotData* out, const std::vector<char>& in) {
 }
 
 bool SnapshotData::FromBlob(SnapshotData* out, std::string_view in) {
+  return FromBlob(out, in, nullptr);
+}
+
+bool SnapshotData::FromBlob(SnapshotData* out,
+                            std::string_view in,
+                            std::shared_ptr<void> in_owner) {
   SnapshotDeserializer r(in);
   r.Debug("SnapshotData::FromBlob()\n");
 
   DCHECK_EQ(out->data_ownership, SnapshotData::DataOwnership::kOwned);
 
   // Metadata
-  uint32_t magic = r.ReadArithmetic<uint32_t>();
+  uint32_t magic = 0;
+  if (in.size() >= sizeof(magic)) {
+    magic = r.ReadArithmetic<uint32_t>();
+  }
   r.Debug("Read magic %" PRIx32 "\n", magic);
-  CHECK_EQ(magic, kMagic);
+  if (magic != kMagic && magic != kSectionedMagic) {
+    fprintf(stderr,
+            "Failed to load the startup snapshot because it is not a "
+            "snapshot blob written by this version of Node.js.\n");
+    return false;
+  }
   out->metadata = r.Read<SnapshotMetadata>();
   r.Debug("Read metadata\n");
   if (!out->Check()) {
     return false;
   }
 
-  out->v8_snapshot_blob_data = r.Read<v8::StartupData>();
+  if (magic == kMagic) {
+    out->v8_snapshot_blob_data = r.Read<v8::StartupData>();
+    r.Debug("Read isolate_data_info\n");
+    out->isolate_data_info = r.Read<IsolateDataSerializeInfo>();
+    out->env_info = r.Read<EnvSerializeInfo>();
+    r.Debug("Read code_cache\n");
+    out->code_cache = r.ReadVector<builtins::CodeCacheInfo>();
+    r.Debug("SnapshotData::FromBlob() read %d bytes\n", r.read_total);
+    return true;
+  }
+
+  // The version matches, so the sources are laid out the way they are read.
+  r.Debug("Read metadata sources\n");
+  out->metadata.sources = r.ReadVector<SnapshotSource>();
   r.Debug("Read isolate_data_info\n");
   out->isolate_data_info = r.Read<IsolateDataSerializeInfo>();
   out->env_info = r.Read<EnvSerializeInfo>();
-  r.Debug("Read code_cache\n");
-  out->code_cache = r.ReadVector<builtins::CodeCacheInfo>();
-
-  r.Debug("SnapshotData::FromBlob() read %d bytes\n", r.read_total);
-  return true;
+  r.Debug("Read sections\n");
+  std::vector<SnapshotSection> sections = r.ReadVector<SnapshotSection>();
+  r.Debug("SnapshotData::FromBlob() read %d bytes of header\n", r.read_total);
+  return ReadSnapshotSections(out, in, sections, std::move(in_owner));
 }
 
 bool SnapshotData::Check() const {
@@ -700,8 +1261,79 @@ bool SnapshotData::Check() const {
   return true;
 }
 
+namespace {
+uint64_t GetMtimeNs(const uv_stat_t& stat) {
+  return static_cast<uint64_t>(stat.st_mtim.tv_sec) * 1000000000 +
+         stat.st_mtim.tv_nsec;
+}
+
+uint32_t GetContentHash(const std::string& contents) {
+  uLong crc = crc32(0L, Z_NULL, 0);
+  return crc32(
+      crc, reinterpret_cast<const Bytef*>(contents.data()), contents.size());
+}
+
+std::optional<std::string> GetRealPath(const std::string& path) {
+  uv_fs_t req;
+  auto defer_req_cleanup = OnScopeLeave([&req]() { uv_fs_req_cleanup(&req); });
+  if (uv_fs_realpath(nullptr, &req, path.c_str(), nullptr) != 0) {
+    return std::nullopt;
+  }
+  return std::string(static_cast<const char*>(req.ptr));
+}
+}  // namespace
+
+std::optional<SnapshotSource> SnapshotSource::FromFile(
+    const std::string& path) {
+  std::optional<std::string> real_path = GetRealPath(path);
+  if (!real_path.has_value()) {
+    return std::nullopt;
+  }
+
+  uv_fs_t req;
+  auto defer_req_cleanup = OnScopeLeave([&req]() { uv_fs_req_cleanup(&req); });
+  if (uv_fs_stat(nullptr, &req, real_path->c_str(), nullptr) != 0) {
+    return std::nullopt;
+  }
+  std::string contents;
+  if (ReadFileSync(&contents, real_path->c_str()) != 0) {
+    return std::nullopt;
+  }
+  return SnapshotSource{std::move(real_path.value()),
+                        req.statbuf.st_size,
+                        GetMtimeNs(req.statbuf),
+                        GetContentHash(contents)};
+}
+
+bool SnapshotSource::IsUpToDate() const {
+  uv_fs_t req;
+  auto defer_req_cleanup = OnScopeLeave([&req]() { uv_fs_req_cleanup(&req); });
+  if (uv_fs_stat(nullptr, &req, path.c_str(), nullptr) != 0 ||
+      req.statbuf.st_size != size) {
+    return false;
+  }
+  if (GetMtimeNs(req.statbuf) == mtime_ns) {
+    return true;
+  }
+  // The file may have been touched or checked out again without changing.
+  std::string contents;
+  return ReadFileSync(&contents, path.c_str()) == 0 &&
+         GetContentHash(contents) == hash;
+}
+
+bool SnapshotData::SourcesAreUpToDate(const std::string& entry_point) const {
+  if (metadata.sources.empty() ||
+      GetRealPath(entry_point) != metadata.sources[0].path) {
+    return false;
+  }
+  return std::ranges::all_of(metadata.sources, [](const SnapshotSource& s) {
+    return s.IsUpToDate();
+  });
+}
+
 SnapshotData::~SnapshotData() {
   if (data_ownership == DataOwnership::kOwned &&
+      v8_snapshot_blob_owner == nullptr &&
       v8_snapshot_blob_data.data != nullptr) {
     delete[] v8_snapshot_blob_data.data;
   }
@@ -875,21 +1507,6 @@ void SnapshotBuilder::InitializeIsolateParams(const SnapshotData* data,
       const_cast<v8::StartupData*>(&(data->v8_snapshot_blob_data));
 }
 
-SnapshotFlags operator|(SnapshotFlags x, SnapshotFlags y) {
-  return static_cast<SnapshotFlags>(static_cast<uint32_t>(x) |
-                                    static_cast<uint32_t>(y));
-}
-
-SnapshotFlags operator&(SnapshotFlags x, SnapshotFlags y) {
-  return static_cast<SnapshotFlags>(static_cast<uint32_t>(x) &
-                                    static_cast<uint32_t>(y));
-}
-
-SnapshotFlags operator|=(/* NOLINT (runtime/references) */ SnapshotFlags& x,
-                         SnapshotFlags y) {
-  return x = x | y;
-}
-
 bool WithoutCodeCache(const SnapshotFlags& flags) {
   return static_cast<bool>(flags & SnapshotFlags::kWithoutCodeCache);
 }
@@ -955,6 +1572,17 @@ std::optional<SnapshotConfig> ReadSnapshotConfig(const char* config_path) {
       if (without_code_cache_value) {
         result.flags |= SnapshotFlags::kWithoutCodeCache;
       }
+    } else if (key == "compress") {
+      bool compress_value = false;
+      if (field.value().get_bool().get(compress_value)) {
+        FPrintF(stderr,
+                "\"compress\" field of %s is not a boolean\n",
+                config_path);
+        return std::nullopt;
+      }
+      if (compress_value) {
+        result.flags |= SnapshotFlags::kCompressed;
+      }
     }
   }
 
@@ -1038,10 +1666,29 @@ ExitCode BuildSnapshotWithoutCodeCache(
   return SnapshotBuilder::CreateSnapshot(out, setup.get());
 }
 
-ExitCode BuildCodeCacheFromSnapshot(SnapshotData* out,
-                                    const std::vector<std::string>& args,
-                                    const std::vector<std::string>& exec_args) {
-  RAIIIsolate raii_isolate(out);
+namespace {
+
+// Generating the code cache compiles every builtin, which is slow enough to
+// be worth spreading over several isolates deserialized from the same
+// snapshot, each compiling a slice of the builtins on its own thread. The
+// code cache does not depend on the isolate it was created in.
+// This only applies when a snapshot is built. At runtime, builtins are
+// compiled one at a time when they are first required, and
+// LookupAndCompileInternal() replaces a rejected code cache entry for each
+// of them as it goes, so there is no batch of work to split up there.
+constexpr size_t kMinBuiltinsPerCodeCacheThread = 32;
+constexpr size_t kCodeCacheThreadStackSize = 4 * 1024 * 1024;
+
+struct CodeCacheSlice {
+  const SnapshotData* snapshot = nullptr;
+  std::vector<std::string> ids;
+  std::vector<builtins::CodeCacheInfo> code_cache;
+  uv_loop_t* loop = nullptr;  // The default loop if null.
+  bool succeeded = false;
+};
+
+void CompileCodeCacheSlice(CodeCacheSlice* slice) {
+  RAIIIsolate raii_isolate(slice->snapshot, slice->loop);
   Isolate* isolate = raii_isolate.get();
   v8::Locker locker(isolate);
   Isolate::Scope isolate_scope(isolate);
@@ -1058,15 +1705,88 @@ ExitCode BuildCodeCacheFromSnapshot(SnapshotData* out,
   Local<Context> context = Context::New(isolate);
   Context::Scope context_scope(context);
   builtins::BuiltinLoader builtin_loader;
+  slice->succeeded = builtin_loader.CompileBuiltinsAndCopyCodeCache(
+      context,
+      slice->snapshot->env_info.principal_realm.builtins,
+      slice->ids,
+      &slice->code_cache);
+}
+
+void CodeCacheThreadMain(void* data) {
+  CodeCacheSlice* slice = static_cast<CodeCacheSlice*>(data);
+  uv_loop_t loop;
+  CHECK_EQ(uv_loop_init(&loop), 0);
+  slice->loop = &loop;
+  CompileCodeCacheSlice(slice);
+  // Let the platform close the handles it registered for the isolate.
+  uv_run(&loop, UV_RUN_DEFAULT);
+  CheckedUvLoopClose(&loop);
+}
+
+}  // anonymous namespace
+
+ExitCode SnapshotBuilder::BuildCodeCacheFromSnapshot(
+    const SnapshotData* snapshot,
+    std::vector<builtins::CodeCacheInfo>* out,
+    size_t max_threads) {
   // Regenerate all the code cache.
-  if (!builtin_loader.CompileAllBuiltinsAndCopyCodeCache(
-          context,
-          out->env_info.principal_realm.builtins,
-          &(out->code_cache))) {
+  std::vector<std::string> ids =
+      builtins::BuiltinLoader().GetCodeCacheBuiltinIds();
+  size_t thread_count =
+      std::min({static_cast<size_t>(uv_available_parallelism()),
+                max_threads,
+                ids.size() / kMinBuiltinsPerCodeCacheThread});
+  thread_count = std::max<size_t>(thread_count, 1);
+  per_process::Debug(DebugCategory::CODE_CACHE,
+                     "Compiling %zu builtins on %zu threads\n",
+                     ids.size(),
+                     thread_count);
+
+  // Interleave the builtins, which are sorted by id, so that the large
+  // groups under one prefix are shared among the slices.
+  std::vector<CodeCacheSlice> slices(thread_count);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    slices[i % thread_count].ids.push_back(std::move(ids[i]));
+  }
+  for (CodeCacheSlice& slice : slices) {
+    slice.snapshot = snapshot;
+  }
+
+  uv_thread_options_t thread_options;
+  thread_options.flags = UV_THREAD_HAS_STACK_SIZE;
+  thread_options.stack_size = kCodeCacheThreadStackSize;
+  std::vector<uv_thread_t> threads(thread_count);
+  std::vector<bool> started(thread_count, false);
+  for (size_t i = 1; i < thread_count; ++i) {
+    started[i] = uv_thread_create_ex(&threads[i],
+                                     &thread_options,
+                                     CodeCacheThreadMain,
+                                     &slices[i]) == 0;
+  }
+  // The main thread takes the first slice, and any slice whose thread could
+  // not be started.
+  for (size_t i = 0; i < thread_count; ++i) {
+    if (!started[i]) {
+      CompileCodeCacheSlice(&slices[i]);
+    }
+  }
+
+  bool all_succeeded = true;
+  for (size_t i = 0; i < thread_count; ++i) {
+    if (started[i]) {
+      CHECK_EQ(uv_thread_join(&threads[i]), 0);
+    }
+    all_succeeded = all_succeeded && slices[i].succeeded;
+    std::ranges::move(slices[i].code_cache, std::back_inserter(*out));
+  }
+  if (!all_succeeded) {
     return ExitCode::kGenericUserError;
   }
+  // Keep the snapshot independent of how the builtins were split up.
+  std::ranges::sort(*out, {}, &builtins::CodeCacheInfo::id);
+
   if (per_process::enabled_debug_list.enabled(DebugCategory::MKSNAPSHOT)) {
-    for (const auto& item : out->code_cache) {
+    for (const auto& item : *out) {
       std::string size_str = FormatSize(item.data.length);
       per_process::Debug(DebugCategory::MKSNAPSHOT,
                          "Generated code cache for %d: %s\n",
@@ -1096,12 +1816,152 @@ ExitCode SnapshotBuilder::Generate(
     // Deserialize the snapshot to recompile code cache. We need to do this in
     // the second pass because V8 requires the code cache to be compiled with a
     // finalized read-only space.
-    return BuildCodeCacheFromSnapshot(out, args, exec_args);
+    return BuildCodeCacheFromSnapshot(out, &out->code_cache);
   }
 
   return ExitCode::kNoFailure;
 }
 
+std::string SnapshotBuilder::GetRebuildLockPath(
+    const std::string& snapshot_path) {
+  return snapshot_path + ".lock";
+}
+
+// A lock older than kRebuildLockTimeoutMs was left behind by a rebuild that
+// failed or crashed, in which case it is taken over. Keeping it until then is
+// what stops every start from retrying a failing rebuild.
+bool SnapshotBuilder::AcquireRebuildLock(const std::string& lock_path) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    uv_fs_t req;
+    int fd = uv_fs_open(nullptr,
+                        &req,
+                        lock_path.c_str(),
+                        UV_FS_O_CREAT | UV_FS_O_EXCL | UV_FS_O_WRONLY,
+                        0644,
+                        nullptr);
+    uv_fs_req_cleanup(&req);
+    if (fd >= 0) {
+      CHECK_EQ(0, uv_fs_close(nullptr, &req, fd, nullptr));
+      uv_fs_req_cleanup(&req);
+      return true;
+    }
+    if (fd != UV_EEXIST) {
+      return false;
+    }
+
+    int r = uv_fs_stat(nullptr, &req, lock_path.c_str(), nullptr);
+    uint64_t lock_mtime_ns = GetMtimeNs(req.statbuf);
+    uv_fs_req_cleanup(&req);
+    if (r == 0) {
+      uv_timespec64_t now;
+      CHECK_EQ(0, uv_clock_gettime(UV_CLOCK_REALTIME, &now));
+      uint64_t now_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000 +
+                        now.tv_nsec;
+      if (now_ns < lock_mtime_ns + kRebuildLockTimeoutMs * 1000000) {
+        return false;
+      }
+      uv_fs_unlink(nullptr, &req, lock_path.c_str(), nullptr);
+      uv_fs_req_cleanup(&req);
+    }
+  }
+  return false;
+}
+
+void SnapshotBuilder::ReleaseRebuildLock(const std::string& lock_path) {
+  uv_fs_t req;
+  uv_fs_unlink(nullptr, &req, lock_path.c_str(), nullptr);
+  uv_fs_req_cleanup(&req);
+}
+
+void SnapshotBuilder::RebuildInBackground(
+    const std::vector<std::string>& args,
+    const std::vector<std::string>& exec_args) {
+  const std::string& snapshot_path = per_process::cli_options->snapshot_blob;
+  std::string lock_path = GetRebuildLockPath(snapshot_path);
+  if (!AcquireRebuildLock(lock_path)) {
+    per_process::Debug(DebugCategory::MKSNAPSHOT,
+                       "%s is already being rebuilt\n",
+                       snapshot_path);
+    return;
+  }
+
+  char exec_path[PATH_MAX];
+  size_t exec_path_len = sizeof(exec_path);
+  if (uv_exepath(exec_path, &exec_path_len) != 0) {
+    ReleaseRebuildLock(lock_path);
+    return;
+  }
+  // exec_args already contain --snapshot-blob and --snapshot-auto-rebuild,
+  // unless they come from NODE_OPTIONS, which the child inherits.
+  std::vector<std::string> child_args{exec_path};
+  child_args.insert(child_args.end(), exec_args.begin(), exec_args.end());
+  child_args.emplace_back("--build-snapshot");
+  child_args.insert(child_args.end(), args.begin() + 1, args.end());
+  std::vector<char*> argv;
+  for (std::string& arg : child_args) {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+
+  uv_stdio_container_t stdio[3];
+  for (uv_stdio_container_t& container : stdio) {
+    container.flags = UV_IGNORE;
+  }
+  uv_process_options_t options{};
+  options.file = exec_path;
+  options.args = argv.data();
+  options.flags = UV_PROCESS_DETACHED | UV_PROCESS_WINDOWS_HIDE;
+  options.stdio_count = arraysize(stdio);
+  options.stdio = stdio;
+  // Reaps the child if it finishes while this process is still running.
+  options.exit_cb = [](uv_process_t* process, int64_t, int) {
+    uv_close(reinterpret_cast<uv_handle_t*>(process), [](uv_handle_t* handle) {
+      delete reinterpret_cast<uv_process_t*>(handle);
+    });
+  };
+
+  auto* process = new uv_process_t;
+  int r = uv_spawn(uv_default_loop(), process, &options);
+  per_process::Debug(DebugCategory::MKSNAPSHOT,
+                     "Rebuilding %s in the background: %s\n",
+                     snapshot_path,
+                     r == 0 ? "started" : uv_strerror(r));
+  if (r != 0) {
+    ReleaseRebuildLock(lock_path);
+    uv_close(reinterpret_cast<uv_handle_t*>(process), [](uv_handle_t* handle) {
+      delete reinterpret_cast<uv_process_t*>(handle);
+    });
+    return;
+  }
+  // The child outlives this process if need be, and does not keep it alive.
+  uv_unref(reinterpret_cast<uv_handle_t*>(process));
+}
+
+bool SnapshotBuilder::ReplaceSnapshotFile(const SnapshotData* data,
+                                          const std::string& path) {
+  std::string temp_path =
+      path + "." + std::to_string(uv_os_getpid()) + ".tmp";
+  FILE* fp = fopen(temp_path.c_str(), "wb");
+  if (fp == nullptr) {
+    return false;
+  }
+  data->ToFile(fp);
+  fclose(fp);
+
+  uv_fs_t req;
+  int r = uv_fs_rename(nullptr, &req, temp_path.c_str(), path.c_str(), nullptr);
+  uv_fs_req_cleanup(&req);
+  if (r != 0) {
+    uv_fs_unlink(nullptr, &req, temp_path.c_str(), nullptr);
+    uv_fs_req_cleanup(&req);
+    return false;
+  }
+  if (per_process::cli_options->snapshot_auto_rebuild) {
+    ReleaseRebuildLock(GetRebuildLockPath(path));
+  }
+  return true;
+}
+
 ExitCode SnapshotBuilder::CreateSnapshot(SnapshotData* out,
                                          CommonEnvironmentSetup* setup) {
   const SnapshotConfig* config = setup->isolate_data()->snapshot_config();
@@ -23,9 +23,12 @@
 #include "aliased_buffer-inl.h"
 #include "base_object-inl.h"
 #include "env-inl.h"
+#include "histogram-inl.h"
 #include "memory_tracker-inl.h"
 #include "node.h"
+#include "node_buffer.h"
 #include "node_external_reference.h"
+#include "node_sampling_profiler.h"
 #include "util-inl.h"
 #include "v8-profiler.h"
 #include "v8.h"
@@ -33,6 +36,7 @@
 namespace node {
 namespace v8_utils {
 using v8::Array;
+using v8::ArrayBuffer;
 using v8::BigInt;
 using v8::CFunction;
 using v8::Context;
@@ -40,12 +44,14 @@ using v8::CpuProfile;
 using v8::CpuProfilingResult;
 using v8::CpuProfilingStatus;
 using v8::DictionaryTemplate;
+using v8::Float64Array;
 using v8::FunctionCallbackInfo;
 using v8::FunctionTemplate;
 using v8::HandleScope;
 using v8::HeapCodeStatistics;
 using v8::HeapSpaceStatistics;
 using v8::HeapStatistics;
+using v8::Int32;
 using v8::Integer;
 using v8::Isolate;
 using v8::Local;
@@ -279,6 +285,40 @@ void StopCpuProfile(const FunctionCallbackInfo<Value>& args) {
   }
 }
 
+void StartSamplingCpuProfile(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  CHECK(args[0]->IsUint32());
+  CHECK(args[1]->IsInt32());
+  uint32_t window_seconds = args[0].As<Uint32>()->Value();
+  int signal = args[1].As<Int32>()->Value();
+  args.GetReturnValue().Set(
+      profiler::SamplingCpuProfiler::Start(env, window_seconds, signal));
+}
+
+void StopSamplingCpuProfile(const FunctionCallbackInfo<Value>& args) {
+  profiler::SamplingCpuProfiler::Stop(Environment::GetCurrent(args));
+}
+
+// Returns the samples of the current window as a gzipped pprof profile.
+void TakeSamplingCpuProfile(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  profiler::SamplingCpuProfiler* profiler = env->sampling_cpu_profiler();
+  if (profiler == nullptr) {
+    return THROW_ERR_CPU_PROFILE_NOT_STARTED(env->isolate(),
+                                             "CPU profile not started");
+  }
+  profiler->Flush();
+  std::string profile = profiler->Serialize();
+  if (profile.empty()) {
+    return THROW_ERR_OPERATION_FAILED(env->isolate(),
+                                      "Failed to compress the CPU profile");
+  }
+  Local<Object> buffer;
+  if (Buffer::Copy(env, profile.data(), profile.size()).ToLocal(&buffer)) {
+    args.GetReturnValue().Set(buffer);
+  }
+}
+
 static void IsStringOneByteRepresentation(
     const FunctionCallbackInfo<Value>& args) {
   CHECK_EQ(args.Length(), 1);
@@ -560,12 +600,16 @@ static void BeforeGCCallback(Isolate* isolate,
   if (profiler->current_gc_type != 0) {
     return;
   }
-  JSONWriter* writer = profiler->writer();
-  writer->json_start();
-  writer->json_keyvalue("gcType", GetGCTypeName(gc_type));
-  writer->json_objectstart("beforeGC");
-  SetHeapStatistics(writer, isolate);
-  writer->json_objectend();
+  if (profiler->binary()) {
+    profiler->RecordSpaceSizesBeforeGC(isolate);
+  } else {
+    JSONWriter* writer = profiler->writer();
+    writer->json_start();
+    writer->json_keyvalue("gcType", GetGCTypeName(gc_type));
+    writer->json_objectstart("beforeGC");
+    SetHeapStatistics(writer, isolate);
+    writer->json_objectend();
+  }
   profiler->current_gc_type = gc_type;
   profiler->start_time = uv_hrtime();
 }
@@ -578,9 +622,16 @@ static void AfterGCCallback(Isolate* isolate,
   if (profiler->current_gc_type != gc_type) {
     return;
   }
-  JSONWriter* writer = profiler->writer();
   profiler->current_gc_type = 0;
-  writer->json_keyvalue("cost", (uv_hrtime() - profiler->start_time) / 1e3);
+  uint64_t duration = uv_hrtime() - profiler->start_time;
+  profiler->RecordPause(gc_type, duration);
+  if (profiler->binary()) {
+    profiler->CommitRecord(isolate, gc_type, duration);
+    profiler->start_time = 0;
+    return;
+  }
+  JSONWriter* writer = profiler->writer();
+  writer->json_keyvalue("cost", duration / 1e3);
   profiler->start_time = 0;
   writer->json_objectstart("afterGC");
   SetHeapStatistics(writer, isolate);
@@ -588,13 +639,89 @@ static void AfterGCCallback(Isolate* isolate,
   writer->json_end();
 }
 
-GCProfiler::GCProfiler(Environment* env, Local<Object> object)
+GCProfiler::GCProfiler(Environment* env,
+                       Local<Object> object,
+                       size_t ring_size)
     : BaseObject(env, object),
       start_time(0),
       current_gc_type(0),
       state(GCProfilerState::kInitialized),
       writer_(out_stream_, false) {
   MakeWeak();
+  for (auto& histogram : pause_histograms_)
+    histogram = std::make_shared<Histogram>(Histogram::Options{});
+  CHECK_LE(ring_size, kMaxRingSize);
+  if (ring_size > 0) {
+    space_count_ = env->isolate()->NumberOfHeapSpaces();
+    records_.resize(ring_size);
+    space_sizes_.resize(ring_size * 2 * space_count_);
+    sizes_before_gc_.resize(space_count_);
+  }
+}
+
+void GCProfiler::RecordSpaceSizesBeforeGC(Isolate* isolate) {
+  // Only the used size is needed, so none of the other statistics are
+  // formatted or stored.
+  HeapSpaceStatistics stats;
+  for (size_t i = 0; i < space_count_; i++) {
+    isolate->GetHeapSpaceStatistics(&stats, i);
+    sizes_before_gc_[i] = stats.space_used_size();
+  }
+}
+
+void GCProfiler::CommitRecord(Isolate* isolate,
+                              v8::GCType gc_type,
+                              uint64_t duration) {
+  // The slot is only overwritten once the GC has finished, so that an
+  // unmatched prologue does not clobber the oldest record.
+  uint64_t* sizes = &space_sizes_[next_record_ * 2 * space_count_];
+  HeapSpaceStatistics stats;
+  for (size_t i = 0; i < space_count_; i++) {
+    isolate->GetHeapSpaceStatistics(&stats, i);
+    sizes[i] = sizes_before_gc_[i];
+    sizes[space_count_ + i] = stats.space_used_size();
+  }
+  records_[next_record_] = {start_time, duration,
+                            static_cast<uint32_t>(gc_type)};
+  next_record_ = (next_record_ + 1) % records_.size();
+  if (record_count_ < records_.size()) record_count_++;
+}
+
+void GCProfiler::RecordPause(v8::GCType gc_type, uint64_t duration) {
+  // GC types are single bits.
+  for (int i = 0; i < kGCTypeCount; i++) {
+    if (gc_type == (1 << i)) {
+      pause_histograms_[i]->Record(duration > 0 ? duration : 1);
+      return;
+    }
+  }
+}
+
+MaybeLocal<Value> GCProfiler::TakeRecordsArray() {
+  Isolate* isolate = env()->isolate();
+  const size_t fields = kRecordFieldCount + space_count_;
+  Local<ArrayBuffer> buffer =
+      ArrayBuffer::New(isolate, record_count_ * fields * sizeof(double));
+  double* out = static_cast<double*>(buffer->Data());
+  size_t index =
+      (next_record_ + records_.size() - record_count_) % records_.size();
+  for (size_t n = 0; n < record_count_; n++) {
+    const Record& record = records_[index];
+    out[kRecordStartTime] = static_cast<double>(record.start_time);
+    out[kRecordDuration] = static_cast<double>(record.duration);
+    out[kRecordGCType] = record.gc_type;
+    const uint64_t* before = &space_sizes_[index * 2 * space_count_];
+    const uint64_t* after = before + space_count_;
+    for (size_t i = 0; i < space_count_; i++) {
+      out[kRecordFieldCount + i] =
+          static_cast<double>(after[i]) - static_cast<double>(before[i]);
+    }
+    out += fields;
+    index = (index + 1) % records_.size();
+  }
+  record_count_ = 0;
+  return Float64Array::New(buffer, 0, buffer->ByteLength() / sizeof(double))
+      .As<Value>();
 }
 
 // This function will be called when
@@ -609,6 +736,16 @@ GCProfiler::~GCProfiler() {
   }
 }
 
+void GCProfiler::MemoryInfo(MemoryTracker* tracker) const {
+  tracker->TrackFieldWithSize("records", records_.capacity() * sizeof(Record));
+  tracker->TrackFieldWithSize("space_sizes",
+                              space_sizes_.capacity() * sizeof(uint64_t));
+  tracker->TrackFieldWithSize("sizes_before_gc",
+                              sizes_before_gc_.capacity() * sizeof(uint64_t));
+  for (const auto& histogram : pause_histograms_)
+    tracker->TrackField("pause_histogram", histogram);
+}
+
 JSONWriter* GCProfiler::writer() {
   return &writer_;
 }
@@ -620,7 +757,13 @@ std::ostringstream* GCProfiler::out_stream() {
 void GCProfiler::New(const FunctionCallbackInfo<Value>& args) {
   CHECK(args.IsConstructCall());
   Environment* env = Environment::GetCurrent(args);
-  new GCProfiler(env, args.This());
+  size_t ring_size = 0;
+  if (args[0]->IsUint32()) ring_size = args[0].As<Uint32>()->Value();
+  if (ring_size > kMaxRingSize) {
+    return THROW_ERR_OUT_OF_RANGE(
+        env, "The ring size must not be greater than %d", kMaxRingSize);
+  }
+  new GCProfiler(env, args.This(), ring_size);
 }
 
 void GCProfiler::Start(const FunctionCallbackInfo<Value>& args) {
@@ -630,6 +773,14 @@ void GCProfiler::Start(const FunctionCallbackInfo<Value>& args) {
   if (profiler->state != GCProfiler::GCProfilerState::kInitialized) {
     return;
   }
+  if (profiler->binary()) {
+    env->isolate()->AddGCPrologueCallback(BeforeGCCallback,
+                                          static_cast<void*>(profiler));
+    env->isolate()->AddGCEpilogueCallback(AfterGCCallback,
+                                          static_cast<void*>(profiler));
+    profiler->state = GCProfiler::GCProfilerState::kStarted;
+    return;
+  }
   profiler->writer()->json_start();
   profiler->writer()->json_keyvalue("version", 1);
 
@@ -655,6 +806,16 @@ void GCProfiler::Stop(const FunctionCallbackInfo<v8::Value>& args) {
   if (profiler->state != GCProfiler::GCProfilerState::kStarted) {
     return;
   }
+  if (profiler->binary()) {
+    env->isolate()->RemoveGCPrologueCallback(BeforeGCCallback, profiler);
+    env->isolate()->RemoveGCEpilogueCallback(AfterGCCallback, profiler);
+    profiler->state = GCProfiler::GCProfilerState::kStopped;
+    Local<Value> ret;
+    if (profiler->TakeRecordsArray().ToLocal(&ret)) {
+      args.GetReturnValue().Set(ret);
+    }
+    return;
+  }
   profiler->writer()->json_arrayend();
   uv_timeval64_t ts;
   if (uv_gettimeofday(&ts) == 0) {
@@ -672,6 +833,31 @@ void GCProfiler::Stop(const FunctionCallbackInfo<v8::Value>& args) {
   }
 }
 
+void GCProfiler::TakeRecords(const FunctionCallbackInfo<Value>& args) {
+  GCProfiler* profiler;
+  ASSIGN_OR_RETURN_UNWRAP(&profiler, args.This());
+  if (!profiler->binary()) return;
+  Local<Value> ret;
+  if (profiler->TakeRecordsArray().ToLocal(&ret)) {
+    args.GetReturnValue().Set(ret);
+  }
+}
+
+void GCProfiler::GetPauseHistograms(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  GCProfiler* profiler;
+  ASSIGN_OR_RETURN_UNWRAP(&profiler, args.This());
+  LocalVector<Value> histograms(env->isolate());
+  for (const auto& pause_histogram : profiler->pause_histograms_) {
+    BaseObjectPtr<HistogramBase> histogram =
+        HistogramBase::Create(env, pause_histogram);
+    if (!histogram) return;
+    histograms.push_back(histogram->object());
+  }
+  args.GetReturnValue().Set(
+      Array::New(env->isolate(), histograms.data(), histograms.size()));
+}
+
 void Initialize(Local<Object> target,
                 Local<Value> unused,
                 Local<Context> context,
@@ -739,6 +925,10 @@ void Initialize(Local<Object> target,
 
   SetMethod(context, target, "startCpuProfile", StartCpuProfile);
   SetMethod(context, target, "stopCpuProfile", StopCpuProfile);
+  SetMethod(
+      context, target, "startSamplingCpuProfile", StartSamplingCpuProfile);
+  SetMethod(context, target, "stopSamplingCpuProfile", StopSamplingCpuProfile);
+  SetMethod(context, target, "takeSamplingCpuProfile", TakeSamplingCpuProfile);
 
   // Export symbols used by v8.isStringOneByteRepresentation()
   SetFastMethodNoSideEffect(context,
@@ -755,6 +945,9 @@ void Initialize(Local<Object> target,
   t->InstanceTemplate()->SetInternalFieldCount(BaseObject::kInternalFieldCount);
   SetProtoMethod(env->isolate(), t, "start", GCProfiler::Start);
   SetProtoMethod(env->isolate(), t, "stop", GCProfiler::Stop);
+  SetProtoMethod(env->isolate(), t, "takeRecords", GCProfiler::TakeRecords);
+  SetProtoMethod(
+      env->isolate(), t, "getPauseHistograms", GCProfiler::GetPauseHistograms);
   SetConstructorFunction(context, target, "GCProfiler", t);
 
   {
@@ -781,11 +974,16 @@ void RegisterExternalReferences(ExternalReferenceRegistry* registry) {
   registry->Register(GCProfiler::New);
   registry->Register(GCProfiler::Start);
   registry->Register(GCProfiler::Stop);
+  registry->Register(GCProfiler::TakeRecords);
+  registry->Register(GCProfiler::GetPauseHistograms);
   registry->Register(GetCppHeapStatistics);
   registry->Register(IsStringOneByteRepresentation);
   registry->Register(fast_is_string_one_byte_representation_);
   registry->Register(StartCpuProfile);
   registry->Register(StopCpuProfile);
+  registry->Register(StartSamplingCpuProfile);
+  registry->Register(StopSamplingCpuProfile);
+  registry->Register(TakeSamplingCpuProfile);
 }
 
 }  // namespace v8_utils
@@ -3,9 +3,12 @@
 
 #if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
 
+#include <memory>
 #include <sstream>
+#include <vector>
 #include "aliased_buffer.h"
 #include "base_object.h"
+#include "histogram.h"
 #include "json_utils.h"
 #include "node_errors.h"
 #include "node_snapshotable.h"
@@ -46,17 +49,45 @@ class BindingData : public SnapshotableObject {
 class GCProfiler : public BaseObject {
  public:
   enum class GCProfilerState { kInitialized, kStarted, kStopped };
-  GCProfiler(Environment* env, v8::Local<v8::Object> object);
+  // One pause histogram per v8::GCType bit.
+  static constexpr int kGCTypeCount = 5;
+  // Fields per record returned by takeRecords(), followed by one used size
+  // delta per heap space.
+  enum RecordField {
+    kRecordStartTime,
+    kRecordDuration,
+    kRecordGCType,
+    kRecordFieldCount
+  };
+
+  // Bounds the memory preallocated for the ring, which is a few hundred
+  // bytes per record depending on the number of heap spaces.
+  static constexpr size_t kMaxRingSize = 1 << 16;
+
+  // ring_size == 0 selects the JSON output. Otherwise GCs are recorded in a
+  // preallocated ring of that many fixed-size records, overwriting the
+  // oldest ones when it is full. ring_size must not exceed kMaxRingSize.
+  GCProfiler(Environment* env, v8::Local<v8::Object> object, size_t ring_size);
   inline ~GCProfiler() override;
   static void New(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Start(const v8::FunctionCallbackInfo<v8::Value>& args);
   static void Stop(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void TakeRecords(const v8::FunctionCallbackInfo<v8::Value>& args);
+  static void GetPauseHistograms(
+      const v8::FunctionCallbackInfo<v8::Value>& args);
 
   JSONWriter* writer();
 
   std::ostringstream* out_stream();
 
-  SET_NO_MEMORY_INFO()
+  bool binary() const { return !records_.empty(); }
+  void RecordSpaceSizesBeforeGC(v8::Isolate* isolate);
+  void CommitRecord(v8::Isolate* isolate,
+                    v8::GCType gc_type,
+                    uint64_t duration);
+  void RecordPause(v8::GCType gc_type, uint64_t duration);
+
+  void MemoryInfo(MemoryTracker* tracker) const override;
   SET_MEMORY_INFO_NAME(GCProfiler)
   SET_SELF_SIZE(GCProfiler)
 
@@ -65,8 +96,29 @@ class GCProfiler : public BaseObject {
   GCProfilerState state;
 
  private:
+  struct Record {
+    uint64_t start_time;
+    uint64_t duration;
+    uint32_t gc_type;
+  };
+
+  // Returns the records in the ring, oldest first, as a Float64Array and
+  // empties the ring.
+  v8::MaybeLocal<v8::Value> TakeRecordsArray();
+
   std::ostringstream out_stream_;
   JSONWriter writer_;
+
+  // Binary mode. The used size of every heap space is stored before and
+  // after each GC, the deltas are only computed in TakeRecordsArray().
+  size_t space_count_ = 0;
+  std::vector<Record> records_;
+  std::vector<uint64_t> space_sizes_;
+  std::vector<uint64_t> sizes_before_gc_;
+  size_t next_record_ = 0;
+  size_t record_count_ = 0;
+
+  std::shared_ptr<Histogram> pause_histograms_[kGCTypeCount];
 };
 
 }  // namespace v8_utils
@@ -72,6 +72,8 @@ struct V8Platform {
     node::tracing::TraceEventHelper::SetAgent(tracing_agent_.get());
     node::tracing::TracingController* controller =
         tracing_agent_->GetTracingController();
+    controller->set_use_coarse_clock(
+        per_process::cli_options->trace_event_coarse_clock);
     trace_state_observer_ =
         std::make_unique<NodeTraceStateObserver>(controller);
     controller->AddTraceStateObserver(trace_state_observer_.get());
@@ -122,11 +124,16 @@ struct V8Platform {
       auto categories = std::views::split(
           per_process::cli_options->trace_event_categories, ","sv);
 
+      auto format = per_process::cli_options->trace_event_format == "perfetto"
+                        ? tracing::NodeTraceWriter::Format::kPerfetto
+                        : tracing::NodeTraceWriter::Format::kJSON;
+
       tracing_file_writer_ = tracing_agent_->AddClient(
           convert_to_set(categories),
           std::unique_ptr<tracing::AsyncTraceWriter>(
               new tracing::NodeTraceWriter(
-                  per_process::cli_options->trace_event_file_pattern)),
+                  per_process::cli_options->trace_event_file_pattern,
+                  format)),
           tracing::Agent::kUseDefaultCategories);
     }
   }
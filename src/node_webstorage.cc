@@ -6,10 +6,17 @@
 #include "node.h"
 #include "node_errors.h"
 #include "node_mem-inl.h"
+#include "node_process-inl.h"
 #include "path.h"
 #include "sqlite3.h"
 #include "util-inl.h"
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+#include <vector>
+
 namespace node {
 namespace webstorage {
 
@@ -82,6 +89,63 @@ static void ThrowQuotaExceededException(Local<Context> context) {
   isolate->ThrowException(exception);
 }
 
+static std::u16string ToU16String(Isolate* isolate, Local<Value> value) {
+  TwoByteValue utf16(isolate, value);
+  return std::u16string(reinterpret_cast<const char16_t*>(utf16.out()),
+                        utf16.length());
+}
+
+static MaybeLocal<String> ToV8String(Isolate* isolate,
+                                     const std::u16string& str) {
+  return String::NewFromTwoByte(isolate,
+                                reinterpret_cast<const uint16_t*>(str.data()),
+                                NewStringType::kNormal,
+                                str.size());
+}
+
+static std::u16string ColumnToU16String(sqlite3_stmt* stmt, int column) {
+  CHECK(sqlite3_column_type(stmt, column) == SQLITE_BLOB);
+  auto size = sqlite3_column_bytes(stmt, column) / sizeof(char16_t);
+  return std::u16string(
+      reinterpret_cast<const char16_t*>(sqlite3_column_blob(stmt, column)),
+      size);
+}
+
+bool KeyLess::operator()(const std::u16string& a,
+                         const std::u16string& b) const {
+  size_t length = std::min(a.size(), b.size());
+  int r = length == 0
+              ? 0
+              : memcmp(a.data(), b.data(), length * sizeof(char16_t));
+  return r != 0 ? r < 0 : a.size() < b.size();
+}
+
+static uint64_t EntrySize(const std::u16string& key,
+                          const std::u16string& value) {
+  return (key.size() + value.size()) * sizeof(char16_t);
+}
+
+// Prepares sql into *stmt on first use and resets it on subsequent ones.
+static int PrepareCached(sqlite3* db,
+                         stmt_unique_ptr* stmt,
+                         std::string_view sql) {
+  if (*stmt) {
+    sqlite3_reset(stmt->get());
+    return sqlite3_clear_bindings(stmt->get());
+  }
+  sqlite3_stmt* s = nullptr;
+  int r = sqlite3_prepare_v3(
+      db, sql.data(), sql.size(), SQLITE_PREPARE_PERSISTENT, &s, 0);
+  *stmt = stmt_unique_ptr(s);
+  return r;
+}
+
+static int StepToCompletion(sqlite3_stmt* stmt) {
+  int r = sqlite3_step(stmt);
+  sqlite3_reset(stmt);
+  return r == SQLITE_DONE ? SQLITE_OK : r;
+}
+
 Storage::Storage(Environment* env,
                  Local<Object> object,
                  std::string_view location)
@@ -93,6 +157,14 @@ Storage::Storage(Environment* env,
 }
 
 Storage::~Storage() {
+  if (db_ != nullptr && location_ != kInMemoryPath) {
+    env()->RemoveAtExit(FlushAtExit, this);
+  }
+  // Errors cannot be reported anymore at this point, the changes are lost.
+  Flush();
+  clear_stmt_ = nullptr;
+  delete_stmt_ = nullptr;
+  upsert_stmt_ = nullptr;
   db_ = nullptr;
 }
 
@@ -202,10 +274,172 @@ Maybe<void> Storage::Open() {
     CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Nothing<void>());
   }
 
+  CHECK_ERROR_OR_THROW(env(), ReadEntries(db), SQLITE_OK, Nothing<void>());
+
   db_ = conn_unique_ptr(db);
+  // process.exit() does not destroy the Storage object, so the pending
+  // changes have to be written from an exit callback as well. The
+  // destructor removes the callback again.
+  if (location_ != kInMemoryPath) {
+    env()->AtExit(FlushAtExit, this);
+  }
   return JustVoid();
 }
 
+int Storage::ReadEntries(sqlite3* db) {
+  static constexpr std::string_view max_size_sql =
+      "SELECT max_size FROM nodejs_webstorage_state";
+  static constexpr std::string_view entries_sql =
+      "SELECT key, value FROM nodejs_webstorage ORDER BY key";
+
+  sqlite3_stmt* s = nullptr;
+  int r =
+      sqlite3_prepare_v2(db, max_size_sql.data(), max_size_sql.size(), &s, 0);
+  if (r != SQLITE_OK) return r;
+  auto stmt = stmt_unique_ptr(s);
+  r = sqlite3_step(stmt.get());
+  if (r != SQLITE_ROW) return r;
+  CHECK(sqlite3_column_type(stmt.get(), 0) == SQLITE_INTEGER);
+  max_size_ = sqlite3_column_int64(stmt.get(), 0);
+
+  r = sqlite3_prepare_v2(db, entries_sql.data(), entries_sql.size(), &s, 0);
+  if (r != SQLITE_OK) return r;
+  stmt = stmt_unique_ptr(s);
+  entries_.clear();
+  total_size_ = 0;
+  while ((r = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+    std::u16string key = ColumnToU16String(stmt.get(), 0);
+    std::u16string value = ColumnToU16String(stmt.get(), 1);
+    total_size_ += EntrySize(key, value);
+    entries_.emplace_hint(entries_.end(), std::move(key), std::move(value));
+  }
+  return r == SQLITE_DONE ? SQLITE_OK : r;
+}
+
+void Storage::MarkDirty(const std::u16string& key) {
+  // An in-memory database would only ever be read from the mirror.
+  if (location_ == kInMemoryPath) return;
+
+  if (dirty_.find(key) == dirty_.end()) {
+    uint64_t persisted_size = 0;
+    auto it = entries_.find(key);
+    if (!cleared_ && it != entries_.end()) {
+      persisted_size = EntrySize(it->first, it->second);
+    }
+    dirty_.emplace(key, persisted_size);
+  }
+  ScheduleFlush();
+}
+
+void Storage::ScheduleFlush() {
+  if (flush_scheduled_) return;
+  flush_scheduled_ = true;
+  env()->SetImmediate([self = BaseObjectPtr<Storage>(this)](Environment* env) {
+    self->flush_scheduled_ = false;
+    int r = self->Flush();
+    if (r != SQLITE_OK && env->can_call_into_js()) {
+      ProcessEmitWarning(
+          env, "localStorage could not be written: %s", sqlite3_errstr(r));
+    }
+  });
+}
+
+int Storage::Flush() {
+  if (db_ == nullptr || (!cleared_ && dirty_.empty())) {
+    return SQLITE_OK;
+  }
+
+  int r = sqlite3_exec(db_.get(), "BEGIN", 0, 0, nullptr);
+  if (r != SQLITE_OK) return r;
+  r = WriteDirtyEntries();
+  if (r == SQLITE_OK) {
+    r = sqlite3_exec(db_.get(), "COMMIT", 0, 0, nullptr);
+  }
+  if (r != SQLITE_OK) {
+    sqlite3_exec(db_.get(), "ROLLBACK", 0, 0, nullptr);
+    return r;
+  }
+
+  dirty_.clear();
+  cleared_ = false;
+  return SQLITE_OK;
+}
+
+int Storage::WriteDirtyEntries() {
+  static constexpr std::string_view clear_sql = "DELETE FROM nodejs_webstorage";
+  static constexpr std::string_view delete_sql =
+      "DELETE FROM nodejs_webstorage WHERE key = ?";
+  static constexpr std::string_view upsert_sql =
+      "INSERT INTO nodejs_webstorage (key, value) VALUES (?, ?)"
+      "  ON CONFLICT (key) DO UPDATE SET value = EXCLUDED.value"
+      "  WHERE EXCLUDED.key = key";
+  sqlite3* db = db_.get();
+  int r;
+
+  if (cleared_) {
+    r = PrepareCached(db, &clear_stmt_, clear_sql);
+    if (r != SQLITE_OK) return r;
+    r = StepToCompletion(clear_stmt_.get());
+    if (r != SQLITE_OK) return r;
+  }
+
+  // Deletions go first and the remaining writes in the order of how much
+  // they grow the database, so that the total size never exceeds the size
+  // that the quota was checked against.
+  std::vector<std::pair<int64_t, EntryMap::const_iterator>> upserts;
+  for (const auto& [key, persisted_size] : dirty_) {
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      int64_t growth =
+          static_cast<int64_t>(EntrySize(it->first, it->second)) -
+          static_cast<int64_t>(persisted_size);
+      upserts.emplace_back(growth, it);
+      continue;
+    }
+    if (cleared_) continue;
+
+    r = PrepareCached(db, &delete_stmt_, delete_sql);
+    if (r != SQLITE_OK) return r;
+    r = sqlite3_bind_blob(delete_stmt_.get(),
+                          1,
+                          key.data(),
+                          key.size() * sizeof(char16_t),
+                          SQLITE_STATIC);
+    if (r != SQLITE_OK) return r;
+    r = StepToCompletion(delete_stmt_.get());
+    if (r != SQLITE_OK) return r;
+  }
+
+  std::stable_sort(
+      upserts.begin(), upserts.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+      });
+  for (const auto& [growth, it] : upserts) {
+    r = PrepareCached(db, &upsert_stmt_, upsert_sql);
+    if (r != SQLITE_OK) return r;
+    r = sqlite3_bind_blob(upsert_stmt_.get(),
+                          1,
+                          it->first.data(),
+                          it->first.size() * sizeof(char16_t),
+                          SQLITE_STATIC);
+    if (r != SQLITE_OK) return r;
+    r = sqlite3_bind_blob(upsert_stmt_.get(),
+                          2,
+                          it->second.data(),
+                          it->second.size() * sizeof(char16_t),
+                          SQLITE_STATIC);
+    if (r != SQLITE_OK) return r;
+    r = StepToCompletion(upsert_stmt_.get());
+    if (r != SQLITE_OK) return r;
+  }
+
+  return SQLITE_OK;
+}
+
+void Storage::FlushAtExit(void* data) {
+  static_cast<Storage*>(data)->Flush();
+}
+
 void Storage::New(const FunctionCallbackInfo<Value>& args) {
   Environment* env = Environment::GetCurrent(args);
   Realm* realm = Realm::GetCurrent(args);
@@ -233,16 +467,18 @@ Maybe<void> Storage::Clear() {
     return Nothing<void>();
   }
 
-  static constexpr std::string_view sql = "DELETE FROM nodejs_webstorage";
-  sqlite3_stmt* s = nullptr;
-  CHECK_ERROR_OR_THROW(
-      env(),
-      sqlite3_prepare_v2(db_.get(), sql.data(), sql.size(), &s, 0),
-      SQLITE_OK,
-      Nothing<void>());
-  auto stmt = stmt_unique_ptr(s);
-  CHECK_ERROR_OR_THROW(
-      env(), sqlite3_step(stmt.get()), SQLITE_DONE, Nothing<void>());
+  if (entries_.empty()) {
+    return JustVoid();
+  }
+
+  entries_.clear();
+  total_size_ = 0;
+  key_cursor_valid_ = false;
+  dirty_.clear();
+  if (location_ != kInMemoryPath) {
+    cleared_ = true;
+    ScheduleFlush();
+  }
   return JustVoid();
 }
 
@@ -251,27 +487,15 @@ MaybeLocal<Array> Storage::Enumerate() {
     return Local<Array>();
   }
 
-  static constexpr std::string_view sql = "SELECT key FROM nodejs_webstorage";
-  sqlite3_stmt* s = nullptr;
-  int r = sqlite3_prepare_v2(db_.get(), sql.data(), sql.size(), &s, 0);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Local<Array>());
-  auto stmt = stmt_unique_ptr(s);
   LocalVector<Value> values(env()->isolate());
-  Local<Value> value;
-  while ((r = sqlite3_step(stmt.get())) == SQLITE_ROW) {
-    CHECK(sqlite3_column_type(stmt.get(), 0) == SQLITE_BLOB);
-    auto size = sqlite3_column_bytes(stmt.get(), 0) / sizeof(uint16_t);
-    if (!String::NewFromTwoByte(env()->isolate(),
-                                reinterpret_cast<const uint16_t*>(
-                                    sqlite3_column_blob(stmt.get(), 0)),
-                                NewStringType::kNormal,
-                                size)
-             .ToLocal(&value)) {
+  values.reserve(entries_.size());
+  Local<String> value;
+  for (const auto& entry : entries_) {
+    if (!ToV8String(env()->isolate(), entry.first).ToLocal(&value)) {
       return Local<Array>();
     }
     values.emplace_back(value);
   }
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_DONE, Local<Array>());
   return Array::New(env()->isolate(), values.data(), values.size());
 }
 
@@ -280,17 +504,7 @@ MaybeLocal<Value> Storage::Length() {
     return {};
   }
 
-  static constexpr std::string_view sql =
-      "SELECT count(*) FROM nodejs_webstorage";
-  sqlite3_stmt* s = nullptr;
-  int r = sqlite3_prepare_v2(db_.get(), sql.data(), sql.size(), &s, 0);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Local<Value>());
-  auto stmt = stmt_unique_ptr(s);
-  CHECK_ERROR_OR_THROW(
-      env(), sqlite3_step(stmt.get()), SQLITE_ROW, Local<Value>());
-  CHECK(sqlite3_column_type(stmt.get(), 0) == SQLITE_INTEGER);
-  int result = sqlite3_column_int(stmt.get(), 0);
-  return Integer::New(env()->isolate(), result);
+  return Integer::NewFromUnsigned(env()->isolate(), entries_.size());
 }
 
 MaybeLocal<Value> Storage::Load(Local<Name> key) {
@@ -303,32 +517,11 @@ MaybeLocal<Value> Storage::Load(Local<Name> key) {
     return {};
   }
 
-  static constexpr std::string_view sql =
-      "SELECT value FROM nodejs_webstorage WHERE key = ? LIMIT 1";
-  sqlite3_stmt* s = nullptr;
-  int r = sqlite3_prepare_v2(db_.get(), sql.data(), sql.size(), &s, 0);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Local<Value>());
-  auto stmt = stmt_unique_ptr(s);
-  TwoByteValue utf16key(env()->isolate(), key);
-  auto key_size = utf16key.length() * sizeof(uint16_t);
-  r = sqlite3_bind_blob(stmt.get(), 1, utf16key.out(), key_size, SQLITE_STATIC);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Local<Value>());
-  r = sqlite3_step(stmt.get());
-  if (r == SQLITE_ROW) {
-    CHECK(sqlite3_column_type(stmt.get(), 0) == SQLITE_BLOB);
-    auto size = sqlite3_column_bytes(stmt.get(), 0) / sizeof(uint16_t);
-    return String::NewFromTwoByte(env()->isolate(),
-                                  reinterpret_cast<const uint16_t*>(
-                                      sqlite3_column_blob(stmt.get(), 0)),
-                                  NewStringType::kNormal,
-                                  size)
-        .As<Value>();
-  } else if (r != SQLITE_DONE) {
-    THROW_SQLITE_ERROR(env(), r);
-    return {};
-  } else {
+  auto it = entries_.find(ToU16String(env()->isolate(), key));
+  if (it == entries_.end()) {
     return Null(env()->isolate());
   }
+  return ToV8String(env()->isolate(), it->second).As<Value>();
 }
 
 MaybeLocal<Value> Storage::LoadKey(const int index) {
@@ -336,31 +529,34 @@ MaybeLocal<Value> Storage::LoadKey(const int index) {
     return {};
   }
 
-  static constexpr std::string_view sql =
-      "SELECT key FROM nodejs_webstorage LIMIT 1 OFFSET ?";
-  sqlite3_stmt* s = nullptr;
-  int r = sqlite3_prepare_v2(db_.get(), sql.data(), sql.size(), &s, 0);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Local<Value>());
-  auto stmt = stmt_unique_ptr(s);
-  r = sqlite3_bind_int(stmt.get(), 1, index);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Local<Value>());
-
-  r = sqlite3_step(stmt.get());
-  if (r == SQLITE_ROW) {
-    CHECK(sqlite3_column_type(stmt.get(), 0) == SQLITE_BLOB);
-    auto size = sqlite3_column_bytes(stmt.get(), 0) / sizeof(uint16_t);
-    return String::NewFromTwoByte(env()->isolate(),
-                                  reinterpret_cast<const uint16_t*>(
-                                      sqlite3_column_blob(stmt.get(), 0)),
-                                  NewStringType::kNormal,
-                                  size)
-        .As<Value>();
-  } else if (r != SQLITE_DONE) {
-    THROW_SQLITE_ERROR(env(), r);
-    return {};
-  } else {
+  size_t target = static_cast<size_t>(index);
+  if (target >= entries_.size()) {
     return Null(env()->isolate());
   }
+
+  // Move the cursor from whichever of the beginning, the end or its last
+  // position is closest, which makes sequential access O(1) per step.
+  if (!key_cursor_valid_) {
+    key_cursor_ = entries_.begin();
+    key_cursor_index_ = 0;
+    key_cursor_valid_ = true;
+  }
+  size_t from_cursor = target > key_cursor_index_
+                           ? target - key_cursor_index_
+                           : key_cursor_index_ - target;
+  if (target < from_cursor) {
+    key_cursor_ = entries_.begin();
+    key_cursor_index_ = 0;
+  } else if (entries_.size() - target < from_cursor) {
+    key_cursor_ = entries_.end();
+    key_cursor_index_ = entries_.size();
+  }
+  std::advance(key_cursor_,
+               static_cast<ptrdiff_t>(target) -
+                   static_cast<ptrdiff_t>(key_cursor_index_));
+  key_cursor_index_ = target;
+
+  return ToV8String(env()->isolate(), key_cursor_->first).As<Value>();
 }
 
 Maybe<void> Storage::Remove(Local<Name> key) {
@@ -374,18 +570,15 @@ Maybe<void> Storage::Remove(Local<Name> key) {
     return Nothing<void>();
   }
 
-  static constexpr std::string_view sql =
-      "DELETE FROM nodejs_webstorage WHERE key = ?";
-  sqlite3_stmt* s = nullptr;
-  int r = sqlite3_prepare_v2(db_.get(), sql.data(), sql.size(), &s, 0);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Nothing<void>());
-  auto stmt = stmt_unique_ptr(s);
-  TwoByteValue utf16key(env()->isolate(), key);
-  auto key_size = utf16key.length() * sizeof(uint16_t);
-  r = sqlite3_bind_blob(stmt.get(), 1, utf16key.out(), key_size, SQLITE_STATIC);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Nothing<void>());
-  CHECK_ERROR_OR_THROW(
-      env(), sqlite3_step(stmt.get()), SQLITE_DONE, Nothing<void>());
+  auto it = entries_.find(ToU16String(env()->isolate(), key));
+  if (it == entries_.end()) {
+    return JustVoid();
+  }
+
+  MarkDirty(it->first);
+  total_size_ -= EntrySize(it->first, it->second);
+  entries_.erase(it);
+  key_cursor_valid_ = false;
   return JustVoid();
 }
 
@@ -405,30 +598,31 @@ Maybe<void> Storage::Store(Local<Name> key, Local<Value> value) {
     return Nothing<void>();
   }
 
-  static constexpr std::string_view sql =
-      "INSERT INTO nodejs_webstorage (key, value) VALUES (?, ?)"
-      "  ON CONFLICT (key) DO UPDATE SET value = EXCLUDED.value"
-      "  WHERE EXCLUDED.key = key";
-  sqlite3_stmt* s = nullptr;
-  TwoByteValue utf16key(env()->isolate(), key);
-  TwoByteValue utf16val(env()->isolate(), val);
-  int r = sqlite3_prepare_v2(db_.get(), sql.data(), sql.size(), &s, 0);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Nothing<void>());
-  auto stmt = stmt_unique_ptr(s);
-  auto key_size = utf16key.length() * sizeof(uint16_t);
-  r = sqlite3_bind_blob(stmt.get(), 1, utf16key.out(), key_size, SQLITE_STATIC);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Nothing<void>());
-  auto val_size = utf16val.length() * sizeof(uint16_t);
-  r = sqlite3_bind_blob(stmt.get(), 2, utf16val.out(), val_size, SQLITE_STATIC);
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_OK, Nothing<void>());
+  std::u16string utf16key = ToU16String(env()->isolate(), key);
+  std::u16string utf16val = ToU16String(env()->isolate(), val);
+  uint64_t new_size = EntrySize(utf16key, utf16val);
+  uint64_t old_size = 0;
+  auto it = entries_.find(utf16key);
+  if (it != entries_.end()) {
+    if (it->second == utf16val) {
+      return JustVoid();
+    }
+    old_size = EntrySize(it->first, it->second);
+  }
 
-  r = sqlite3_step(stmt.get());
-  if (r == SQLITE_CONSTRAINT) {
+  if (total_size_ - old_size + new_size > max_size_) {
     ThrowQuotaExceededException(env()->context());
     return Nothing<void>();
   }
 
-  CHECK_ERROR_OR_THROW(env(), r, SQLITE_DONE, Nothing<void>());
+  MarkDirty(utf16key);
+  total_size_ = total_size_ - old_size + new_size;
+  if (it != entries_.end()) {
+    it->second = std::move(utf16val);
+  } else {
+    entries_.emplace(std::move(utf16key), std::move(utf16val));
+    key_cursor_valid_ = false;
+  }
   return JustVoid();
 }
 
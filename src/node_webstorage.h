@@ -8,6 +8,9 @@
 #include "sqlite3.h"
 #include "util.h"
 
+#include <map>
+#include <string>
+
 namespace node {
 namespace webstorage {
 
@@ -25,6 +28,20 @@ using stmt_unique_ptr = std::unique_ptr<sqlite3_stmt, stmt_deleter>;
 
 static constexpr std::string_view kInMemoryPath = ":memory:";
 
+// Orders keys the way SQLite orders the BLOBs they are stored as, so that
+// key(index) and the enumeration order do not depend on whether the entries
+// come from the database or from memory: bytewise as by memcmp(), and a key
+// that is a prefix of another one first.
+struct KeyLess {
+  bool operator()(const std::u16string& a, const std::u16string& b) const;
+};
+
+// The storage is mirrored in memory. It is read from the database once, when
+// it is first accessed, and all reads are served from the mirror afterwards.
+// Changes are applied to the mirror synchronously and written back to the
+// database in a single transaction once the event loop is idle, when the
+// process exits, or when the Storage object is destroyed.
+
 class Storage : public BaseObject {
  public:
   Storage(Environment* env,
@@ -45,12 +62,45 @@ class Storage : public BaseObject {
   SET_SELF_SIZE(Storage)
 
  private:
+  using EntryMap = std::map<std::u16string, std::u16string, KeyLess>;
+
   v8::Maybe<void> Open();
+  int ReadEntries(sqlite3* db);
+  // Records that key has changed since the last flush and schedules one.
+  void MarkDirty(const std::u16string& key);
+  void ScheduleFlush();
+  // Writes all changes since the last flush to the database. Returns an
+  // SQLite result code. On failure, the changes stay pending.
+  int Flush();
+  int WriteDirtyEntries();
+  static void FlushAtExit(void* data);
 
   ~Storage() override;
   std::string location_;
   conn_unique_ptr db_;
+  stmt_unique_ptr clear_stmt_;
+  stmt_unique_ptr delete_stmt_;
+  stmt_unique_ptr upsert_stmt_;
   v8::Global<v8::Map> symbols_;
+
+  EntryMap entries_;
+  // Size in bytes of the keys and values in entries_, as counted against
+  // max_size_.
+  uint64_t total_size_ = 0;
+  uint64_t max_size_ = 0;
+  // Keys that changed since the last flush, mapped to the size their entry
+  // had in the database at that time (0 if it did not exist). The sizes are
+  // used to order the writes so that the quota triggers never see an
+  // intermediate state above the quota.
+  std::map<std::u16string, uint64_t> dirty_;
+  // Whether all entries have to be deleted before dirty_ is written.
+  bool cleared_ = false;
+  bool flush_scheduled_ = false;
+  // LoadKey() remembers its last position so that iterating over the keys
+  // by index does not start from the beginning for each of them.
+  EntryMap::const_iterator key_cursor_;
+  size_t key_cursor_index_ = 0;
+  bool key_cursor_valid_ = false;
 };
 
 }  // namespace webstorage
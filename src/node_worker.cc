@@ -50,6 +50,7 @@ using v8::ResourceConstraints;
 using v8::SealHandleScope;
 using v8::String;
 using v8::TryCatch;
+using v8::Uint32;
 using v8::Value;
 
 namespace node {
@@ -163,7 +164,7 @@ void Worker::UpdateResourceConstraints(ResourceConstraints* constraints) {
 class WorkerThreadData {
  public:
   explicit WorkerThreadData(Worker* w)
-    : w_(w) {
+    : w_(w), platform_(w->platform_) {
     int ret = uv_loop_init(&loop_);
     if (ret != 0) {
       char err_buf[128];
@@ -173,61 +174,57 @@ class WorkerThreadData {
       return;
     }
     loop_init_failed_ = false;
-    uv_loop_configure(&loop_, UV_METRICS_IDLE_TIME);
 
-    std::shared_ptr<ArrayBufferAllocator> allocator =
-        ArrayBufferAllocator::Create();
-    Isolate::CreateParams params;
-    SetIsolateCreateParamsForNode(&params);
-    w->UpdateResourceConstraints(&params.constraints);
-    params.array_buffer_allocator_shared = allocator;
-    Isolate* isolate =
-        NewIsolate(&params, &loop_, w->platform_, w->snapshot_data());
-    if (isolate == nullptr) {
+    if (!CreateIsolate(w->snapshot_data(),
+                       w->stack_base_,
+                       [w](ResourceConstraints* constraints) {
+                         w->UpdateResourceConstraints(constraints);
+                       })) {
       // TODO(joyeecheung): maybe this should be kBootstrapFailure instead?
       w->Exit(ExitCode::kGenericUserError,
               "ERR_WORKER_INIT_FAILED",
               "Failed to create new Isolate");
       return;
     }
+    AttachToWorker(w);
+  }
 
-    SetIsolateUpForNode(isolate);
-
-    // Be sure it's called before Environment::InitializeDiagnostics()
-    // so that this callback stays when the callback of
-    // --heapsnapshot-near-heap-limit gets is popped.
-    isolate->AddNearHeapLimitCallback(Worker::NearHeapLimit, w);
-
-    {
-      Locker locker(isolate);
-      Isolate::Scope isolate_scope(isolate);
-      // V8 computes its stack limit the first time a `Locker` is used based on
-      // --stack-size. Reset it to the correct value.
-      isolate->SetStackLimit(w->stack_base_);
+  // Used by WorkerPool to set up the event loop, the Isolate and its main
+  // Context ahead of time, before the Worker that is going to use them
+  // exists. AttachToWorker() completes the setup.
+  WorkerThreadData(MultiIsolatePlatform* platform,
+                   const SnapshotData* snapshot_data,
+                   uintptr_t stack_base)
+      : w_(nullptr), platform_(platform) {
+    CHECK_NOT_NULL(snapshot_data);
+    if (uv_loop_init(&loop_) != 0) return;
+    loop_init_failed_ = false;
 
-      HandleScope handle_scope(isolate);
-      isolate_data_.reset(IsolateData::CreateIsolateData(
-          isolate,
-          &loop_,
-          w_->platform_,
-          allocator.get(),
-          w->snapshot_data()->AsEmbedderWrapper().get(),
-          std::move(w_->per_isolate_opts_)));
-      CHECK(isolate_data_);
-      CHECK(!isolate_data_->is_building_snapshot());
-      isolate_data_->set_worker_context(w_);
-      isolate_data_->max_young_gen_size =
-          params.constraints.max_young_generation_size_in_bytes();
+    if (!CreateIsolate(snapshot_data,
+                       stack_base,
+                       [stack_base](ResourceConstraints* constraints) {
+                         constraints->set_stack_limit(
+                             reinterpret_cast<uint32_t*>(stack_base));
+                       })) {
+      return;
     }
 
-    Mutex::ScopedLock lock(w_->mutex_);
-    w_->isolate_ = isolate;
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    HandleScope handle_scope(isolate_);
+    TryCatch try_catch(isolate_);
+    Local<Context> context;
+    if (Context::FromSnapshot(isolate_, SnapshotData::kNodeBaseContextIndex)
+            .ToLocal(&context) &&
+        InitializeContextRuntime(context).IsJust()) {
+      context_.Reset(isolate_, context);
+    }
   }
 
   ~WorkerThreadData() {
-    Debug(w_, "Worker %llu dispose isolate", w_->thread_id_.id);
-    Isolate* isolate;
-    {
+    Isolate* isolate = isolate_;
+    if (w_ != nullptr) {
+      Debug(w_, "Worker %llu dispose isolate", w_->thread_id_.id);
       Mutex::ScopedLock lock(w_->mutex_);
       isolate = w_->isolate_;
       w_->isolate_ = nullptr;
@@ -242,14 +239,15 @@ class WorkerThreadData {
       {
         Locker locker(isolate);
         Isolate::Scope isolate_scope(isolate);
+        context_.Reset();
         isolate_data_.reset();
       }
 
-      w_->platform_->AddIsolateFinishedCallback(isolate, [](void* data) {
+      platform_->AddIsolateFinishedCallback(isolate, [](void* data) {
         *static_cast<bool*>(data) = true;
       }, &platform_finished);
 
-      w_->platform_->DisposeIsolate(isolate);
+      platform_->DisposeIsolate(isolate);
 
       // Wait until the platform has cleaned up all relevant resources.
       while (!platform_finished) {
@@ -262,13 +260,82 @@ class WorkerThreadData {
   }
 
   bool loop_is_usable() const { return !loop_init_failed_; }
+  bool is_prewarmed() const { return !context_.IsEmpty(); }
+
+  // Creates the per-Isolate data for w and makes the Isolate its own.
+  void AttachToWorker(Worker* w) {
+    w_ = w;
+    // For prewarmed Isolates, this records the default limits they were
+    // created with. Otherwise, it has already happened in CreateIsolate().
+    w->UpdateResourceConstraints(&constraints_);
+
+    // Be sure it's called before Environment::InitializeDiagnostics()
+    // so that this callback stays when the callback of
+    // --heapsnapshot-near-heap-limit gets is popped.
+    isolate_->AddNearHeapLimitCallback(Worker::NearHeapLimit, w);
+
+    {
+      Locker locker(isolate_);
+      Isolate::Scope isolate_scope(isolate_);
+      // V8 computes its stack limit the first time a `Locker` is used based on
+      // --stack-size. Reset it to the correct value.
+      isolate_->SetStackLimit(w->stack_base_);
+
+      HandleScope handle_scope(isolate_);
+      isolate_data_.reset(IsolateData::CreateIsolateData(
+          isolate_,
+          &loop_,
+          platform_,
+          allocator_.get(),
+          w->snapshot_data()->AsEmbedderWrapper().get(),
+          std::move(w->per_isolate_opts_)));
+      CHECK(isolate_data_);
+      CHECK(!isolate_data_->is_building_snapshot());
+      isolate_data_->set_worker_context(w);
+      isolate_data_->max_young_gen_size =
+          constraints_.max_young_generation_size_in_bytes();
+    }
+
+    Mutex::ScopedLock lock(w->mutex_);
+    w->isolate_ = isolate_;
+  }
 
  private:
-  Worker* const w_;
+  template <typename Fn>
+  bool CreateIsolate(const SnapshotData* snapshot_data,
+                     uintptr_t stack_base,
+                     Fn&& update_constraints) {
+    uv_loop_configure(&loop_, UV_METRICS_IDLE_TIME);
+
+    allocator_ = ArrayBufferAllocator::Create();
+    Isolate::CreateParams params;
+    SetIsolateCreateParamsForNode(&params);
+    update_constraints(&params.constraints);
+    params.array_buffer_allocator_shared = allocator_;
+    isolate_ = NewIsolate(&params, &loop_, platform_, snapshot_data);
+    if (isolate_ == nullptr) return false;
+    constraints_ = params.constraints;
+
+    SetIsolateUpForNode(isolate_);
+
+    Locker locker(isolate_);
+    Isolate::Scope isolate_scope(isolate_);
+    // V8 computes its stack limit the first time a `Locker` is used based on
+    // --stack-size. Reset it to the correct value.
+    isolate_->SetStackLimit(stack_base);
+    return true;
+  }
+
+  Worker* w_;
+  MultiIsolatePlatform* const platform_;
   uv_loop_t loop_;
   bool loop_init_failed_ = true;
+  std::shared_ptr<ArrayBufferAllocator> allocator_;
+  ResourceConstraints constraints_;
+  Isolate* isolate_ = nullptr;
   DeleteFnPtr<IsolateData, FreeIsolateData> isolate_data_;
-  const SnapshotData* snapshot_data_ = nullptr;
+  // Only set for threads taken from a WorkerPool.
+  v8::Global<Context> context_;
   friend class Worker;
 };
 
@@ -295,18 +362,25 @@ size_t Worker::NearHeapLimit(void* data, size_t current_heap_limit,
   return new_limit;
 }
 
-void Worker::Run() {
+void Worker::Run(WorkerThreadData* prewarmed) {
   std::string trace_name = "[worker " + std::to_string(thread_id_.id) + "]" +
                            (name_ == "" ? "" : " " + name_);
   TRACE_EVENT_METADATA1(
       "__metadata", "thread_name", "name", TRACE_STR_COPY(trace_name.c_str()));
   CHECK_NOT_NULL(platform_);
 
-  Debug(this, "Creating isolate for worker with id %llu", thread_id_.id);
-
-  WorkerThreadData data(this);
+  std::optional<WorkerThreadData> own_data;
+  WorkerThreadData* data = prewarmed;
+  if (data != nullptr) {
+    Debug(this, "Using prewarmed isolate for worker with id %llu",
+          thread_id_.id);
+    data->AttachToWorker(this);
+  } else {
+    Debug(this, "Creating isolate for worker with id %llu", thread_id_.id);
+    data = &own_data.emplace(this);
+  }
   if (isolate_ == nullptr) return;
-  CHECK(data.loop_is_usable());
+  CHECK(data->loop_is_usable());
 
   Debug(this, "Starting worker with id %llu", thread_id_.id);
   {
@@ -343,7 +417,11 @@ void Worker::Run() {
         // resource constraints, we need something in place to handle it,
         // though.
         TryCatch try_catch(isolate_);
-        if (snapshot_data_ != nullptr) {
+        if (data->is_prewarmed()) {
+          Debug(this, "Worker %llu uses prewarmed context\n", thread_id_.id);
+          context = data->context_.Get(isolate_);
+          data->context_.Reset();
+        } else if (snapshot_data_ != nullptr) {
           Debug(this,
                 "Worker %llu uses context from snapshot %d\n",
                 thread_id_.id,
@@ -377,7 +455,7 @@ void Worker::Run() {
         environment_flags_ |= EnvironmentFlags::kNoWaitForInspectorFrontend;
 #endif
         env_.reset(CreateEnvironment(
-            data.isolate_data_.get(),
+            data->isolate_data_.get(),
             context,
             std::move(argv_),
             std::move(exec_argv_),
@@ -417,6 +495,7 @@ void Worker::Run() {
         }
 
         Debug(this, "Loaded environment for worker %llu", thread_id_.id);
+        WorkerPool::Get()->RecordStartup(uv_hrtime() - start_time_);
       }
     }
 
@@ -750,29 +829,25 @@ void Worker::StartThread(const FunctionCallbackInfo<Value>& args) {
   thread_options.stack_size = w->stack_size_;
 
   uv_thread_t* tid = &w->tid_.emplace();  // Create uv_thread_t instance
-  int ret = uv_thread_create_ex(tid, &thread_options, [](void* arg) {
-    // XXX: This could become a std::unique_ptr, but that makes at least
-    // gcc 6.3 detect undefined behaviour when there shouldn't be any.
-    // gcc 7+ handles this well.
-    Worker* w = static_cast<Worker*>(arg);
-    const uintptr_t stack_top = reinterpret_cast<uintptr_t>(&arg);
-
-    uv_thread_setname(w->name_.c_str());
-    // Leave a few kilobytes just to make sure we're within limits and have
-    // some space to do work in C++ land.
-    w->stack_base_ = stack_top - (w->stack_size_ - kStackBufferSize);
-
-    w->Run();
-
-    Mutex::ScopedLock lock(w->mutex_);
-    w->env()->SetImmediateThreadsafe(
-        [w = std::unique_ptr<Worker>(w)](Environment* env) {
-          if (w->has_ref_)
-            env->add_refs(-1);
-          w->JoinThread();
-          // implicitly delete w
-        });
-  }, static_cast<void*>(w));
+  w->start_time_ = uv_hrtime();
+  int ret = 0;
+  if (!WorkerPool::Get()->TryHandOff(w, tid)) {
+    ret = uv_thread_create_ex(tid, &thread_options, [](void* arg) {
+      // XXX: This could become a std::unique_ptr, but that makes at least
+      // gcc 6.3 detect undefined behaviour when there shouldn't be any.
+      // gcc 7+ handles this well.
+      Worker* w = static_cast<Worker*>(arg);
+      const uintptr_t stack_top = reinterpret_cast<uintptr_t>(&arg);
+
+      uv_thread_setname(w->name_.c_str());
+      // Leave a few kilobytes just to make sure we're within limits and have
+      // some space to do work in C++ land.
+      w->stack_base_ = stack_top - (w->stack_size_ - kStackBufferSize);
+
+      w->Run();
+      w->OnThreadStopped();
+    }, static_cast<void*>(w));
+  }
 
   if (ret == 0) {
     // The object now owns the created thread and should not be garbage
@@ -797,6 +872,202 @@ void Worker::StartThread(const FunctionCallbackInfo<Value>& args) {
   }
 }
 
+void Worker::OnThreadStopped() {
+  Mutex::ScopedLock lock(mutex_);
+  env()->SetImmediateThreadsafe(
+      [w = std::unique_ptr<Worker>(this)](Environment* env) {
+        if (w->has_ref_)
+          env->add_refs(-1);
+        w->JoinThread();
+        // implicitly delete w
+      });
+}
+
+struct WorkerPool::Standby {
+  WorkerPool* pool;
+  MultiIsolatePlatform* platform;
+  const SnapshotData* snapshot_data;
+  uv_thread_t tid;
+  // Set once the Isolate and Context have been created successfully.
+  bool ready = false;
+  // Set by the pool to make the thread dispose its Isolate and exit.
+  bool shutdown = false;
+  // Set by TryHandOff(). From then on, the thread owns this object.
+  Worker* worker = nullptr;
+};
+
+WorkerPool::WorkerPool()
+    : startup_histogram_(std::make_shared<Histogram>(Histogram::Options{})) {}
+
+WorkerPool* WorkerPool::Get() {
+  // Leaked on purpose, standby threads are stopped through the cleanup hook
+  // of the owning Environment.
+  static WorkerPool* pool = new WorkerPool();
+  return pool;
+}
+
+void WorkerPool::StandbyThreadMain(void* arg) {
+  Standby* standby = static_cast<Standby*>(arg);
+  WorkerPool* pool = standby->pool;
+  const uintptr_t stack_top = reinterpret_cast<uintptr_t>(&arg);
+  const uintptr_t stack_base =
+      stack_top - (Worker::kDefaultStackSize - Worker::kStackBufferSize);
+  uv_thread_setname("WorkerPool");
+
+  Worker* w = nullptr;
+  {
+    WorkerThreadData data(
+        standby->platform, standby->snapshot_data, stack_base);
+    {
+      Mutex::ScopedLock lock(pool->mutex_);
+      // If setting up failed, stay in the pool without ever becoming ready
+      // so that the pool does not keep retrying. The thread is joined when
+      // the pool is resized or shut down.
+      if (!data.is_prewarmed()) return;
+      standby->ready = true;
+      while (!standby->shutdown && standby->worker == nullptr)
+        pool->cond_.Wait(lock);
+      w = standby->worker;
+    }
+    // When shutting down, the pool still owns standby and joins this thread.
+    if (w == nullptr) return;
+    delete standby;
+
+    uv_thread_setname(w->name_.c_str());
+    w->stack_base_ = stack_base;
+    w->Run(&data);
+  }
+  w->OnThreadStopped();
+}
+
+bool WorkerPool::SpawnStandbyLocked() {
+  auto standby = std::make_unique<Standby>();
+  standby->pool = this;
+  standby->platform = platform_;
+  standby->snapshot_data = snapshot_data_;
+
+  uv_thread_options_t thread_options;
+  thread_options.flags = UV_THREAD_HAS_STACK_SIZE;
+  thread_options.stack_size = Worker::kDefaultStackSize;
+  if (uv_thread_create_ex(&standby->tid,
+                          &thread_options,
+                          StandbyThreadMain,
+                          standby.get()) != 0) {
+    return false;
+  }
+  standbys_.emplace_back(std::move(standby));
+  return true;
+}
+
+bool WorkerPool::Configure(Environment* env, size_t size) {
+  if (size == 0) {
+    {
+      Mutex::ScopedLock lock(mutex_);
+      if (owner_ != env) return owner_ == nullptr;
+      env->RemoveCleanupHook(CleanupHook, this);
+    }
+    Shutdown();
+    return true;
+  }
+
+  std::vector<std::unique_ptr<Standby>> retired;
+  {
+    Mutex::ScopedLock lock(mutex_);
+    if (owner_ == nullptr) {
+      if (env->isolate_data()->snapshot_data() == nullptr) return false;
+      owner_ = env;
+      platform_ = env->isolate_data()->platform();
+      snapshot_data_ = env->isolate_data()->snapshot_data();
+      env->AddCleanupHook(CleanupHook, this);
+    } else if (owner_ != env) {
+      return false;
+    }
+
+    size_ = size;
+    while (standbys_.size() < size_ && SpawnStandbyLocked()) {
+    }
+    while (standbys_.size() > size_) {
+      standbys_.back()->shutdown = true;
+      retired.emplace_back(std::move(standbys_.back()));
+      standbys_.pop_back();
+    }
+    cond_.Broadcast(lock);
+  }
+
+  for (const auto& standby : retired)
+    CHECK_EQ(uv_thread_join(&standby->tid), 0);
+  return true;
+}
+
+void WorkerPool::CleanupHook(void* arg) {
+  static_cast<WorkerPool*>(arg)->Shutdown();
+}
+
+void WorkerPool::Shutdown() {
+  std::vector<std::unique_ptr<Standby>> retired;
+  {
+    Mutex::ScopedLock lock(mutex_);
+    owner_ = nullptr;
+    platform_ = nullptr;
+    snapshot_data_ = nullptr;
+    size_ = 0;
+    for (auto& standby : standbys_) standby->shutdown = true;
+    retired = std::move(standbys_);
+    standbys_.clear();
+    cond_.Broadcast(lock);
+  }
+
+  // Standby threads that are still starting up finish doing so first.
+  for (const auto& standby : retired)
+    CHECK_EQ(uv_thread_join(&standby->tid), 0);
+}
+
+bool WorkerPool::TryHandOff(Worker* w, uv_thread_t* tid) {
+  if (w->snapshot_data() == nullptr ||
+      w->stack_size_ != Worker::kDefaultStackSize ||
+      w->resource_limits_[kMaxYoungGenerationSizeMb] > 0 ||
+      w->resource_limits_[kMaxOldGenerationSizeMb] > 0 ||
+      w->resource_limits_[kCodeRangeSizeMb] > 0) {
+    return false;
+  }
+
+  Mutex::ScopedLock lock(mutex_);
+  if (size_ == 0 || w->platform_ != platform_ ||
+      w->snapshot_data() != snapshot_data_) {
+    return false;
+  }
+
+  auto it = std::ranges::find_if(
+      standbys_, [](const auto& standby) { return standby->ready; });
+  if (it == standbys_.end()) {
+    misses_++;
+    return false;
+  }
+
+  // The standby thread deletes the object once it wakes up.
+  Standby* standby = it->release();
+  standbys_.erase(it);
+  standby->worker = w;
+  *tid = standby->tid;
+  hits_++;
+  cond_.Broadcast(lock);
+
+  // Replace the thread that was just taken.
+  SpawnStandbyLocked();
+  return true;
+}
+
+void WorkerPool::RecordStartup(uint64_t duration_ns) {
+  startup_histogram_->Record(static_cast<int64_t>(duration_ns));
+}
+
+WorkerPool::Statistics WorkerPool::GetStatistics() const {
+  Mutex::ScopedLock lock(mutex_);
+  size_t idle = std::ranges::count_if(
+      standbys_, [](const auto& standby) { return standby->ready; });
+  return Statistics{size_, idle, hits_, misses_};
+}
+
 void Worker::StopThread(const FunctionCallbackInfo<Value>& args) {
   Worker* w;
   ASSIGN_OR_RETURN_UNWRAP(&w, args.This());
@@ -1467,6 +1738,36 @@ void GetEnvMessagePort(const FunctionCallbackInfo<Value>& args) {
   }
 }
 
+void ConfigureWorkerPool(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  CHECK(args[0]->IsUint32());
+  size_t size = args[0].As<Uint32>()->Value();
+  args.GetReturnValue().Set(WorkerPool::Get()->Configure(env, size));
+}
+
+void GetWorkerPoolStatistics(const FunctionCallbackInfo<Value>& args) {
+  Isolate* isolate = args.GetIsolate();
+  WorkerPool::Statistics stats = WorkerPool::Get()->GetStatistics();
+  double fields[] = {
+      static_cast<double>(stats.size),
+      static_cast<double>(stats.idle),
+      static_cast<double>(stats.hits),
+      static_cast<double>(stats.misses),
+  };
+  static_assert(arraysize(fields) == kWorkerPoolStatisticsCount);
+  Local<ArrayBuffer> ab = ArrayBuffer::New(isolate, sizeof(fields));
+  memcpy(ab->Data(), fields, sizeof(fields));
+  args.GetReturnValue().Set(
+      Float64Array::New(ab, 0, kWorkerPoolStatisticsCount));
+}
+
+void GetWorkerStartupHistogram(const FunctionCallbackInfo<Value>& args) {
+  Environment* env = Environment::GetCurrent(args);
+  BaseObjectPtr<HistogramBase> histogram =
+      HistogramBase::Create(env, WorkerPool::Get()->startup_histogram());
+  if (histogram) args.GetReturnValue().Set(histogram->object());
+}
+
 void CreateWorkerPerIsolateProperties(IsolateData* isolate_data,
                                       Local<ObjectTemplate> target) {
   Isolate* isolate = isolate_data->isolate();
@@ -1567,6 +1868,11 @@ void CreateWorkerPerIsolateProperties(IsolateData* isolate_data,
   }
 
   SetMethod(isolate, target, "getEnvMessagePort", GetEnvMessagePort);
+  SetMethod(isolate, target, "configureWorkerPool", ConfigureWorkerPool);
+  SetMethodNoSideEffect(
+      isolate, target, "getWorkerPoolStatistics", GetWorkerPoolStatistics);
+  SetMethod(
+      isolate, target, "getWorkerStartupHistogram", GetWorkerStartupHistogram);
 }
 
 void CreateWorkerPerContextProperties(Local<Object> target,
@@ -1627,10 +1933,19 @@ void CreateWorkerPerContextProperties(Local<Object> target,
   NODE_DEFINE_CONSTANT(target, kCodeRangeSizeMb);
   NODE_DEFINE_CONSTANT(target, kStackSizeMb);
   NODE_DEFINE_CONSTANT(target, kTotalResourceLimitCount);
+
+  NODE_DEFINE_CONSTANT(target, kWorkerPoolSize);
+  NODE_DEFINE_CONSTANT(target, kWorkerPoolIdle);
+  NODE_DEFINE_CONSTANT(target, kWorkerPoolHits);
+  NODE_DEFINE_CONSTANT(target, kWorkerPoolMisses);
+  NODE_DEFINE_CONSTANT(target, kWorkerPoolStatisticsCount);
 }
 
 void RegisterExternalReferences(ExternalReferenceRegistry* registry) {
   registry->Register(GetEnvMessagePort);
+  registry->Register(ConfigureWorkerPool);
+  registry->Register(GetWorkerPoolStatistics);
+  registry->Register(GetWorkerStartupHistogram);
   registry->Register(Worker::New);
   registry->Register(Worker::StartThread);
   registry->Register(Worker::StopThread);
@@ -3,8 +3,11 @@
 
 #if defined(NODE_WANT_INTERNALS) && NODE_WANT_INTERNALS
 
+#include <memory>
 #include <optional>
 #include <unordered_map>
+#include <vector>
+#include "histogram.h"
 #include "json_utils.h"
 #include "node_exit_code.h"
 #include "node_messaging.h"
@@ -25,6 +28,15 @@ enum ResourceLimits {
   kTotalResourceLimitCount
 };
 
+// Layout of the array returned by getWorkerPoolStatistics().
+enum WorkerPoolStatisticsFields {
+  kWorkerPoolSize,
+  kWorkerPoolIdle,
+  kWorkerPoolHits,
+  kWorkerPoolMisses,
+  kWorkerPoolStatisticsCount
+};
+
 // A worker thread, as represented in its parent thread.
 class Worker : public AsyncWrap {
  public:
@@ -39,8 +51,9 @@ class Worker : public AsyncWrap {
          const bool is_internal);
   ~Worker() override;
 
-  // Run the worker. This is only called from the worker thread.
-  void Run();
+  // Run the worker. This is only called from the worker thread. `prewarmed`
+  // is set if the thread was taken from the WorkerPool.
+  void Run(WorkerThreadData* prewarmed = nullptr);
 
   // Forcibly exit the thread with a specified exit code. This may be called
   // from any thread. `error_code` and `error_message` can be used to create
@@ -90,6 +103,9 @@ class Worker : public AsyncWrap {
 
  private:
   bool CreateEnvMessagePort(Environment* env);
+  // Schedules the deletion of this object on the parent thread. This is the
+  // last thing the worker thread does.
+  void OnThreadStopped();
   static size_t NearHeapLimit(void* data, size_t current_heap_limit,
                               size_t initial_heap_limit);
 
@@ -119,7 +135,8 @@ class Worker : public AsyncWrap {
   void UpdateResourceConstraints(v8::ResourceConstraints* constraints);
 
   // Full size of the thread's stack.
-  size_t stack_size_ = 4 * 1024 * 1024;
+  static constexpr size_t kDefaultStackSize = 4 * 1024 * 1024;
+  size_t stack_size_ = kDefaultStackSize;
   // Stack buffer size that is not available to the JS engine.
   static constexpr size_t kStackBufferSize = 192 * 1024;
 
@@ -144,7 +161,76 @@ class Worker : public AsyncWrap {
 
   const SnapshotData* snapshot_data_ = nullptr;
   const bool is_internal_;
+  // uv_hrtime() when the thread was requested to start, used for the
+  // startup latency histogram.
+  uint64_t start_time_ = 0;
   friend class WorkerThreadData;
+  friend class WorkerPool;
+};
+
+// Keeps a number of threads on standby that have already created a V8
+// Isolate and deserialized its main Context from the startup snapshot (which
+// may be a user-land snapshot built with --build-snapshot). Starting a Worker
+// then hands it over to one of these threads instead of doing all of that
+// on a fresh thread. Only Workers that use the same platform and snapshot
+// as the pool and do not customize the stack size or heap limits can be
+// started this way; all others, and all Workers while no standby thread is
+// ready, start a new thread as before.
+class WorkerPool final {
+ public:
+  struct Statistics {
+    size_t size;    // Configured number of standby threads.
+    size_t idle;    // Standby threads that are ready for a handoff.
+    size_t hits;    // Workers that were started on a standby thread.
+    size_t misses;  // Eligible Workers that found no ready standby thread.
+  };
+
+  static WorkerPool* Get();
+
+  // Sets the number of standby threads, starting or stopping threads as
+  // needed. The pool is emptied when the Environment that configured it is
+  // cleaned up. Returns false if the pool is owned by another Environment or
+  // if env does not use a startup snapshot.
+  bool Configure(Environment* env, size_t size);
+
+  // Called from Worker::StartThread() with the Worker's mutex held. If the
+  // Worker is eligible and a standby thread is ready, that thread takes
+  // over the Worker, *tid is set to it and true is returned. The thread is
+  // then joined like any other Worker thread.
+  bool TryHandOff(Worker* w, uv_thread_t* tid);
+
+  // Records the time between the start of a Worker thread being requested
+  // and the Worker's environment being loaded, for all Workers.
+  void RecordStartup(uint64_t duration_ns);
+  const std::shared_ptr<Histogram>& startup_histogram() const {
+    return startup_histogram_;
+  }
+
+  Statistics GetStatistics() const;
+
+ private:
+  struct Standby;
+
+  WorkerPool();
+
+  static void StandbyThreadMain(void* arg);
+  static void CleanupHook(void* arg);
+  bool SpawnStandbyLocked();
+  void Shutdown();
+
+  mutable Mutex mutex_;
+  ConditionVariable cond_;
+  Environment* owner_ = nullptr;
+  MultiIsolatePlatform* platform_ = nullptr;
+  const SnapshotData* snapshot_data_ = nullptr;
+  size_t size_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+  // Threads that are starting up or waiting for a Worker. Once a thread
+  // takes over a Worker, it is removed from here.
+  std::vector<std::unique_ptr<Standby>> standbys_;
+
+  const std::shared_ptr<Histogram> startup_histogram_;
 };
 
 template <typename Fn>
@@ -9,9 +9,16 @@
 #include <limits.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <atomic>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace {
@@ -33,25 +40,9 @@ std::string WildcardIfDir(const std::string& res) noexcept {
   return res;
 }
 
-void FreeRecursivelyNode(
-    node::permission::FSPermission::RadixTree::Node* node) {
-  if (node == nullptr) {
-    return;
-  }
-
-  if (node->children.size()) {
-    for (auto& c : node->children) {
-      FreeRecursivelyNode(c.second);
-    }
-  }
-
-  delete node->wildcard_child;
-  delete node;
-}
-
 bool is_tree_granted(
     node::Environment* env,
-    const node::permission::FSPermission::RadixTree* granted_tree,
+    const node::permission::FSPermission::PathTrie* granted_tree,
     const std::string_view& param) {
   std::string resolved_param = node::PathResolve(env, {param});
 #ifdef _WIN32
@@ -69,59 +60,43 @@ bool is_tree_granted(
     resolved_param.erase(0, 2);
   }
 #endif
-  return granted_tree->Lookup(resolved_param, true);
+  return granted_tree->empty() || granted_tree->Lookup(resolved_param);
 }
 
 static const char* kBoxDrawingsLightUpAndRight = "└─ ";
 static const char* kBoxDrawingsLightVerticalAndRight = "├─ ";
 
-void PrintTree(const node::permission::FSPermission::RadixTree::Node* node,
-               size_t depth = 0,
-               const std::string& branch_prefix = "",
-               bool is_last = true) {
-  if (node == nullptr) {
-    return;
+// Splits a path into its segments, skipping empty ones.
+template <typename Fn>
+void ForEachSegment(std::string_view path, Fn&& fn) {
+  size_t pos = 0;
+  while (pos < path.size()) {
+    size_t end = path.find(node::kPathSeparator, pos);
+    if (end == std::string_view::npos) end = path.size();
+    if (end > pos) fn(path.substr(pos, end - pos), end == path.size());
+    pos = end + 1;
   }
+}
 
-  if (depth > 0 || (node->prefix.length() > 0)) {
-    std::string indent;
+// Longer paths are not cached, so that an entry can be replaced without
+// allocating.
+constexpr size_t kMaxCachedPathLength = 256;
 
-    if (depth > 0) {
-      indent = branch_prefix;
-      if (is_last) {
-        indent += kBoxDrawingsLightUpAndRight;
-      } else {
-        indent += kBoxDrawingsLightVerticalAndRight;
-      }
-    }
+struct LookupCacheEntry {
+  uint64_t trie_id = 0;
+  uint16_t length = 0;
+  bool granted = false;
+  char path[kMaxCachedPathLength];
 
-    node::per_process::Debug(node::DebugCategory::PERMISSION_MODEL,
-                             "%s%s\n",
-                             indent.c_str(),
-                             node->prefix.c_str());
-  }
+  std::string_view key() const { return std::string_view(path, length); }
+};
 
-  if (node->children.size() > 0) {
-    size_t count = 0;
-    size_t total = node->children.size();
+// fs calls tend to hit the same few paths repeatedly, e.g. when a module
+// is resolved or a file is statted before it is opened.
+constexpr size_t kLookupCacheSize = 16;
+thread_local std::array<LookupCacheEntry, kLookupCacheSize> lookup_cache;
 
-    std::string next_branch_prefix;
-    if (depth > 0) {
-      next_branch_prefix = branch_prefix;
-      if (is_last) {
-        next_branch_prefix += "   ";
-      } else {
-        next_branch_prefix += "│  ";
-      }
-    }
-
-    for (const auto& pair : node->children) {
-      count++;
-      bool child_is_last = (count == total);
-      PrintTree(pair.second, depth + 1, next_branch_prefix, child_is_last);
-    }
-  }
-}
+std::atomic<uint64_t> next_trie_id{1};
 
 }  // namespace
 
@@ -134,6 +109,7 @@ namespace permission {
 void FSPermission::Apply(Environment* env,
                          const std::vector<std::string>& allow,
                          PermissionScope scope) {
+  std::vector<std::string> paths;
   for (const std::string& res : allow) {
     if (res == "*") {
       if (scope == PermissionScope::kFileSystemRead) {
@@ -145,20 +121,16 @@ void FSPermission::Apply(Environment* env,
       }
       return;
     }
-    GrantAccess(scope, PathResolve(env, {res}));
+    paths.push_back(WildcardIfDir(PathResolve(env, {res})));
   }
-}
 
-void FSPermission::GrantAccess(PermissionScope perm, const std::string& res) {
-  const std::string path = WildcardIfDir(res);
-  if (perm == PermissionScope::kFileSystemRead &&
-      !granted_in_fs_.Lookup(path)) {
-    granted_in_fs_.Insert(path);
-    deny_all_in_ = false;
-  } else if (perm == PermissionScope::kFileSystemWrite &&
-             !granted_out_fs_.Lookup(path)) {
-    granted_out_fs_.Insert(path);
-    deny_all_out_ = false;
+  // The paths are only needed to build the trie.
+  if (scope == PermissionScope::kFileSystemRead) {
+    granted_in_fs_.Build(paths);
+    if (!paths.empty()) deny_all_in_ = false;
+  } else if (scope == PermissionScope::kFileSystemWrite) {
+    granted_out_fs_.Build(paths);
+    if (!paths.empty()) deny_all_out_ = false;
   }
 }
 
@@ -181,66 +153,202 @@ bool FSPermission::is_granted(Environment* env,
   }
 }
 
-FSPermission::RadixTree::RadixTree() : root_node_(new Node("")) {}
+struct FSPermission::PathTrie::BuildNode {
+  std::map<std::string, std::unique_ptr<BuildNode>> children;
+  std::set<std::string> prefixes;
+  bool is_end = false;
+  bool grants_subtree = false;
+};
+
+struct FSPermission::PathTrie::SegmentTable {
+  std::unordered_map<std::string, Segment> segments;
+
+  Segment Intern(const std::string& name, std::string* strings) {
+    auto it = segments.find(name);
+    if (it != segments.end()) return it->second;
+    Segment segment{static_cast<uint32_t>(strings->size()),
+                    static_cast<uint32_t>(name.size())};
+    strings->append(name);
+    segments.emplace(name, segment);
+    return segment;
+  }
+};
+
+void FSPermission::PathTrie::Build(const std::vector<std::string>& paths) {
+  nodes_.clear();
+  edges_.clear();
+  prefixes_.clear();
+  strings_.clear();
+  id_ = next_trie_id++;
+  if (paths.empty()) return;
+
+  BuildNode root;
+  for (const std::string& path : paths) {
+    const size_t wildcard = path.find('*');
+    const std::string_view granted =
+        std::string_view(path).substr(0, wildcard);
+    // Only a wildcard directly after a separator grants whole segments.
+    const bool partial = wildcard != std::string::npos && !granted.empty() &&
+                         granted.back() != kPathSeparator;
+
+    BuildNode* current = &root;
+    ForEachSegment(granted, [&](std::string_view name, bool is_last) {
+      if (is_last && partial) {
+        current->prefixes.emplace(name);
+        current = nullptr;
+        return;
+      }
+      std::unique_ptr<BuildNode>& child = current->children[std::string(name)];
+      if (!child) child = std::make_unique<BuildNode>();
+      current = child.get();
+    });
+    if (current != nullptr) {
+      if (wildcard == std::string::npos) {
+        current->is_end = true;
+      } else {
+        current->grants_subtree = true;
+      }
+    }
 
-FSPermission::RadixTree::~RadixTree() {
-  FreeRecursivelyNode(root_node_);
+    per_process::Debug(DebugCategory::PERMISSION_MODEL, "Inserting %s\n", path);
+  }
+
+  SegmentTable segments;
+  Flatten(root, &segments);
+  nodes_.shrink_to_fit();
+  edges_.shrink_to_fit();
+  prefixes_.shrink_to_fit();
+  strings_.shrink_to_fit();
+
+  if (per_process::enabled_debug_list.enabled(DebugCategory::PERMISSION_MODEL))
+      [[unlikely]] {
+    Print(0, "", 0, "", true);
+  }
 }
 
-bool FSPermission::RadixTree::Lookup(const std::string_view& s,
-                                     bool when_empty_return) const {
-  FSPermission::RadixTree::Node* current_node = root_node_;
-  if (current_node->children.empty()) {
-    return when_empty_return;
+uint32_t FSPermission::PathTrie::Flatten(const BuildNode& build_node,
+                                         SegmentTable* segments) {
+  const uint32_t index = static_cast<uint32_t>(nodes_.size());
+  nodes_.emplace_back();
+
+  // The edges of a node are appended before those of its children, so that
+  // they are contiguous and, like the std::map, sorted.
+  const uint32_t first_edge = static_cast<uint32_t>(edges_.size());
+  for (const auto& [name, child] : build_node.children) {
+    edges_.push_back({segments->Intern(name, &strings_), 0});
+  }
+  const uint32_t first_prefix = static_cast<uint32_t>(prefixes_.size());
+  for (const std::string& prefix : build_node.prefixes) {
+    prefixes_.push_back(segments->Intern(prefix, &strings_));
   }
-  size_t parent_node_prefix_len = current_node->prefix.length();
-  const std::string path(s);
-  auto path_len = path.length();
 
-  while (true) {
-    if (parent_node_prefix_len == path_len && current_node->IsEndNode()) {
-      return true;
-    }
+  uint32_t edge = first_edge;
+  for (const auto& [name, child] : build_node.children) {
+    edges_[edge++].node = Flatten(*child, segments);
+  }
 
-    auto node = current_node->NextNode(path, parent_node_prefix_len);
-    if (node == nullptr) {
-      return false;
-    }
+  Node& node = nodes_[index];
+  node.first_edge = first_edge;
+  node.edge_count = static_cast<uint32_t>(build_node.children.size());
+  node.first_prefix = first_prefix;
+  node.prefix_count = static_cast<uint32_t>(build_node.prefixes.size());
+  node.is_end = build_node.is_end;
+  node.grants_subtree = build_node.grants_subtree;
+  return index;
+}
 
-    current_node = node;
-    parent_node_prefix_len += current_node->prefix.length();
-    if (current_node->wildcard_child != nullptr &&
-        path_len >= (parent_node_prefix_len - 2 /* slash* */)) {
-      return true;
-    }
+bool FSPermission::PathTrie::Lookup(std::string_view path) const {
+  if (path.size() > kMaxCachedPathLength) return LookupUncached(path);
+  LookupCacheEntry& entry =
+      lookup_cache[std::hash<std::string_view>()(path) % kLookupCacheSize];
+  if (entry.trie_id == id_ && entry.key() == path) {
+    return entry.granted;
   }
+
+  const bool granted = LookupUncached(path);
+  entry.trie_id = id_;
+  entry.length = static_cast<uint16_t>(path.size());
+  memcpy(entry.path, path.data(), path.size());
+  entry.granted = granted;
+  return granted;
 }
 
-void FSPermission::RadixTree::Insert(const std::string& path) {
-  FSPermission::RadixTree::Node* current_node = root_node_;
+bool FSPermission::PathTrie::LookupUncached(std::string_view path) const {
+  if (nodes_.empty()) return false;
+  const Node* current = &nodes_[0];
+  bool granted = false;
+  bool done = false;
 
-  size_t parent_node_prefix_len = current_node->prefix.length();
-  size_t path_len = path.length();
+  ForEachSegment(path, [&](std::string_view name, bool is_last) {
+    if (done) return;
+    if (current->grants_subtree) {
+      granted = done = true;
+      return;
+    }
 
-  for (size_t i = 1; i <= path_len; ++i) {
-    bool is_wildcard_node = path[i - 1] == '*';
-    bool is_last_char = i == path_len;
+    for (uint32_t i = 0; i < current->prefix_count; i++) {
+      if (name.starts_with(segment(prefixes_[current->first_prefix + i]))) {
+        granted = done = true;
+        return;
+      }
+    }
 
-    if (is_wildcard_node || is_last_char) {
-      std::string node_path = path.substr(parent_node_prefix_len, i);
-      current_node = current_node->CreateChild(node_path);
+    const Edge* begin = edges_.data() + current->first_edge;
+    const Edge* end = begin + current->edge_count;
+    const Edge* edge =
+        std::lower_bound(begin, end, name, [&](const Edge& e, auto n) {
+          return segment(e.segment) < n;
+        });
+    if (edge == end || segment(edge->segment) != name) {
+      done = true;
+      return;
     }
+    current = &nodes_[edge->node];
+  });
 
-    if (is_wildcard_node) {
-      current_node = current_node->CreateWildcardChild();
-      parent_node_prefix_len = i;
+  if (done) return granted;
+  return current->is_end || current->grants_subtree;
+}
+
+void FSPermission::PathTrie::Print(uint32_t index,
+                                   std::string_view name,
+                                   size_t depth,
+                                   const std::string& branch_prefix,
+                                   bool is_last) const {
+  const Node& node = nodes_[index];
+  if (depth > 0) {
+    std::string line = branch_prefix;
+    line += is_last ? kBoxDrawingsLightUpAndRight
+                    : kBoxDrawingsLightVerticalAndRight;
+    line += name;
+    if (node.grants_subtree) {
+      line += kPathSeparator;
+      line += '*';
     }
+    per_process::Debug(DebugCategory::PERMISSION_MODEL, "%s\n", line);
   }
 
-  if (per_process::enabled_debug_list.enabled(DebugCategory::PERMISSION_MODEL))
-      [[unlikely]] {
-    per_process::Debug(DebugCategory::PERMISSION_MODEL, "Inserting %s\n", path);
-    PrintTree(root_node_);
+  std::string next_branch_prefix;
+  if (depth > 0) {
+    next_branch_prefix = branch_prefix + (is_last ? "   " : "│  ");
+  }
+  for (uint32_t i = 0; i < node.prefix_count; i++) {
+    bool last = node.edge_count == 0 && i + 1 == node.prefix_count;
+    std::string prefix(segment(prefixes_[node.first_prefix + i]));
+    per_process::Debug(DebugCategory::PERMISSION_MODEL,
+                       "%s%s%s*\n",
+                       next_branch_prefix,
+                       last ? kBoxDrawingsLightUpAndRight
+                            : kBoxDrawingsLightVerticalAndRight,
+                       prefix);
+  }
+  for (uint32_t i = 0; i < node.edge_count; i++) {
+    const Edge& edge = edges_[node.first_edge + i];
+    Print(edge.node,
+          segment(edge.segment),
+          depth + 1,
+          next_branch_prefix,
+          i + 1 == node.edge_count);
   }
 }
 
@@ -5,7 +5,9 @@
 
 #include "v8.h"
 
-#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "permission/permission_base.h"
 #include "util.h"
 
@@ -22,135 +24,68 @@ class FSPermission final : public PermissionBase {
                   PermissionScope perm,
                   const std::string_view& param) const override;
 
-  struct RadixTree {
-    struct Node {
-      std::string prefix;
-      std::unordered_map<char, Node*> children;
-      Node* wildcard_child;
-      bool is_leaf;
-
-      explicit Node(const std::string& pre)
-          : prefix(pre), wildcard_child(nullptr), is_leaf(false) {}
-
-      Node() : wildcard_child(nullptr), is_leaf(false) {}
-
-      Node* CreateChild(const std::string& path_prefix) {
-        if (path_prefix.empty() && !is_leaf) {
-          is_leaf = true;
-          return this;
-        }
-
-        CHECK(!path_prefix.empty());
-        char label = path_prefix[0];
-
-        Node* child = children[label];
-        if (child == nullptr) {
-          children[label] = new Node(path_prefix);
-          return children[label];
-        }
-
-        // swap prefix
-        size_t i = 0;
-        size_t prefix_len = path_prefix.length();
-        for (; i < child->prefix.length(); ++i) {
-          if (i > prefix_len || path_prefix[i] != child->prefix[i]) {
-            std::string parent_prefix = child->prefix.substr(0, i);
-            std::string child_prefix = child->prefix.substr(i);
-
-            child->prefix = child_prefix;
-            Node* split_child = new Node(parent_prefix);
-            split_child->children[child_prefix[0]] = child;
-            children[parent_prefix[0]] = split_child;
-
-            return split_child->CreateChild(path_prefix.substr(i));
-          }
-        }
-        child->is_leaf = true;
-        return child->CreateChild(path_prefix.substr(i));
-      }
-
-      Node* CreateWildcardChild() {
-        if (wildcard_child != nullptr) {
-          return wildcard_child;
-        }
-        wildcard_child = new Node();
-        return wildcard_child;
-      }
-
-      Node* NextNode(const std::string& path, size_t idx) const {
-        if (idx >= path.length()) {
-          return nullptr;
-        }
-
-        // wildcard node takes precedence
-        if (children.size() > 1) {
-          auto it = children.find('*');
-          if (it != children.end()) {
-            return it->second;
-          }
-        }
-
-        auto it = children.find(path[idx]);
-        if (it == children.end()) {
-          return nullptr;
-        }
-        auto child = it->second;
-        // match prefix
-        size_t prefix_len = child->prefix.length();
-        for (size_t i = 0; i < path.length(); ++i) {
-          if (i >= prefix_len || child->prefix[i] == '*') {
-            return child;
-          }
-
-          // Handle optional trailing
-          // path = /home/subdirectory
-          // child = subdirectory/*
-          if (idx >= path.length() &&
-              child->prefix[i] == node::kPathSeparator) {
-            continue;
-          }
-
-          if (path[idx++] != child->prefix[i]) {
-            return nullptr;
-          }
-        }
-        return child;
-      }
-
-      // A node can be a *end* node and have children
-      // E.g: */slower*, */slown* are inserted:
-      // /slow
-      // ---> er
-      // ---> n
-      // If */slow* is inserted right after, it will create an
-      // empty node
-      // /slow
-      // ---> '\000' ASCII (0) || \0
-      // ---> er
-      // ---> n
-      bool IsEndNode() const {
-        if (children.empty()) {
-          return true;
-        }
-        return is_leaf;
-      }
+  // Immutable trie of the granted paths, built once by Apply(). Edges are
+  // whole path segments. Nodes, sorted edge arrays and the interned segment
+  // strings are each kept in one flat array, so a lookup is a binary search
+  // per segment over contiguous memory instead of a pointer per character.
+  //
+  // A path that contains a '*' grants every path that starts with the part
+  // before the '*'. If that part ends with a separator, the directory itself
+  // is granted too.
+  class PathTrie {
+   public:
+    void Build(const std::vector<std::string>& paths);
+    bool empty() const { return nodes_.empty(); }
+    // Consults a small per-thread cache of recent lookups first.
+    bool Lookup(std::string_view path) const;
+
+   private:
+    struct Segment {
+      uint32_t offset;  // Into strings_.
+      uint32_t length;
+    };
+
+    struct Edge {
+      Segment segment;
+      uint32_t node;
     };
 
-    RadixTree();
-    ~RadixTree();
-    void Insert(const std::string& s);
-    bool Lookup(const std::string_view& s) const { return Lookup(s, false); }
-    bool Lookup(const std::string_view& s, bool when_empty_return) const;
+    struct Node {
+      uint32_t first_edge = 0;
+      uint32_t edge_count = 0;
+      // Partial segments from paths like /tmp/foo*, into prefixes_.
+      uint32_t first_prefix = 0;
+      uint32_t prefix_count = 0;
+      bool is_end = false;
+      bool grants_subtree = false;
+    };
 
-   private:
-    Node* root_node_;
+    struct BuildNode;
+    struct SegmentTable;
+
+    std::string_view segment(Segment segment) const {
+      return std::string_view(strings_).substr(segment.offset, segment.length);
+    }
+    bool LookupUncached(std::string_view path) const;
+    uint32_t Flatten(const BuildNode& build_node, SegmentTable* segments);
+    void Print(uint32_t node,
+               std::string_view name,
+               size_t depth,
+               const std::string& branch_prefix,
+               bool is_last) const;
+
+    std::vector<Node> nodes_;  // nodes_[0] is the root.
+    std::vector<Edge> edges_;
+    std::vector<Segment> prefixes_;
+    std::string strings_;
+    // Distinguishes the tries in the lookup cache.
+    uint64_t id_ = 0;
   };
 
  private:
-  void GrantAccess(PermissionScope scope, const std::string& param);
   // fs granted on startup
-  RadixTree granted_in_fs_;
-  RadixTree granted_out_fs_;
+  PathTrie granted_in_fs_;
+  PathTrie granted_out_fs_;
 
   bool deny_all_in_ = true;
   bool deny_all_out_ = true;
@@ -228,6 +228,49 @@ void Agent::Flush(bool blocking) {
     id_writer.second->Flush(blocking);
 }
 
+uint64_t TracingController::AddTraceEvent(
+    char phase,
+    const uint8_t* category_enabled_flag,
+    const char* name,
+    const char* scope,
+    uint64_t id,
+    uint64_t bind_id,
+    int32_t num_args,
+    const char** arg_names,
+    const uint8_t* arg_types,
+    const uint64_t* arg_values,
+    std::unique_ptr<v8::ConvertableToTraceFormat>* arg_convertables,
+    unsigned int flags) {
+  uint64_t handle = v8::platform::tracing::TracingController::AddTraceEvent(
+      phase, category_enabled_flag, name, scope, id, bind_id, num_args,
+      arg_names, arg_types, arg_values, arg_convertables, flags);
+  NodeTraceBuffer::CommitTraceEvent();
+  return handle;
+}
+
+uint64_t TracingController::AddTraceEventWithTimestamp(
+    char phase,
+    const uint8_t* category_enabled_flag,
+    const char* name,
+    const char* scope,
+    uint64_t id,
+    uint64_t bind_id,
+    int32_t num_args,
+    const char** arg_names,
+    const uint8_t* arg_types,
+    const uint64_t* arg_values,
+    std::unique_ptr<v8::ConvertableToTraceFormat>* arg_convertables,
+    unsigned int flags,
+    int64_t timestamp) {
+  uint64_t handle =
+      v8::platform::tracing::TracingController::AddTraceEventWithTimestamp(
+          phase, category_enabled_flag, name, scope, id, bind_id, num_args,
+          arg_names, arg_types, arg_values, arg_convertables, flags,
+          timestamp);
+  NodeTraceBuffer::CommitTraceEvent();
+  return handle;
+}
+
 void TracingController::AddMetadataEvent(
     const unsigned char* category_group_enabled,
     const char* name,
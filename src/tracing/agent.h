@@ -37,8 +37,55 @@ class TracingController : public v8::platform::tracing::TracingController {
   TracingController() : v8::platform::tracing::TracingController() {}
 
   int64_t CurrentTimestampMicroseconds() override {
+    if (is_coarse_clock_thread_ && coarse_clock_us_ != 0) {
+      return coarse_clock_us_;
+    }
     return uv_hrtime() / 1000;
   }
+
+  // With the coarse clock, events from the thread that enabled it (the main
+  // thread) are stamped with the time of the most recent refresh of its
+  // Environment's coarse clock (see PerformanceState) instead of reading the
+  // clock for each event. Other threads do not refresh that clock, so their
+  // events keep using the precise one.
+  static void set_use_coarse_clock(bool value) {
+    is_coarse_clock_thread_ = value;
+    coarse_clock_us_ = 0;
+  }
+  static inline void UpdateCoarseClock(uint64_t hrtime) {
+    if (!is_coarse_clock_thread_) return;
+    coarse_clock_us_ = static_cast<int64_t>(hrtime / 1000);
+  }
+  // Events are added to a NodeTraceBuffer before they are filled in, so
+  // they are committed to it afterwards.
+  uint64_t AddTraceEvent(
+      char phase,
+      const uint8_t* category_enabled_flag,
+      const char* name,
+      const char* scope,
+      uint64_t id,
+      uint64_t bind_id,
+      int32_t num_args,
+      const char** arg_names,
+      const uint8_t* arg_types,
+      const uint64_t* arg_values,
+      std::unique_ptr<v8::ConvertableToTraceFormat>* arg_convertables,
+      unsigned int flags) override;
+  uint64_t AddTraceEventWithTimestamp(
+      char phase,
+      const uint8_t* category_enabled_flag,
+      const char* name,
+      const char* scope,
+      uint64_t id,
+      uint64_t bind_id,
+      int32_t num_args,
+      const char** arg_names,
+      const uint8_t* arg_types,
+      const uint64_t* arg_values,
+      std::unique_ptr<v8::ConvertableToTraceFormat>* arg_convertables,
+      unsigned int flags,
+      int64_t timestamp) override;
+
   void AddMetadataEvent(
       const unsigned char* category_group_enabled,
       const char* name,
@@ -48,6 +95,10 @@ class TracingController : public v8::platform::tracing::TracingController {
       const uint64_t* arg_values,
       std::unique_ptr<v8::ConvertableToTraceFormat>* convertable_values,
       unsigned int flags);
+
+ private:
+  static inline thread_local bool is_coarse_clock_thread_ = false;
+  static inline thread_local int64_t coarse_clock_us_ = 0;
 };
 
 class AgentWriterHandle {
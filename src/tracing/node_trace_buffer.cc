@@ -6,51 +6,56 @@
 namespace node {
 namespace tracing {
 
-InternalTraceBuffer::InternalTraceBuffer(size_t max_chunks, uint32_t id,
-                                         Agent* agent)
-    : flushing_(false), max_chunks_(max_chunks),
-      agent_(agent), id_(id) {
+namespace {
+
+// The chunk that the current thread fills for the NodeTraceBuffer with the
+// given id. There is normally only a single NodeTraceBuffer per process, so
+// one entry per thread is enough; switching buffers simply starts a new
+// chunk.
+struct ThreadChunkCache {
+  ~ThreadChunkCache() {
+    if (thread) thread->exited.store(true, std::memory_order_release);
+  }
+
+  uint64_t buffer_id = 0;
+  std::shared_ptr<ThreadTraceChunk> thread;
+};
+
+thread_local ThreadChunkCache thread_chunk_cache;
+std::atomic<uint64_t> next_buffer_id{1};
+
+}  // anonymous namespace
+
+InternalTraceBuffer::InternalTraceBuffer(size_t max_chunks, Agent* agent)
+    : flushing_(false), max_chunks_(max_chunks), agent_(agent) {
   chunks_.resize(max_chunks);
+  skipped_events_.resize(max_chunks);
 }
 
-TraceObject* InternalTraceBuffer::AddTraceEvent(uint64_t* handle) {
+bool InternalTraceBuffer::AddChunk(std::unique_ptr<TraceBufferChunk>* chunk,
+                                   size_t skip) {
   Mutex::ScopedLock scoped_lock(mutex_);
-  // Create new chunk if last chunk is full or there is no chunk.
-  if (total_chunks_ == 0 || chunks_[total_chunks_ - 1]->IsFull()) {
-    auto& chunk = chunks_[total_chunks_++];
-    if (chunk) {
-      chunk->Reset(current_chunk_seq_++);
-    } else {
-      chunk = std::make_unique<TraceBufferChunk>(current_chunk_seq_++);
-    }
-  }
-  auto& chunk = chunks_[total_chunks_ - 1];
-  size_t event_index;
-  TraceObject* trace_object = chunk->AddTraceEvent(&event_index);
-  *handle = MakeHandle(total_chunks_ - 1, chunk->seq(), event_index);
-  return trace_object;
+  if (total_chunks_ == max_chunks_) return false;
+  size_t chunk_index = total_chunks_++;
+  chunk_index_by_seq_[(*chunk)->seq()] = chunk_index;
+  skipped_events_[chunk_index] = skip;
+  // Hand the flushed chunk that previously occupied this slot back to the
+  // caller for reuse.
+  chunks_[chunk_index].swap(*chunk);
+  return true;
 }
 
-TraceObject* InternalTraceBuffer::GetEventByHandle(uint64_t handle) {
+TraceObject* InternalTraceBuffer::GetEvent(uint32_t chunk_seq,
+                                           size_t event_index) {
   Mutex::ScopedLock scoped_lock(mutex_);
-  if (handle == 0) {
-    // A handle value of zero never has a trace event associated with it.
-    return nullptr;
-  }
-  size_t chunk_index, event_index;
-  uint32_t buffer_id, chunk_seq;
-  ExtractHandle(handle, &buffer_id, &chunk_index, &chunk_seq, &event_index);
-  if (buffer_id != id_ || chunk_index >= total_chunks_) {
-    // Either the chunk belongs to the other buffer, or is outside the current
-    // range of chunks loaded in memory (the latter being true suggests that
-    // the chunk has already been flushed and is no longer in memory.)
-    return nullptr;
-  }
-  auto& chunk = chunks_[chunk_index];
-  if (chunk->seq() != chunk_seq) {
-    // Chunk is no longer in memory.
+  auto it = chunk_index_by_seq_.find(chunk_seq);
+  if (it == chunk_index_by_seq_.end()) {
+    // Either the chunk belongs to the other buffer, or it has already been
+    // flushed and is no longer in memory.
     return nullptr;
   }
+  auto& chunk = chunks_[it->second];
+  if (event_index >= chunk->size()) return nullptr;
   return chunk->GetEventAt(event_index);
 }
 
@@ -61,7 +66,7 @@ void InternalTraceBuffer::Flush(bool blocking) {
       flushing_ = true;
       for (size_t i = 0; i < total_chunks_; ++i) {
         auto& chunk = chunks_[i];
-        for (size_t j = 0; j < chunk->size(); ++j) {
+        for (size_t j = skipped_events_[i]; j < chunk->size(); ++j) {
           TraceObject* trace_event = chunk->GetEventAt(j);
           // Another thread may have added a trace that is yet to be
           // initialized. Skip such traces.
@@ -71,6 +76,7 @@ void InternalTraceBuffer::Flush(bool blocking) {
           }
         }
       }
+      chunk_index_by_seq_.clear();
       total_chunks_ = 0;
       flushing_ = false;
     }
@@ -78,28 +84,13 @@ void InternalTraceBuffer::Flush(bool blocking) {
   agent_->Flush(blocking);
 }
 
-uint64_t InternalTraceBuffer::MakeHandle(
-    size_t chunk_index, uint32_t chunk_seq, size_t event_index) const {
-  return ((static_cast<uint64_t>(chunk_seq) * Capacity() +
-          chunk_index * TraceBufferChunk::kChunkSize + event_index) << 1) + id_;
-}
-
-void InternalTraceBuffer::ExtractHandle(
-    uint64_t handle, uint32_t* buffer_id, size_t* chunk_index,
-    uint32_t* chunk_seq, size_t* event_index) const {
-  *buffer_id = static_cast<uint32_t>(handle & 0x1);
-  handle >>= 1;
-  *chunk_seq = static_cast<uint32_t>(handle / Capacity());
-  size_t indices = handle % Capacity();
-  *chunk_index = indices / TraceBufferChunk::kChunkSize;
-  *event_index = indices % TraceBufferChunk::kChunkSize;
-}
-
 NodeTraceBuffer::NodeTraceBuffer(size_t max_chunks,
     Agent* agent, uv_loop_t* tracing_loop)
-    : tracing_loop_(tracing_loop),
-      buffer1_(max_chunks, 0, agent),
-      buffer2_(max_chunks, 1, agent) {
+    : id_(next_buffer_id.fetch_add(1, std::memory_order_relaxed)),
+      agent_(agent),
+      tracing_loop_(tracing_loop),
+      buffer1_(max_chunks, agent),
+      buffer2_(max_chunks, agent) {
   current_buf_.store(&buffer1_);
 
   flush_signal_.data = this;
@@ -120,31 +111,147 @@ NodeTraceBuffer::~NodeTraceBuffer() {
   }
 }
 
+ThreadTraceChunk* NodeTraceBuffer::GetThreadChunk() {
+  ThreadChunkCache& cache = thread_chunk_cache;
+  if (cache.buffer_id != id_) {
+    if (cache.thread) cache.thread->exited.store(true);
+    auto thread = std::make_shared<ThreadTraceChunk>();
+    {
+      Mutex::ScopedLock scoped_lock(threads_mutex_);
+      threads_.push_back(thread);
+    }
+    cache.buffer_id = id_;
+    cache.thread = std::move(thread);
+  }
+  return cache.thread.get();
+}
+
 TraceObject* NodeTraceBuffer::AddTraceEvent(uint64_t* handle) {
-  // If the buffer is full, attempt to perform a flush.
-  if (!TryLoadAvailableBuffer()) {
-    // Assign a value of zero as the trace event handle.
-    // This is equivalent to calling InternalTraceBuffer::MakeHandle(0, 0, 0),
-    // and will cause GetEventByHandle to return NULL if passed as an argument.
-    *handle = 0;
-    return nullptr;
+  ThreadTraceChunk* thread = GetThreadChunk();
+  TraceBufferChunk* chunk = thread->chunk.get();
+  // Only the owning thread ever replaces its chunk, so filling it does not
+  // need any locking.
+  if (chunk == nullptr || chunk->IsFull()) {
+    Mutex::ScopedLock scoped_lock(thread->mutex);
+    if (!HandOverChunk(thread)) {
+      // Both buffers are full. Assign a value of zero as the trace event
+      // handle, which causes GetEventByHandle to return NULL if passed as an
+      // argument.
+      *handle = 0;
+      return nullptr;
+    }
+    StartChunk(thread);
+    chunk = thread->chunk.get();
   }
-  return current_buf_.load()->AddTraceEvent(handle);
+  size_t event_index;
+  TraceObject* trace_object = chunk->AddTraceEvent(&event_index);
+  // The event is only published by CommitTraceEvent(), after the caller has
+  // filled it in.
+  thread->added = event_index + 1;
+  *handle = MakeHandle(chunk->seq(), event_index);
+  return trace_object;
+}
+
+// static
+void NodeTraceBuffer::CommitTraceEvent() {
+  ThreadTraceChunk* thread = thread_chunk_cache.thread.get();
+  if (thread != nullptr)
+    thread->size.store(thread->added, std::memory_order_release);
 }
 
 TraceObject* NodeTraceBuffer::GetEventByHandle(uint64_t handle) {
-  return current_buf_.load()->GetEventByHandle(handle);
+  if (handle == 0) {
+    // A handle value of zero never has a trace event associated with it.
+    return nullptr;
+  }
+  uint32_t chunk_seq;
+  size_t event_index;
+  ExtractHandle(handle, &chunk_seq, &event_index);
+  // Events are almost always looked up by the thread that added them, while
+  // their chunk is still being filled.
+  TraceBufferChunk* chunk = GetThreadChunk()->chunk.get();
+  if (chunk != nullptr && chunk->seq() == chunk_seq) {
+    return event_index < chunk->size() ? chunk->GetEventAt(event_index)
+                                       : nullptr;
+  }
+  TraceObject* trace_event = buffer1_.GetEvent(chunk_seq, event_index);
+  if (trace_event == nullptr)
+    trace_event = buffer2_.GetEvent(chunk_seq, event_index);
+  return trace_event;
 }
 
 bool NodeTraceBuffer::Flush() {
+  HandOverExitedThreadChunks();
+  {
+    // Write out the events in chunks that are still being filled. The
+    // owning threads keep adding events behind the ones written here.
+    Mutex::ScopedLock scoped_lock(threads_mutex_);
+    for (const auto& thread : threads_) {
+      Mutex::ScopedLock thread_lock(thread->mutex);
+      if (!thread->chunk) continue;
+      // Only events that have been committed are fully initialized.
+      size_t size = thread->size.load(std::memory_order_acquire);
+      for (size_t i = thread->flushed; i < size; ++i)
+        agent_->AppendTraceEvent(thread->chunk->GetEventAt(i));
+      thread->flushed = size;
+    }
+  }
   buffer1_.Flush(true);
   buffer2_.Flush(true);
   return true;
 }
 
+// Moves the filled chunk of a thread into the current InternalTraceBuffer.
+// Must be called with thread->mutex held. Returns false if both buffers are
+// full, in which case the thread keeps its chunk.
+bool NodeTraceBuffer::HandOverChunk(ThreadTraceChunk* thread) {
+  if (!thread->chunk || thread->flushed == thread->chunk->size()) return true;
+  // The other buffer may have been filled by another thread in between, so
+  // try once more after switching buffers.
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (!TryLoadAvailableBuffer()) return false;
+    if (current_buf_.load()->AddChunk(&thread->chunk, thread->flushed))
+      return true;
+  }
+  return false;
+}
+
+// Gives a thread an empty chunk, reusing the one it currently holds if any.
+// Must be called with thread->mutex held.
+void NodeTraceBuffer::StartChunk(ThreadTraceChunk* thread) {
+  uint32_t seq = next_chunk_seq_.fetch_add(1, std::memory_order_relaxed);
+  // Zero is reserved for the invalid handle.
+  if (seq == 0) seq = next_chunk_seq_.fetch_add(1, std::memory_order_relaxed);
+  if (thread->chunk) {
+    thread->chunk->Reset(seq);
+  } else {
+    thread->chunk = std::make_unique<TraceBufferChunk>(seq);
+  }
+  thread->size.store(0, std::memory_order_release);
+  thread->added = 0;
+  thread->flushed = 0;
+}
+
+// Hands over the partially filled chunks of threads that have exited and
+// forgets about those threads.
+void NodeTraceBuffer::HandOverExitedThreadChunks() {
+  Mutex::ScopedLock scoped_lock(threads_mutex_);
+  for (auto it = threads_.begin(); it != threads_.end();) {
+    ThreadTraceChunk* thread = it->get();
+    if (thread->exited.load(std::memory_order_acquire)) {
+      Mutex::ScopedLock thread_lock(thread->mutex);
+      if (HandOverChunk(thread)) {
+        it = threads_.erase(it);
+        continue;
+      }
+    }
+    ++it;
+  }
+}
+
 // Attempts to set current_buf_ such that it references a buffer that can
-// write at least one trace event. If both buffers are unavailable this
-// method returns false; otherwise it returns true.
+// take at least one chunk. If both buffers are unavailable this method
+// returns false; otherwise it returns true.
 bool NodeTraceBuffer::TryLoadAvailableBuffer() {
   InternalTraceBuffer* prev_buf = current_buf_.load();
   if (prev_buf->IsFull()) {
@@ -160,6 +267,17 @@ bool NodeTraceBuffer::TryLoadAvailableBuffer() {
   return true;
 }
 
+uint64_t NodeTraceBuffer::MakeHandle(uint32_t chunk_seq, size_t event_index) {
+  return static_cast<uint64_t>(chunk_seq) * TraceBufferChunk::kChunkSize +
+         event_index;
+}
+
+void NodeTraceBuffer::ExtractHandle(uint64_t handle, uint32_t* chunk_seq,
+                                    size_t* event_index) {
+  *chunk_seq = static_cast<uint32_t>(handle / TraceBufferChunk::kChunkSize);
+  *event_index = handle % TraceBufferChunk::kChunkSize;
+}
+
 // static
 void NodeTraceBuffer::NonBlockingFlushSignalCb(uv_async_t* signal) {
   NodeTraceBuffer* buffer = static_cast<NodeTraceBuffer*>(signal->data);
@@ -169,6 +287,7 @@ void NodeTraceBuffer::NonBlockingFlushSignalCb(uv_async_t* signal) {
   if (buffer->buffer2_.IsFull() && !buffer->buffer2_.IsFlushing()) {
     buffer->buffer2_.Flush(false);
   }
+  buffer->HandOverExitedThreadChunks();
 }
 
 // static
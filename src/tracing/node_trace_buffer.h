@@ -6,6 +6,9 @@
 #include "libplatform/v8-tracing.h"
 
 #include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace node {
 namespace tracing {
@@ -17,35 +20,54 @@ using v8::platform::tracing::TraceObject;
 // forward declaration
 class NodeTraceBuffer;
 
+// A chunk that is filled by a single thread. Events are added to it without
+// any locking; once the tracing controller has initialized an event, the
+// owning thread publishes how many events are complete via `size` so that a
+// blocking flush can write out a partially filled chunk. `mutex` is only
+// taken when the chunk is handed over to an InternalTraceBuffer or while it
+// is being flushed.
+struct ThreadTraceChunk {
+  std::unique_ptr<TraceBufferChunk> chunk;
+  std::atomic<size_t> size{0};
+  // Number of events handed out by AddTraceEvent(), including one that may
+  // not be initialized yet. Only accessed by the owning thread.
+  size_t added = 0;
+  // Set once the owning thread has exited. Its last chunk is then handed over
+  // by the tracing thread.
+  std::atomic<bool> exited{false};
+  Mutex mutex;
+  // Number of events at the start of `chunk` that were already written out
+  // by a blocking flush. Protected by `mutex`.
+  size_t flushed = 0;
+};
+
 class InternalTraceBuffer {
  public:
-  InternalTraceBuffer(size_t max_chunks, uint32_t id, Agent* agent);
-
-  TraceObject* AddTraceEvent(uint64_t* handle);
-  TraceObject* GetEventByHandle(uint64_t handle);
+  InternalTraceBuffer(size_t max_chunks, Agent* agent);
+
+  // Takes ownership of a filled chunk, of which the first `skip` events have
+  // already been flushed. On success, *chunk is replaced with a previously
+  // flushed chunk that can be reused, or nullptr. Returns false if the
+  // buffer is full.
+  bool AddChunk(std::unique_ptr<TraceBufferChunk>* chunk, size_t skip);
+  TraceObject* GetEvent(uint32_t chunk_seq, size_t event_index);
   void Flush(bool blocking);
   bool IsFull() const {
-    return total_chunks_ == max_chunks_ && chunks_[total_chunks_ - 1]->IsFull();
+    return total_chunks_ == max_chunks_;
   }
   bool IsFlushing() const {
     return flushing_;
   }
 
  private:
-  uint64_t MakeHandle(size_t chunk_index, uint32_t chunk_seq,
-                      size_t event_index) const;
-  void ExtractHandle(uint64_t handle, uint32_t* buffer_id, size_t* chunk_index,
-                     uint32_t* chunk_seq, size_t* event_index) const;
-  size_t Capacity() const { return max_chunks_ * TraceBufferChunk::kChunkSize; }
-
   Mutex mutex_;
   bool flushing_;
   size_t max_chunks_;
   Agent* agent_;
   std::vector<std::unique_ptr<TraceBufferChunk>> chunks_;
+  std::vector<size_t> skipped_events_;
+  std::unordered_map<uint32_t, size_t> chunk_index_by_seq_;
   size_t total_chunks_ = 0;
-  uint32_t current_chunk_seq_ = 1;
-  uint32_t id_;
 };
 
 class NodeTraceBuffer : public TraceBuffer {
@@ -57,13 +79,28 @@ class NodeTraceBuffer : public TraceBuffer {
   TraceObject* GetEventByHandle(uint64_t handle) override;
   bool Flush() override;
 
+  // Called by the TracingController on the thread that added the last event
+  // once that event has been initialized, making it visible to Flush().
+  static void CommitTraceEvent();
+
   static const size_t kBufferChunks = 1024;
 
  private:
+  ThreadTraceChunk* GetThreadChunk();
+  bool HandOverChunk(ThreadTraceChunk* thread);
+  void StartChunk(ThreadTraceChunk* thread);
+  void HandOverExitedThreadChunks();
   bool TryLoadAvailableBuffer();
   static void NonBlockingFlushSignalCb(uv_async_t* signal);
   static void ExitSignalCb(uv_async_t* signal);
 
+  static uint64_t MakeHandle(uint32_t chunk_seq, size_t event_index);
+  static void ExtractHandle(uint64_t handle, uint32_t* chunk_seq,
+                            size_t* event_index);
+
+  // Identifies this buffer in the thread-local chunk cache.
+  const uint64_t id_;
+  Agent* agent_;
   uv_loop_t* tracing_loop_;
   uv_async_t flush_signal_;
   uv_async_t exit_signal_;
@@ -75,6 +112,10 @@ class NodeTraceBuffer : public TraceBuffer {
   std::atomic<InternalTraceBuffer*> current_buf_;
   InternalTraceBuffer buffer1_;
   InternalTraceBuffer buffer2_;
+  std::atomic<uint32_t> next_chunk_seq_{1};
+  // Every thread that has added trace events to this buffer.
+  Mutex threads_mutex_;
+  std::vector<std::shared_ptr<ThreadTraceChunk>> threads_;
 };
 
 }  // namespace tracing
@@ -16,7 +16,13 @@ using v8::platform::tracing::TraceWriter;
 
 class NodeTraceWriter : public AsyncTraceWriter {
  public:
-  explicit NodeTraceWriter(const std::string& log_file_pattern);
+  enum class Format {
+    kJSON,      // Chrome JSON trace event format.
+    kPerfetto,  // Perfetto protobuf trace format.
+  };
+
+  explicit NodeTraceWriter(const std::string& log_file_pattern,
+                           Format format = Format::kJSON);
   ~NodeTraceWriter() override;
 
   void InitializeOnThread(uv_loop_t* loop) override;
@@ -46,7 +52,7 @@ class NodeTraceWriter : public AsyncTraceWriter {
   uv_async_t exit_signal_;
   // Prevents concurrent R/W on state related to serialized trace data
   // before it's written to disk, namely stream_ and total_traces_
-  // as well as json_trace_writer_.
+  // as well as trace_writer_.
   Mutex stream_mutex_;
   // Prevents concurrent R/W on state related to write requests.
   // If both mutexes are locked, request_mutex_ has to be locked first.
@@ -64,8 +70,9 @@ class NodeTraceWriter : public AsyncTraceWriter {
   int total_traces_ = 0;
   int file_num_ = 0;
   std::string log_file_pattern_;
+  Format format_;
   std::ostringstream stream_;
-  std::unique_ptr<TraceWriter> json_trace_writer_;
+  std::unique_ptr<TraceWriter> trace_writer_;
   bool exited_ = false;
 };
 
@@ -0,0 +1,471 @@
+#include "tracing/perfetto_trace_writer.h"
+
+#include "tracing/trace_event_common.h"
+
+#include <cstring>
+
+namespace node {
+namespace tracing {
+
+namespace {
+
+// Field numbers from the Perfetto protos, see
+// https://github.com/google/perfetto/tree/main/protos/perfetto/trace.
+namespace field {
+// perfetto.protos.Trace
+constexpr uint32_t kTracePacket = 1;
+// TracePacket
+constexpr uint32_t kTimestamp = 8;
+constexpr uint32_t kTrustedPacketSequenceId = 10;
+constexpr uint32_t kTrackEvent = 11;
+constexpr uint32_t kInternedData = 12;
+constexpr uint32_t kSequenceFlags = 13;
+constexpr uint32_t kTrackDescriptor = 60;
+// InternedData
+constexpr uint32_t kEventCategories = 1;
+constexpr uint32_t kEventNames = 2;
+constexpr uint32_t kDebugAnnotationNames = 3;
+// EventCategory, EventName and DebugAnnotationName
+constexpr uint32_t kIid = 1;
+constexpr uint32_t kInternedName = 2;
+// TrackDescriptor
+constexpr uint32_t kUuid = 1;
+constexpr uint32_t kTrackName = 2;
+constexpr uint32_t kProcess = 3;
+constexpr uint32_t kThread = 4;
+constexpr uint32_t kParentUuid = 5;
+constexpr uint32_t kCounter = 8;
+// ProcessDescriptor and ThreadDescriptor
+constexpr uint32_t kPid = 1;
+constexpr uint32_t kTid = 2;
+constexpr uint32_t kThreadName = 5;
+constexpr uint32_t kProcessName = 6;
+// TrackEvent
+constexpr uint32_t kCategoryIids = 3;
+constexpr uint32_t kDebugAnnotations = 4;
+constexpr uint32_t kLegacyEvent = 6;
+constexpr uint32_t kType = 9;
+constexpr uint32_t kNameIid = 10;
+constexpr uint32_t kTrackUuid = 11;
+constexpr uint32_t kCounterValue = 30;
+constexpr uint32_t kDoubleCounterValue = 44;
+constexpr uint32_t kFlowIds = 47;
+constexpr uint32_t kTerminatingFlowIds = 48;
+// TrackEvent.LegacyEvent
+constexpr uint32_t kPhase = 2;
+constexpr uint32_t kUnscopedId = 6;
+constexpr uint32_t kIdScope = 7;
+constexpr uint32_t kBindId = 8;
+constexpr uint32_t kBindToEnclosing = 12;
+constexpr uint32_t kFlowDirection = 13;
+// DebugAnnotation
+constexpr uint32_t kNameIidAnnotation = 1;
+constexpr uint32_t kBoolValue = 2;
+constexpr uint32_t kUintValue = 3;
+constexpr uint32_t kIntValue = 4;
+constexpr uint32_t kDoubleValue = 5;
+constexpr uint32_t kStringValue = 6;
+constexpr uint32_t kPointerValue = 7;
+constexpr uint32_t kLegacyJsonValue = 9;
+}  // namespace field
+
+// TrackEvent.Type
+constexpr int kTypeUnspecified = 0;
+constexpr int kTypeSliceBegin = 1;
+constexpr int kTypeSliceEnd = 2;
+constexpr int kTypeInstant = 3;
+constexpr int kTypeCounter = 4;
+
+// TracePacket.SequenceFlags
+constexpr uint32_t kIncrementalStateCleared = 1;
+constexpr uint32_t kNeedsIncrementalState = 2;
+
+// All packets are written on a single sequence.
+constexpr uint32_t kSequenceId = 1;
+
+// Track UUIDs. Thread tracks use the pid and tid, with the top two bits
+// distinguishing them from process and counter tracks.
+constexpr uint64_t kProcessTrackBit = uint64_t{1} << 62;
+constexpr uint64_t kCounterTrackBit = uint64_t{1} << 63;
+
+enum WireType {
+  kVarInt = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+};
+
+void AppendVarInt(std::string* out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+void AppendTag(std::string* out, uint32_t field, WireType type) {
+  AppendVarInt(out, (static_cast<uint64_t>(field) << 3) | type);
+}
+
+void AppendVarIntField(std::string* out, uint32_t field, uint64_t value) {
+  AppendTag(out, field, kVarInt);
+  AppendVarInt(out, value);
+}
+
+void AppendFixed64Field(std::string* out, uint32_t field, uint64_t value) {
+  AppendTag(out, field, kFixed64);
+  for (int i = 0; i < 8; i++)
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+}
+
+void AppendDoubleField(std::string* out, uint32_t field, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  AppendFixed64Field(out, field, bits);
+}
+
+void AppendBytesField(std::string* out, uint32_t field,
+                      const char* data, size_t length) {
+  AppendTag(out, field, kLengthDelimited);
+  AppendVarInt(out, length);
+  out->append(data, length);
+}
+
+void AppendStringField(std::string* out, uint32_t field, const char* str) {
+  AppendBytesField(out, field, str, strlen(str));
+}
+
+void AppendMessageField(std::string* out, uint32_t field,
+                        const std::string& message) {
+  AppendBytesField(out, field, message.data(), message.size());
+}
+
+bool IsNumericArg(uint8_t type) {
+  return type == TRACE_VALUE_TYPE_UINT || type == TRACE_VALUE_TYPE_INT ||
+         type == TRACE_VALUE_TYPE_DOUBLE || type == TRACE_VALUE_TYPE_BOOL;
+}
+
+}  // anonymous namespace
+
+PerfettoTraceWriter::PerfettoTraceWriter(std::ostream& stream)
+    : stream_(stream) {}
+
+void PerfettoTraceWriter::AppendTraceEvent(TraceObject* trace_event) {
+  int64_t ts = trace_event->ts();
+  switch (trace_event->phase()) {
+    case TRACE_EVENT_PHASE_METADATA:
+      AppendMetadata(trace_event);
+      return;
+    case TRACE_EVENT_PHASE_COUNTER:
+      AppendCounterPackets(trace_event);
+      return;
+    case TRACE_EVENT_PHASE_BEGIN:
+      AppendEventPacket(trace_event, kTypeSliceBegin, ts,
+                        ThreadTrack(trace_event->pid(), trace_event->tid()),
+                        true);
+      return;
+    case TRACE_EVENT_PHASE_END:
+      AppendEventPacket(trace_event, kTypeSliceEnd, ts,
+                        ThreadTrack(trace_event->pid(), trace_event->tid()),
+                        true);
+      return;
+    case TRACE_EVENT_PHASE_COMPLETE: {
+      // Complete events become a begin/end pair.
+      uint64_t track = ThreadTrack(trace_event->pid(), trace_event->tid());
+      AppendEventPacket(trace_event, kTypeSliceBegin, ts, track, true);
+      AppendEventPacket(trace_event, kTypeSliceEnd,
+                        ts + trace_event->duration(), track, false);
+      return;
+    }
+    case TRACE_EVENT_PHASE_INSTANT: {
+      uint64_t track =
+          (trace_event->flags() & TRACE_EVENT_FLAG_SCOPE_MASK) ==
+                  TRACE_EVENT_SCOPE_THREAD
+              ? ThreadTrack(trace_event->pid(), trace_event->tid())
+              : ProcessTrack(trace_event->pid());
+      AppendEventPacket(trace_event, kTypeInstant, ts, track, true);
+      return;
+    }
+    case TRACE_EVENT_PHASE_MARK:
+      AppendEventPacket(trace_event, kTypeInstant, ts,
+                        ThreadTrack(trace_event->pid(), trace_event->tid()),
+                        true);
+      return;
+    default:
+      // Async, flow and object events are written as legacy events, which
+      // trace processors import the same way as their JSON counterparts.
+      AppendEventPacket(trace_event, kTypeUnspecified, ts,
+                        ThreadTrack(trace_event->pid(), trace_event->tid()),
+                        true);
+      return;
+  }
+}
+
+void PerfettoTraceWriter::AppendEventPacket(TraceObject* trace_event,
+                                            int type,
+                                            int64_t ts,
+                                            uint64_t track,
+                                            bool with_details) {
+  if (type != kTypeUnspecified)
+    AppendVarIntField(&event_, field::kType, type);
+  AppendVarIntField(&event_, field::kTrackUuid, track);
+  if (with_details) {
+    unsigned int flags = trace_event->flags();
+    AppendVarIntField(&event_, field::kCategoryIids,
+                      InternCategory(trace_event->category_enabled_flag()));
+    AppendVarIntField(&event_, field::kNameIid,
+                      InternString(&event_names_, field::kEventNames,
+                                   trace_event->name()));
+    AppendDebugAnnotations(trace_event);
+
+    if (type == kTypeUnspecified) {
+      nested_.clear();
+      AppendVarIntField(&nested_, field::kPhase, trace_event->phase());
+      if (flags & TRACE_EVENT_FLAG_HAS_ID) {
+        AppendVarIntField(&nested_, field::kUnscopedId, trace_event->id());
+        if (trace_event->scope() != nullptr)
+          AppendStringField(&nested_, field::kIdScope, trace_event->scope());
+      }
+      if (flags & (TRACE_EVENT_FLAG_FLOW_IN | TRACE_EVENT_FLAG_FLOW_OUT)) {
+        AppendVarIntField(&nested_, field::kBindId, trace_event->bind_id());
+        // FlowDirection: FLOW_IN = 1, FLOW_OUT = 2, FLOW_INOUT = 3.
+        AppendVarIntField(&nested_, field::kFlowDirection,
+                          ((flags & TRACE_EVENT_FLAG_FLOW_IN) ? 1 : 0) |
+                          ((flags & TRACE_EVENT_FLAG_FLOW_OUT) ? 2 : 0));
+      }
+      if (flags & TRACE_EVENT_FLAG_BIND_TO_ENCLOSING)
+        AppendVarIntField(&nested_, field::kBindToEnclosing, 1);
+      AppendMessageField(&event_, field::kLegacyEvent, nested_);
+    } else if (flags & TRACE_EVENT_FLAG_FLOW_OUT) {
+      AppendFixed64Field(&event_, field::kFlowIds, trace_event->bind_id());
+    } else if (flags & TRACE_EVENT_FLAG_FLOW_IN) {
+      AppendFixed64Field(&event_, field::kTerminatingFlowIds,
+                         trace_event->bind_id());
+    }
+  }
+  AppendMessageField(&packet_, field::kTrackEvent, event_);
+  WritePacket(ts, true);
+}
+
+void PerfettoTraceWriter::AppendDebugAnnotations(TraceObject* trace_event) {
+  const char** arg_names = trace_event->arg_names();
+  const uint8_t* arg_types = trace_event->arg_types();
+  TraceObject::ArgValue* arg_values = trace_event->arg_values();
+  std::unique_ptr<v8::ConvertableToTraceFormat>* arg_convertables =
+      trace_event->arg_convertables();
+  for (int i = 0; i < trace_event->num_args(); ++i) {
+    nested_.clear();
+    AppendVarIntField(&nested_, field::kNameIidAnnotation,
+                      InternString(&annotation_names_,
+                                   field::kDebugAnnotationNames,
+                                   arg_names[i]));
+    const TraceObject::ArgValue& value = arg_values[i];
+    switch (arg_types[i]) {
+      case TRACE_VALUE_TYPE_BOOL:
+        AppendVarIntField(&nested_, field::kBoolValue, value.as_uint ? 1 : 0);
+        break;
+      case TRACE_VALUE_TYPE_UINT:
+        AppendVarIntField(&nested_, field::kUintValue, value.as_uint);
+        break;
+      case TRACE_VALUE_TYPE_INT:
+        AppendVarIntField(&nested_, field::kIntValue,
+                          static_cast<uint64_t>(value.as_int));
+        break;
+      case TRACE_VALUE_TYPE_DOUBLE:
+        AppendDoubleField(&nested_, field::kDoubleValue, value.as_double);
+        break;
+      case TRACE_VALUE_TYPE_POINTER:
+        AppendVarIntField(&nested_, field::kPointerValue,
+                          reinterpret_cast<uintptr_t>(value.as_pointer));
+        break;
+      case TRACE_VALUE_TYPE_STRING:
+      case TRACE_VALUE_TYPE_COPY_STRING:
+        AppendStringField(&nested_, field::kStringValue,
+                          value.as_string != nullptr ? value.as_string
+                                                     : "nullptr");
+        break;
+      case TRACE_VALUE_TYPE_CONVERTABLE: {
+        std::string json;
+        arg_convertables[i]->AppendAsTraceFormat(&json);
+        AppendBytesField(&nested_, field::kLegacyJsonValue,
+                         json.data(), json.size());
+        break;
+      }
+      default:
+        continue;
+    }
+    AppendMessageField(&event_, field::kDebugAnnotations, nested_);
+  }
+}
+
+void PerfettoTraceWriter::AppendCounterPackets(TraceObject* trace_event) {
+  // Like in the JSON format, every argument of a counter event is a separate
+  // counter.
+  const char** arg_names = trace_event->arg_names();
+  const uint8_t* arg_types = trace_event->arg_types();
+  TraceObject::ArgValue* arg_values = trace_event->arg_values();
+  for (int i = 0; i < trace_event->num_args(); ++i) {
+    if (!IsNumericArg(arg_types[i])) continue;
+    uint64_t track = CounterTrack(trace_event->pid(), trace_event->name(),
+                                  arg_names[i]);
+    AppendVarIntField(&event_, field::kType, kTypeCounter);
+    AppendVarIntField(&event_, field::kTrackUuid, track);
+    if (arg_types[i] == TRACE_VALUE_TYPE_DOUBLE) {
+      AppendDoubleField(&event_, field::kDoubleCounterValue,
+                        arg_values[i].as_double);
+    } else {
+      AppendVarIntField(&event_, field::kCounterValue, arg_values[i].as_uint);
+    }
+    AppendMessageField(&packet_, field::kTrackEvent, event_);
+    WritePacket(trace_event->ts(), false);
+  }
+}
+
+void PerfettoTraceWriter::AppendMetadata(TraceObject* trace_event) {
+  // Only process and thread names are supported; they become the names of
+  // the corresponding tracks.
+  if (trace_event->num_args() < 1) return;
+  uint8_t type = trace_event->arg_types()[0];
+  if (type != TRACE_VALUE_TYPE_STRING && type != TRACE_VALUE_TYPE_COPY_STRING)
+    return;
+  const char* value = trace_event->arg_values()[0].as_string;
+  if (value == nullptr) return;
+
+  int pid = trace_event->pid();
+  int tid = trace_event->tid();
+  if (strcmp(trace_event->name(), "thread_name") == 0) {
+    uint64_t uuid = ThreadTrack(pid, tid);
+    if (tracks_[uuid] != value) WriteThreadDescriptor(uuid, pid, tid, value);
+  } else if (strcmp(trace_event->name(), "process_name") == 0) {
+    uint64_t uuid = ProcessTrack(pid);
+    if (tracks_[uuid] != value) WriteProcessDescriptor(uuid, pid, value);
+  }
+}
+
+uint64_t PerfettoTraceWriter::ThreadTrack(int pid, int tid) {
+  uint64_t uuid = ((static_cast<uint64_t>(static_cast<uint32_t>(pid)) << 32) |
+                   static_cast<uint32_t>(tid)) &
+                  ~(kProcessTrackBit | kCounterTrackBit);
+  if (tracks_.count(uuid) == 0) WriteThreadDescriptor(uuid, pid, tid, "");
+  return uuid;
+}
+
+uint64_t PerfettoTraceWriter::ProcessTrack(int pid) {
+  uint64_t uuid = kProcessTrackBit | static_cast<uint32_t>(pid);
+  if (tracks_.count(uuid) == 0) WriteProcessDescriptor(uuid, pid, "");
+  return uuid;
+}
+
+uint64_t PerfettoTraceWriter::CounterTrack(int pid,
+                                           const char* name,
+                                           const char* arg_name) {
+  std::string track_name = std::string(name) + " " + arg_name;
+  std::string key = std::to_string(pid) + ":" + track_name;
+  auto it = counter_tracks_.find(key);
+  if (it != counter_tracks_.end()) return it->second;
+
+  uint64_t parent = ProcessTrack(pid);
+  uint64_t uuid = kCounterTrackBit | next_counter_track_++;
+  counter_tracks_.emplace(std::move(key), uuid);
+  nested_.clear();
+  AppendVarIntField(&nested_, field::kUuid, uuid);
+  AppendStringField(&nested_, field::kTrackName, track_name.c_str());
+  AppendVarIntField(&nested_, field::kParentUuid, parent);
+  AppendBytesField(&nested_, field::kCounter, "", 0);
+  AppendMessageField(&packet_, field::kTrackDescriptor, nested_);
+  WritePacket(-1, false);
+  return uuid;
+}
+
+void PerfettoTraceWriter::WriteProcessDescriptor(uint64_t uuid,
+                                                 int pid,
+                                                 const char* name) {
+  tracks_[uuid] = name;
+  scratch_.clear();
+  AppendVarIntField(&scratch_, field::kPid, pid);
+  if (*name != '\0') AppendStringField(&scratch_, field::kProcessName, name);
+  nested_.clear();
+  AppendVarIntField(&nested_, field::kUuid, uuid);
+  AppendMessageField(&nested_, field::kProcess, scratch_);
+  AppendMessageField(&packet_, field::kTrackDescriptor, nested_);
+  WritePacket(-1, false);
+}
+
+void PerfettoTraceWriter::WriteThreadDescriptor(uint64_t uuid,
+                                                int pid,
+                                                int tid,
+                                                const char* name) {
+  tracks_[uuid] = name;
+  scratch_.clear();
+  AppendVarIntField(&scratch_, field::kPid, pid);
+  AppendVarIntField(&scratch_, field::kTid, tid);
+  if (*name != '\0') AppendStringField(&scratch_, field::kThreadName, name);
+  nested_.clear();
+  AppendVarIntField(&nested_, field::kUuid, uuid);
+  AppendMessageField(&nested_, field::kThread, scratch_);
+  AppendMessageField(&packet_, field::kTrackDescriptor, nested_);
+  WritePacket(-1, false);
+}
+
+uint64_t PerfettoTraceWriter::InternString(InternTable* table,
+                                           uint32_t interned_data_field,
+                                           const char* str) {
+  auto it = table->find(str);
+  if (it != table->end()) return it->second;
+  uint64_t iid = AppendInternedString(interned_data_field, str);
+  table->emplace(str, iid);
+  return iid;
+}
+
+uint64_t PerfettoTraceWriter::InternCategory(
+    const uint8_t* category_enabled_flag) {
+  // Category group flags are never deallocated, so they can be used as keys.
+  auto it = categories_.find(category_enabled_flag);
+  if (it != categories_.end()) return it->second;
+  uint64_t iid = AppendInternedString(
+      field::kEventCategories,
+      v8::platform::tracing::TracingController::GetCategoryGroupName(
+          category_enabled_flag));
+  categories_.emplace(category_enabled_flag, iid);
+  return iid;
+}
+
+uint64_t PerfettoTraceWriter::AppendInternedString(
+    uint32_t interned_data_field, const char* str) {
+  uint64_t iid = next_iid_++;
+  scratch_.clear();
+  AppendVarIntField(&scratch_, field::kIid, iid);
+  AppendStringField(&scratch_, field::kInternedName, str);
+  AppendMessageField(&interned_, interned_data_field, scratch_);
+  return iid;
+}
+
+void PerfettoTraceWriter::WritePacket(int64_t ts,
+                                      bool needs_incremental_state) {
+  if (ts >= 0) {
+    // Trace event timestamps are in microseconds.
+    AppendVarIntField(&packet_, field::kTimestamp,
+                      static_cast<uint64_t>(ts) * 1000);
+  }
+  AppendVarIntField(&packet_, field::kTrustedPacketSequenceId, kSequenceId);
+  if (!interned_.empty())
+    AppendMessageField(&packet_, field::kInternedData, interned_);
+  uint32_t flags = needs_incremental_state ? kNeedsIncrementalState : 0;
+  if (first_packet_) {
+    flags |= kIncrementalStateCleared;
+    first_packet_ = false;
+  }
+  if (flags != 0) AppendVarIntField(&packet_, field::kSequenceFlags, flags);
+
+  scratch_.clear();
+  AppendTag(&scratch_, field::kTracePacket, kLengthDelimited);
+  AppendVarInt(&scratch_, packet_.size());
+  stream_.write(scratch_.data(), scratch_.size());
+  stream_.write(packet_.data(), packet_.size());
+
+  packet_.clear();
+  event_.clear();
+  interned_.clear();
+}
+
+}  // namespace tracing
+}  // namespace node
@@ -0,0 +1,78 @@
+#ifndef SRC_TRACING_PERFETTO_TRACE_WRITER_H_
+#define SRC_TRACING_PERFETTO_TRACE_WRITER_H_
+
+#include "libplatform/v8-tracing.h"
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+namespace node {
+namespace tracing {
+
+using v8::platform::tracing::TraceObject;
+using v8::platform::tracing::TraceWriter;
+
+// Serializes trace events as a stream of Perfetto TracePacket protos, i.e. in
+// the format of a perfetto.protos.Trace message, which is understood by
+// ui.perfetto.dev, trace_processor and chrome://tracing.
+//
+// Category, event and argument names are interned: each one is written once
+// per writer, together with the first packet that uses it, and referenced
+// by id afterwards. Interning state is reset for every new writer, so every
+// file that a writer is used for can be loaded on its own.
+class PerfettoTraceWriter : public TraceWriter {
+ public:
+  explicit PerfettoTraceWriter(std::ostream& stream);
+
+  void AppendTraceEvent(TraceObject* trace_event) override;
+  void Flush() override {}
+
+ private:
+  using InternTable = std::unordered_map<std::string, uint64_t>;
+
+  uint64_t InternString(InternTable* table, uint32_t interned_data_field,
+                        const char* str);
+  uint64_t InternCategory(const uint8_t* category_enabled_flag);
+  // Adds a new entry to the interned data of the current packet.
+  uint64_t AppendInternedString(uint32_t interned_data_field,
+                                const char* str);
+  uint64_t ThreadTrack(int pid, int tid);
+  uint64_t ProcessTrack(int pid);
+  uint64_t CounterTrack(int pid, const char* name, const char* arg_name);
+  void AppendMetadata(TraceObject* trace_event);
+  void AppendEventPacket(TraceObject* trace_event, int type, int64_t ts,
+                         uint64_t track, bool with_details);
+  void AppendDebugAnnotations(TraceObject* trace_event);
+  void WriteProcessDescriptor(uint64_t uuid, int pid, const char* name);
+  void WriteThreadDescriptor(uint64_t uuid, int pid, int tid,
+                             const char* name);
+  void AppendCounterPackets(TraceObject* trace_event);
+  // Writes packet_ to stream_ and clears packet_, event_ and interned_.
+  void WritePacket(int64_t ts, bool needs_incremental_state);
+
+  std::ostream& stream_;
+  bool first_packet_ = true;
+  // Scratch buffers, reused across packets.
+  std::string packet_;
+  std::string event_;
+  std::string interned_;
+  std::string nested_;
+  std::string scratch_;
+
+  std::unordered_map<const uint8_t*, uint64_t> categories_;
+  InternTable event_names_;
+  InternTable annotation_names_;
+  uint64_t next_iid_ = 1;
+
+  // Track descriptors that have been written, and the name they were
+  // written with.
+  std::unordered_map<uint64_t, std::string> tracks_;
+  InternTable counter_tracks_;
+  uint64_t next_counter_track_ = 1;
+};
+
+}  // namespace tracing
+}  // namespace node
+
+#endif  // SRC_TRACING_PERFETTO_TRACE_WRITER_H_
@@ -735,12 +735,13 @@ Local<String> UnionBytes::ToStringChecked(Isolate* isolate) const {
   }
 }
 
-RAIIIsolateWithoutEntering::RAIIIsolateWithoutEntering(const SnapshotData* data)
+RAIIIsolateWithoutEntering::RAIIIsolateWithoutEntering(const SnapshotData* data,
+                                                       uv_loop_t* loop)
     : allocator_{ArrayBuffer::Allocator::NewDefaultAllocator()} {
   isolate_ = Isolate::Allocate();
   CHECK_NOT_NULL(isolate_);
-  per_process::v8_platform.Platform()->RegisterIsolate(isolate_,
-                                                       uv_default_loop());
+  per_process::v8_platform.Platform()->RegisterIsolate(
+      isolate_, loop != nullptr ? loop : uv_default_loop());
   Isolate::CreateParams params;
   if (data != nullptr) {
     SnapshotBuilder::InitializeIsolateParams(data, &params);
@@ -756,8 +757,8 @@ RAIIIsolateWithoutEntering::~RAIIIsolateWithoutEntering() {
   per_process::v8_platform.Platform()->DisposeIsolate(isolate_);
 }
 
-RAIIIsolate::RAIIIsolate(const SnapshotData* data)
-    : isolate_{data}, isolate_scope_{isolate_.get()} {}
+RAIIIsolate::RAIIIsolate(const SnapshotData* data, uv_loop_t* loop)
+    : isolate_{data, loop}, isolate_scope_{isolate_.get()} {}
 
 RAIIIsolate::~RAIIIsolate() {}
 
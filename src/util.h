@@ -983,7 +983,10 @@ void SetConstructorFunction(v8::Isolate* isolate,
 // Like RAIIIsolate, except doesn't enter the isolate while it's in scope.
 class RAIIIsolateWithoutEntering {
  public:
-  explicit RAIIIsolateWithoutEntering(const SnapshotData* data = nullptr);
+  // The isolate's foreground tasks are posted to loop, or to the default
+  // loop if it is null.
+  explicit RAIIIsolateWithoutEntering(const SnapshotData* data = nullptr,
+                                      uv_loop_t* loop = nullptr);
   ~RAIIIsolateWithoutEntering();
 
   v8::Isolate* get() const { return isolate_; }
@@ -997,7 +1000,8 @@ class RAIIIsolateWithoutEntering {
 // immediately.
 class RAIIIsolate {
  public:
-  explicit RAIIIsolate(const SnapshotData* data = nullptr);
+  explicit RAIIIsolate(const SnapshotData* data = nullptr,
+                       uv_loop_t* loop = nullptr);
   ~RAIIIsolate();
 
   v8::Isolate* get() const { return isolate_.get(); }
@@ -2,7 +2,11 @@
 #define TEST_CCTEST_NODE_TEST_FIXTURE_H_
 
 #include <cstdlib>
+#include <filesystem>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include "gtest/gtest.h"
 #include "node.h"
 #include "node_platform.h"
@@ -55,6 +59,39 @@ struct Argv {
   int nr_args_;
 };
 
+// A directory for the files of the current test. It is unique to the test
+// and the process, created empty and removed again with the object.
+class TestTempDir {
+ public:
+  explicit TestTempDir(std::string_view prefix) {
+    const testing::TestInfo* test =
+        testing::UnitTest::GetInstance()->current_test_info();
+    path_ = testing::TempDir() + std::string(prefix) + "-" + test->name() +
+            "-" + std::to_string(uv_os_getpid());
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+    CHECK(std::filesystem::create_directories(path_, ec));
+  }
+
+  ~TestTempDir() {
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+  }
+
+  TestTempDir(const TestTempDir&) = delete;
+  TestTempDir& operator=(const TestTempDir&) = delete;
+
+  const std::string& path() const { return path_; }
+
+  // Returns the path of a file in the directory.
+  std::string Path(std::string_view name) const {
+    return path_ + "/" + std::string(name);
+  }
+
+ private:
+  std::string path_;
+};
+
 using ArrayBufferUniquePtr = std::unique_ptr<node::ArrayBufferAllocator,
       decltype(&node::FreeArrayBufferAllocator)>;
 using TracingAgentUniquePtr = std::unique_ptr<node::tracing::Agent>;
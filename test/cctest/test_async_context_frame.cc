@@ -0,0 +1,197 @@
+#include "async_context_frame.h"
+#include "cppgc_helpers-inl.h"
+#include "env-inl.h"
+#include "gtest/gtest.h"
+#include "node_test_fixture.h"
+
+#include <vector>
+
+using node::Environment;
+using node::async_context_frame::AsyncContextFrame;
+using v8::Global;
+using v8::HandleScope;
+using v8::Integer;
+using v8::Isolate;
+using v8::Local;
+using v8::Object;
+using v8::Value;
+
+using Entry = AsyncContextFrame::Entry;
+using Node = AsyncContextFrame::Node;
+
+class AsyncContextFrameTest : public EnvironmentTestFixture {
+ protected:
+  // Returns the value stored for key in frame, or an empty handle.
+  static Local<Value> Get(Isolate* isolate,
+                          AsyncContextFrame* frame,
+                          int hash,
+                          Local<Object> key) {
+    const Entry* entry = frame->Lookup(hash, key);
+    if (entry == nullptr) return Local<Value>();
+    return entry->value.Get(isolate);
+  }
+
+  static int32_t GetInt(Isolate* isolate,
+                        AsyncContextFrame* frame,
+                        int hash,
+                        Local<Object> key) {
+    Local<Value> value = Get(isolate, frame, hash, key);
+    EXPECT_FALSE(value.IsEmpty());
+    if (value.IsEmpty()) return -1;
+    return value.As<Integer>()->Value();
+  }
+};
+
+// Frames are persistent: updates return new frames and leave the old ones
+// as they were.
+TEST_F(AsyncContextFrameTest, InsertAndRemove) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  constexpr int kKeys = 100;
+  std::vector<Local<Object>> keys;
+  std::vector<AsyncContextFrame*> frames = {AsyncContextFrame::Create(*env)};
+  for (int i = 0; i < kKeys; i++) {
+    keys.push_back(Object::New(isolate_));
+    frames.push_back(frames.back()->With(keys[i], Integer::New(isolate_, i)));
+    ASSERT_NE(frames.back(), nullptr);
+  }
+
+  for (int n = 0; n <= kKeys; n++) {
+    AsyncContextFrame* frame = frames[n];
+    EXPECT_EQ(frame->size(), static_cast<size_t>(n));
+    for (int i = 0; i < kKeys; i++) {
+      if (i < n) {
+        int hash = keys[i]->GetIdentityHash();
+        EXPECT_EQ(GetInt(isolate_, frame, hash, keys[i]), i);
+        EXPECT_NE(frame->Lookup(keys[i]), nullptr);
+      } else {
+        EXPECT_EQ(frame->Lookup(keys[i]), nullptr);
+      }
+    }
+  }
+
+  // Replacing a value does not change the size.
+  AsyncContextFrame* full = frames.back();
+  AsyncContextFrame* replaced = full->With(keys[0], Integer::New(isolate_, -5));
+  EXPECT_EQ(replaced->size(), full->size());
+  EXPECT_EQ(GetInt(isolate_, replaced, keys[0]->GetIdentityHash(), keys[0]),
+            -5);
+  EXPECT_EQ(GetInt(isolate_, full, keys[0]->GetIdentityHash(), keys[0]), 0);
+
+  // Removing a missing key returns the frame itself.
+  EXPECT_EQ(frames[0]->Without(keys[0]), frames[0]);
+
+  AsyncContextFrame* frame = full;
+  for (int i = 0; i < kKeys; i++) {
+    frame = frame->Without(keys[i]);
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(frame->size(), static_cast<size_t>(kKeys - i - 1));
+    EXPECT_EQ(frame->Lookup(keys[i]), nullptr);
+    if (i + 1 < kKeys) {
+      EXPECT_NE(frame->Lookup(keys[i + 1]), nullptr);
+    }
+  }
+  EXPECT_EQ(frame->root(), nullptr);
+  EXPECT_EQ(full->size(), static_cast<size_t>(kKeys));
+}
+
+// Keys with the same hash end up in a collision node below the last level.
+TEST_F(AsyncContextFrameTest, Collisions) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  constexpr int kHash = 0x2345;
+  Local<Object> keys[] = {
+      Object::New(isolate_), Object::New(isolate_), Object::New(isolate_)};
+  AsyncContextFrame* frame = AsyncContextFrame::Create(*env);
+  for (int i = 0; i < 3; i++) {
+    frame = frame->With(kHash, keys[i], Integer::New(isolate_, i));
+  }
+  EXPECT_EQ(frame->size(), 3u);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(GetInt(isolate_, frame, kHash, keys[i]), i);
+  }
+  // A key with the same hash that is not in the frame is not found.
+  EXPECT_EQ(frame->Lookup(kHash, Object::New(isolate_)), nullptr);
+
+  AsyncContextFrame* replaced =
+      frame->With(kHash, keys[1], Integer::New(isolate_, 10));
+  EXPECT_EQ(replaced->size(), 3u);
+  EXPECT_EQ(GetInt(isolate_, replaced, kHash, keys[1]), 10);
+  EXPECT_EQ(GetInt(isolate_, frame, kHash, keys[1]), 1);
+
+  AsyncContextFrame* removed = frame->Without(kHash, keys[1]);
+  EXPECT_EQ(removed->size(), 2u);
+  EXPECT_EQ(removed->Lookup(kHash, keys[1]), nullptr);
+  EXPECT_EQ(GetInt(isolate_, removed, kHash, keys[0]), 0);
+  EXPECT_EQ(GetInt(isolate_, removed, kHash, keys[2]), 2);
+}
+
+// When only one entry is left below a slot, it is moved back up to the slot.
+TEST_F(AsyncContextFrameTest, PullsUpSingleEntries) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  Local<Object> a = Object::New(isolate_);
+  Local<Object> b = Object::New(isolate_);
+  Local<Object> c = Object::New(isolate_);
+  // a and b share the slot on the first two levels, c has the same hash as
+  // a.
+  constexpr int kHashA = 1;
+  constexpr int kHashB = 1 + (1 << 10);
+  AsyncContextFrame* frame = AsyncContextFrame::Create(*env)
+                                 ->With(kHashA, a, Integer::New(isolate_, 0))
+                                 ->With(kHashB, b, Integer::New(isolate_, 1));
+  const Node* root = frame->root();
+  ASSERT_EQ(root->count, 1u);
+  ASSERT_TRUE(root->children()[0].node);
+  EXPECT_FALSE(root->children()[0].entry);
+
+  AsyncContextFrame* without_b = frame->Without(kHashB, b);
+  root = without_b->root();
+  ASSERT_EQ(root->count, 1u);
+  EXPECT_FALSE(root->children()[0].node);
+  ASSERT_TRUE(root->children()[0].entry);
+  EXPECT_EQ(GetInt(isolate_, without_b, kHashA, a), 0);
+
+  AsyncContextFrame* with_c =
+      without_b->With(kHashA, c, Integer::New(isolate_, 2));
+  EXPECT_TRUE(with_c->root()->children()[0].node);
+  AsyncContextFrame* without_a = with_c->Without(kHashA, a);
+  root = without_a->root();
+  ASSERT_EQ(root->count, 1u);
+  ASSERT_TRUE(root->children()[0].entry);
+  EXPECT_EQ(GetInt(isolate_, without_a, kHashA, c), 2);
+
+  EXPECT_EQ(without_a->Without(kHashA, c)->root(), nullptr);
+}
+
+// Creates a frame with a store that refers back to the frame, and returns
+// a weak handle to it.
+static void CreateSelfReferencingFrame(Environment* env,
+                                       Global<Object>* weak) {
+  Isolate* isolate = env->isolate();
+  HandleScope handle_scope(isolate);
+  Local<Object> key = Object::New(isolate);
+  Local<Object> store = Object::New(isolate);
+  AsyncContextFrame* frame = AsyncContextFrame::Create(env)->With(key, store);
+  store->Set(env->context(), key, frame->object()).Check();
+  weak->Reset(isolate, frame->object());
+  weak->SetWeak();
+}
+
+TEST_F(AsyncContextFrameTest, SelfReferencingFrameIsCollected) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  Global<Object> weak;
+  CreateSelfReferencingFrame(*env, &weak);
+  ASSERT_FALSE(weak.IsEmpty());
+  isolate_->LowMemoryNotification();
+  EXPECT_TRUE(weak.IsEmpty());
+}
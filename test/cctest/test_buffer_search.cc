@@ -0,0 +1,93 @@
+#include "gtest/gtest.h"
+#include "node_buffer_search.h"
+
+#include <string>
+#include <vector>
+
+using node::Buffer::CountByte;
+using node::Buffer::FindAll;
+using node::Buffer::SplitOffsets;
+
+namespace {
+
+std::vector<uint32_t> FindAllOf(const std::string& haystack,
+                                const std::string& needle,
+                                size_t capacity) {
+  std::vector<uint32_t> result;
+  std::vector<uint32_t> out(capacity);
+  size_t start = 0;
+  for (;;) {
+    size_t count = FindAll(reinterpret_cast<const uint8_t*>(haystack.data()),
+                           haystack.size(),
+                           start,
+                           reinterpret_cast<const uint8_t*>(needle.data()),
+                           needle.size(),
+                           out.data(),
+                           out.size());
+    result.insert(result.end(), out.begin(), out.begin() + count);
+    if (count < capacity) return result;
+    start = out[count - 1] + needle.size();
+  }
+}
+
+std::vector<uint32_t> FindAllNaive(const std::string& haystack,
+                                   const std::string& needle) {
+  std::vector<uint32_t> result;
+  for (size_t pos = haystack.find(needle); pos != std::string::npos;
+       pos = haystack.find(needle, pos + needle.size())) {
+    result.push_back(static_cast<uint32_t>(pos));
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(BufferSearchTest, FindAllMatchesNaiveSearch) {
+  // Long enough to cover the vector loops, the tails and matches that
+  // straddle vector blocks.
+  std::string haystack;
+  for (int i = 0; i < 1000; i++) haystack += "ab"[(i * 7 + i / 3) % 2];
+  for (const char* needle : {"a", "b", "ab", "aa", "aba", "abba", "bbaab"}) {
+    for (size_t capacity : {1, 3, 64, 1024}) {
+      EXPECT_EQ(FindAllOf(haystack, needle, capacity),
+                FindAllNaive(haystack, needle))
+          << needle << " " << capacity;
+    }
+  }
+}
+
+TEST(BufferSearchTest, FindAllDoesNotOverlap) {
+  std::string haystack(100, 'a');
+  std::vector<uint32_t> offsets = FindAllOf(haystack, "aaa", 8);
+  ASSERT_EQ(offsets.size(), 33u);
+  EXPECT_EQ(offsets[1], 3u);
+  EXPECT_EQ(offsets[32], 96u);
+}
+
+TEST(BufferSearchTest, SplitOffsets) {
+  const std::string input = "{\"a\":1}\n{\"b\":2}\n\n{\"c\":3}";
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(input.data());
+  const uint8_t newline = '\n';
+  uint32_t out[8];
+  EXPECT_EQ(SplitOffsets(data, input.size(), 0, &newline, 1, out, 8), 4u);
+  EXPECT_EQ(out[0], 7u);
+  EXPECT_EQ(out[1], 15u);
+  EXPECT_EQ(out[2], 16u);
+  EXPECT_EQ(out[3], input.size());
+
+  // Without room for the end of the last segment, the split is resumed.
+  EXPECT_EQ(SplitOffsets(data, input.size(), 0, &newline, 1, out, 3), 3u);
+  EXPECT_EQ(out[2], 16u);
+  EXPECT_EQ(SplitOffsets(data, input.size(), 17, &newline, 1, out, 3), 1u);
+  EXPECT_EQ(out[0], input.size());
+}
+
+TEST(BufferSearchTest, CountByte) {
+  std::string input(10000, 'x');
+  for (size_t i = 0; i < input.size(); i += 7) input[i] = '\n';
+  EXPECT_EQ(CountByte(reinterpret_cast<const uint8_t*>(input.data()),
+                      input.size(),
+                      '\n'),
+            1429u);
+  EXPECT_EQ(CountByte(nullptr, 0, '\n'), 0u);
+}
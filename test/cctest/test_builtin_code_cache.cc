@@ -0,0 +1,73 @@
+#include "node_builtins.h"
+#include "node_snapshot_builder.h"
+#include "node_v8_platform-inl.h"
+#include "util-inl.h"
+
+#include "gtest/gtest.h"
+#include "node_test_fixture.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using node::ExitCode;
+using node::NodePlatform;
+using node::SnapshotBuilder;
+using node::SnapshotData;
+using node::builtins::BuiltinLoader;
+using node::builtins::CodeCacheInfo;
+
+class BuiltinCodeCacheTest : public NodeZeroIsolateTestFixture {
+ protected:
+  void SetUp() override {
+    NodeZeroIsolateTestFixture::SetUp();
+    // The snapshot builder registers its isolates with the per-process
+    // platform, which the test runner does not initialize.
+    previous_platform_ = node::per_process::v8_platform.platform_;
+    node::per_process::v8_platform.platform_ = platform.get();
+  }
+
+  void TearDown() override {
+    // Lets the platform close the handles of the isolate that was run on
+    // this thread.
+    uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+    node::per_process::v8_platform.platform_ = previous_platform_;
+    NodeZeroIsolateTestFixture::TearDown();
+  }
+
+  static ExitCode Build(const SnapshotData* snapshot,
+                        std::vector<CodeCacheInfo>* out,
+                        size_t max_threads) {
+    return SnapshotBuilder::BuildCodeCacheFromSnapshot(
+        snapshot, out, max_threads);
+  }
+
+  static constexpr size_t kMaxThreads = SnapshotBuilder::kMaxCodeCacheThreads;
+
+ private:
+  NodePlatform* previous_platform_ = nullptr;
+};
+
+// The code cache compiled on several threads covers the same builtins as the
+// one compiled on a single thread, in the same order.
+TEST_F(BuiltinCodeCacheTest, ParallelMatchesSerial) {
+  const SnapshotData* snapshot = SnapshotBuilder::GetEmbeddedSnapshotData();
+  if (snapshot == nullptr) {
+    GTEST_SKIP() << "Built without an embedded snapshot";
+  }
+
+  std::vector<CodeCacheInfo> serial;
+  ASSERT_EQ(Build(snapshot, &serial, 1), ExitCode::kNoFailure);
+  std::vector<CodeCacheInfo> parallel;
+  ASSERT_EQ(Build(snapshot, &parallel, kMaxThreads), ExitCode::kNoFailure);
+
+  std::vector<std::string> ids = BuiltinLoader().GetCodeCacheBuiltinIds();
+  std::ranges::sort(ids);
+  ASSERT_EQ(serial.size(), ids.size());
+  ASSERT_EQ(parallel.size(), ids.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    EXPECT_EQ(serial[i].id, ids[i]);
+    EXPECT_EQ(parallel[i].id, ids[i]);
+    EXPECT_GT(parallel[i].data.length, 0u) << ids[i];
+  }
+}
@@ -0,0 +1,165 @@
+#include "compile_cache.h"
+#include "env-inl.h"
+#include "gtest/gtest.h"
+#include "module_wrap.h"
+#include "node_test_fixture.h"
+#include "util-inl.h"
+
+#include <cstring>
+#include <filesystem>
+#include <string>
+
+using node::CachedCodeType;
+using node::CompileCacheEnableStatus;
+using node::CompileCacheEntry;
+using node::EnableOption;
+using node::Environment;
+using node::loader::ModuleWrap;
+using v8::HandleScope;
+using v8::Local;
+using v8::Module;
+using v8::ScriptCompiler;
+using v8::Symbol;
+
+class CompileCacheTest : public EnvironmentTestFixture {
+ protected:
+  void EnableCompileCache(Environment* env) {
+    EXPECT_EQ(
+        env->EnableCompileCache(dir_.path(), EnableOption::DEFAULT).status,
+        CompileCacheEnableStatus::ENABLED);
+  }
+
+  // Compiles a module the way the default loader does, and returns whether
+  // V8 rejected the code cache.
+  bool Compile(Environment* env, const char* source, const char* url) {
+    bool rejected = false;
+    Local<Module> module;
+    EXPECT_TRUE(ModuleWrap::CompileSourceTextModule(
+                    env->principal_realm(),
+                    node::OneByteString(isolate_, source),
+                    node::OneByteString(isolate_, url),
+                    0,
+                    0,
+                    ModuleWrap::GetHostDefinedOptions(isolate_,
+                                                      Symbol::New(isolate_)),
+                    std::nullopt,
+                    &rejected)
+                    .ToLocal(&module))
+        << url;
+    return rejected;
+  }
+
+  // Returns the cache entry of a module that has been compiled.
+  CompileCacheEntry* GetEntry(Environment* env,
+                              const char* source,
+                              const char* url) {
+    return env->compile_cache_handler()->GetOrInsert(
+        node::OneByteString(isolate_, source),
+        node::OneByteString(isolate_, url),
+        CachedCodeType::kESM);
+  }
+
+  TestTempDir dir_{"compile-cache"};
+};
+
+static constexpr const char* kSourceA = "import './b.mjs'; export const a = 1;";
+static constexpr const char* kUrlA = "file:///app/a.mjs";
+static constexpr const char* kSourceB = "export const b = 2;";
+static constexpr const char* kUrlB = "file:///app/b.mjs";
+
+// The cache written on a miss is picked up by the next environment.
+TEST_F(CompileCacheTest, MissThenHit) {
+  const Argv argv;
+  std::string cache_filename;
+  {
+    const HandleScope handle_scope(isolate_);
+    Env env{handle_scope, argv};
+    EnableCompileCache(*env);
+    EXPECT_FALSE(Compile(*env, kSourceB, kUrlB));
+    CompileCacheEntry* entry = GetEntry(*env, kSourceB, kUrlB);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_NE(entry->cache, nullptr);
+    EXPECT_TRUE(entry->refreshed);
+    cache_filename = entry->cache_filename;
+    (*env)->FlushCompileCache();
+    EXPECT_TRUE(std::filesystem::exists(cache_filename));
+  }
+  {
+    const HandleScope handle_scope(isolate_);
+    Env env{handle_scope, argv};
+    EnableCompileCache(*env);
+    EXPECT_FALSE(Compile(*env, kSourceB, kUrlB));
+    CompileCacheEntry* entry = GetEntry(*env, kSourceB, kUrlB);
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->cache_filename, cache_filename);
+    EXPECT_NE(entry->cache, nullptr);
+    EXPECT_FALSE(entry->refreshed);
+  }
+}
+
+// A cache that V8 rejects is replaced by a fresh one.
+TEST_F(CompileCacheTest, RejectedCache) {
+  const Argv argv;
+  {
+    const HandleScope handle_scope(isolate_);
+    Env env{handle_scope, argv};
+    EnableCompileCache(*env);
+    Compile(*env, kSourceB, kUrlB);
+    (*env)->FlushCompileCache();
+  }
+  const HandleScope handle_scope(isolate_);
+  Env env{handle_scope, argv};
+  EnableCompileCache(*env);
+  CompileCacheEntry* entry = GetEntry(*env, kSourceB, kUrlB);
+  ASSERT_NE(entry, nullptr);
+  ASSERT_NE(entry->cache, nullptr);
+  // Change the flag hash in the header of the V8 code cache, as if it had
+  // been produced with other V8 flags.
+  constexpr int kFlagHashOffset = 3 * sizeof(uint32_t);
+  const int length = entry->cache->length;
+  ASSERT_GT(length, kFlagHashOffset);
+  uint8_t* data = new uint8_t[length];
+  memcpy(data, entry->cache->data, length);
+  data[kFlagHashOffset] ^= 0xff;
+  uint32_t stale_flag_hash;
+  memcpy(&stale_flag_hash, data + kFlagHashOffset, sizeof(stale_flag_hash));
+  entry->cache.reset(new ScriptCompiler::CachedData(
+      data, length, ScriptCompiler::CachedData::BufferOwned));
+
+  EXPECT_TRUE(Compile(*env, kSourceB, kUrlB));
+  EXPECT_EQ(GetEntry(*env, kSourceB, kUrlB), entry);
+  EXPECT_TRUE(entry->refreshed);
+  ASSERT_NE(entry->cache, nullptr);
+  uint32_t flag_hash;
+  memcpy(&flag_hash, entry->cache->data + kFlagHashOffset, sizeof(flag_hash));
+  EXPECT_NE(flag_hash, stale_flag_hash);
+}
+
+// Compiling a module starts reading the cache of its relative imports, which
+// is used when they are compiled even if the file is gone by then.
+TEST_F(CompileCacheTest, PrefetchesDependencies) {
+  const Argv argv;
+  std::string cache_filename;
+  {
+    const HandleScope handle_scope(isolate_);
+    Env env{handle_scope, argv};
+    EnableCompileCache(*env);
+    Compile(*env, kSourceA, kUrlA);
+    Compile(*env, kSourceB, kUrlB);
+    cache_filename = GetEntry(*env, kSourceB, kUrlB)->cache_filename;
+    (*env)->FlushCompileCache();
+  }
+  const HandleScope handle_scope(isolate_);
+  Env env{handle_scope, argv};
+  EnableCompileCache(*env);
+  EXPECT_FALSE(Compile(*env, kSourceA, kUrlA));
+  // Let the prefetch finish before its file is removed.
+  uv_run(&current_loop, UV_RUN_DEFAULT);
+  ASSERT_TRUE(std::filesystem::remove(cache_filename));
+
+  EXPECT_FALSE(Compile(*env, kSourceB, kUrlB));
+  CompileCacheEntry* entry = GetEntry(*env, kSourceB, kUrlB);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_NE(entry->cache, nullptr);
+  EXPECT_FALSE(entry->refreshed);
+}
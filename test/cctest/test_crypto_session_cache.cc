@@ -0,0 +1,170 @@
+#include "crypto/crypto_session_cache.h"
+#include "gtest/gtest.h"
+#include "node_internals.h"
+#include "uv.h"
+
+#include <openssl/ssl.h>
+
+#include <cstring>
+#include <ctime>
+#include <string>
+
+using node::crypto::SharedSessionCache;
+
+namespace {
+
+void SetSessionTime(SSL_SESSION* session, time_t t) {
+#if OPENSSL_VERSION_NUMBER >= 0x30300000L
+  SSL_SESSION_set_time_ex(session, t);
+#else
+  SSL_SESSION_set_time(session, t);
+#endif
+}
+
+ncrypto::SSLSessionPointer NewSession(unsigned char id_byte) {
+  ncrypto::SSLSessionPointer session(SSL_SESSION_new());
+  // i2d_SSL_SESSION() refuses sessions without a cipher.
+  SSL_CTX* ctx = SSL_CTX_new(TLS_method());
+  SSL* ssl = SSL_new(ctx);
+  const SSL_CIPHER* cipher = sk_SSL_CIPHER_value(SSL_get_ciphers(ssl), 0);
+  EXPECT_EQ(SSL_SESSION_set_cipher(session.get(), cipher), 1);
+  SSL_free(ssl);
+  SSL_CTX_free(ctx);
+
+  unsigned char id[32];
+  memset(id, id_byte, sizeof(id));
+  EXPECT_EQ(SSL_SESSION_set1_id(session.get(), id, sizeof(id)), 1);
+  EXPECT_EQ(SSL_SESSION_set_protocol_version(session.get(), TLS1_2_VERSION),
+            1);
+  SetSessionTime(session.get(), time(nullptr));
+  SSL_SESSION_set_timeout(session.get(), 300);
+  return session;
+}
+
+}  // namespace
+
+TEST(SharedSessionCache, InsertLookupRemove) {
+  SharedSessionCache* cache = SharedSessionCache::Get();
+  ncrypto::SSLSessionPointer session = NewSession(0x11);
+  unsigned int id_len;
+  const unsigned char* id = SSL_SESSION_get_id(session.get(), &id_len);
+
+  cache->Insert(session.get());
+  ncrypto::SSLSessionPointer found = cache->Lookup(id, id_len);
+  ASSERT_TRUE(found);
+  unsigned int found_id_len;
+  const unsigned char* found_id = SSL_SESSION_get_id(found.get(),
+                                                     &found_id_len);
+  ASSERT_EQ(found_id_len, id_len);
+  EXPECT_EQ(memcmp(found_id, id, id_len), 0);
+
+  cache->Remove(id, id_len);
+  EXPECT_FALSE(cache->Lookup(id, id_len));
+}
+
+TEST(SharedSessionCache, ExpiredSessionsAreNotReturned) {
+  SharedSessionCache* cache = SharedSessionCache::Get();
+  ncrypto::SSLSessionPointer session = NewSession(0x22);
+  SetSessionTime(session.get(), time(nullptr) - 1000);
+  unsigned int id_len;
+  const unsigned char* id = SSL_SESSION_get_id(session.get(), &id_len);
+
+  cache->Insert(session.get());
+  EXPECT_FALSE(cache->Lookup(id, id_len));
+}
+
+TEST(SharedSessionCache, TicketKeyRotation) {
+  SharedSessionCache* cache = SharedSessionCache::Get();
+  SharedSessionCache::TicketKeys old_keys;
+  cache->GetCurrentTicketKeys(&old_keys);
+
+  ASSERT_TRUE(cache->RotateTicketKeys());
+  SharedSessionCache::TicketKeys new_keys;
+  cache->GetCurrentTicketKeys(&new_keys);
+  EXPECT_NE(memcmp(old_keys.name, new_keys.name, sizeof(old_keys.name)), 0);
+
+  SharedSessionCache::TicketKeys found;
+  EXPECT_EQ(cache->FindTicketKeys(new_keys.name, &found), 1);
+  EXPECT_EQ(memcmp(found.aes, new_keys.aes, sizeof(found.aes)), 0);
+  // Tickets issued with the previous keys are accepted and renewed.
+  EXPECT_EQ(cache->FindTicketKeys(old_keys.name, &found), 2);
+  EXPECT_EQ(memcmp(found.aes, old_keys.aes, sizeof(found.aes)), 0);
+
+  unsigned char unknown[SharedSessionCache::kTicketKeyPartSize] = {};
+  EXPECT_EQ(cache->FindTicketKeys(unknown, &found), 0);
+}
+
+TEST(SharedSessionCache, Persistence) {
+  SharedSessionCache* cache = SharedSessionCache::Get();
+  std::string path = testing::TempDir() + "node-shared-session-cache.bin";
+  remove(path.c_str());
+  ASSERT_TRUE(cache->Configure(SharedSessionCache::kDefaultCapacity, path));
+
+  ncrypto::SSLSessionPointer session = NewSession(0x33);
+  unsigned int id_len;
+  const unsigned char* id = SSL_SESSION_get_id(session.get(), &id_len);
+  cache->Insert(session.get());
+  SharedSessionCache::TicketKeys saved_keys;
+  cache->GetCurrentTicketKeys(&saved_keys);
+  ASSERT_TRUE(cache->Flush());
+  // The temporary file is unique to this process and renamed into place.
+  std::string tmp_path =
+      path + "." + std::to_string(uv_os_getpid()) + ".tmp";
+  FILE* tmp = fopen(tmp_path.c_str(), "rb");
+  EXPECT_EQ(tmp, nullptr);
+  if (tmp != nullptr) fclose(tmp);
+
+  // Change the in-memory state without writing it to the file.
+  ASSERT_TRUE(cache->Configure(SharedSessionCache::kDefaultCapacity, ""));
+  cache->Remove(id, id_len);
+  ASSERT_TRUE(cache->RotateTicketKeys());
+  EXPECT_FALSE(cache->Lookup(id, id_len));
+
+  // Loading the file restores the session and the ticket keys.
+  ASSERT_TRUE(cache->Configure(SharedSessionCache::kDefaultCapacity, path));
+  EXPECT_TRUE(cache->Lookup(id, id_len));
+  SharedSessionCache::TicketKeys loaded_keys;
+  cache->GetCurrentTicketKeys(&loaded_keys);
+  EXPECT_EQ(memcmp(&loaded_keys, &saved_keys, sizeof(saved_keys)), 0);
+
+  ASSERT_TRUE(cache->Configure(SharedSessionCache::kDefaultCapacity, ""));
+  remove(path.c_str());
+}
+
+TEST(SharedSessionCache, TruncatedFile) {
+  SharedSessionCache* cache = SharedSessionCache::Get();
+  std::string path = testing::TempDir() + "node-shared-session-cache-cut.bin";
+  remove(path.c_str());
+  ASSERT_TRUE(cache->Configure(SharedSessionCache::kDefaultCapacity, path));
+
+  ncrypto::SSLSessionPointer session = NewSession(0x44);
+  unsigned int id_len;
+  const unsigned char* id = SSL_SESSION_get_id(session.get(), &id_len);
+  cache->Insert(session.get());
+  ASSERT_TRUE(cache->Flush());
+
+  // Cut the last session short.
+  std::string data;
+  ASSERT_EQ(node::ReadFileSync(&data, path.c_str()), 0);
+  data.resize(data.size() - 1);
+  FILE* file = fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(fwrite(data.data(), 1, data.size(), file), data.size());
+  fclose(file);
+
+  ASSERT_TRUE(cache->Configure(SharedSessionCache::kDefaultCapacity, ""));
+  cache->Remove(id, id_len);
+  ASSERT_TRUE(cache->RotateTicketKeys());
+  SharedSessionCache::TicketKeys keys;
+  cache->GetCurrentTicketKeys(&keys);
+
+  // The file is rejected as a whole, nothing it contains is applied.
+  EXPECT_FALSE(cache->Configure(SharedSessionCache::kDefaultCapacity, path));
+  EXPECT_FALSE(cache->Lookup(id, id_len));
+  SharedSessionCache::TicketKeys loaded_keys;
+  cache->GetCurrentTicketKeys(&loaded_keys);
+  EXPECT_EQ(memcmp(&loaded_keys, &keys, sizeof(keys)), 0);
+
+  ASSERT_TRUE(cache->Configure(SharedSessionCache::kDefaultCapacity, ""));
+  remove(path.c_str());
+}
@@ -0,0 +1,138 @@
+#include "encoding_binding.h"
+#include "env-inl.h"
+#include "gtest/gtest.h"
+#include "node_test_fixture.h"
+#include "util-inl.h"
+
+#include <string>
+#include <vector>
+
+using node::encoding_binding::UTF8Decoder;
+using v8::ArrayBuffer;
+using v8::Boolean;
+using v8::Context;
+using v8::Function;
+using v8::HandleScope;
+using v8::Local;
+using v8::Object;
+using v8::ObjectTemplate;
+using v8::TryCatch;
+using v8::Uint8Array;
+using v8::Value;
+
+class UTF8DecoderTest : public EnvironmentTestFixture {
+ protected:
+  // Creates a decoder through the binding constructor.
+  Local<Object> NewDecoder(Local<Context> context,
+                           bool ignore_bom,
+                           bool fatal) {
+    node::Environment* env = node::Environment::GetCurrent(context);
+    Local<ObjectTemplate> target = ObjectTemplate::New(isolate_);
+    UTF8Decoder::CreatePerIsolateProperties(env->isolate_data(), target);
+    Local<Value> constructor =
+        target->NewInstance(context)
+            .ToLocalChecked()
+            ->Get(context, v8::String::NewFromUtf8Literal(isolate_,
+                                                          "UTF8Decoder"))
+            .ToLocalChecked();
+    Local<Value> argv[] = {Boolean::New(isolate_, ignore_bom),
+                           Boolean::New(isolate_, fatal)};
+    return constructor.As<Function>()
+        ->NewInstance(context, node::arraysize(argv), argv)
+        .ToLocalChecked();
+  }
+
+  // Calls decoder.decode(bytes, stream). Returns "<error>" if it throws.
+  std::string Decode(Local<Context> context,
+                     Local<Object> decoder,
+                     const std::vector<uint8_t>& bytes,
+                     bool stream) {
+    Local<ArrayBuffer> buffer = ArrayBuffer::New(isolate_, bytes.size());
+    if (!bytes.empty()) memcpy(buffer->Data(), bytes.data(), bytes.size());
+    Local<Value> argv[] = {Uint8Array::New(buffer, 0, bytes.size()),
+                           Boolean::New(isolate_, stream)};
+    Local<Value> decode =
+        decoder
+            ->Get(context, v8::String::NewFromUtf8Literal(isolate_, "decode"))
+            .ToLocalChecked();
+    TryCatch try_catch(isolate_);
+    Local<Value> result;
+    if (!decode.As<Function>()
+             ->Call(context, decoder, node::arraysize(argv), argv)
+             .ToLocal(&result)) {
+      EXPECT_TRUE(try_catch.HasCaught());
+      return "<error>";
+    }
+    return *node::Utf8Value(isolate_, result);
+  }
+};
+
+TEST_F(UTF8DecoderTest, MultiByteSequencesAcrossChunks) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Local<Context> context = env.context();
+
+  for (bool fatal : {false, true}) {
+    Local<Object> decoder = NewDecoder(context, false, fatal);
+    // U+20AC, one byte per chunk.
+    EXPECT_EQ(Decode(context, decoder, {0xE2}, true), "");
+    EXPECT_EQ(Decode(context, decoder, {0x82}, true), "");
+    EXPECT_EQ(Decode(context, decoder, {0xAC}, true), "\xE2\x82\xAC");
+    // U+1F600 split in the middle, followed by ASCII in the same chunk.
+    EXPECT_EQ(Decode(context, decoder, {0x61, 0xF0, 0x9F}, true), "a");
+    EXPECT_EQ(Decode(context, decoder, {0x98, 0x80, 0x62}, true),
+              "\xF0\x9F\x98\x80"
+              "b");
+    // U+00E9 split across the last two chunks.
+    EXPECT_EQ(Decode(context, decoder, {0xC3}, true), "");
+    EXPECT_EQ(Decode(context, decoder, {0xA9}, false), "\xC3\xA9");
+  }
+}
+
+TEST_F(UTF8DecoderTest, BOMAcrossChunks) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Local<Context> context = env.context();
+
+  Local<Object> decoder = NewDecoder(context, false, false);
+  EXPECT_EQ(Decode(context, decoder, {0xEF}, true), "");
+  EXPECT_EQ(Decode(context, decoder, {0xBB, 0xBF, 0x61}, true), "a");
+  // Only a BOM at the start of the stream is removed.
+  EXPECT_EQ(Decode(context, decoder, {0xEF, 0xBB}, true), "");
+  EXPECT_EQ(Decode(context, decoder, {0xBF}, false), "\xEF\xBB\xBF");
+  // The end of the stream resets the decoder.
+  EXPECT_EQ(Decode(context, decoder, {0xEF, 0xBB}, true), "");
+  EXPECT_EQ(Decode(context, decoder, {0xBF, 0x62}, false), "b");
+
+  Local<Object> keep_bom = NewDecoder(context, true, false);
+  EXPECT_EQ(Decode(context, keep_bom, {0xEF, 0xBB}, true), "");
+  EXPECT_EQ(Decode(context, keep_bom, {0xBF, 0x61}, false),
+            "\xEF\xBB\xBF"
+            "a");
+}
+
+TEST_F(UTF8DecoderTest, FlushIncompleteSequence) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Local<Context> context = env.context();
+
+  Local<Object> replacing = NewDecoder(context, false, false);
+  EXPECT_EQ(Decode(context, replacing, {0x61, 0xE2, 0x82}, true), "a");
+  EXPECT_EQ(Decode(context, replacing, {}, false), "\xEF\xBF\xBD");
+  // The sequence is cut short by the next chunk.
+  EXPECT_EQ(Decode(context, replacing, {0xE2, 0x82}, true), "");
+  EXPECT_EQ(Decode(context, replacing, {0x62}, false),
+            "\xEF\xBF\xBD"
+            "b");
+
+  Local<Object> fatal = NewDecoder(context, false, true);
+  EXPECT_EQ(Decode(context, fatal, {0x61, 0xE2, 0x82}, true), "a");
+  EXPECT_EQ(Decode(context, fatal, {}, false), "<error>");
+  // The error resets the decoder.
+  EXPECT_EQ(Decode(context, fatal, {0x63}, false), "c");
+  EXPECT_EQ(Decode(context, fatal, {0xF0, 0x9F}, true), "");
+  EXPECT_EQ(Decode(context, fatal, {0x64}, false), "<error>");
+}
@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+#include "permission/fs_permission.h"
+
+#include <string>
+#include <vector>
+
+using node::kPathSeparator;
+using node::permission::FSPermission;
+
+namespace {
+
+// Turns a path written with '/' into one for the current platform.
+std::string P(std::string path) {
+  for (char& c : path) {
+    if (c == '/') c = kPathSeparator;
+  }
+  return path;
+}
+
+}  // namespace
+
+TEST(FSPermissionPathTrie, Empty) {
+  FSPermission::PathTrie trie;
+  EXPECT_TRUE(trie.empty());
+  trie.Build({});
+  EXPECT_TRUE(trie.empty());
+  EXPECT_FALSE(trie.Lookup(P("/tmp")));
+}
+
+TEST(FSPermissionPathTrie, ExactPaths) {
+  FSPermission::PathTrie trie;
+  trie.Build({P("/home/user/file.js"), P("/home/user/other.js")});
+  EXPECT_FALSE(trie.empty());
+  EXPECT_TRUE(trie.Lookup(P("/home/user/file.js")));
+  EXPECT_TRUE(trie.Lookup(P("/home/user/other.js")));
+  EXPECT_FALSE(trie.Lookup(P("/home/user")));
+  EXPECT_FALSE(trie.Lookup(P("/home/user/file.j")));
+  EXPECT_FALSE(trie.Lookup(P("/home/user/file.js2")));
+  EXPECT_FALSE(trie.Lookup(P("/home/user/file.js/child")));
+}
+
+TEST(FSPermissionPathTrie, Directories) {
+  FSPermission::PathTrie trie;
+  trie.Build({P("/tmp/*"), P("/home/user/project/*")});
+  EXPECT_TRUE(trie.Lookup(P("/tmp")));
+  EXPECT_TRUE(trie.Lookup(P("/tmp/a/b/c")));
+  EXPECT_TRUE(trie.Lookup(P("/home/user/project")));
+  EXPECT_TRUE(trie.Lookup(P("/home/user/project/index.js")));
+  EXPECT_FALSE(trie.Lookup(P("/tmpfile")));
+  EXPECT_FALSE(trie.Lookup(P("/home/user")));
+  EXPECT_FALSE(trie.Lookup(P("/home/user/project2")));
+}
+
+TEST(FSPermissionPathTrie, PartialSegments) {
+  FSPermission::PathTrie trie;
+  trie.Build({P("/tmp/test*"), P("/var/lib/a*/ignored")});
+  EXPECT_TRUE(trie.Lookup(P("/tmp/test")));
+  EXPECT_TRUE(trie.Lookup(P("/tmp/test.txt")));
+  EXPECT_TRUE(trie.Lookup(P("/tmp/tests/nested")));
+  EXPECT_FALSE(trie.Lookup(P("/tmp/tes")));
+  EXPECT_FALSE(trie.Lookup(P("/tmp")));
+  // Everything after the first '*' is ignored.
+  EXPECT_TRUE(trie.Lookup(P("/var/lib/apt")));
+  EXPECT_FALSE(trie.Lookup(P("/var/lib/dpkg")));
+}
+
+TEST(FSPermissionPathTrie, RepeatedLookupsAreCached) {
+  FSPermission::PathTrie trie;
+  trie.Build({P("/tmp/*")});
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(trie.Lookup(P("/tmp/file")));
+    EXPECT_FALSE(trie.Lookup(P("/etc/passwd")));
+  }
+  // Rebuilding invalidates the cached results.
+  trie.Build({P("/etc/*")});
+  EXPECT_FALSE(trie.Lookup(P("/tmp/file")));
+  EXPECT_TRUE(trie.Lookup(P("/etc/passwd")));
+}
+
+TEST(FSPermissionPathTrie, LongPaths) {
+  FSPermission::PathTrie trie;
+  const std::string dir = P("/tmp/" + std::string(300, 'a'));
+  trie.Build({dir + P("/*")});
+  // Too long to be cached, looked up every time.
+  for (int i = 0; i < 2; i++) {
+    EXPECT_TRUE(trie.Lookup(dir + P("/file")));
+    EXPECT_FALSE(trie.Lookup(dir + "b" + P("/file")));
+  }
+}
+
+// The paths below are granted or denied both by the trie and by the radix
+// tree that it replaced.
+TEST(FSPermissionPathTrie, SameAsRadixTree) {
+  FSPermission::PathTrie trie;
+  trie.Build({P("/home/user/project/*"), P("/tmp/test*"), P("/etc/hosts")});
+  for (const char* path : {"/home/user/project",
+                           "/home/user/project/index.js",
+                           "/tmp/test.txt",
+                           "/tmp/tests/nested",
+                           "/etc/hosts"}) {
+    EXPECT_TRUE(trie.Lookup(P(path))) << path;
+  }
+  for (const char* path : {"/home/user",
+                           "/home/user/project2",
+                           "/tmp",
+                           "/tmpfile",
+                           "/etc",
+                           "/etc/hosts2"}) {
+    EXPECT_FALSE(trie.Lookup(P(path))) << path;
+  }
+}
+
+// The radix tree granted a path one character short of a wildcard prefix,
+// and could miss a prefix that other entries extended.
+TEST(FSPermissionPathTrie, DifferentFromRadixTree) {
+  FSPermission::PathTrie trie;
+  trie.Build({P("/abc*"), P("/tmp/test*")});
+  // Granted by the radix tree.
+  EXPECT_FALSE(trie.Lookup(P("/ab")));
+  EXPECT_FALSE(trie.Lookup(P("/tmp/tes")));
+
+  trie.Build({P("/ab*"), P("/ab/*")});
+  // Denied by the radix tree.
+  EXPECT_TRUE(trie.Lookup(P("/ab")));
+  // Denied by both.
+  EXPECT_FALSE(trie.Lookup(P("/a")));
+
+  trie.Build({P("/tmp/test*"), P("/tmp/tests/*")});
+  // Denied by the radix tree.
+  EXPECT_TRUE(trie.Lookup(P("/tmp/test")));
+  // Granted by both.
+  EXPECT_TRUE(trie.Lookup(P("/tmp/tests")));
+
+  trie.Build({P("/a/b*"), P("/a/bc*")});
+  // Denied by the radix tree.
+  EXPECT_TRUE(trie.Lookup(P("/a/b")));
+  // Granted by both.
+  EXPECT_TRUE(trie.Lookup(P("/a/bcd")));
+}
@@ -0,0 +1,139 @@
+#include "base_object-inl.h"
+#include "gtest/gtest.h"
+#include "node_test_fixture.h"
+#include "node_v8.h"
+
+#include <vector>
+
+using node::BaseObject;
+using node::BaseObjectPtr;
+using node::Environment;
+using node::MakeBaseObject;
+using node::v8_utils::GCProfiler;
+using v8::Float64Array;
+using v8::Function;
+using v8::FunctionCallback;
+using v8::FunctionTemplate;
+using v8::HandleScope;
+using v8::Local;
+using v8::Object;
+using v8::Value;
+
+class GCProfilerTest : public EnvironmentTestFixture {
+ protected:
+  static BaseObjectPtr<GCProfiler> NewProfiler(Environment* env,
+                                               size_t ring_size) {
+    Local<Object> obj = BaseObject::MakeLazilyInitializedJSTemplate(env)
+                            ->GetFunction(env->context())
+                            .ToLocalChecked()
+                            ->NewInstance(env->context())
+                            .ToLocalChecked();
+    return MakeBaseObject<GCProfiler>(env, obj, ring_size);
+  }
+
+  // Calls one of the binding methods on the profiler.
+  static Local<Value> Call(Environment* env,
+                           GCProfiler* profiler,
+                           FunctionCallback method) {
+    Local<Function> fn = FunctionTemplate::New(env->isolate(), method)
+                             ->GetFunction(env->context())
+                             .ToLocalChecked();
+    return fn->Call(env->context(), profiler->object(), 0, nullptr)
+        .ToLocalChecked();
+  }
+};
+
+// Records of GCs that did not fit into the ring are overwritten, the rest
+// are returned oldest first.
+TEST_F(GCProfilerTest, RingWrapsAround) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  constexpr size_t kRingSize = 3;
+  BaseObjectPtr<GCProfiler> profiler = NewProfiler(*env, kRingSize);
+  ASSERT_TRUE(profiler->binary());
+  for (uint64_t i = 1; i <= 5; i++) {
+    profiler->start_time = i * 1000;
+    profiler->RecordSpaceSizesBeforeGC(isolate_);
+    profiler->CommitRecord(isolate_, v8::kGCTypeScavenge, i);
+  }
+
+  Local<Value> records = Call(*env, profiler.get(), GCProfiler::TakeRecords);
+  ASSERT_TRUE(records->IsFloat64Array());
+  Local<Float64Array> array = records.As<Float64Array>();
+  const size_t fields =
+      GCProfiler::kRecordFieldCount + isolate_->NumberOfHeapSpaces();
+  ASSERT_EQ(array->Length(), kRingSize * fields);
+  std::vector<double> values(array->Length());
+  array->CopyContents(values.data(), array->ByteLength());
+  for (size_t n = 0; n < kRingSize; n++) {
+    const double* record = values.data() + n * fields;
+    EXPECT_EQ(record[GCProfiler::kRecordStartTime], (n + 3) * 1000.0);
+    EXPECT_EQ(record[GCProfiler::kRecordDuration], n + 3.0);
+    EXPECT_EQ(record[GCProfiler::kRecordGCType],
+              static_cast<double>(v8::kGCTypeScavenge));
+  }
+
+  // Taking the records empties the ring.
+  records = Call(*env, profiler.get(), GCProfiler::TakeRecords);
+  EXPECT_EQ(records.As<Float64Array>()->Length(), 0u);
+}
+
+// Pauses are counted per GC type, in both modes.
+TEST_F(GCProfilerTest, PauseHistograms) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  for (size_t ring_size : {0, 4}) {
+    BaseObjectPtr<GCProfiler> profiler = NewProfiler(*env, ring_size);
+    EXPECT_EQ(profiler->binary(), ring_size > 0);
+    profiler->RecordPause(v8::kGCTypeScavenge, 2000);
+    profiler->RecordPause(v8::kGCTypeScavenge, 0);
+    profiler->RecordPause(v8::kGCTypeMarkSweepCompact, 50000);
+
+    Local<Value> histograms =
+        Call(*env, profiler.get(), GCProfiler::GetPauseHistograms);
+    ASSERT_TRUE(histograms->IsArray());
+    Local<Value> summary =
+        v8::Script::Compile(env.context(),
+                            v8::String::NewFromUtf8Literal(
+                                isolate_,
+                                "(histograms) => histograms.map((h) => "
+                                "`${h.count()}:${h.max()}`).join()"))
+            .ToLocalChecked()
+            ->Run(env.context())
+            .ToLocalChecked();
+    Local<Value> result =
+        summary.As<Function>()
+            ->Call(env.context(), env.context()->Global(), 1, &histograms)
+            .ToLocalChecked();
+    node::Utf8Value utf8(isolate_, result);
+    // Scavenge, MinorMarkSweep, MarkSweepCompact, IncrementalMarking,
+    // ProcessWeakCallbacks. The pause of 0 is recorded as 1.
+    EXPECT_STREQ(*utf8, "2:2000,0:0,1:50015,0:0,0:0") << ring_size;
+  }
+}
+
+// The binding refuses rings it would take too much memory to preallocate.
+TEST_F(GCProfilerTest, RingSizeOutOfRange) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  Local<FunctionTemplate> tmpl =
+      FunctionTemplate::New(isolate_, GCProfiler::New);
+  tmpl->InstanceTemplate()->SetInternalFieldCount(
+      BaseObject::kInternalFieldCount);
+  Local<Function> constructor =
+      tmpl->GetFunction(env.context()).ToLocalChecked();
+  for (uint32_t ring_size : {GCProfiler::kMaxRingSize,
+                             GCProfiler::kMaxRingSize + 1}) {
+    v8::TryCatch try_catch(isolate_);
+    Local<Value> arg = v8::Integer::NewFromUnsigned(isolate_, ring_size);
+    EXPECT_EQ(constructor->NewInstance(env.context(), 1, &arg).IsEmpty(),
+              ring_size > GCProfiler::kMaxRingSize);
+    EXPECT_EQ(try_catch.HasCaught(), ring_size > GCProfiler::kMaxRingSize);
+  }
+}
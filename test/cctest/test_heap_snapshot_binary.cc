@@ -0,0 +1,187 @@
+#include "gtest/gtest.h"
+#include "heap_snapshot_binary.h"
+#include "node_test_fixture.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using node::heap::BinaryHeapSnapshotEncoder;
+using node::heap::BinaryHeapSnapshotToken;
+
+namespace {
+
+class StringOutputStream : public v8::OutputStream {
+ public:
+  int GetChunkSize() override { return 1024; }
+  void EndOfStream() override { ended = true; }
+  WriteResult WriteAsciiChunk(char* data, int size) override {
+    contents.append(data, size);
+    return kContinue;
+  }
+
+  std::string contents;
+  bool ended = false;
+};
+
+// Minimal version of tools/heapsnapshot-binary-to-json.mjs. Produces JSON
+// without any insignificant whitespace.
+std::string Decode(const std::string& input) {
+  size_t pos = 0;
+  auto read_varint = [&]() {
+    uint64_t value = 0;
+    int shift = 0;
+    uint8_t byte;
+    do {
+      byte = static_cast<uint8_t>(input[pos++]);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      shift += 7;
+    } while (byte & 0x80);
+    return value;
+  };
+
+  EXPECT_EQ(input.compare(0, 4, "NHSB"), 0);
+  EXPECT_EQ(input[4], node::heap::kBinaryHeapSnapshotVersion);
+  pos = 5;
+
+  std::string out;
+  // Per open container: whether it is an object and how many values it has.
+  std::vector<std::pair<bool, size_t>> stack;
+  auto separator = [&]() {
+    if (stack.empty()) return;
+    auto& top = stack.back();
+    if (top.second > 0) out += top.first && top.second % 2 == 1 ? ':' : ',';
+    top.second++;
+  };
+
+  while (pos < input.size()) {
+    auto token = static_cast<BinaryHeapSnapshotToken>(input[pos++]);
+    switch (token) {
+      case BinaryHeapSnapshotToken::kEnd:
+        out += stack.back().first ? '}' : ']';
+        stack.pop_back();
+        break;
+      case BinaryHeapSnapshotToken::kArray:
+      case BinaryHeapSnapshotToken::kObject:
+        separator();
+        out += token == BinaryHeapSnapshotToken::kObject ? '{' : '[';
+        stack.emplace_back(token == BinaryHeapSnapshotToken::kObject, 0);
+        break;
+      case BinaryHeapSnapshotToken::kString:
+      case BinaryHeapSnapshotToken::kLiteral: {
+        size_t length = read_varint();
+        separator();
+        if (token == BinaryHeapSnapshotToken::kString) out += '"';
+        out += input.substr(pos, length);
+        if (token == BinaryHeapSnapshotToken::kString) out += '"';
+        pos += length;
+        break;
+      }
+      case BinaryHeapSnapshotToken::kIntRun: {
+        for (uint64_t count = read_varint(); count > 0; count--) {
+          uint64_t zigzag = read_varint();
+          separator();
+          out += std::to_string(static_cast<int64_t>(zigzag >> 1) ^
+                                -static_cast<int64_t>(zigzag & 1));
+        }
+        break;
+      }
+      default:
+        ADD_FAILURE() << "unknown token " << static_cast<int>(token);
+        return out;
+    }
+  }
+  EXPECT_TRUE(stack.empty());
+  return out;
+}
+
+std::string StripWhitespace(const std::string& json) {
+  std::string out;
+  bool in_string = false;
+  bool escape = false;
+  for (char c : json) {
+    if (in_string) {
+      if (escape) {
+        escape = false;
+      } else if (c == '\\') {
+        escape = true;
+      } else if (c == '"') {
+        in_string = false;
+      }
+    } else if (c == '"') {
+      in_string = true;
+    } else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+      continue;
+    }
+    out += c;
+  }
+  return out;
+}
+
+std::string Encode(const std::string& json, size_t chunk_size) {
+  StringOutputStream out;
+  BinaryHeapSnapshotEncoder encoder(&out);
+  std::string copy = json;
+  for (size_t i = 0; i < copy.size(); i += chunk_size) {
+    int size = static_cast<int>(std::min(chunk_size, copy.size() - i));
+    EXPECT_EQ(encoder.WriteAsciiChunk(&copy[i], size),
+              v8::OutputStream::kContinue);
+  }
+  encoder.EndOfStream();
+  EXPECT_TRUE(out.ended);
+  return out.contents;
+}
+
+}  // namespace
+
+TEST(BinaryHeapSnapshotEncoder, RoundTripsAcrossChunkBoundaries) {
+  const std::string json =
+      "{\"snapshot\":{\"meta\":{\"node_fields\":[\"type\",\"name\"],"
+      "\"node_types\":[[\"hidden\",\"array\"],\"string\"]},"
+      "\"node_count\":2,\"edge_count\":1,\"trace_function_count\":0},\n"
+      "\"nodes\":[9,1,1,0,\n3,2,-17,123456789012],\n"
+      "\"edges\":[],\n"
+      "\"samples\":[1.5,2e3],\n"
+      "\"flags\":[true,false,null],\n"
+      "\"strings\":[\"\",\"a \\\"quoted\\\" \\\\ string\",\"[{,:}]\","
+      "\"\\u00e9\"]}";
+  for (size_t chunk_size : {1, 2, 3, 7, 64, 4096}) {
+    EXPECT_EQ(Decode(Encode(json, chunk_size)), StripWhitespace(json))
+        << "chunk size " << chunk_size;
+  }
+}
+
+TEST(BinaryHeapSnapshotEncoder, LongIntegerArrays) {
+  std::string json = "[";
+  for (int i = 0; i < 10000; i++) {
+    if (i > 0) json += ',';
+    json += std::to_string(i * 37 - 5000);
+  }
+  json += "]";
+  std::string encoded = Encode(json, 65536);
+  EXPECT_EQ(Decode(encoded), json);
+  EXPECT_LT(encoded.size(), json.size() / 2);
+}
+
+class BinaryHeapSnapshotTest : public EnvironmentTestFixture {};
+
+TEST_F(BinaryHeapSnapshotTest, RoundTripsRealSnapshot) {
+  const v8::HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  const v8::HeapSnapshot* snapshot =
+      isolate_->GetHeapProfiler()->TakeHeapSnapshot();
+  ASSERT_NE(snapshot, nullptr);
+
+  StringOutputStream json;
+  snapshot->Serialize(&json, v8::HeapSnapshot::kJSON);
+  StringOutputStream binary;
+  BinaryHeapSnapshotEncoder encoder(&binary);
+  snapshot->Serialize(&encoder, v8::HeapSnapshot::kJSON);
+  const_cast<v8::HeapSnapshot*>(snapshot)->Delete();
+
+  ASSERT_TRUE(binary.ended);
+  EXPECT_EQ(Decode(binary.contents), StripWhitespace(json.contents));
+  EXPECT_LT(binary.contents.size(), json.contents.size());
+}
@@ -0,0 +1,105 @@
+#include "histogram-inl.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using node::Histogram;
+
+namespace {
+
+Histogram::Options ShardedOptions() {
+  Histogram::Options options;
+  options.sharded = true;
+  return options;
+}
+
+}  // namespace
+
+TEST(Histogram, ShardedMatchesUnsharded) {
+  Histogram plain(Histogram::Options{});
+  Histogram sharded(ShardedOptions());
+  EXPECT_FALSE(plain.sharded());
+  EXPECT_TRUE(sharded.sharded());
+
+  for (int64_t value = 1; value <= 1000; value++) {
+    EXPECT_TRUE(plain.Record(value));
+    EXPECT_TRUE(sharded.Record(value));
+  }
+  EXPECT_FALSE(sharded.Record(-1));
+
+  EXPECT_EQ(sharded.Count(), plain.Count());
+  EXPECT_EQ(sharded.Exceeds(), 1u);
+  EXPECT_EQ(sharded.Min(), plain.Min());
+  EXPECT_EQ(sharded.Max(), plain.Max());
+  EXPECT_EQ(sharded.Mean(), plain.Mean());
+  EXPECT_EQ(sharded.Percentile(50), plain.Percentile(50));
+  EXPECT_EQ(sharded.Percentile(99), plain.Percentile(99));
+
+  // Adding a sharded histogram includes the values in its shards.
+  Histogram sum(Histogram::Options{});
+  sum.Add(sharded);
+  EXPECT_EQ(sum.Count(), plain.Count());
+  EXPECT_EQ(sum.Max(), plain.Max());
+
+  sharded.Reset();
+  EXPECT_EQ(sharded.Count(), 0u);
+  EXPECT_EQ(sharded.Exceeds(), 0u);
+}
+
+TEST(Histogram, ShardedConcurrentRecord) {
+  constexpr int kThreads = 8;
+  constexpr int kValuesPerThread = 10000;
+  Histogram histogram(ShardedOptions());
+
+  std::vector<std::thread> recorders;
+  for (int i = 0; i < kThreads; i++) {
+    recorders.emplace_back([&histogram, i]() {
+      for (int j = 0; j < kValuesPerThread; j++)
+        histogram.Record(1 + i * kValuesPerThread + j);
+    });
+  }
+  for (std::thread& recorder : recorders) recorder.join();
+
+  EXPECT_EQ(histogram.Count(),
+            static_cast<size_t>(kThreads) * kValuesPerThread);
+  EXPECT_EQ(histogram.Min(), 1);
+  EXPECT_GE(histogram.Max(), kThreads * kValuesPerThread);
+}
+
+// Reading merges the shards while other threads keep recording to them.
+TEST(Histogram, ShardedReadWhileRecording) {
+  constexpr int kThreads = 4;
+  constexpr int kValuesPerThread = 50000;
+  Histogram histogram(ShardedOptions());
+
+  std::atomic<int> running{kThreads};
+  std::vector<std::thread> recorders;
+  for (int i = 0; i < kThreads; i++) {
+    recorders.emplace_back([&histogram, &running]() {
+      for (int j = 0; j < kValuesPerThread; j++) histogram.Record(1 + j);
+      running--;
+    });
+  }
+  size_t last_count = 0;
+  while (running.load() > 0) {
+    size_t count = histogram.Count();
+    EXPECT_GE(count, last_count);
+    last_count = count;
+    if (count > 0) {
+      EXPECT_EQ(histogram.Min(), 1);
+      EXPECT_LE(histogram.Max(), kValuesPerThread + kValuesPerThread / 100);
+    }
+  }
+  for (std::thread& recorder : recorders) recorder.join();
+
+  EXPECT_EQ(histogram.Count(),
+            static_cast<size_t>(kThreads) * kValuesPerThread);
+  EXPECT_EQ(histogram.Min(), 1);
+  EXPECT_GE(histogram.Max(), kValuesPerThread);
+  // Reading again without new values gives the same result.
+  EXPECT_EQ(histogram.Percentile(50), histogram.Percentile(50));
+  EXPECT_EQ(histogram.Count(),
+            static_cast<size_t>(kThreads) * kValuesPerThread);
+}
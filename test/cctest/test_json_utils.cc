@@ -2,6 +2,8 @@
 
 #include "gtest/gtest.h"
 
+#include <sstream>
+
 TEST(JSONUtilsTest, EscapeJsonChars) {
   using node::EscapeJsonChars;
   EXPECT_EQ("abc", EscapeJsonChars("abc"));
@@ -24,3 +26,34 @@ TEST(JSONUtilsTest, EscapeJsonChars) {
     EXPECT_EQ("a" + expected[i], EscapeJsonChars("a" + input));
   }
 }
+
+TEST(JSONUtilsTest, WriterFragments) {
+  using node::JSONWriter;
+  for (bool compact : {false, true}) {
+    std::ostringstream inline_out;
+    JSONWriter inline_writer(inline_out, compact);
+    inline_writer.json_start();
+    inline_writer.json_keyvalue("a", 1);
+    inline_writer.json_objectstart("b");
+    inline_writer.json_keyvalue("c", "d");
+    inline_writer.json_objectend();
+    inline_writer.json_keyvalue("e", 2);
+    inline_writer.json_objectend();
+
+    std::ostringstream fragment_out;
+    JSONWriter fragment_writer(fragment_out, compact, 2);
+    fragment_writer.json_objectstart("b");
+    fragment_writer.json_keyvalue("c", "d");
+    fragment_writer.json_objectend();
+
+    std::ostringstream out;
+    JSONWriter writer(out, compact);
+    writer.json_start();
+    writer.json_keyvalue("a", 1);
+    writer.json_raw(fragment_out.str());
+    writer.json_keyvalue("e", 2);
+    writer.json_objectend();
+
+    EXPECT_EQ(out.str(), inline_out.str());
+  }
+}
@@ -0,0 +1,224 @@
+#include "base_object-inl.h"
+#include "compile_cache.h"
+#include "env-inl.h"
+#include "gtest/gtest.h"
+#include "module_wrap.h"
+#include "node_test_fixture.h"
+#include "util-inl.h"
+
+#include <string>
+#include <vector>
+
+using node::BaseObject;
+using node::CachedCodeType;
+using node::CompileCacheEnableStatus;
+using node::CompileCacheEntry;
+using node::EnableOption;
+using node::Environment;
+using node::loader::ModuleWrap;
+using v8::Array;
+using v8::FunctionTemplate;
+using v8::HandleScope;
+using v8::Local;
+using v8::LocalVector;
+using v8::Module;
+using v8::Promise;
+using v8::Undefined;
+using v8::Value;
+
+class CompileAndLinkTest : public EnvironmentTestFixture {
+ protected:
+  struct Source {
+    const char* url;
+    const char* text;
+  };
+
+  void EnableCompileCache(Environment* env) {
+    EXPECT_EQ(
+        env->EnableCompileCache(cache_dir_.path(), EnableOption::DEFAULT)
+            .status,
+        CompileCacheEnableStatus::ENABLED);
+  }
+
+  // Calls compileAndLinkModules() and returns its promise.
+  Local<Promise> CompileAndLink(Environment* env,
+                                const std::vector<Source>& sources) {
+    LocalVector<Value> urls(isolate_);
+    LocalVector<Value> texts(isolate_);
+    for (const Source& source : sources) {
+      urls.push_back(node::OneByteString(isolate_, source.url));
+      texts.push_back(node::OneByteString(isolate_, source.text));
+    }
+    Local<Value> argv[] = {Array::New(isolate_, urls.data(), urls.size()),
+                           Array::New(isolate_, texts.data(), texts.size())};
+    return FunctionTemplate::New(isolate_, ModuleWrap::CompileAndLinkModules)
+        ->GetFunction(env->context())
+        .ToLocalChecked()
+        ->Call(env->context(), Undefined(isolate_), node::arraysize(argv), argv)
+        .ToLocalChecked()
+        .As<Promise>();
+  }
+
+  // Runs the loop until the streaming tasks are done, and returns the
+  // modules and errors the promise was resolved with.
+  std::pair<Local<Array>, Local<Array>> Settle(Environment* env,
+                                               Local<Promise> promise) {
+    uv_run(&current_loop, UV_RUN_DEFAULT);
+    EXPECT_EQ(promise->State(), Promise::kFulfilled);
+    Local<Array> result = promise->Result().As<Array>();
+    return {result->Get(env->context(), 0).ToLocalChecked().As<Array>(),
+            result->Get(env->context(), 1).ToLocalChecked().As<Array>()};
+  }
+
+  Local<Value> At(Environment* env, Local<Array> array, uint32_t i) {
+    return array->Get(env->context(), i).ToLocalChecked();
+  }
+
+  ModuleWrap* WrapAt(Environment* env, Local<Array> modules, uint32_t i) {
+    Local<Value> value = At(env, modules, i);
+    if (!value->IsObject()) return nullptr;
+    return BaseObject::FromJSObject<ModuleWrap>(value);
+  }
+
+  Module::Status StatusOf(ModuleWrap* wrap) {
+    return wrap->module_.Get(isolate_)->GetStatus();
+  }
+
+  static const std::vector<ModuleWrap*>& LinkedModuleWraps(ModuleWrap* wrap) {
+    return wrap->linked_module_wraps_;
+  }
+
+  TestTempDir cache_dir_{"compile-and-link"};
+};
+
+// Modules missing from the compile cache are streamed on the thread pool,
+// the others are compiled from the cache right away.
+TEST_F(CompileAndLinkTest, StreamedAndCached) {
+  const Argv argv;
+  const std::vector<Source> sources = {
+      {"file:///app/a.mjs", "import './b.mjs'; export const a = 1;"},
+      {"file:///app/b.mjs", "export const b = 2;"},
+  };
+  for (bool cached : {false, true}) {
+    const HandleScope handle_scope(isolate_);
+    Env env{handle_scope, argv};
+    EnableCompileCache(*env);
+    Local<Promise> promise = CompileAndLink(*env, sources);
+    // Without streaming tasks, the job is done before the call returns.
+    EXPECT_EQ(promise->State() == Promise::kPending, !cached);
+    auto [modules, errors] = Settle(*env, promise);
+    ASSERT_EQ(modules->Length(), sources.size());
+    for (uint32_t i = 0; i < sources.size(); i++) {
+      ModuleWrap* wrap = WrapAt(*env, modules, i);
+      ASSERT_NE(wrap, nullptr) << cached << " " << i;
+      EXPECT_EQ(StatusOf(wrap), Module::kInstantiated) << cached << " " << i;
+      EXPECT_TRUE(At(*env, errors, i)->IsUndefined()) << cached << " " << i;
+      CompileCacheEntry* entry = (*env)->compile_cache_handler()->GetOrInsert(
+          node::OneByteString(isolate_, sources[i].text),
+          node::OneByteString(isolate_, sources[i].url),
+          CachedCodeType::kESM);
+      ASSERT_NE(entry, nullptr);
+      EXPECT_NE(entry->cache, nullptr);
+      EXPECT_EQ(entry->refreshed, !cached) << i;
+    }
+    (*env)->FlushCompileCache();
+  }
+}
+
+// Errors are reported in the slot of the module they were thrown for, and
+// do not keep the other modules from being compiled and instantiated.
+TEST_F(CompileAndLinkTest, PerModuleErrors) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  const std::vector<Source> sources = {
+      {"file:///app/ok.mjs", "export const x = 1;"},
+      {"file:///app/bad.mjs", "export const = ;"},
+      {"file:///app/uses-bad.mjs", "import './bad.mjs';"},
+      {"file:///app/missing.mjs", "import { nope } from './ok.mjs';"},
+  };
+  auto [modules, errors] = Settle(*env, CompileAndLink(*env, sources));
+
+  ModuleWrap* ok = WrapAt(*env, modules, 0);
+  ASSERT_NE(ok, nullptr);
+  EXPECT_EQ(StatusOf(ok), Module::kInstantiated);
+  EXPECT_TRUE(At(*env, errors, 0)->IsUndefined());
+
+  // A compilation error leaves the module out.
+  EXPECT_EQ(WrapAt(*env, modules, 1), nullptr);
+  EXPECT_TRUE(At(*env, errors, 1)->IsNativeError());
+
+  // Its dependents are compiled, but left for the loader to link.
+  ModuleWrap* uses_bad = WrapAt(*env, modules, 2);
+  ASSERT_NE(uses_bad, nullptr);
+  EXPECT_FALSE(uses_bad->IsLinked());
+  EXPECT_EQ(StatusOf(uses_bad), Module::kUninstantiated);
+  EXPECT_TRUE(At(*env, errors, 2)->IsUndefined());
+
+  // An instantiation error is reported for the module that failed.
+  ModuleWrap* missing = WrapAt(*env, modules, 3);
+  ASSERT_NE(missing, nullptr);
+  EXPECT_TRUE(missing->IsLinked());
+  EXPECT_EQ(StatusOf(missing), Module::kUninstantiated);
+  EXPECT_TRUE(At(*env, errors, 3)->IsNativeError());
+}
+
+// Relative, absolute and file: specifiers are linked natively. Bare
+// specifiers and requests with import attributes are left to the loader.
+TEST_F(CompileAndLinkTest, Linking) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  const std::vector<Source> sources = {
+      {"file:///app/main.mjs",
+       "import './rel.mjs'; import '../app/up.mjs';"
+       "import '/app/abs.mjs'; import 'file:///app/url.mjs';"},
+      {"file:///app/rel.mjs", "export {};"},
+      {"file:///app/up.mjs", "export {};"},
+      {"file:///app/abs.mjs", "export {};"},
+      {"file:///app/url.mjs", "export {};"},
+      {"file:///app/bare.mjs", "import 'pkg';"},
+      {"file:///app/attributes.mjs",
+       "import data from './data.json' with { type: 'json' };"},
+      {"file:///app/data.json", "export default 1;"},
+  };
+  auto [modules, errors] = Settle(*env, CompileAndLink(*env, sources));
+
+  ModuleWrap* main = WrapAt(*env, modules, 0);
+  ASSERT_NE(main, nullptr);
+  EXPECT_TRUE(main->IsLinked());
+  EXPECT_EQ(StatusOf(main), Module::kInstantiated);
+  const std::vector<ModuleWrap*>& linked = LinkedModuleWraps(main);
+  ASSERT_EQ(linked.size(), 4u);
+  for (uint32_t i = 0; i < linked.size(); i++) {
+    EXPECT_EQ(linked[i], WrapAt(*env, modules, i + 1)) << i;
+  }
+
+  for (uint32_t i : {5, 6}) {
+    ModuleWrap* declined = WrapAt(*env, modules, i);
+    ASSERT_NE(declined, nullptr) << i;
+    EXPECT_FALSE(declined->IsLinked()) << i;
+    EXPECT_EQ(StatusOf(declined), Module::kUninstantiated) << i;
+  }
+  for (uint32_t i = 0; i < modules->Length(); i++) {
+    EXPECT_TRUE(At(*env, errors, i)->IsUndefined()) << i;
+  }
+}
+
+// A job that finishes once the environment can no longer call into JS
+// leaves the promise alone.
+TEST_F(CompileAndLinkTest, FinishWithoutJS) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  Local<Promise> promise =
+      CompileAndLink(*env, {{"file:///app/a.mjs", "export const a = 1;"}});
+  ASSERT_EQ(promise->State(), Promise::kPending);
+  (*env)->set_can_call_into_js(false);
+  uv_run(&current_loop, UV_RUN_DEFAULT);
+  (*env)->set_can_call_into_js(true);
+  EXPECT_EQ(promise->State(), Promise::kPending);
+}
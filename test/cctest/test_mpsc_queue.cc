@@ -0,0 +1,81 @@
+#include <memory>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "mpsc_queue.h"
+#include "node_internals.h"
+
+using node::MPSCQueue;
+
+TEST(MPSCQueue, SingleThreadFIFO) {
+  MPSCQueue<int> queue;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.Peek(), nullptr);
+
+  queue.Push(1);
+  queue.Push(2);
+  queue.Push(3);
+  EXPECT_EQ(queue.size(), 3u);
+  ASSERT_NE(queue.Peek(), nullptr);
+  EXPECT_EQ(*queue.Peek(), 1);
+
+  int value;
+  ASSERT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(value, 1);
+  ASSERT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(value, 2);
+  ASSERT_TRUE(queue.Pop(&value));
+  EXPECT_EQ(value, 3);
+  EXPECT_FALSE(queue.Pop(&value));
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.size(), 0u);
+}
+
+// Elements that are still queued are released by the destructor.
+TEST(MPSCQueue, DestructorReleasesElements) {
+  auto tracked = std::make_shared<int>(42);
+  {
+    MPSCQueue<std::shared_ptr<int>> queue;
+    queue.Push(tracked);
+    queue.Push(tracked);
+    std::shared_ptr<int> popped;
+    ASSERT_TRUE(queue.Pop(&popped));
+    EXPECT_EQ(tracked.use_count(), 3);
+  }
+  EXPECT_EQ(tracked.use_count(), 1);
+}
+
+// Every element pushed by several concurrent producers is received exactly
+// once, and the elements of each producer arrive in the order they were
+// pushed.
+TEST(MPSCQueue, MultipleProducers) {
+  constexpr int kProducers = 4;
+  constexpr int kPerProducer = 100000;
+  MPSCQueue<std::pair<int, int>> queue;
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < kPerProducer; i++) queue.Push({p, i});
+    });
+  }
+
+  std::vector<int> next(kProducers, 0);
+  int received = 0;
+  while (received < kProducers * kPerProducer) {
+    std::pair<int, int> item;
+    if (!queue.Pop(&item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_GE(item.first, 0);
+    ASSERT_LT(item.first, kProducers);
+    ASSERT_EQ(item.second, next[item.first]);
+    next[item.first]++;
+    received++;
+  }
+
+  for (auto& producer : producers) producer.join();
+  EXPECT_TRUE(queue.empty());
+  for (int p = 0; p < kProducers; p++) EXPECT_EQ(next[p], kPerProducer);
+}
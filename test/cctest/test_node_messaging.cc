@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+#include "node_messaging.h"
+#include "node_test_fixture.h"
+#include "util-inl.h"
+
+using node::Environment;
+using node::worker::Message;
+using node::worker::TransferList;
+using v8::Context;
+using v8::Function;
+using v8::HandleScope;
+using v8::Local;
+using v8::Script;
+using v8::String;
+using v8::Value;
+
+class MessagingTest : public EnvironmentTestFixture {
+ protected:
+  // Runs `source`, which must evaluate to a function, with `arg`.
+  Local<Value> Call(Local<Context> context,
+                    const char* source,
+                    Local<Value> arg = Local<Value>()) {
+    Local<Value> fn = Script::Compile(context,
+                                      String::NewFromUtf8(isolate_, source)
+                                          .ToLocalChecked())
+                          .ToLocalChecked()
+                          ->Run(context)
+                          .ToLocalChecked();
+    CHECK(fn->IsFunction());
+    int argc = arg.IsEmpty() ? 0 : 1;
+    return fn.As<Function>()
+        ->Call(context, context->Global(), argc, &arg)
+        .ToLocalChecked();
+  }
+
+  Local<Value> RoundTrip(Environment* env, Local<Value> value) {
+    Message message;
+    EXPECT_TRUE(
+        message.Serialize(env, env->context(), value, TransferList())
+            .FromJust());
+    return message.Deserialize(env, env->context()).ToLocalChecked();
+  }
+};
+
+TEST_F(MessagingTest, PlainDataRoundTrip) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Local<Context> context = env.context();
+
+  Local<Value> input = Call(context, R"(() => ({
+    int: -42,
+    double: 1.5,
+    negativeZero: -0,
+    oneByte: 'café',
+    twoByte: '☃ snow',
+    list: [true, false, null, undefined, 2 ** 40],
+    records: [{ x: 1, y: 'a' }, { x: 2, y: 'b' }, { y: 3, x: 4 }],
+    bytes: new Uint8Array([1, 2, 3]),
+    doubles: new Float64Array([0.5, -1]),
+    nested: { deeper: { deepest: [[]] } },
+  }))");
+  Local<Value> output = RoundTrip(*env, input);
+
+  Local<Value> result = Call(context, R"((o) => {
+    const checks = [
+      o.int === -42,
+      o.double === 1.5,
+      Object.is(o.negativeZero, -0),
+      o.oneByte === 'café',
+      o.twoByte === '☃ snow',
+      o.list.length === 5 && o.list[0] === true && o.list[1] === false,
+      o.list[2] === null && 3 in o.list && o.list[3] === undefined,
+      o.list[4] === 2 ** 40,
+      JSON.stringify(o.records) ===
+        '[{"x":1,"y":"a"},{"x":2,"y":"b"},{"y":3,"x":4}]',
+      Object.getPrototypeOf(o.records[1]) === Object.prototype,
+      o.bytes instanceof Uint8Array && o.bytes.join() === '1,2,3',
+      o.doubles instanceof Float64Array && o.doubles.join() === '0.5,-1',
+      Array.isArray(o.nested.deeper.deepest[0]),
+    ];
+    return checks.indexOf(false);
+  })", output);
+  EXPECT_EQ(result.As<v8::Int32>()->Value(), -1);
+}
+
+// Values that the plain data encoder does not handle are still cloned
+// correctly by the ValueSerializer.
+TEST_F(MessagingTest, PlainDataFallback) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Local<Context> context = env.context();
+
+  Local<Value> input = Call(context, R"(() => {
+    const shared = { a: 1 };
+    const cyclic = { b: 2 };
+    cyclic.self = cyclic;
+    const holey = [1, , 3];
+    const named = [1, 2];
+    named.extra = 'x';
+    return {
+      shared: [shared, shared],
+      cyclic,
+      holey,
+      named,
+      indexed: { 0: 'zero', key: 'value' },
+      map: new Map([[1, 2]]),
+      date: new Date(0),
+      view: new Uint8Array(new ArrayBuffer(8), 4, 2),
+      big: 10n,
+    };
+  })");
+  Local<Value> output = RoundTrip(*env, input);
+
+  Local<Value> result = Call(context, R"((o) => {
+    const checks = [
+      o.shared[0] === o.shared[1],
+      o.cyclic.self === o.cyclic,
+      o.holey.length === 3 && !(1 in o.holey),
+      o.named.extra === 'x',
+      o.indexed[0] === 'zero' && o.indexed.key === 'value',
+      o.map instanceof Map && o.map.get(1) === 2,
+      o.date instanceof Date && o.date.getTime() === 0,
+      o.view.byteOffset === 4 && o.view.buffer.byteLength === 8,
+      o.big === 10n,
+    ];
+    return checks.indexOf(false);
+  })", output);
+  EXPECT_EQ(result.As<v8::Int32>()->Value(), -1);
+}
+
+// Accessors are detected before any value is read, so falling back to the
+// ValueSerializer does not run getters a second time.
+TEST_F(MessagingTest, PlainDataGettersRunOnce) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Local<Context> context = env.context();
+
+  Local<Value> input = Call(context, R"(() => {
+    globalThis.getterCalls = 0;
+    const list = [1, 2];
+    Object.defineProperty(list, 1, {
+      enumerable: true,
+      get() { globalThis.getterCalls++; return 'element'; },
+    });
+    return {
+      first: 1,
+      get value() { globalThis.getterCalls++; return 'property'; },
+      list,
+    };
+  })");
+  Local<Value> output = RoundTrip(*env, input);
+
+  Local<Value> result = Call(context, R"((o) => {
+    const checks = [
+      globalThis.getterCalls === 2,
+      o.first === 1 && o.value === 'property',
+      o.list[1] === 'element',
+    ];
+    return checks.indexOf(false);
+  })", output);
+  EXPECT_EQ(result.As<v8::Int32>()->Value(), -1);
+}
@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+#include "histogram-inl.h"
+#include "node_perf.h"
+#include "node_test_fixture.h"
+#include "tracing/agent.h"
+
+#include <thread>
+
+using node::Environment;
+using node::Histogram;
+using node::performance::EventLoopPhaseProfiler;
+using node::performance::NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_NSEC;
+using node::performance::NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_SEC;
+using node::performance::NODE_PERFORMANCE_COARSE_CLOCK_NOW;
+using node::performance::NODE_PERFORMANCE_LOOP_PHASE_IO;
+using node::performance::NODE_PERFORMANCE_LOOP_PHASE_TIMERS;
+using node::performance::performance_process_start;
+using node::performance::PerformanceState;
+using node::tracing::TracingController;
+
+class LoopPhaseProfilerTest : public EnvironmentTestFixture {};
+
+TEST_F(LoopPhaseProfilerTest, RecordsWhileRunning) {
+  const v8::HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Environment* environment = *env;
+
+  EXPECT_EQ(environment->loop_phase_profiler(), nullptr);
+  { EventLoopPhaseProfiler::Scope scope(environment,
+                                        NODE_PERFORMANCE_LOOP_PHASE_TIMERS); }
+
+  EventLoopPhaseProfiler::Start(environment);
+  EventLoopPhaseProfiler* profiler = environment->loop_phase_profiler();
+  ASSERT_NE(profiler, nullptr);
+  std::shared_ptr<Histogram> timers =
+      profiler->histogram(NODE_PERFORMANCE_LOOP_PHASE_TIMERS);
+  std::shared_ptr<Histogram> io =
+      profiler->histogram(NODE_PERFORMANCE_LOOP_PHASE_IO);
+  EXPECT_EQ(timers->Count(), 0u);
+
+  { EventLoopPhaseProfiler::Scope scope(environment,
+                                        NODE_PERFORMANCE_LOOP_PHASE_TIMERS); }
+  EXPECT_EQ(timers->Count(), 1u);
+
+  // Keep the loop alive for one iteration, which polls for I/O once.
+  uv_idle_t idle;
+  uv_idle_init(environment->event_loop(), &idle);
+  uv_idle_start(&idle, [](uv_idle_t*) {});
+  uv_run(environment->event_loop(), UV_RUN_NOWAIT);
+  EXPECT_EQ(io->Count(), 1u);
+  uv_close(reinterpret_cast<uv_handle_t*>(&idle), nullptr);
+  uv_run(environment->event_loop(), UV_RUN_NOWAIT);
+
+  EventLoopPhaseProfiler::Stop(environment);
+  EXPECT_EQ(environment->loop_phase_profiler(), nullptr);
+  { EventLoopPhaseProfiler::Scope scope(environment,
+                                        NODE_PERFORMANCE_LOOP_PHASE_TIMERS); }
+  EXPECT_EQ(timers->Count(), 1u);
+}
+
+class PerformanceCoarseClockTest : public EnvironmentTestFixture {};
+
+TEST_F(PerformanceCoarseClockTest, RefreshUpdatesAllFields) {
+  const v8::HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  PerformanceState* state = (*env)->performance_state();
+  EXPECT_GE(state->coarse_now(), performance_process_start);
+
+  const uint64_t now = performance_process_start + 3'250'000'000;
+  state->RefreshCoarseClock(now);
+  EXPECT_EQ(state->coarse_now(), now);
+  EXPECT_DOUBLE_EQ(state->coarse_clock[NODE_PERFORMANCE_COARSE_CLOCK_NOW],
+                   3250.0);
+  EXPECT_EQ(state->coarse_clock[NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_SEC],
+            static_cast<double>(now / 1'000'000'000));
+  EXPECT_EQ(state->coarse_clock[NODE_PERFORMANCE_COARSE_CLOCK_HRTIME_NSEC],
+            static_cast<double>(now % 1'000'000'000));
+}
+
+TEST(PerformanceCoarseClock, RecordDeltaWithLaggingClock) {
+  Histogram histogram(Histogram::Options{});
+  histogram.RecordDelta(1000);
+  EXPECT_EQ(histogram.RecordDelta(1500), 500u);
+  // A coarse clock reading that is older than the previous precise one.
+  EXPECT_EQ(histogram.RecordDeltaCoarse(1200), 0u);
+  EXPECT_EQ(histogram.RecordDeltaCoarse(1700), 200u);
+  EXPECT_EQ(histogram.Count(), 3u);
+}
+
+// Only the thread that enabled the coarse trace clock uses it.
+TEST(PerformanceCoarseClock, TraceClockIsMainThreadOnly) {
+  TracingController controller;
+  constexpr int64_t kCoarseNow = 1'000'000'000;
+
+  TracingController::set_use_coarse_clock(true);
+  // Before the first refresh, the precise clock is used.
+  EXPECT_GT(controller.CurrentTimestampMicroseconds(), 0);
+  TracingController::UpdateCoarseClock(kCoarseNow);
+  EXPECT_EQ(controller.CurrentTimestampMicroseconds(), kCoarseNow / 1000);
+
+  int64_t other_thread_timestamp = 0;
+  std::thread other([&]() {
+    // Refreshes from other threads are ignored.
+    TracingController::UpdateCoarseClock(kCoarseNow / 2);
+    other_thread_timestamp = controller.CurrentTimestampMicroseconds();
+  });
+  other.join();
+  EXPECT_NE(other_thread_timestamp, kCoarseNow / 2 / 1000);
+  EXPECT_GE(other_thread_timestamp,
+            static_cast<int64_t>(performance_process_start / 1000));
+  EXPECT_EQ(controller.CurrentTimestampMicroseconds(), kCoarseNow / 1000);
+
+  TracingController::set_use_coarse_clock(false);
+  EXPECT_GE(controller.CurrentTimestampMicroseconds(),
+            static_cast<int64_t>(performance_process_start / 1000));
+}
@@ -0,0 +1,69 @@
+#include "env-inl.h"
+#include "gtest/gtest.h"
+#include "node_sampling_profiler.h"
+#include "node_test_fixture.h"
+
+#include <string>
+
+using node::Environment;
+using node::profiler::SamplingCpuProfiler;
+
+class SamplingCpuProfilerTest : public EnvironmentTestFixture {};
+
+TEST_F(SamplingCpuProfilerTest, SerializesSamplesAsGzippedPprof) {
+  const v8::HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Environment* environment = *env;
+
+  EXPECT_EQ(environment->sampling_cpu_profiler(), nullptr);
+  ASSERT_TRUE(SamplingCpuProfiler::Start(environment, 5, 0));
+  // Only one profiler per environment.
+  EXPECT_FALSE(SamplingCpuProfiler::Start(environment, 5, 0));
+  SamplingCpuProfiler* profiler = environment->sampling_cpu_profiler();
+  ASSERT_NE(profiler, nullptr);
+  // Just the "(truncated)" stack.
+  EXPECT_EQ(profiler->stack_count(), 1u);
+
+  v8::Local<v8::Context> context = isolate_->GetCurrentContext();
+  const char* busy_loop =
+      "function spin() {"
+      "  const end = Date.now() + 200;"
+      "  let i = 0;"
+      "  while (Date.now() < end) i++;"
+      "  return i;"
+      "}"
+      "spin();";
+  v8::Local<v8::Script> script =
+      v8::Script::Compile(
+          context,
+          v8::String::NewFromUtf8(isolate_, busy_loop).ToLocalChecked())
+          .ToLocalChecked();
+  script->Run(context).ToLocalChecked();
+
+  profiler->Flush();
+  EXPECT_GT(profiler->stack_count(), 1u);
+  std::string profile = profiler->Serialize();
+  ASSERT_GT(profile.size(), 2u);
+  EXPECT_EQ(static_cast<uint8_t>(profile[0]), 0x1f);
+  EXPECT_EQ(static_cast<uint8_t>(profile[1]), 0x8b);
+
+  SamplingCpuProfiler::Stop(environment);
+  EXPECT_EQ(environment->sampling_cpu_profiler(), nullptr);
+  uv_run(environment->event_loop(), UV_RUN_NOWAIT);
+}
+
+TEST_F(SamplingCpuProfilerTest, RejectsInvalidSignal) {
+  const v8::HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+  Environment* environment = *env;
+
+  EXPECT_FALSE(SamplingCpuProfiler::Start(environment, 5, -1));
+  EXPECT_EQ(environment->sampling_cpu_profiler(), nullptr);
+  // Lets the signal handle close.
+  uv_run(environment->event_loop(), UV_RUN_NOWAIT);
+  ASSERT_TRUE(SamplingCpuProfiler::Start(environment, 5, 0));
+  SamplingCpuProfiler::Stop(environment);
+  uv_run(environment->event_loop(), UV_RUN_NOWAIT);
+}
@@ -0,0 +1,116 @@
+#include "tracing/agent.h"
+#include "tracing/trace_event_common.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "uv.h"
+
+using node::tracing::Agent;
+using node::tracing::AgentWriterHandle;
+using node::tracing::AsyncTraceWriter;
+using node::tracing::TracingController;
+using v8::platform::tracing::TraceObject;
+
+namespace {
+
+constexpr char kCategory[] = "node-trace-buffer-test";
+constexpr char kEventName[] = "node-trace-buffer-test-event";
+constexpr uint64_t kEventCount = 20000;
+
+struct RecordedEvents {
+  node::Mutex mutex;
+  // Number of times each event was written out, by its argument.
+  std::vector<int> counts = std::vector<int>(kEventCount);
+  int foreign = 0;
+};
+
+class RecordingWriter : public AsyncTraceWriter {
+ public:
+  explicit RecordingWriter(RecordedEvents* events) : events_(events) {}
+
+  void AppendTraceEvent(TraceObject* trace_event) override {
+    node::Mutex::ScopedLock lock(events_->mutex);
+    if (trace_event->name() != kEventName || trace_event->num_args() != 1 ||
+        trace_event->arg_values()[0].as_uint >= kEventCount) {
+      events_->foreign++;
+      return;
+    }
+    events_->counts[trace_event->arg_values()[0].as_uint]++;
+  }
+
+  void Flush(bool blocking) override {}
+
+ private:
+  RecordedEvents* events_;
+};
+
+struct WriterThread {
+  TracingController* controller;
+  std::atomic<bool> done{false};
+
+  static void Run(void* arg) {
+    WriterThread* writer = static_cast<WriterThread*>(arg);
+    const uint8_t* category =
+        writer->controller->GetCategoryGroupEnabled(kCategory);
+    const char* arg_names[] = {"index"};
+    const uint8_t arg_types[] = {TRACE_VALUE_TYPE_UINT};
+    for (uint64_t i = 0; i < kEventCount; i++) {
+      writer->controller->AddTraceEvent(TRACE_EVENT_PHASE_INSTANT,
+                                        category,
+                                        kEventName,
+                                        nullptr,
+                                        0,
+                                        0,
+                                        1,
+                                        arg_names,
+                                        arg_types,
+                                        &i,
+                                        nullptr,
+                                        TRACE_EVENT_FLAG_NONE);
+    }
+    writer->done.store(true);
+  }
+};
+
+}  // namespace
+
+// Blocking flushes write out the chunk that another thread is filling at the
+// same time. Every event must be written exactly once and only after it has
+// been initialized, also when its slot held an older event before.
+TEST(NodeTraceBuffer, FlushWithConcurrentWriter) {
+  RecordedEvents events;
+  {
+    Agent agent;
+    AgentWriterHandle handle =
+        agent.AddClient({kCategory},
+                        std::make_unique<RecordingWriter>(&events),
+                        Agent::kIgnoreDefaultCategories);
+
+    WriterThread writer;
+    writer.controller = agent.GetTracingController();
+    uv_thread_t tid;
+    ASSERT_EQ(uv_thread_create(&tid, WriterThread::Run, &writer), 0);
+    // Every change of categories stops tracing, which flushes the buffer.
+    while (!writer.done.load()) {
+      handle.Enable({"node-trace-buffer-test-other"});
+      handle.Disable({"node-trace-buffer-test-other"});
+    }
+    ASSERT_EQ(uv_thread_join(&tid), 0);
+    // Disconnecting the client flushes the remaining events.
+    handle.reset();
+  }
+
+  EXPECT_EQ(events.foreign, 0);
+  size_t missing = 0;
+  size_t duplicated = 0;
+  for (int count : events.counts) {
+    if (count == 0) missing++;
+    if (count > 1) duplicated++;
+  }
+  EXPECT_EQ(duplicated, 0u);
+  // Events added while tracing was briefly stopped are dropped.
+  EXPECT_LT(missing, kEventCount);
+}
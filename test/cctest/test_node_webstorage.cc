@@ -0,0 +1,316 @@
+#include "base_object-inl.h"
+#include "env-inl.h"
+#include "gtest/gtest.h"
+#include "node_test_fixture.h"
+#include "node_webstorage.h"
+#include "sqlite3.h"
+
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+using node::BaseObject;
+using node::Environment;
+using node::webstorage::Storage;
+using v8::Array;
+using v8::Global;
+using v8::HandleScope;
+using v8::Isolate;
+using v8::Local;
+using v8::Name;
+using v8::NewStringType;
+using v8::Object;
+using v8::String;
+using v8::TryCatch;
+using v8::Value;
+
+using Entries = std::vector<std::pair<std::u16string, std::u16string>>;
+
+class WebStorageTest : public EnvironmentTestFixture {
+ protected:
+  static Storage* NewStorage(Environment* env, const std::string& path) {
+    Local<Object> obj = BaseObject::MakeLazilyInitializedJSTemplate(env)
+                            ->GetFunction(env->context())
+                            .ToLocalChecked()
+                            ->NewInstance(env->context())
+                            .ToLocalChecked();
+    return new Storage(env, obj, path);
+  }
+
+  // Creates the database with the given quota and returns a Storage for it.
+  Storage* NewStorageWithQuota(Environment* env, uint64_t max_size) {
+    // Opening the database creates the schema.
+    EXPECT_FALSE(NewStorage(env, path_)->Length().IsEmpty());
+    Exec("UPDATE nodejs_webstorage_state SET max_size = " +
+         std::to_string(max_size));
+    return NewStorage(env, path_);
+  }
+
+  void Exec(const std::string& sql) {
+    sqlite3* db;
+    ASSERT_EQ(sqlite3_open(path_.c_str(), &db), SQLITE_OK);
+    EXPECT_EQ(sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr),
+              SQLITE_OK);
+    sqlite3_close(db);
+  }
+
+  // Returns the entries that are in the database, in SQLite's order.
+  Entries ReadDatabase() {
+    Entries entries;
+    sqlite3* db;
+    EXPECT_EQ(sqlite3_open(path_.c_str(), &db), SQLITE_OK);
+    sqlite3_stmt* stmt;
+    EXPECT_EQ(sqlite3_prepare_v2(
+                  db,
+                  "SELECT key, value FROM nodejs_webstorage ORDER BY key",
+                  -1,
+                  &stmt,
+                  nullptr),
+              SQLITE_OK);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+      std::u16string columns[2];
+      for (int i = 0; i < 2; i++) {
+        columns[i] = std::u16string(
+            static_cast<const char16_t*>(sqlite3_column_blob(stmt, i)),
+            sqlite3_column_bytes(stmt, i) / sizeof(char16_t));
+      }
+      entries.emplace_back(columns[0], columns[1]);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return entries;
+  }
+
+  // Runs the immediates, which writes the pending changes.
+  static void RunImmediates() { uv_run(&current_loop, UV_RUN_NOWAIT); }
+
+  Local<String> Str(const std::u16string& str) {
+    return String::NewFromTwoByte(isolate_,
+                                  reinterpret_cast<const uint16_t*>(str.data()),
+                                  NewStringType::kNormal,
+                                  str.size())
+        .ToLocalChecked();
+  }
+
+  std::u16string ToU16(Local<Value> value) {
+    node::TwoByteValue utf16(isolate_, value);
+    return std::u16string(reinterpret_cast<const char16_t*>(utf16.out()),
+                          utf16.length());
+  }
+
+  bool Store(Storage* storage,
+             const std::u16string& key,
+             const std::u16string& value) {
+    TryCatch try_catch(isolate_);
+    bool stored = storage->Store(Str(key), Str(value)).IsJust();
+    EXPECT_EQ(stored, !try_catch.HasCaught());
+    return stored;
+  }
+
+  std::u16string LoadKey(Storage* storage, int index) {
+    Local<Value> key = storage->LoadKey(index).ToLocalChecked();
+    EXPECT_TRUE(key->IsString()) << index;
+    return ToU16(key);
+  }
+
+  TestTempDir dir_{"webstorage"};
+  std::string path_ = dir_.Path("storage.db");
+};
+
+// key(index) and the enumeration follow SQLite's order of the keys, which
+// compares their UTF-16LE bytes, also when they are served from memory.
+TEST_F(WebStorageTest, KeyOrderMatchesDatabase) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  Storage* storage = NewStorage(*env, path_);
+  const std::u16string keys[] = {
+      u"b", u"\u00ff", u"ab", u"\u0100", u"a", u"\u0201", u"\u0102"};
+  for (const std::u16string& key : keys) {
+    ASSERT_TRUE(Store(storage, key, key + u"!"));
+  }
+  RunImmediates();
+
+  Entries database = ReadDatabase();
+  ASSERT_EQ(database.size(), std::size(keys));
+  // U+0201 is stored as 01 02 and comes before U+0102, stored as 02 01.
+  const std::u16string expected[] = {
+      u"\u0100", u"\u0201", u"\u0102", u"a", u"ab", u"b", u"\u00ff"};
+  for (size_t i = 0; i < database.size(); i++) {
+    EXPECT_EQ(database[i].first, expected[i]) << i;
+  }
+
+  Local<Array> enumerated = storage->Enumerate().ToLocalChecked();
+  ASSERT_EQ(enumerated->Length(), std::size(expected));
+  for (uint32_t i = 0; i < enumerated->Length(); i++) {
+    EXPECT_EQ(ToU16(enumerated->Get(env.context(), i).ToLocalChecked()),
+              expected[i])
+        << i;
+  }
+
+  // The cursor gives the same answers in any order of access.
+  const int n = static_cast<int>(std::size(expected));
+  for (int i = 0; i < n; i++) {
+    EXPECT_EQ(LoadKey(storage, i), expected[i]);
+  }
+  for (int i = n - 1; i >= 0; i--) {
+    EXPECT_EQ(LoadKey(storage, i), expected[i]);
+  }
+  for (int i : {3, 0, 6, 2, 5, 1, 4}) {
+    EXPECT_EQ(LoadKey(storage, i), expected[i]);
+  }
+  EXPECT_TRUE(storage->LoadKey(n).ToLocalChecked()->IsNull());
+
+  // Changes to the keys move the cursor back to a valid position.
+  EXPECT_EQ(LoadKey(storage, 4), u"ab");
+  ASSERT_TRUE(storage->Remove(Str(u"a")).IsJust());
+  EXPECT_EQ(LoadKey(storage, 3), u"ab");
+  EXPECT_EQ(LoadKey(storage, 4), u"b");
+  const std::u16string nul(1, u'\0');
+  ASSERT_TRUE(Store(storage, nul, u"0"));
+  EXPECT_EQ(LoadKey(storage, 0), nul);
+  EXPECT_EQ(LoadKey(storage, 5), u"b");
+}
+
+// Writes that shrink the database are flushed before those that grow it, so
+// the quota triggers accept a batch that stays within the quota.
+TEST_F(WebStorageTest, FlushOrdersWritesBySize) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  constexpr uint64_t kQuota = 100;
+  Storage* storage = NewStorageWithQuota(*env, kQuota);
+  ASSERT_TRUE(Store(storage, u"a", std::u16string(20, u'a')));
+  ASSERT_TRUE(Store(storage, u"b", std::u16string(20, u'b')));
+  ASSERT_TRUE(Store(storage, u"c", std::u16string(5, u'c')));
+  RunImmediates();
+  ASSERT_EQ(ReadDatabase().size(), 3u);
+
+  // In key order, growing "a" first would go over the quota.
+  ASSERT_TRUE(Store(storage, u"a", std::u16string(30, u'a')));
+  ASSERT_TRUE(Store(storage, u"b", std::u16string(2, u'b')));
+  ASSERT_TRUE(storage->Remove(Str(u"c")).IsJust());
+  ASSERT_TRUE(Store(storage, u"d", std::u16string(8, u'd')));
+  RunImmediates();
+
+  Entries expected = {{u"a", std::u16string(30, u'a')},
+                      {u"b", std::u16string(2, u'b')},
+                      {u"d", std::u16string(8, u'd')}};
+  EXPECT_EQ(ReadDatabase(), expected);
+}
+
+// The quota is enforced synchronously against the entries in memory.
+TEST_F(WebStorageTest, Quota) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  // Keys and values count two bytes per code unit.
+  Storage* storage = NewStorageWithQuota(*env, 100);
+  ASSERT_TRUE(Store(storage, u"a", std::u16string(40, u'a')));
+  // Replacing a value only counts the difference.
+  ASSERT_TRUE(Store(storage, u"a", std::u16string(45, u'a')));
+  EXPECT_FALSE(Store(storage, u"b", std::u16string(4, u'b')));
+  EXPECT_TRUE(storage->Load(Str(u"b")).ToLocalChecked()->IsNull());
+  EXPECT_TRUE(Store(storage, u"b", std::u16string(3, u'b')));
+  EXPECT_FALSE(Store(storage, u"a", std::u16string(46, u'a')));
+  EXPECT_EQ(ToU16(storage->Load(Str(u"a")).ToLocalChecked()),
+            std::u16string(45, u'a'));
+
+  // Removing entries makes room again.
+  ASSERT_TRUE(storage->Clear().IsJust());
+  EXPECT_TRUE(Store(storage, u"c", std::u16string(48, u'c')));
+  RunImmediates();
+  Entries expected = {{u"c", std::u16string(48, u'c')}};
+  EXPECT_EQ(ReadDatabase(), expected);
+}
+
+TEST_F(WebStorageTest, Clear) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  Storage* storage = NewStorage(*env, path_);
+  ASSERT_TRUE(Store(storage, u"a", u"1"));
+  ASSERT_TRUE(Store(storage, u"b", u"2"));
+  RunImmediates();
+  ASSERT_EQ(ReadDatabase().size(), 2u);
+
+  // Entries written after clear() in the same batch are kept.
+  ASSERT_TRUE(storage->Clear().IsJust());
+  ASSERT_TRUE(Store(storage, u"b", u"3"));
+  ASSERT_TRUE(Store(storage, u"c", u"4"));
+  EXPECT_TRUE(storage->Load(Str(u"a")).ToLocalChecked()->IsNull());
+  RunImmediates();
+  Entries expected = {{u"b", u"3"}, {u"c", u"4"}};
+  EXPECT_EQ(ReadDatabase(), expected);
+
+  ASSERT_TRUE(storage->Clear().IsJust());
+  EXPECT_EQ(storage->Length()
+                .ToLocalChecked()
+                ->Uint32Value(env.context())
+                .FromJust(),
+            0u);
+  RunImmediates();
+  EXPECT_TRUE(ReadDatabase().empty());
+
+  // Another Storage for the same file sees the result.
+  ASSERT_TRUE(Store(storage, u"d", u"5"));
+  RunImmediates();
+  Storage* other = NewStorage(*env, path_);
+  EXPECT_EQ(LoadKey(other, 0), u"d");
+}
+
+// Pending changes are written by the exit callbacks, which process.exit()
+// runs without destroying the Storage objects.
+TEST_F(WebStorageTest, FlushesAtExit) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  Storage* storage = NewStorage(*env, path_);
+  ASSERT_TRUE(Store(storage, u"a", u"1"));
+  ASSERT_TRUE(Store(storage, u"b", u"2"));
+  EXPECT_TRUE(ReadDatabase().empty());
+  (*env)->RunAtExitCallbacks();
+  Entries expected = {{u"a", u"1"}, {u"b", u"2"}};
+  EXPECT_EQ(ReadDatabase(), expected);
+}
+
+static void CreateStorage(Environment* env,
+                          const std::string& path,
+                          Global<Object>* weak) {
+  Isolate* isolate = env->isolate();
+  HandleScope handle_scope(isolate);
+  Local<Object> obj = BaseObject::MakeLazilyInitializedJSTemplate(env)
+                          ->GetFunction(env->context())
+                          .ToLocalChecked()
+                          ->NewInstance(env->context())
+                          .ToLocalChecked();
+  Storage* storage = new Storage(env, obj, path);
+  Local<Name> key = node::FIXED_ONE_BYTE_STRING(isolate, "a");
+  CHECK(storage->Store(key, key).IsJust());
+  weak->Reset(isolate, obj);
+  weak->SetWeak();
+}
+
+// A Storage that is collected removes its exit callback.
+TEST_F(WebStorageTest, CollectedStorageRemovesExitCallback) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  Global<Object> weak;
+  CreateStorage(*env, path_, &weak);
+  // The scheduled flush keeps the Storage alive until it has run.
+  RunImmediates();
+  ASSERT_EQ(ReadDatabase().size(), 1u);
+  isolate_->LowMemoryNotification();
+  EXPECT_TRUE(weak.IsEmpty());
+  (*env)->RunAtExitCallbacks();
+  Entries expected = {{u"a", u"a"}};
+  EXPECT_EQ(ReadDatabase(), expected);
+}
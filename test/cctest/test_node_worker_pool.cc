@@ -0,0 +1,40 @@
+#include "gtest/gtest.h"
+#include "histogram-inl.h"
+#include "node_test_fixture.h"
+#include "node_worker.h"
+
+using node::worker::WorkerPool;
+
+class WorkerPoolTest : public EnvironmentTestFixture {};
+
+// The cctest environments are not created from a startup snapshot, so there
+// is nothing a standby thread could deserialize.
+TEST_F(WorkerPoolTest, RequiresSnapshot) {
+  const v8::HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  WorkerPool* pool = WorkerPool::Get();
+  EXPECT_EQ(pool, WorkerPool::Get());
+  EXPECT_FALSE(pool->Configure(*env, 2));
+
+  WorkerPool::Statistics stats = pool->GetStatistics();
+  EXPECT_EQ(stats.size, 0u);
+  EXPECT_EQ(stats.idle, 0u);
+
+  // Emptying a pool that nobody owns is allowed.
+  EXPECT_TRUE(pool->Configure(*env, 0));
+}
+
+TEST_F(WorkerPoolTest, RecordsStartupLatency) {
+  WorkerPool* pool = WorkerPool::Get();
+  const std::shared_ptr<node::Histogram>& histogram =
+      pool->startup_histogram();
+  size_t count = histogram->Count();
+
+  pool->RecordStartup(2000000);
+  pool->RecordStartup(1000000);
+  EXPECT_EQ(histogram->Count(), count + 2);
+  EXPECT_LE(histogram->Min(), 1000000);
+  EXPECT_GE(histogram->Max(), 2000000);
+}
@@ -0,0 +1,118 @@
+#include "tracing/perfetto_trace_writer.h"
+#include "tracing/trace_event_common.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using node::tracing::PerfettoTraceWriter;
+using v8::platform::tracing::TraceObject;
+using v8::platform::tracing::TracingController;
+
+namespace {
+
+uint64_t ReadVarInt(const std::string& data, size_t* pos) {
+  uint64_t value = 0;
+  for (int shift = 0; *pos < data.size(); shift += 7) {
+    uint8_t byte = data[(*pos)++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) break;
+  }
+  return value;
+}
+
+// Splits a serialized perfetto.protos.Trace into its TracePackets.
+std::vector<std::string> ReadPackets(const std::string& data) {
+  std::vector<std::string> packets;
+  size_t pos = 0;
+  while (pos < data.size()) {
+    EXPECT_EQ(ReadVarInt(data, &pos), (1u << 3) | 2u);
+    size_t length = ReadVarInt(data, &pos);
+    EXPECT_LE(pos + length, data.size());
+    packets.push_back(data.substr(pos, length));
+    pos += length;
+  }
+  return packets;
+}
+
+size_t CountOccurrences(const std::string& data, const std::string& str) {
+  size_t count = 0;
+  for (size_t pos = data.find(str); pos != std::string::npos;
+       pos = data.find(str, pos + 1)) {
+    count++;
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST(PerfettoTraceWriter, InternsNames) {
+  TracingController controller;
+  const uint8_t* category =
+      controller.GetCategoryGroupEnabled("perfetto-test-category");
+  const char* arg_names[] = {"perfetto-test-arg"};
+  const uint8_t arg_types[] = {TRACE_VALUE_TYPE_INT};
+  const uint64_t arg_values[] = {42};
+
+  std::ostringstream stream;
+  {
+    PerfettoTraceWriter writer(stream);
+    for (int i = 0; i < 3; i++) {
+      TraceObject begin;
+      begin.InitializeForTesting(TRACE_EVENT_PHASE_BEGIN, category,
+                                 "perfetto-test-event", nullptr, 0, 0, 1,
+                                 arg_names, arg_types, arg_values, nullptr,
+                                 TRACE_EVENT_FLAG_NONE, 1, 2, 100 + i, 0, 0,
+                                 0);
+      writer.AppendTraceEvent(&begin);
+      TraceObject end;
+      end.InitializeForTesting(TRACE_EVENT_PHASE_END, category,
+                               "perfetto-test-event", nullptr, 0, 0, 0,
+                               nullptr, nullptr, nullptr, nullptr,
+                               TRACE_EVENT_FLAG_NONE, 1, 2, 200 + i, 0, 0, 0);
+      writer.AppendTraceEvent(&end);
+    }
+  }
+
+  std::string data = stream.str();
+  // One thread track descriptor and six events.
+  EXPECT_EQ(ReadPackets(data).size(), 7u);
+  EXPECT_EQ(CountOccurrences(data, "perfetto-test-category"), 1u);
+  EXPECT_EQ(CountOccurrences(data, "perfetto-test-event"), 1u);
+  EXPECT_EQ(CountOccurrences(data, "perfetto-test-arg"), 1u);
+}
+
+TEST(PerfettoTraceWriter, CompleteEventsAndCounters) {
+  TracingController controller;
+  const uint8_t* category =
+      controller.GetCategoryGroupEnabled("perfetto-test-category");
+  const char* arg_names[] = {"a", "b"};
+  const uint8_t arg_types[] = {TRACE_VALUE_TYPE_INT, TRACE_VALUE_TYPE_UINT};
+  const uint64_t arg_values[] = {1, 2};
+
+  std::ostringstream stream;
+  {
+    PerfettoTraceWriter writer(stream);
+    TraceObject complete;
+    complete.InitializeForTesting(TRACE_EVENT_PHASE_COMPLETE, category,
+                                  "complete", nullptr, 0, 0, 0, nullptr,
+                                  nullptr, nullptr, nullptr,
+                                  TRACE_EVENT_FLAG_NONE, 1, 2, 100, 0, 50, 0);
+    writer.AppendTraceEvent(&complete);
+    TraceObject counter;
+    counter.InitializeForTesting(TRACE_EVENT_PHASE_COUNTER, category,
+                                 "counter", nullptr, 0, 0, 2, arg_names,
+                                 arg_types, arg_values, nullptr,
+                                 TRACE_EVENT_FLAG_NONE, 1, 2, 200, 0, 0, 0);
+    writer.AppendTraceEvent(&counter);
+  }
+
+  std::string data = stream.str();
+  // Thread track, begin and end for the complete event, then the process
+  // track, and a track plus a value for each counter.
+  EXPECT_EQ(ReadPackets(data).size(), 8u);
+  EXPECT_EQ(CountOccurrences(data, "counter a"), 1u);
+  EXPECT_EQ(CountOccurrences(data, "counter b"), 1u);
+}
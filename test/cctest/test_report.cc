@@ -1,6 +1,13 @@
+#include "base_object-inl.h"
 #include "node.h"
+#include "node_report.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
 #include <string>
+#include <vector>
 #include "gtest/gtest.h"
 #include "node_test_fixture.h"
 
@@ -11,6 +18,7 @@ using v8::FunctionCallbackInfo;
 using v8::HandleScope;
 using v8::Isolate;
 using v8::Local;
+using v8::Object;
 using v8::SealHandleScope;
 using v8::String;
 using v8::Value;
@@ -123,3 +131,85 @@ TEST_F(ReportTest, ReportWithEnv) {
 
   EXPECT_TRUE(report_callback_called);
 }
+
+// Returns the top-level keys of a pretty-printed report, in order.
+static std::vector<std::string> TopLevelKeys(const std::string& report) {
+  std::vector<std::string> keys;
+  std::istringstream in(report);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 3, "  \"") != 0) continue;
+    keys.push_back(line.substr(3, line.find('"', 3) - 3));
+  }
+  return keys;
+}
+
+// Returns the lines of the report section that starts with the given key at
+// the given indentation.
+static std::string Section(const std::string& report,
+                           const std::string& key,
+                           const std::string& indent) {
+  size_t start = report.find("\n" + indent + "\"" + key + "\"");
+  if (start == std::string::npos) return "";
+  size_t end = std::min(report.find("\n" + indent + "}", start),
+                        report.find("\n" + indent + "]", start));
+  return report.substr(start, end - start);
+}
+
+TEST_F(ReportTest, AsyncReportMatchesSyncReport) {
+  const HandleScope handle_scope(isolate_);
+  const Argv argv;
+  Env env{handle_scope, argv};
+
+  char tmpdir[1024];
+  size_t tmpdir_size = sizeof(tmpdir);
+  ASSERT_EQ(uv_os_tmpdir(tmpdir, &tmpdir_size), 0);
+  std::string path = std::string(tmpdir) + "/node-report-async-test-" +
+                     std::to_string(uv_os_getpid()) + ".json";
+
+  Local<Context> context = env.context();
+  Local<Object> req =
+      node::BaseObject::MakeLazilyInitializedJSTemplate(*env)
+          ->GetFunction(context)
+          .ToLocalChecked()
+          ->NewInstance(context)
+          .ToLocalChecked();
+  Local<Function> oncomplete =
+      Function::New(context, [](const FunctionCallbackInfo<Value>& args) {
+        EXPECT_TRUE(args[0]->IsInt32());
+        EXPECT_EQ(args[0].As<v8::Int32>()->Value(), 0);
+        report_callback_called = true;
+      }).ToLocalChecked();
+  req->Set(context,
+           String::NewFromUtf8Literal(isolate_, "oncomplete"),
+           oncomplete)
+      .FromJust();
+
+  node::report::TriggerNodeReportAsync(
+      *env, req, "FooMessage", "BarTrigger", path, Local<Value>());
+  while (!report_callback_called) {
+    ASSERT_TRUE(uv_run(&current_loop, UV_RUN_ONCE) != 0 ||
+                report_callback_called);
+  }
+
+  std::ifstream file(path);
+  std::stringstream async_report;
+  async_report << file.rdbuf();
+  file.close();
+  remove(path.c_str());
+
+  std::ostringstream sync_report;
+  node::GetNodeReport(
+      *env, "FooMessage", "BarTrigger", Local<Value>(), sync_report);
+
+  std::string actual = async_report.str();
+  std::string expected = sync_report.str();
+  EXPECT_NE(actual.find("FooMessage"), std::string::npos);
+  EXPECT_NE(actual.find("BarTrigger"), std::string::npos);
+  EXPECT_EQ(TopLevelKeys(actual), TopLevelKeys(expected));
+  // The parts that are copied on the reporting thread are the same.
+  EXPECT_EQ(Section(actual, "environmentVariables", "  "),
+            Section(expected, "environmentVariables", "  "));
+  EXPECT_EQ(Section(actual, "commandLine", "    "),
+            Section(expected, "commandLine", "    "));
+}
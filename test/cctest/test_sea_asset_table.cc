@@ -0,0 +1,94 @@
+#include "gtest/gtest.h"
+#include "node_sea.h"
+
+#include <cstring>
+#include <map>
+#include <string>
+
+using node::sea::SeaAssetTable;
+
+static std::map<std::string, std::string> TestAssets() {
+  return {
+      {"config.json", "{\"name\":\"app\"}"},
+      {"empty.txt", ""},
+      {"lib/a.js", "module.exports = 'a';"},
+      {"lib/b.js", std::string(4096, 'b')},
+  };
+}
+
+TEST(SeaAssetTable, LooksUpAssetsByKey) {
+  std::string storage;
+  SeaAssetTable table = SeaAssetTable::Build(TestAssets(), false, &storage);
+  ASSERT_EQ(table.size(), 4u);
+  for (const auto& [key, content] : TestAssets()) {
+    EXPECT_EQ(table.Get(key), content) << key;
+  }
+  EXPECT_FALSE(table.Get("lib").has_value());
+  EXPECT_FALSE(table.Get("lib/c.js").has_value());
+  EXPECT_FALSE(table.Get("zzz").has_value());
+  EXPECT_FALSE(SeaAssetTable().Get("config.json").has_value());
+}
+
+TEST(SeaAssetTable, KeysAreSorted) {
+  std::string storage;
+  SeaAssetTable table = SeaAssetTable::Build(TestAssets(), false, &storage);
+  EXPECT_EQ(table.key(0), "config.json");
+  EXPECT_EQ(table.key(1), "empty.txt");
+  EXPECT_EQ(table.key(2), "lib/a.js");
+  EXPECT_EQ(table.key(3), "lib/b.js");
+}
+
+TEST(SeaAssetTable, DecompressesOnFirstAccess) {
+  std::string storage;
+  SeaAssetTable table = SeaAssetTable::Build(TestAssets(), true, &storage);
+  // Only the repetitive asset shrinks enough to be stored compressed.
+  EXPECT_LT(storage.size(), 4096u);
+
+  std::optional<std::string_view> first = table.Get("lib/b.js");
+  ASSERT_TRUE(first.has_value());
+  EXPECT_EQ(*first, std::string(4096, 'b'));
+  // Later lookups return the cached copy.
+  EXPECT_EQ(table.Get("lib/b.js")->data(), first->data());
+  EXPECT_EQ(table.Get("lib/a.js"), "module.exports = 'a';");
+}
+
+TEST(SeaAssetTable, ReadsUnalignedIndex) {
+  std::string storage;
+  SeaAssetTable::Build(TestAssets(), false, &storage);
+  // Tables are read in place from the blob, at any offset.
+  std::string blob = "x" + storage;
+  size_t index_size = 4 * SeaAssetTable::kEntrySize;
+  std::string_view view(blob);
+  SeaAssetTable built = SeaAssetTable::Build(TestAssets(), false, &storage);
+  SeaAssetTable table(4,
+                      view.substr(1, index_size),
+                      view.substr(1 + index_size, built.keys().size()),
+                      view.substr(1 + index_size + built.keys().size()));
+  EXPECT_EQ(table.Get("lib/a.js"), "module.exports = 'a';");
+  EXPECT_EQ(table.Get("empty.txt"), "");
+}
+
+TEST(SeaAssetTable, IndexLayout) {
+  std::string storage;
+  SeaAssetTable table = SeaAssetTable::Build(TestAssets(), true, &storage);
+  ASSERT_EQ(table.index().size(), 4 * SeaAssetTable::kEntrySize);
+  // key offset, key size, content offset, content size, size, compression.
+  uint64_t fields[SeaAssetTable::kEntryFields];
+  memcpy(fields, table.index().data(), sizeof(fields));
+  EXPECT_EQ(fields[0], 0u);
+  EXPECT_EQ(fields[1], 11u);
+  EXPECT_EQ(fields[2], 0u);
+  EXPECT_EQ(fields[3], 14u);
+  EXPECT_EQ(fields[4], 14u);
+  EXPECT_EQ(fields[5], 0u);
+
+  memcpy(fields,
+         table.index().data() + 3 * SeaAssetTable::kEntrySize,
+         sizeof(fields));
+  EXPECT_EQ(fields[0], 28u);
+  EXPECT_EQ(fields[1], 8u);
+  EXPECT_EQ(fields[2], 35u);
+  EXPECT_LT(fields[3], 4096u);
+  EXPECT_EQ(fields[4], 4096u);
+  EXPECT_EQ(fields[5], 1u);
+}
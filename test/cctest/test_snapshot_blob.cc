@@ -0,0 +1,297 @@
+#include "env-inl.h"
+#include "gtest/gtest.h"
+#include "node_metadata.h"
+#include "node_options.h"
+#include "node_snapshot_builder.h"
+#include "node_test_fixture.h"
+#include "util-inl.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using node::SnapshotBuilder;
+using node::SnapshotData;
+using node::SnapshotFlags;
+using node::SnapshotSource;
+using node::builtins::BuiltinCodeCacheData;
+using node::builtins::CodeCacheInfo;
+
+// Large enough to be split into several compressed frames.
+static constexpr int kV8BlobSize = 9 * 1024 * 1024 + 123;
+
+static std::unique_ptr<SnapshotData> CreateSnapshotData(SnapshotFlags flags) {
+  auto data = std::make_unique<SnapshotData>();
+  data->metadata.node_version = node::per_process::metadata.versions.node;
+  data->metadata.node_arch = node::per_process::metadata.arch;
+  data->metadata.node_platform = node::per_process::metadata.platform;
+  data->metadata.flags = flags;
+
+  char* v8_blob = new char[kV8BlobSize];
+  for (int i = 0; i < kV8BlobSize; ++i) {
+    v8_blob[i] = static_cast<char>((i / 7) % 251);
+  }
+  data->v8_snapshot_blob_data = {v8_blob, kV8BlobSize};
+
+  for (const char* id : {"internal/a", "internal/b"}) {
+    auto cache = std::make_shared<std::vector<uint8_t>>(
+        4096 + strlen(id), static_cast<uint8_t>(id[9]));
+    data->code_cache.push_back({id, BuiltinCodeCacheData(std::move(cache))});
+  }
+  return data;
+}
+
+static void ExpectSameContents(const SnapshotData& expected,
+                               const SnapshotData& actual) {
+  ASSERT_EQ(actual.v8_snapshot_blob_data.raw_size,
+            expected.v8_snapshot_blob_data.raw_size);
+  EXPECT_EQ(memcmp(actual.v8_snapshot_blob_data.data,
+                   expected.v8_snapshot_blob_data.data,
+                   expected.v8_snapshot_blob_data.raw_size),
+            0);
+  ASSERT_EQ(actual.code_cache.size(), expected.code_cache.size());
+  for (size_t i = 0; i < expected.code_cache.size(); ++i) {
+    const CodeCacheInfo& a = actual.code_cache[i];
+    const CodeCacheInfo& e = expected.code_cache[i];
+    EXPECT_EQ(a.id, e.id);
+    ASSERT_EQ(a.data.length, e.data.length) << e.id;
+    EXPECT_EQ(memcmp(a.data.data, e.data.data, e.data.length), 0) << e.id;
+  }
+}
+
+static bool PointsInto(const void* ptr, const std::vector<char>& blob) {
+  const char* p = static_cast<const char*>(ptr);
+  return p >= blob.data() && p < blob.data() + blob.size();
+}
+
+TEST(SnapshotBlob, RoundTripsCompressedSections) {
+  std::unique_ptr<SnapshotData> data =
+      CreateSnapshotData(SnapshotFlags::kCompressed);
+  std::vector<char> compressed = data->ToBlob();
+  std::vector<char> uncompressed =
+      CreateSnapshotData(SnapshotFlags::kDefault)->ToBlob();
+  EXPECT_LT(compressed.size(), uncompressed.size() / 2);
+
+  SnapshotData read;
+  ASSERT_TRUE(SnapshotData::FromBlob(&read, compressed));
+  EXPECT_EQ(read.v8_snapshot_blob_owner, nullptr);
+  ExpectSameContents(*data, read);
+}
+
+TEST(SnapshotBlob, UsesUncompressedSectionsInPlace) {
+  std::unique_ptr<SnapshotData> data =
+      CreateSnapshotData(SnapshotFlags::kDefault);
+  auto blob = std::make_shared<std::vector<char>>(data->ToBlob());
+  std::string_view view(blob->data(), blob->size());
+
+  SnapshotData read;
+  ASSERT_TRUE(SnapshotData::FromBlob(&read, view, blob));
+  ExpectSameContents(*data, read);
+  EXPECT_EQ(read.v8_snapshot_blob_owner, blob);
+  ASSERT_TRUE(PointsInto(read.v8_snapshot_blob_data.data, *blob));
+  EXPECT_EQ((read.v8_snapshot_blob_data.data - blob->data()) %
+                SnapshotData::kSectionAlignment,
+            0u);
+  for (const CodeCacheInfo& info : read.code_cache) {
+    EXPECT_TRUE(PointsInto(info.data.data, *blob)) << info.id;
+  }
+
+  // Without an owner, everything is copied.
+  SnapshotData copied;
+  ASSERT_TRUE(SnapshotData::FromBlob(&copied, view));
+  ExpectSameContents(*data, copied);
+  EXPECT_FALSE(PointsInto(copied.v8_snapshot_blob_data.data, *blob));
+}
+
+TEST(SnapshotBlob, MapsFile) {
+  std::unique_ptr<SnapshotData> data =
+      CreateSnapshotData(SnapshotFlags::kDefault);
+  FILE* fp = tmpfile();
+  ASSERT_NE(fp, nullptr);
+  data->ToFile(fp);
+  rewind(fp);
+
+  SnapshotData read;
+  ASSERT_TRUE(SnapshotData::FromFile(&read, fp));
+  // The mapping outlives the file.
+  fclose(fp);
+  ExpectSameContents(*data, read);
+#ifdef _WIN32
+  // Files are read into memory instead, so they can still be replaced.
+  EXPECT_EQ(read.v8_snapshot_blob_owner, nullptr);
+#else
+  EXPECT_NE(read.v8_snapshot_blob_owner, nullptr);
+#endif
+}
+
+TEST(SnapshotBlob, RoundTripsSources) {
+  std::unique_ptr<SnapshotData> data =
+      CreateSnapshotData(SnapshotFlags::kDefault);
+  data->metadata.sources = {{"/app/builder.js", 123, 1700000000123456789, 42},
+                            {"/app/snapshot.json", 4, 17, 0xdeadbeef}};
+
+  SnapshotData read;
+  ASSERT_TRUE(SnapshotData::FromBlob(&read, data->ToBlob()));
+  ASSERT_EQ(read.metadata.sources.size(), 2u);
+  for (size_t i = 0; i < 2; ++i) {
+    const SnapshotSource& a = read.metadata.sources[i];
+    const SnapshotSource& e = data->metadata.sources[i];
+    EXPECT_EQ(a.path, e.path);
+    EXPECT_EQ(a.size, e.size);
+    EXPECT_EQ(a.mtime_ns, e.mtime_ns);
+    EXPECT_EQ(a.hash, e.hash);
+  }
+  ExpectSameContents(*data, read);
+}
+
+// Blobs of another format are rejected instead of being misread.
+TEST(SnapshotBlob, RejectsUnknownFormat) {
+  std::vector<char> blob =
+      CreateSnapshotData(SnapshotFlags::kDefault)->ToBlob();
+  uint32_t magic = SnapshotData::kSectionedMagic + 1;
+  memcpy(blob.data(), &magic, sizeof(magic));
+  SnapshotData read;
+  EXPECT_FALSE(SnapshotData::FromBlob(&read, blob));
+
+  SnapshotData truncated;
+  EXPECT_FALSE(SnapshotData::FromBlob(&truncated, std::string_view("\x1a")));
+}
+
+class SnapshotRebuildTest : public ::testing::Test {
+ protected:
+  static void WriteFile(const std::string& path, std::string_view contents) {
+    FILE* fp = fopen(path.c_str(), "wb");
+    ASSERT_NE(fp, nullptr) << path;
+    ASSERT_EQ(fwrite(contents.data(), 1, contents.size(), fp),
+              contents.size());
+    ASSERT_EQ(fclose(fp), 0);
+  }
+
+  // Sets the modification time of the file to seconds since the epoch.
+  static void SetMtime(const std::string& path, double mtime) {
+    uv_fs_t req;
+    ASSERT_EQ(uv_fs_utime(nullptr, &req, path.c_str(), mtime, mtime, nullptr),
+              0);
+    uv_fs_req_cleanup(&req);
+  }
+
+  static double Now() {
+    uv_timespec64_t now;
+    CHECK_EQ(0, uv_clock_gettime(UV_CLOCK_REALTIME, &now));
+    return static_cast<double>(now.tv_sec);
+  }
+
+  static std::string GetRebuildLockPath(const std::string& snapshot_path) {
+    return SnapshotBuilder::GetRebuildLockPath(snapshot_path);
+  }
+
+  static bool AcquireRebuildLock(const std::string& lock_path) {
+    return SnapshotBuilder::AcquireRebuildLock(lock_path);
+  }
+
+  TestTempDir dir_{"snapshot-rebuild"};
+};
+
+// Only a change of size or contents makes a snapshot stale, as long as it was
+// built from the entry point.
+TEST_F(SnapshotRebuildTest, StaleCheck) {
+  const std::string builder = dir_.Path("builder.js");
+  const std::string config = dir_.Path("snapshot.json");
+  WriteFile(builder, "globalThis.a = 1;");
+  WriteFile(config, "{}");
+  SetMtime(builder, 1000000);
+  SetMtime(config, 1000000);
+
+  SnapshotData data;
+  EXPECT_FALSE(data.SourcesAreUpToDate(builder));
+  for (const std::string& path : {builder, config}) {
+    std::optional<SnapshotSource> source = SnapshotSource::FromFile(path);
+    ASSERT_TRUE(source.has_value()) << path;
+    data.metadata.sources.push_back(std::move(*source));
+  }
+  EXPECT_TRUE(data.SourcesAreUpToDate(builder));
+  EXPECT_TRUE(data.SourcesAreUpToDate(dir_.path() + "/./builder.js"));
+  EXPECT_FALSE(data.SourcesAreUpToDate(config));
+  EXPECT_FALSE(data.SourcesAreUpToDate(dir_.Path("other.js")));
+
+  // Touched, but not changed.
+  SetMtime(builder, 1000010);
+  EXPECT_TRUE(data.SourcesAreUpToDate(builder));
+  // Changed, but not resized.
+  WriteFile(builder, "globalThis.b = 1;");
+  SetMtime(builder, 1000020);
+  EXPECT_FALSE(data.SourcesAreUpToDate(builder));
+  WriteFile(builder, "globalThis.a = 1;");
+  EXPECT_TRUE(data.SourcesAreUpToDate(builder));
+
+  // The configuration file counts as well.
+  WriteFile(config, "{ }");
+  EXPECT_FALSE(data.SourcesAreUpToDate(builder));
+  WriteFile(config, "{}");
+  EXPECT_TRUE(data.SourcesAreUpToDate(builder));
+  ASSERT_TRUE(std::filesystem::remove(config));
+  EXPECT_FALSE(data.SourcesAreUpToDate(builder));
+}
+
+// A lock is only taken over once it is older than kRebuildLockTimeoutMs.
+TEST_F(SnapshotRebuildTest, LockTakeover) {
+  const std::string lock = GetRebuildLockPath(dir_.Path("snap.blob"));
+  EXPECT_EQ(lock, dir_.Path("snap.blob.lock"));
+  ASSERT_TRUE(AcquireRebuildLock(lock));
+  EXPECT_TRUE(std::filesystem::exists(lock));
+  EXPECT_FALSE(AcquireRebuildLock(lock));
+
+  const double timeout = SnapshotBuilder::kRebuildLockTimeoutMs / 1000.0;
+  SetMtime(lock, Now() - timeout + 60);
+  EXPECT_FALSE(AcquireRebuildLock(lock));
+  SetMtime(lock, Now() - timeout - 60);
+  ASSERT_TRUE(AcquireRebuildLock(lock));
+  // The lock is fresh again.
+  EXPECT_FALSE(AcquireRebuildLock(lock));
+}
+
+TEST_F(SnapshotRebuildTest, ReplaceSnapshotFile) {
+  const std::string blob = dir_.Path("snap.blob");
+  const std::string lock = GetRebuildLockPath(blob);
+  WriteFile(blob, "stale");
+  ASSERT_TRUE(AcquireRebuildLock(lock));
+
+  // The lock is released by the process that was started to rebuild.
+  node::PerProcessOptions* options = node::per_process::cli_options.get();
+  const bool auto_rebuild = options->snapshot_auto_rebuild;
+  options->snapshot_auto_rebuild = true;
+  auto restore = node::OnScopeLeave(
+      [=]() { options->snapshot_auto_rebuild = auto_rebuild; });
+
+  std::unique_ptr<SnapshotData> data =
+      CreateSnapshotData(SnapshotFlags::kDefault);
+  ASSERT_TRUE(SnapshotBuilder::ReplaceSnapshotFile(data.get(), blob));
+  EXPECT_FALSE(std::filesystem::exists(lock));
+  // Only the snapshot is left, no temporary file.
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(dir_.path()),
+                          std::filesystem::directory_iterator()),
+            1);
+
+  FILE* fp = fopen(blob.c_str(), "rb");
+  ASSERT_NE(fp, nullptr);
+  SnapshotData read;
+  ASSERT_TRUE(SnapshotData::FromFile(&read, fp));
+  fclose(fp);
+  ExpectSameContents(*data, read);
+
+  // A snapshot that is in use can be replaced, its users keep the old one.
+  std::unique_ptr<SnapshotData> other =
+      CreateSnapshotData(SnapshotFlags::kCompressed);
+  ASSERT_TRUE(SnapshotBuilder::ReplaceSnapshotFile(other.get(), blob));
+  ExpectSameContents(*data, read);
+
+  // A snapshot that cannot be written is reported.
+  EXPECT_FALSE(SnapshotBuilder::ReplaceSnapshotFile(
+      data.get(), dir_.Path("missing/a.blob")));
+}
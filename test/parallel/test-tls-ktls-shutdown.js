@@ -0,0 +1,101 @@
+'use strict';
+
+// Ending a connection while kernel TLS is still writing cleartext to the
+// socket sends the close_notify after that data and before the FIN.
+
+const common = require('../common');
+if (!common.hasCrypto)
+  common.skip('missing crypto');
+
+const assert = require('assert');
+const fixtures = require('../common/fixtures');
+const net = require('net');
+const tls = require('tls');
+
+// In TLS 1.3 with AES-GCM, an encrypted alert is a 2 byte alert, the inner
+// content type and a 16 byte tag.
+const kAlertRecordLength = 2 + 1 + 16;
+
+const payload = Buffer.alloc(4 * 1024 * 1024, 'k');
+
+// Checked on exit, once both ends have seen the FIN.
+let ktlsActive = false;
+let received = 0;
+let serverEnded = false;
+let lastRecord;
+
+const server = tls.createServer({
+  key: fixtures.readKey('rsa_private.pem'),
+  cert: fixtures.readKey('rsa_cert.crt'),
+  minVersion: 'TLSv1.3',
+  ciphersuites: 'TLS_AES_128_GCM_SHA256',
+}, (socket) => {
+  socket.on('data', (data) => {
+    received += data.length;
+  });
+  socket.on('end', () => {
+    serverEnded = true;
+    socket.end();
+  });
+});
+
+// Records what the client sends, on its way to the server, and walks its
+// records once the client is done.
+const proxy = net.createServer((client) => {
+  const sent = [];
+  const upstream = net.connect(server.address().port);
+  client.on('data', (data) => sent.push(data));
+  client.on('end', () => {
+    const bytes = Buffer.concat(sent);
+    let offset = 0;
+    while (offset + 5 <= bytes.length) {
+      lastRecord = {
+        type: bytes[offset],
+        length: bytes.readUInt16BE(offset + 3),
+      };
+      offset += 5 + lastRecord.length;
+    }
+    assert.strictEqual(offset, bytes.length);
+  });
+  client.pipe(upstream);
+  upstream.pipe(client);
+});
+
+server.listen(0, common.mustCall(() => {
+  proxy.listen(0, common.mustCall(() => {
+    const conn = tls.connect({
+      port: proxy.address().port,
+      rejectUnauthorized: false,
+      minVersion: 'TLSv1.3',
+      ciphersuites: 'TLS_AES_128_GCM_SHA256',
+    }, common.mustCall(() => {
+      // The switch to kernel TLS happens right after the handshake.
+      setImmediate(common.mustCall(() => {
+        ktlsActive = conn._handle.isKTLSActive();
+        if (!ktlsActive) {
+          common.printSkipMessage('kernel TLS is not available');
+          conn.destroy();
+          return;
+        }
+        conn.end(payload);
+      }));
+    }));
+    conn._handle.enableKTLS();
+    conn.resume();
+    conn.on('close', common.mustCall(() => {
+      proxy.close();
+      server.close();
+    }));
+  }));
+}));
+
+process.on('exit', () => {
+  if (!ktlsActive)
+    return;
+  assert.strictEqual(received, payload.length);
+  assert(serverEnded);
+  // The last record before the FIN is the alert, not cleartext the kernel
+  // encrypted.
+  assert.strictEqual(lastRecord.type, 23);  // application_data
+  assert.strictEqual(lastRecord.length, kAlertRecordLength);
+});
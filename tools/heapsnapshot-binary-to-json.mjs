@@ -0,0 +1,171 @@
+#!/usr/bin/env node
+
+// Converts a binary heap snapshot (written by triggerHeapSnapshot() with the
+// binary flag, see src/heap_snapshot_binary.h) into the standard
+// .heapsnapshot JSON that Chrome DevTools and other tools can load.
+//
+// Usage: node tools/heapsnapshot-binary-to-json.mjs <input> [<output>]
+//
+// The output defaults to the input path with its .bin extension removed.
+// Both files are processed in fixed-size chunks, so converting a snapshot
+// does not require holding either of them in memory.
+
+import fs from 'node:fs';
+import process from 'node:process';
+
+const kEnd = 0;
+const kArray = 1;
+const kObject = 2;
+const kString = 3;
+const kIntRun = 4;
+const kLiteral = 5;
+
+const kMagic = 'NHSB';
+const kVersion = 1;
+const kChunkSize = 1 << 20;
+
+class Reader {
+  constructor(fd) {
+    this.fd = fd;
+    this.buffer = Buffer.allocUnsafe(kChunkSize);
+    this.length = 0;
+    this.offset = 0;
+  }
+
+  // Returns false at the end of the input.
+  fill() {
+    if (this.offset < this.length) return true;
+    this.length = fs.readSync(this.fd, this.buffer, 0, kChunkSize, null);
+    this.offset = 0;
+    return this.length > 0;
+  }
+
+  byte() {
+    if (!this.fill()) throw new Error('Unexpected end of snapshot');
+    return this.buffer[this.offset++];
+  }
+
+  varint() {
+    // Numbers are used instead of BigInts, snapshot values fit into 53 bits.
+    let value = 0;
+    let scale = 1;
+    let byte;
+    do {
+      byte = this.byte();
+      value += (byte & 0x7f) * scale;
+      scale *= 128;
+    } while (byte & 0x80);
+    return value;
+  }
+
+  bytes(length) {
+    const parts = [];
+    while (length > 0) {
+      if (!this.fill()) throw new Error('Unexpected end of snapshot');
+      const end = Math.min(this.length, this.offset + length);
+      // Copy, the buffer is reused by the next fill().
+      parts.push(Buffer.from(this.buffer.subarray(this.offset, end)));
+      length -= end - this.offset;
+      this.offset = end;
+    }
+    return Buffer.concat(parts);
+  }
+}
+
+class Writer {
+  constructor(fd) {
+    this.fd = fd;
+    this.parts = [];
+    this.size = 0;
+  }
+
+  write(str) {
+    this.parts.push(str);
+    this.size += str.length;
+    if (this.size >= kChunkSize) this.flush();
+  }
+
+  flush() {
+    fs.writeSync(this.fd, this.parts.join(''));
+    this.parts = [];
+    this.size = 0;
+  }
+}
+
+function convert(reader, writer) {
+  const magic = reader.bytes(kMagic.length).toString('latin1');
+  if (magic !== kMagic) throw new Error('Not a binary heap snapshot');
+  const version = reader.byte();
+  if (version !== kVersion) {
+    throw new Error(`Unsupported binary heap snapshot version ${version}`);
+  }
+
+  // For every open container, whether it is an object and how many values
+  // (keys included) it has seen so far.
+  const stack = [];
+  function separator() {
+    const top = stack.at(-1);
+    if (top === undefined) return;
+    if (top.count > 0) {
+      writer.write(top.isObject && top.count % 2 === 1 ? ':' : ',');
+    }
+    top.count++;
+  }
+
+  while (reader.fill()) {
+    const token = reader.byte();
+    switch (token) {
+      case kEnd: {
+        const top = stack.pop();
+        if (top === undefined) throw new Error('Unbalanced snapshot');
+        writer.write(top.isObject ? '}' : ']');
+        // Match V8's layout of one top-level field per line.
+        if (stack.length === 1) writer.write('\n');
+        break;
+      }
+      case kArray:
+      case kObject:
+        separator();
+        writer.write(token === kObject ? '{' : '[');
+        stack.push({ isObject: token === kObject, count: 0 });
+        break;
+      case kString:
+      case kLiteral: {
+        const length = reader.varint();
+        separator();
+        // Strings keep their JSON escapes, so they are copied verbatim.
+        const text = reader.bytes(length).toString('utf8');
+        writer.write(token === kString ? `"${text}"` : text);
+        break;
+      }
+      case kIntRun: {
+        for (let count = reader.varint(); count > 0; count--) {
+          const zigzag = reader.varint();
+          separator();
+          writer.write(String(zigzag % 2 ? -(zigzag + 1) / 2 : zigzag / 2));
+        }
+        break;
+      }
+      default:
+        throw new Error(`Unknown token ${token}`);
+    }
+  }
+  if (stack.length !== 0) throw new Error('Truncated snapshot');
+  writer.flush();
+}
+
+const [input, output = input?.replace(/\.bin$/, '')] = process.argv.slice(2);
+if (input === undefined || output === input) {
+  console.error(
+    'Usage: node tools/heapsnapshot-binary-to-json.mjs <input> [<output>]');
+  process.exit(1);
+}
+
+const inputFd = fs.openSync(input, 'r');
+const outputFd = fs.openSync(output, 'w');
+try {
+  convert(new Reader(inputFd), new Writer(outputFd));
+} finally {
+  fs.closeSync(inputFd);
+  fs.closeSync(outputFd);
+}